@@ -202,14 +202,86 @@
 //                                 -o C:/My_Applications/Temp/automatic
 //                                 -t C:/My_Applications/Temp/trigger
 //
+//  October 2026 : add -threads <n> switch
+//
+//        For imagers (TROPOMI, OMI, GEMS, OMPS), the rows of a scanline are
+//        read one after the other and then fitted in parallel by <n> threads.
+//        The results are saved in the order of the rows, so the output is the
+//        same as without the switch.
+//
+//        The switch is ignored (with a fallback to the sequential analysis)
+//        when an analysis window uses the undersampling correction, applies
+//        the Kurucz calibration on the spectra (shared buffers) or saves its
+//        residuals in a text file (written in the order of the records).  In
+//        that case, and for the other formats, the threads evaluate the numeric
+//        derivatives of the Marquardt-Levenberg fit of each record instead.
+//
+//        add -processes <n> switch
+//
+//        The files to process (-f, project tree) are first collected and sorted
+//        by decreasing size.  <n> worker processes are then forked; each one
+//        prepares its own engine once and pulls files from the shared queue.
+//        A user-defined output file name gets the index of the worker as suffix
+//        (<output>_1, <output>_2, ...); "automatic" output files are unchanged.
+//
+//        add -record-range <first:last>, -shard <k/N> and -merge <output> switches
+//
+//        -record-range restricts the analysis to a range of records of each file
+//        and -shard to the k-th of N parts of this range, cut at scanline
+//        boundaries.  Each shard writes its own output file (<output>_shard<k>of<N>,
+//        so a user-defined output file name is required).  Records outside the
+//        range are written as fill values in the netCDF output, so that the
+//        outputs of the N shards can be merged with
+//
+//           doas_cl -merge <output.nc> -f <output>_shard1of<N>.nc ... -f <output>_shard<N>of<N>.nc
+//
+//        -threads <n> is also used to prepare the rows of imagers at the start
+//        of the session (convolution of the cross sections, Kurucz calibration
+//        and alignment of the reference spectra of each row).  The errors of
+//        the rows are reported in the order of the rows.
+//
+//        Otherwise (ground-based instruments, one row at a time), the threads
+//        fit the sub-windows of the Kurucz calibration at the same time.
+//
+//        add -qr-update switch
+//
+//        In the Marquardt-Levenberg fits, the QR decomposition of the columns of
+//        the linear system that don't depend on the non linear parameters
+//        (polynomial, cross sections without their own shift or stretch) is
+//        calculated once per fit; only the other columns are decomposed at each
+//        iteration.  Results are the same up to rounding errors.
+//
+//        add -warm-start switch
+//
+//        The non linear parameters (shifts, stretches, offsets...) of an analysis
+//        window start from the last converged fit of the same window and row
+//        (previous scanline for imagers, previous spectrum of the scan for
+//        MAX-DOAS) instead of the initial values of the project.  The initial
+//        values are used again after a failed fit, a jump of the chi square or a
+//        change of reference.  Results agree within the convergence criterion.
+//
+//        add -preload-l1 <MB> switch
+//
+//        For TROPOMI, GEMS and OMPS orbit files, the spectra (radiances, noise,
+//        wavelengths and bad pixel masks as read by each format) are read by a
+//        background thread in large sequential chunks of scanlines, ahead of
+//        the records analysed, with at most <MB> megabytes in memory.  The
+//        records are then taken from memory instead of one hyperslab each.
+//
 //  ----------------------------------------------------------------------------
 //
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <iostream>
 #include <memory>
+#include <new>
 #include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 #include <QXmlInputSource>
 #include <QXmlSimpleReader>
 #include <QXmlStreamReader>
@@ -229,6 +301,8 @@
 #else
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <termios.h>
 
 // kbhit function doesn't exist in Linux libraries (implementation found on the web)
@@ -288,7 +362,8 @@ enum RunMode {
   None,
   Error,
   Help,
-  Batch
+  Batch,
+  Merge
 };
 
 enum BatchTool {
@@ -308,6 +383,7 @@ typedef struct commands
   QList<QString> xmlCommands;
   QString outputDir;
   QString calibDir;
+  QString mergeFile;
 } commands_t;
 
 // -----------------------------------------------------------------------------
@@ -514,9 +590,11 @@ enum BatchTool requiredBatchTool(const QString &filename);
 void showUsage();
 void showHelp();
 int  batchProcess(commands_t *cmd);
+int  mergeShards(commands_t *cmd);
 
 int batchProcessQdoas(commands_t *cmd);
 int readConfigQdoas(commands_t *cmd, QList<const CProjectConfigItem*> &projectItems);
+int shardOutput(const CProjectConfigItem *projItem, const QString &outputDir, QString &output);
 int analyseProjectQdoasPrepare(void **engineContext, const CProjectConfigItem *projItem, const QString &outputDir,const QString &calibDir,
                    CBatchEngineController *controller);
 
@@ -529,13 +607,20 @@ int calibSaveSwitch=0;
 int xmlSwitch=0;
 int triggerSwitch=0;
 int verboseMode=0;
+int threadsNumber=1;
+int qrUpdateSwitch=0;
+int warmStartSwitch=0;
+int preloadL1Size=0;              // -preload-l1 <MB> (0 to read the spectra record by record)
+int processesNumber=1;
+int recordFirst=0,recordLast=0;   // -record-range first:last (0 for no limit)
+int shardIndex=0,shardsNumber=1;  // -shard k/N (k from 1 to N)
 
 
 class QdoasBatch {
 
 public:
   QdoasBatch(const CProjectConfigItem *projItem, const QString &outputDir, const QString &calibDir, int& rc) :
-    projItem(projItem), outputDir(outputDir), calibDir(calibDir), have_enginecontext(false), rc(rc), files_processed(0) {
+    projItem(projItem), outputDir(outputDir), calibDir(calibDir), have_enginecontext(false), rc(rc), files_processed(0), queue_only(false) {
   };
 
   ~QdoasBatch() {
@@ -560,11 +645,21 @@ public:
 
   int analyse_file(const QString &filename);
 
+  int analyse_scanlines(int nWorkers);
+
   int analyse_directory(const QString &dir, const QString &filter, bool recursive);
 
   int analyse_treeNode(const CProjectConfigTreeNode *node);
 
+  // multi-process mode : first collect the files to process (analyse_file only
+  // queues them), then distribute the queue over worker processes
+  void queue_files() { queue_only = true; }
+
+  int analyse_queue(int nProcesses);
+
 private:
+  QString worker_output(int indexWorker) const;
+
   CBatchEngineController controller;
   std::unique_ptr<const CProjectConfigItem> projItem;
   const QString &outputDir;
@@ -573,6 +668,8 @@ private:
   bool have_enginecontext;
   int& rc; // for final return code from destructor
   size_t files_processed; // count number of files found for processing
+  bool queue_only; // if true, analyse_file adds the file to file_queue
+  QList<QString> file_queue;
 };
 
 //-------------------------------------------------------------------
@@ -613,6 +710,9 @@ int main(int argc, char **argv)
     case Batch:
       retCode = batchProcess(&cmd);
       break;
+    case Merge:
+      retCode = mergeShards(&cmd);
+      break;
     }
   }
 
@@ -737,6 +837,83 @@ enum RunMode parseCommandLine(int argc, char **argv, commands_t *cmd)
       else if (!strcmp(argv[i],"-v"))
        verboseMode=1;
       // -----------------------------------------------------------------------
+      // number of threads for the analysis of the rows of a scanline ...
+      else if (!strcmp(argv[i],"-threads")) {
+        if (++i < argc && argv[i][0] != '-' && atoi(argv[i]) > 0) {
+          threadsNumber=atoi(argv[i]);
+        }
+        else {
+          runMode = Error;
+          std::cerr << "Option '-threads' requires a positive number as argument." << std::endl;
+        }
+      }
+      // -----------------------------------------------------------------------
+      // decompose only the columns of the fit that change with the non linear parameters ...
+      else if (!strcmp(argv[i],"-qr-update"))
+       qrUpdateSwitch=1;
+      // -----------------------------------------------------------------------
+      // start the non linear fits from the last converged fit of the same window and row ...
+      else if (!strcmp(argv[i],"-warm-start"))
+       warmStartSwitch=1;
+      // -----------------------------------------------------------------------
+      // memory budget for the preload of the spectra of L1B orbit files ...
+      else if (!strcmp(argv[i],"-preload-l1")) {
+        if (++i < argc && argv[i][0] != '-' && atoi(argv[i]) > 0) {
+          preloadL1Size=atoi(argv[i]);
+        }
+        else {
+          runMode = Error;
+          std::cerr << "Option '-preload-l1' requires a positive number of MB as argument." << std::endl;
+        }
+      }
+      // -----------------------------------------------------------------------
+      // number of worker processes sharing the list of files to process ...
+      else if (!strcmp(argv[i],"-processes")) {
+        if (++i < argc && argv[i][0] != '-' && atoi(argv[i]) > 0) {
+          processesNumber=atoi(argv[i]);
+        }
+        else {
+          runMode = Error;
+          std::cerr << "Option '-processes' requires a positive number as argument." << std::endl;
+        }
+      }
+      // -----------------------------------------------------------------------
+      // range of records to process in each file ...
+      else if (!strcmp(argv[i],"-record-range")) {
+        if (++i < argc && (sscanf(argv[i], "%d:%d", &recordFirst, &recordLast) == 2) &&
+            (recordFirst >= 0) && (recordLast >= 0) && (!recordLast || (recordFirst <= recordLast))) {
+          fileSwitch=0;
+        }
+        else {
+          runMode = Error;
+          std::cerr << "Option '-record-range' requires an argument first:last (record numbers, 0 for no limit)." << std::endl;
+        }
+      }
+      // -----------------------------------------------------------------------
+      // part of the records of each file to process ...
+      else if (!strcmp(argv[i],"-shard")) {
+        if (++i < argc && (sscanf(argv[i], "%d/%d", &shardIndex, &shardsNumber) == 2) &&
+            (shardsNumber >= 1) && (shardIndex >= 1) && (shardIndex <= shardsNumber)) {
+          fileSwitch=0;
+        }
+        else {
+          runMode = Error;
+          std::cerr << "Option '-shard' requires an argument k/N with 1<=k<=N." << std::endl;
+        }
+      }
+      // -----------------------------------------------------------------------
+      // merge the netCDF output files of the shards of an input file ...
+      else if (!strcmp(argv[i],"-merge")) {
+        if (++i < argc && argv[i][0] != '-') {
+          fileSwitch=0;
+          cmd->mergeFile = argv[i];
+        }
+        else {
+          runMode = Error;
+          std::cerr << "Option '-merge' requires an argument (merged output file)." << std::endl;
+        }
+      }
+      // -----------------------------------------------------------------------
       // output directory ...
       else if (!strcmp(argv[i], "-o")) {
         if (++i < argc && argv[i][0] != '-') {
@@ -773,6 +950,23 @@ enum RunMode parseCommandLine(int argc, char **argv, commands_t *cmd)
     triggerSwitch=0;
    }
 
+  if ((processesNumber>1) && triggerSwitch)
+   {
+    std::cerr << "Warning : -processes switch ignored in triggering mode" << std::endl;
+    processesNumber=1;
+   }
+
+  if ((runMode!=Error) && (runMode!=Help) && !cmd->mergeFile.isEmpty())
+   {
+    if (cmd->filenames.isEmpty())
+     {
+      runMode = Error;
+      std::cerr << "Option '-merge' requires the output files of the shards (-f <file> ...)." << std::endl;
+     }
+    else
+     runMode = Merge;
+   }
+
   // consistency checks ??
 
   return runMode;
@@ -855,6 +1049,37 @@ void showUsage()
     "\n"
     "    -v                  : verbose on (default is off)\n"
     "\n"
+    "    -threads <n>        : for QDoas analysis of imagers (TROPOMI, OMI, GEMS, OMPS),\n"
+    "                          prepare the rows and fit the rows of a scanline with\n"
+    "                          <n> threads; otherwise, evaluate the derivatives of\n"
+    "                          each fit and the sub-windows of the Kurucz calibration\n"
+    "                          with <n> threads\n"
+    "\n"
+    "    -qr-update          : for QDoas, only decompose again the columns of the fit\n"
+    "                          that change with the non linear parameters\n"
+    "\n"
+    "    -warm-start         : for QDoas, start the non linear parameters of each fit\n"
+    "                          from the last converged fit of the same analysis window\n"
+    "                          and row\n"
+    "\n"
+    "    -preload-l1 <MB>    : for QDoas, read the spectra of TROPOMI, GEMS and OMPS\n"
+    "                          files in large sequential chunks in the background,\n"
+    "                          with at most <MB> megabytes in memory\n"
+    "\n"
+    "    -processes <n>      : for QDoas, distribute the files to process over <n>\n"
+    "                          processes (largest files first); each process writes\n"
+    "                          its own output file\n"
+    "\n"
+    "    -record-range <first:last> : for QDoas, only process records first to last\n"
+    "                          of each file (0 for no limit)\n"
+    "    -shard <k/N>        : for QDoas, only process the k-th of N parts (complete\n"
+    "                          scanlines) of the records of each file; the output\n"
+    "                          file name (-o) gets the suffix _shard<k>of<N>\n"
+    "                          (not supported for automatic output files nor for\n"
+    "                          MAX-DOAS netCDF output of successful records only)\n"
+    "    -merge <output> -f <shard output>... : merge the netCDF output files of the\n"
+    "                          shards of a file into <output>\n"
+    "\n"
     "    -xml <path=value>   : advanced option to replace the values of some options \n"
     "                          in the configuration file by new ones.\n"
     "    -t, -trigger <path=value> : advanced option to trigger the files to process\n"
@@ -884,7 +1109,15 @@ int batchProcessQdoas(commands_t *cmd)
 
   int rc_batch = 0;
   while (!projectItems.isEmpty() && retCode == 0) {
-    QdoasBatch batch(projectItems.takeFirst(), cmd->outputDir, cmd->calibDir, rc_batch);
+    QString output = cmd->outputDir;
+    if ((shardsNumber > 1) && (shardOutput(projectItems.first(), cmd->outputDir, output) != 0)) {
+      retCode = -1;
+      break;
+    }
+    QdoasBatch batch(projectItems.takeFirst(), output, cmd->calibDir, rc_batch);
+    if (processesNumber > 1) {
+      batch.queue_files();
+    }
     if (triggerSwitch) {
       retCode = batch.analyse_project(cmd->triggerDir);
     } else if (!cmd->filenames.isEmpty()) {
@@ -898,6 +1131,9 @@ int batchProcessQdoas(commands_t *cmd)
     } else {
       retCode = batch.analyse_project();
     }
+    if (!retCode && (processesNumber > 1)) {
+      retCode = batch.analyse_queue(processesNumber);
+    }
   }
 
   // Check for error from QdoasBatch destructor
@@ -912,6 +1148,29 @@ int batchProcessQdoas(commands_t *cmd)
   return retCode;
 }
 
+// output of a shard (-shard k/N) : the shards of a file are analysed by different
+// processes, so a user-defined output file name gets the index of the shard as
+// suffix (<output>_shard<k>of<N>); "automatic" output files are built from the
+// name of the input file only and would be overwritten by the other shards
+
+int shardOutput(const CProjectConfigItem *projItem, const QString &outputDir, QString &output)
+{
+  QString path = (!outputDir.isEmpty()) ? outputDir : QString(projItem->properties()->output.path);
+  QFileInfo info(path);
+
+  if (path.isEmpty() || info.isDir() || !info.fileName().compare("automatic", Qt::CaseInsensitive)) {
+    std::cerr << "ERROR: Option '-shard' requires an output file name (-o <file>), the shards of a file can't share automatic output files." << std::endl;
+    return -1;
+  }
+
+  QString suffix = info.suffix();
+  QString base = (suffix.isEmpty()) ? path : path.left(path.size() - suffix.size() - 1);
+  QString name = base + QString("_shard%1of%2").arg(shardIndex).arg(shardsNumber);
+
+  output = (suffix.isEmpty()) ? name : name + "." + suffix;
+  return 0;
+}
+
 int readConfigQdoas(commands_t *cmd, QList<const CProjectConfigItem*> &projectItems)
 {
   // read the configuration file
@@ -1123,6 +1382,8 @@ int analyseProjectQdoasPrepare(void **engineContext, const CProjectConfigItem *p
         nWindows--;
       }
     }
+    // prepare the rows of imagers (convolution, calibration of the reference) with -threads <n> threads
+    mediateRequestSetSetupThreads(threadsNumber);
     int rc = mediateRequestSetAnalysisWindows(*engineContext, nWindows, awDataList, (!calibSwitch)?THREAD_TYPE_ANALYSIS:THREAD_TYPE_KURUCZ, msgResp);
     msgResp->process(controller);
     if (rc != 0) {
@@ -1177,6 +1438,12 @@ int QdoasBatch::analyse_file(const QString &filename) {
     std::cout << "Processing file " << filename.toStdString() << std::endl;
 
   ++files_processed;
+
+  if (queue_only) {
+    file_queue.push_back(filename);
+    return 0;
+  }
+
   int retCode = 0;
   // If this is the first file we process, we still have to run analyseProjectQdoasPrepare()
   if (!have_enginecontext) {
@@ -1196,15 +1463,47 @@ int QdoasBatch::analyse_file(const QString &filename) {
                                         filename.toLocal8Bit().constData(), &beginFileResp)
     : mediateRequestBeginCalibrateSpectra(engineContext, filename.toLocal8Bit().constData(), &beginFileResp);
 
+  if ((result > 0) && (recordFirst || recordLast || (shardsNumber > 1)) &&
+      (mediateRequestSetRecordRange(engineContext,
+                                    recordFirst ? recordFirst : projItem->properties()->selection.recordNumberMinimum,
+                                    recordLast ? recordLast : projItem->properties()->selection.recordNumberMaximum,
+                                    shardIndex - 1, shardsNumber, &beginFileResp) == -1))
+    result = -1;
+
   beginFileResp.setNumberOfRecords(result);
   beginFileResp.process(&controller);
 
   if (result == -1)
     return 1;
 
+  mediateRequestSetQRUpdate(qrUpdateSwitch);
+  mediateRequestSetWarmStart(warmStartSwitch);
+  mediateRequestSetPreloadL1(preloadL1Size);
+
+  // analyse the rows of each scanline in parallel if requested and possible
+
+  int nWorkers = 0;
+  if (!calibSwitch && (threadsNumber > 1)) {
+    CEngineResponseMessage workersResp;
+    nWorkers = mediateRequestBeginAnalyseScanlines(engineContext, threadsNumber, &workersResp);
+    workersResp.process(&controller);
+
+    if (nWorkers == -1)
+      retCode = 1;
+    else if (nWorkers > 0) {
+      mediateRequestSetFitThreads(1);
+      retCode = analyse_scanlines(nWorkers);
+    }
+  }
+
+  // records analysed one after the other : use the threads for the derivatives of each fit
+
+  if (nWorkers == 0)
+    mediateRequestSetFitThreads(threadsNumber);
+
   int oldResult=-1;
   // loop based on the controller ...
-  while (!retCode && controller.active() && (result!=oldResult)) {
+  while (!retCode && (nWorkers == 0) && controller.active() && (result!=oldResult)) {
     CEngineResponseSpecificRecord resp;
 
     oldResult=result;
@@ -1229,6 +1528,137 @@ int QdoasBatch::analyse_file(const QString &filename) {
   return retCode;
 }
 
+int QdoasBatch::analyse_scanlines(int nWorkers) {
+  int retCode = 0;
+
+  while (!retCode && controller.active()) {
+    CEngineResponseSpecificRecord readResp;
+
+    // rows of the scanline are read one after the other ...
+    int nRows = mediateRequestNextMatchingAnalyseScanline(engineContext, &readResp);
+    readResp.process(&controller);
+
+    if (nRows <= 0) {
+      if (nRows == -1)
+        retCode = 1;
+      break;
+    }
+
+    // ... fitted by the workers, each row with its own response ...
+    std::vector<CEngineResponseSpecificRecord> rowResp(nRows);
+    std::vector<std::thread> workers;
+    std::atomic<int> nextRow(0);
+
+    for (int indexWorker = 0; indexWorker < std::min(nWorkers, nRows); ++indexWorker) {
+      workers.emplace_back([&, indexWorker]() {
+          for (int indexRow = nextRow++; indexRow < nRows; indexRow = nextRow++)
+            mediateRequestAnalyseScanlineRow(indexRow, indexWorker, &rowResp[indexRow]);
+        });
+    }
+    for (auto& worker : workers)
+      worker.join();
+
+    // ... and saved in order
+    for (int indexRow = 0; indexRow < nRows; ++indexRow) {
+      int result = mediateRequestSaveScanlineRow(engineContext, indexRow, &rowResp[indexRow]);
+      rowResp[indexRow].setRecordNumber(result);
+      if (result == -1)
+        retCode = 1;
+      else if (verboseMode)
+        std::cout << "  completed record " << result << std::endl;
+      rowResp[indexRow].process(&controller);
+    }
+  }
+
+  mediateRequestEndAnalyseScanlines();
+  return retCode;
+}
+
+// output of a worker process : a user-defined output file name gets the index
+// of the worker as suffix, "automatic" output files are already built from the
+// name of the input files
+
+QString QdoasBatch::worker_output(int indexWorker) const {
+  QString path = (!outputDir.isEmpty()) ? outputDir : QString(projItem->properties()->output.path);
+  QFileInfo info(path);
+
+  if (path.isEmpty() || info.isDir() || !info.fileName().compare("automatic", Qt::CaseInsensitive))
+    return path;
+
+  QString suffix = info.suffix();
+  QString base = (suffix.isEmpty()) ? path : path.left(path.size() - suffix.size() - 1);
+  QString name = base + QString("_%1").arg(indexWorker + 1);
+
+  return (suffix.isEmpty()) ? name : name + "." + suffix;
+}
+
+int QdoasBatch::analyse_queue(int nProcesses) {
+  queue_only = false;
+
+  // largest files first for a better load balancing
+  std::stable_sort(file_queue.begin(), file_queue.end(), [](const QString &a, const QString &b) {
+      return QFileInfo(a).size() > QFileInfo(b).size();
+    });
+
+#ifdef _WIN32
+  std::cerr << "Warning : -processes switch not supported on Windows; files are processed sequentially" << std::endl;
+  int retCode = 0;
+  for (const auto& filename : file_queue)
+    retCode = analyse_file(filename);
+  return retCode;
+#else
+  nProcesses = std::min(nProcesses, file_queue.size());
+
+  // index of the next file to process, shared by the worker processes
+  void *shared = mmap(NULL, sizeof(std::atomic<int>), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED) {
+    std::cerr << "ERROR: failed to create the queue shared by the worker processes." << std::endl;
+    return 1;
+  }
+  std::atomic<int> *next_file = new (shared) std::atomic<int>(0);
+
+  std::cout.flush();
+  std::cerr.flush();
+
+  std::vector<pid_t> workers;
+  int retCode = 0;
+
+  for (int indexWorker = 0; indexWorker < nProcesses; ++indexWorker) {
+    pid_t pid = fork();
+
+    if (pid == 0) {
+      // worker process : prepare the engine once and pull files from the queue
+      QString output = worker_output(indexWorker);
+      int rc_worker = 0;
+      int rc_files = 0;
+      {
+        QdoasBatch worker(projItem.release(), output, calibDir, rc_worker);
+        for (int indexFile = (*next_file)++; indexFile < file_queue.size(); indexFile = (*next_file)++) {
+          if (worker.analyse_file(file_queue[indexFile]))
+            rc_files = 1;
+        }
+      }
+      std::cout.flush();
+      _exit((rc_files || rc_worker) ? 1 : 0);
+    } else if (pid < 0) {
+      std::cerr << "ERROR: failed to start worker process " << indexWorker + 1 << "." << std::endl;
+      retCode = 1;
+      break;
+    }
+    workers.push_back(pid);
+  }
+
+  for (pid_t pid : workers) {
+    int status = 0;
+    if ((waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+      retCode = 1;
+  }
+
+  munmap(shared, sizeof(std::atomic<int>));
+  return retCode;
+#endif
+}
+
 int QdoasBatch::analyse_treeNode(const CProjectConfigTreeNode *node) {
   int retCode = 0;
 
@@ -1287,6 +1717,25 @@ int QdoasBatch::analyse_directory(const QString &dir, const QString &filter, boo
   return retCode;
 }
 
+int mergeShards(commands_t *cmd)
+{
+  std::vector<std::string> shardFiles;
+  std::vector<const char *> shardNames;
+
+  for (const auto& filename : cmd->filenames)
+    shardFiles.push_back(filename.toLocal8Bit().constData());
+  for (const auto& filename : shardFiles)
+    shardNames.push_back(filename.c_str());
+
+  CBatchEngineController controller;
+  CEngineResponseMessage resp;
+
+  int retCode = mediateRequestMergeShards(cmd->mergeFile.toLocal8Bit().constData(), shardNames.data(), shardNames.size(), &resp);
+
+  resp.process(&controller);
+  return (retCode != 0) ? 1 : 0;
+}
+
 int batchProcessConvolution(commands_t *cmd)
 {
   TRACE("batchProcessConvolution");
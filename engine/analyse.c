@@ -47,8 +47,13 @@
 //
 //  ANALYSE_SvdInit - all parameters initialization for best Shift and Stretch determination and concentrations computation;
 //  Function - cross sections and spectrum alignment using spline fitting functions and new Yfit computation;
+//  ANALYSE_SetQRUpdate - keep the decomposition of the columns that don't change during a fit;
+//  ANALYSE_FunctionDeriv - analytic derivatives of the fitting function in the shift, stretch and offset of spectrum and reference;
 //  NumDeriv - derivatives computation;
 //  DerivFunc - set derivatives for non linear parameters;
+//  ANALYSE_SetWarmStart - start the fits from the last converged fit of the same window and row;
+//  AnalyseWarmStartGet - initialize the non linear parameters from the last converged fit;
+//  AnalyseWarmStartSet - keep the non linear parameters of a converged fit;
 //  ANALYSE_CurFitMethod - make a least-square fit to a non linear function;
 //
 //  ANALYSE_AlignReference - align reference spectrum on etalon;
@@ -153,6 +158,11 @@
 #include "matrix_netcdf_read.h"
 #include "visual_c_compat.h"
 
+#ifdef _MSC_VER
+// Older Visual C does not know C99 restrict keyword
+#define restrict
+#endif
+
 // ===================
 // Global DECLARATIONS
 // ===================
@@ -160,36 +170,28 @@
 #define ANALYSE_LONGPATH 0                                                      // 0 normal mode, 1 for Anoop specific needs
 #define MAX_REPEAT_CURFIT 3
 
-PROJECT *PRJCT_itemList;
+// Scratch vectors needed at the same time by the fitting function : 6 buffers in ANALYSE_Function,
+// 8 in ANALYSE_FunctionDeriv, the filter (2) and the numeric derivatives in Curfit (2)
 
-doas_spectrum *global_doas_spectrum; // Should better remove this global variable.
+#define ANALYSE_SCRATCH_SIZE(size) (12*((size)+1)+2*(MAX_FIT*4+1))
+
+PROJECT *PRJCT_itemList;
 
 int    ANALYSE_plotKurucz,ANALYSE_plotRef,ANALYSE_indexLine;
 
 int NFeno;                             // number of analysis windows
 
-int SvdPDeb,SvdPFin,                   // analysis window limits
-  LimMin,LimMax,LimN;
-
 WRK_SYMBOL *WorkSpace;                 // list of symbols in a project
 int NWorkSpace;
-FENO **TabFeno,*Feno;                  // list of analysis windows in a project
+FENO **TabFeno;                        // list of analysis windows in a project
 
 int ANALYSE_swathSize=0;
 
-double *x,*Lambda,*LambdaSpec,
-  *ANALYSE_pixels,
-  *ANALYSE_splineX,              // abscissa used for spectra, in the units selected by user
-  *ANALYSE_absolu,               // residual spectrum
-  *ANALYSE_secX,                 // residual spectrum + the contribution of a cross section for fit display
-  *ANALYSE_t,                    // residual transmission in Marquardt-Levenberg not linear method
-  *ANALYSE_tc,                   // residual transmission in Marquardt-Levenberg not linear method
-  *ANALYSE_xsTrav,               // temporary buffer for processing on cross sections
-  *ANALYSE_xsTrav2,              // cross sections second derivatives
-  *ANALYSE_shift,
+double *ANALYSE_pixels,
   *ANALYSE_zeros,
   *ANALYSE_ones;
-double   ANALYSE_nFree;                // number of free degrees
+
+struct analysis_workspace ANALYSE_mainWorkspace;                               // per-fit buffers for the sequential processing
 
 MATRIX_OBJECT ANALYSIS_slitMatrix[NSFP],ANALYSIS_slitK;
 double ANALYSIS_slitParam[NSFP];
@@ -199,10 +201,6 @@ USAMP  ANALYSE_usampBuffers;
 // STATIC DECLARATIONS
 // ===================
 
-int NOrtho,
-  *OrthoSet,
-  hFilterSpecLog,hFilterRefLog;
-
 int NDET[MAX_SWATHSIZE];
 // description of an analysis windows
 
@@ -212,19 +210,6 @@ PRJCT_SLIT   *pSlitOptions;            // slit function options
 PRJCT_KURUCZ *pKuruczOptions;          // Kurucz options
 PRJCT_USAMP  *pUsamp;                  // undersampling options
 
-double *Fitp,
-  *FitDeltap,
-  *FitMinp,
-  *FitMaxp,
-  *a,
-  *b,
-  *Sigma,
-  *SplineSpec,
-  *SplineRef,
-  StretchFact1,StretchFact2,
-  Square,
-  ZM,TDET;
-
 // Internal variables
 
 int KuruczUseRef=0;   // 0 if spectrum is shifted, 1 if reference is shifted
@@ -233,6 +218,11 @@ int analyseDebugMask=0;
 int analyseDebugVar=0;
 INDEX analyseIndexRecord;
 
+static int analyseQRUpdate=0;                                                   // update the decomposition of the fit with the columns that change only (see ANALYSE_SetQRUpdate)
+static int analyseWarmStart=0;                                                  // start the non linear fits from the previous converged fit (see ANALYSE_SetWarmStart)
+
+#define ANALYSE_WARM_START_CHISQR_JUMP  (double)4.                              // maximum ratio between the chi square of a warm started fit and the one of the fit it started from
+
 // =================
 // UTILITY FUNCTIONS
 // =================
@@ -291,14 +281,14 @@ static inline double root_mean_square(const double * array, const doas_spectrum
 }
 
 // Return the wavelength of the center pixel of the analysis window
-// (SvdPDeb + SvdPFin)/2.  If this is in the middle of 2 pixels,
+// (first + last)/2.  If this is in the middle of 2 pixels,
 // return the average wavelength of those pixels.
-inline double center_pixel_wavelength(int first, int last) {
+inline double center_pixel_wavelength(const double *lambda,int first, int last) {
   int center = (first + last)/2;
   if ( (first + last) %2) {
-    return 0.5*(ANALYSE_splineX[center] + ANALYSE_splineX[1+center]);
+    return 0.5*(lambda[center] + lambda[1+center]);
   } else {
-    return ANALYSE_splineX[center];
+    return lambda[center];
   }
 }
 
@@ -341,13 +331,13 @@ bool remove_spikes(double *residuals,
   return spikes;
  }
 
-int reinit_analysis(FENO *pFeno, const int n_wavel) {
+int reinit_analysis(struct analysis_workspace *ws,FENO *pFeno, const int n_wavel) {
   pFeno->fit_properties.DimL = spectrum_length(pFeno->fit_properties.specrange);
   pFeno->Decomp = 1;
 
-  memcpy(ANALYSE_absolu, ANALYSE_zeros, sizeof(double) * n_wavel);
+  memcpy(ws->absolu, ANALYSE_zeros, sizeof(double) * n_wavel);
 
-  return ANALYSE_SvdInit(pFeno,&pFeno->fit_properties, n_wavel, Lambda);
+  return ANALYSE_SvdInit(ws,pFeno,&pFeno->fit_properties, n_wavel, ws->lambda);
  }
 
 void AnalyseGetFenoLim(FENO *pFeno,INDEX *pLimMin,INDEX *pLimMax, const int n_wavel)
@@ -1049,25 +1039,31 @@ void Analyse_Molecular_Ring_End(FENO *pFeno,int n_wavel)
 // indexColumn: column index in A of the vector we want to orghogonalize
 // A[..][1..DimL]: vectors
 // DimL: vector dimension
-void OrthogonalizeVector(const int *OrthoSet, const double *NormSet,int NOrthoSet,INDEX indexColumn,double **A,int DimL) {
+//
+// The columns of A are contiguous (FIT_PROPERTIES_alloc), the loops work on
+// plain pointers to let the compiler vectorize them.
+void OrthogonalizeVector(const struct analysis_workspace *ws,const int *OrthoSet, const double *NormSet,int NOrthoSet,INDEX indexColumn,double **A,int DimL) {
+  double *restrict v=&A[indexColumn][1];
+
   for (int j=0;j<NOrthoSet;j++) {
 
     if (NormSet[j]!=0.) {
-      const int indexSvd=Feno->TabCross[OrthoSet[j]].IndSvdA;
+      const int indexSvd=ws->feno->TabCross[OrthoSet[j]].IndSvdA;
+      const double *restrict u=&A[indexSvd][1];
 
       double dot = 0.;
-      for (int i=1;i<=DimL;i++)
-        dot+=A[indexSvd][i]*A[indexColumn][i];
+      for (int i=0;i<DimL;i++)
+        dot+=u[i]*v[i];
 
       dot /=NormSet[j];
 
-      for (int i=1;i<=DimL;i++)
-        A[indexColumn][i]-=dot*A[indexSvd][i];
+      for (int i=0;i<DimL;i++)
+        v[i]-=dot*u[i];
     }
   }
 }
 
-static void OrthogonalizeToCross(int indexCross,double *NormSet,int currentNOrtho, double **A, int DimL) {
+static void OrthogonalizeToCross(const struct analysis_workspace *ws,int indexCross,double *NormSet,int currentNOrtho, double **A, int DimL) {
   // Declarations
 
   CROSS_REFERENCE *pTabCross;
@@ -1077,21 +1073,21 @@ static void OrthogonalizeToCross(int indexCross,double *NormSet,int currentNOrth
   DEBUG_FunctionBegin(__func__,DEBUG_FCTTYPE_UTIL);
 #endif
 
-  for (indexTabCross=0;indexTabCross<Feno->NTabCross;indexTabCross++) {
-    pTabCross=&Feno->TabCross[indexTabCross];
+  for (indexTabCross=0;indexTabCross<ws->feno->NTabCross;indexTabCross++) {
+    pTabCross=&ws->feno->TabCross[indexTabCross];
 
     if (pTabCross->IndOrthog==indexCross) {
-      OrthoSet[currentNOrtho]=indexCross;
-      NormSet[currentNOrtho]=VECTOR_Norm(A[Feno->TabCross[indexCross].IndSvdA],DimL);
+      ws->orthoSet[currentNOrtho]=indexCross;
+      NormSet[currentNOrtho]=VECTOR_Norm(A[ws->feno->TabCross[indexCross].IndSvdA],DimL);
 
       if ((ANALYSE_phFilter->filterFunction==NULL) ||
-          (!Feno->hidden && !ANALYSE_phFilter->hpFilterAnalysis) ||
-          ((Feno->hidden==1) && !ANALYSE_phFilter->hpFilterCalib))
-        OrthogonalizeVector(OrthoSet,NormSet,currentNOrtho+1,pTabCross->IndSvdA,A,DimL);
+          (!ws->feno->hidden && !ANALYSE_phFilter->hpFilterAnalysis) ||
+          ((ws->feno->hidden==1) && !ANALYSE_phFilter->hpFilterCalib))
+        OrthogonalizeVector(ws,ws->orthoSet,NormSet,currentNOrtho+1,pTabCross->IndSvdA,A,DimL);
       else
-        OrthogonalizeVector(&OrthoSet[NOrtho],&NormSet[NOrtho],currentNOrtho-NOrtho+1,pTabCross->IndSvdA,A,DimL);
+        OrthogonalizeVector(ws,&ws->orthoSet[ws->nOrtho],&NormSet[ws->nOrtho],currentNOrtho-ws->nOrtho+1,pTabCross->IndSvdA,A,DimL);
 
-      OrthogonalizeToCross(indexTabCross,NormSet,currentNOrtho+1,A,DimL);
+      OrthogonalizeToCross(ws,indexTabCross,NormSet,currentNOrtho+1,A,DimL);
     }
   }
 
@@ -1104,7 +1100,7 @@ static void OrthogonalizeToCross(int indexCross,double *NormSet,int currentNOrth
 // Differences between two cross sections
 // --------------------------------------
 
-static void XsDifferences(double **A,int DimL)
+static void XsDifferences(const struct analysis_workspace *ws,double **A,int DimL)
  {
   // Declarations
 
@@ -1112,13 +1108,13 @@ static void XsDifferences(double **A,int DimL)
 
   // Subtraction
 
-  for (int j=0;j<Feno->NTabCross;j++)   // Index in the WorkSpace symbols list -> use IndSvdA to have indexes in the matrix
+  for (int j=0;j<ws->feno->NTabCross;j++)   // Index in the WorkSpace symbols list -> use IndSvdA to have indexes in the matrix
    {
-    pTabCross=&Feno->TabCross[j];
+    pTabCross=&ws->feno->TabCross[j];
 
     if (pTabCross->IndSvdA && (pTabCross->IndSubtract!=ITEM_NONE))
      for (int i=1;i<=DimL;i++)
-      A[pTabCross->IndSvdA][i]=A[Feno->TabCross[pTabCross->IndSubtract].IndSvdA][i]-A[pTabCross->IndSvdA][i];
+      A[pTabCross->IndSvdA][i]=A[ws->feno->TabCross[pTabCross->IndSubtract].IndSvdA][i]-A[pTabCross->IndSvdA][i];
    }
  }
 
@@ -1126,39 +1122,39 @@ static void XsDifferences(double **A,int DimL)
 // Orthogonalization : Orthogonalization of matrix A processing
 // ------------------------------------------------------------
 
-static void Orthogonalization(double **A, int DimL) {
-  if (NOrtho) { // if no orthogonal base, cross sections can not be orthogonalized to another cross section
+static void Orthogonalization(const struct analysis_workspace *ws,double **A, int DimL) {
+  if (ws->nOrtho) { // if no orthogonal base, cross sections can not be orthogonalized to another cross section
 
-    double *NormSet = malloc(Feno->NTabCross * sizeof(*NormSet));
+    double *NormSet = malloc(ws->feno->NTabCross * sizeof(*NormSet));
 
-    NormSet[0]=VECTOR_Norm(A[Feno->TabCross[OrthoSet[0]].IndSvdA],DimL);
-    for (int i=1;i<NOrtho;++i) {
+    NormSet[0]=VECTOR_Norm(A[ws->feno->TabCross[ws->orthoSet[0]].IndSvdA],DimL);
+    for (int i=1;i<ws->nOrtho;++i) {
       // orthogonalize vector i w.r.t. vectors 0..i-1:
-      OrthogonalizeVector(OrthoSet,NormSet,i,Feno->TabCross[OrthoSet[i]].IndSvdA,A,DimL);
+      OrthogonalizeVector(ws,ws->orthoSet,NormSet,i,ws->feno->TabCross[ws->orthoSet[i]].IndSvdA,A,DimL);
       // calculate norm of orthogonalized vector i:
-      NormSet[i]=VECTOR_Norm(A[Feno->TabCross[OrthoSet[i]].IndSvdA],DimL);
+      NormSet[i]=VECTOR_Norm(A[ws->feno->TabCross[ws->orthoSet[i]].IndSvdA],DimL);
     }
 
     // Orthogonalization to base only
 
     if ((ANALYSE_phFilter->filterFunction==NULL) ||
-        (!Feno->hidden && !ANALYSE_phFilter->hpFilterAnalysis) ||
-        ((Feno->hidden==1) && !ANALYSE_phFilter->hpFilterCalib))
+        (!ws->feno->hidden && !ANALYSE_phFilter->hpFilterAnalysis) ||
+        ((ws->feno->hidden==1) && !ANALYSE_phFilter->hpFilterCalib))
 
-      for (int j=0;j<Feno->NTabCross;j++) {
-        CROSS_REFERENCE *pTabCross=&Feno->TabCross[j];
+      for (int j=0;j<ws->feno->NTabCross;j++) {
+        CROSS_REFERENCE *pTabCross=&ws->feno->TabCross[j];
 
         if (pTabCross->IndSvdA && (pTabCross->IndOrthog==ORTHOGONAL_BASE))
-          OrthogonalizeVector(OrthoSet,NormSet,NOrtho,pTabCross->IndSvdA,A,DimL);
+          OrthogonalizeVector(ws,ws->orthoSet,NormSet,ws->nOrtho,pTabCross->IndSvdA,A,DimL);
       }
 
     // Orthogonalization to base plus another vector
 
-    for (int j=0;j<Feno->NTabCross;j++) {
-      CROSS_REFERENCE *pTabCross=&Feno->TabCross[j];
+    for (int j=0;j<ws->feno->NTabCross;j++) {
+      CROSS_REFERENCE *pTabCross=&ws->feno->TabCross[j];
 
       if (pTabCross->IndSvdA && (pTabCross->IndOrthog==ORTHOGONAL_BASE))
-       OrthogonalizeToCross(j,NormSet,NOrtho,A,DimL);
+       OrthogonalizeToCross(ws,j,NormSet,ws->nOrtho,A,DimL);
     }
     free(NormSet);
   }
@@ -1171,7 +1167,7 @@ static void Orthogonalization(double **A, int DimL) {
 // Correction of a cross section by the effective temperature
 // Test 24/01/2002
 
-RC TemperatureCorrection(double *xs,double *A,double *B,double *C,double *newXs,double T, const int n_wavel)
+RC TemperatureCorrection(const struct analysis_workspace *ws,double *xs,double *A,double *B,double *C,double *newXs,double T, const int n_wavel)
 {
 #if defined(__DEBUG_) && __DEBUG_
   DEBUG_FunctionBegin(__func__,DEBUG_FCTTYPE_UTIL);
@@ -1179,7 +1175,7 @@ RC TemperatureCorrection(double *xs,double *A,double *B,double *C,double *newXs,
 
   memcpy(newXs,ANALYSE_zeros,sizeof(double)*n_wavel);
 
-  for (int j=LimMin;j<=LimMax;j++)
+  for (int j=ws->limMin;j<=ws->limMax;j++)
     newXs[j]=xs[j]+(T-241)*A[j]+(T-241)*(T-241)*B[j]+(T-241)*(T-241)*(T-241)*C[j];
 
 #if defined(__DEBUG_) && __DEBUG_
@@ -1193,7 +1189,7 @@ RC TemperatureCorrection(double *xs,double *A,double *B,double *C,double *newXs,
 // ShiftVector : Apply shift and stretch on vector; convolve reference when fitting SFP in Kurucz
 // -----------------------------------------------
 
-RC ShiftVector(const double *lambda, double *source, const double *deriv, double *target, const int n_wavel,
+RC ShiftVector(const struct analysis_workspace *ws,const double *lambda, double *source, const double *deriv, double *target, const int n_wavel,
                double DSH,double DST,double DST2,                           // first shift and stretch
                double DSH_,double DST_,double DST2_,                        // second shift and stretch
                const double *Param,int fwhmDir,int kuruczFlag,int slitFlag,INDEX indexFenoColumn)
@@ -1202,54 +1198,59 @@ RC ShiftVector(const double *lambda, double *source, const double *deriv, double
   DEBUG_FunctionBegin(__func__,DEBUG_FCTTYPE_APPL|DEBUG_FCTTYPE_MEM);
 #endif
 
-  double lambda0 = (!Feno->hidden)?Feno->lambda0: center_pixel_wavelength(SvdPDeb, SvdPFin);
-  memcpy(ANALYSE_shift,ANALYSE_zeros,sizeof(double)*n_wavel);
-  int fwhmFlag=((Feno->analysisType==ANALYSIS_TYPE_FWHM_NLFIT) && (fwhmDir!=0) && (Param!=NULL))?1:0;
-  CROSS_REFERENCE *TabCross=Feno->TabCross;
+  FENO *pFeno=ws->feno;
+  double lambda0 = (!pFeno->hidden)?pFeno->lambda0: center_pixel_wavelength(ws->splineX,ws->svdPDeb, ws->svdPFin);
+  memcpy(ws->shift,ANALYSE_zeros,sizeof(double)*n_wavel);
+  int fwhmFlag=((pFeno->analysisType==ANALYSIS_TYPE_FWHM_NLFIT) && (fwhmDir!=0) && (Param!=NULL))?1:0;
+  CROSS_REFERENCE *TabCross=pFeno->TabCross;
+  double *fwhmVector=NULL,*stepVector=NULL;                                     // fwhm and grid step per pixel when fitting the difference of resolution
 
   RC rc=ERROR_ID_NO;
 
-  // Buffer allocation for second derivative
+  // Buffer allocation for the convolution
+
+  if (fwhmFlag &&
+      (((fwhmVector=MEMORY_AllocScratchDVector(__func__,"fwhmVector",0,n_wavel-1))==NULL) ||
+       ((stepVector=MEMORY_AllocScratchDVector(__func__,"stepVector",0,n_wavel-1))==NULL)))
+    rc=ERROR_ID_ALLOC;
 
-  for (int j=LimMin;j<=LimMax;j++) {             // !! p'=p-(DSH+DST*(p-p0)+DST2*(p-p0)^2
+  for (int j=ws->limMin;(j<=ws->limMax) && !rc;j++) {             // !! p'=p-(DSH+DST*(p-p0)+DST2*(p-p0)^2
     // Second shift and stretch              //    p''=p'-(DSH'+DST'*(p'-p0')+DST2'*(p'-p0')^2
     // with   p=ANALYSE_splineX (Lambda if unit is nm;pixels if unit is pixels)
-    double x0=(ANALYSE_splineX[j]-lambda0);        //        p0'=p0-DSH
-    double y=ANALYSE_splineX[j]-(DSH_+DST_*x0+DST2_*x0*x0);
+    double x0=(ws->splineX[j]-lambda0);        //        p0'=p0-DSH
+    double y=ws->splineX[j]-(DSH_+DST_*x0+DST2_*x0*x0);
 
     // First shift and stretch
 
     x0=(y-lambda0+DSH_);
-    ANALYSE_shift[j]=y-(DSH+DST*x0*StretchFact1+DST2*x0*x0*StretchFact2);
+    ws->shift[j]=y-(DSH+DST*x0*ws->stretchFact1+DST2*x0*x0*ws->stretchFact2);
 
     // Fit difference of resolution between spectrum and reference
 
     if (fwhmFlag) {
       double fwhm= 0.;
 
-      const double deltaX=(ANALYSE_splineX[j]-lambda0);
+      const double deltaX=(ws->splineX[j]-lambda0);
 
-      if (Feno->indexFwhmConst!=ITEM_NONE)
-       fwhm+=(TabCross[Feno->indexFwhmConst].FitParam!=ITEM_NONE)?(double)Param[TabCross[Feno->indexFwhmConst].FitParam]:(double)TabCross[Feno->indexFwhmConst].InitParam;
-      if (Feno->indexFwhmOrder1!=ITEM_NONE)
-       fwhm+=((TabCross[Feno->indexFwhmOrder1].FitParam!=ITEM_NONE)?(double)Param[TabCross[Feno->indexFwhmOrder1].FitParam]:(double)TabCross[Feno->indexFwhmOrder1].InitParam)*deltaX*TabCross[Feno->indexFwhmOrder1].Fact;
-      if (Feno->indexFwhmOrder2!=ITEM_NONE)
-       fwhm+=((TabCross[Feno->indexFwhmOrder2].FitParam!=ITEM_NONE)?(double)Param[TabCross[Feno->indexFwhmOrder2].FitParam]:(double)TabCross[Feno->indexFwhmOrder2].InitParam)*deltaX*deltaX*TabCross[Feno->indexFwhmOrder2].Fact;
+      if (pFeno->indexFwhmConst!=ITEM_NONE)
+       fwhm+=(TabCross[pFeno->indexFwhmConst].FitParam!=ITEM_NONE)?(double)Param[TabCross[pFeno->indexFwhmConst].FitParam]:(double)TabCross[pFeno->indexFwhmConst].InitParam;
+      if (pFeno->indexFwhmOrder1!=ITEM_NONE)
+       fwhm+=((TabCross[pFeno->indexFwhmOrder1].FitParam!=ITEM_NONE)?(double)Param[TabCross[pFeno->indexFwhmOrder1].FitParam]:(double)TabCross[pFeno->indexFwhmOrder1].InitParam)*deltaX*TabCross[pFeno->indexFwhmOrder1].Fact;
+      if (pFeno->indexFwhmOrder2!=ITEM_NONE)
+       fwhm+=((TabCross[pFeno->indexFwhmOrder2].FitParam!=ITEM_NONE)?(double)Param[TabCross[pFeno->indexFwhmOrder2].FitParam]:(double)TabCross[pFeno->indexFwhmOrder2].InitParam)*deltaX*deltaX*TabCross[pFeno->indexFwhmOrder2].Fact;
 
-      // Apply shift and stretch
+      // Apply shift and stretch : convolution of the pixels where the vector has the highest resolution, interpolation of the other ones
 
-      if ( fwhm!=(double)0. &&
-           ( (fwhmDir>0 && fwhm>(double)0.) || (fwhmDir<0 && fwhm<(double)0.) ) ) {
-        rc = XSCONV_TypeGauss(lambda,source,deriv,ANALYSE_shift[j],(ANALYSE_splineX[j+1]-ANALYSE_splineX[j]),
-                              &target[j],fabs(fwhm),(double)0.,SLIT_TYPE_GAUSS, n_wavel);
-      } else {
-        rc = SPLINE_Vector(lambda,source,deriv,n_wavel,&ANALYSE_shift[j],&target[j],1,pAnalysisOptions->interpol);
-      }
-      if (rc != ERROR_ID_NO)
-        break;
+      fwhmVector[j]=( fwhm!=(double)0. &&
+                      ( (fwhmDir>0 && fwhm>(double)0.) || (fwhmDir<0 && fwhm<(double)0.) ) ) ? fabs(fwhm) : (double)0.;
+      stepVector[j]=ws->splineX[j+1]-ws->splineX[j];
      }
   }
 
+  if (fwhmFlag && !rc)
+    rc = XSCONV_TypeGaussVector(lambda,source,deriv,n_wavel,&ws->shift[ws->limMin],&stepVector[ws->limMin],&fwhmVector[ws->limMin],
+                                &target[ws->limMin],ws->limN,pAnalysisOptions->interpol);
+
   if (kuruczFlag) {
     // Declarations
 
@@ -1258,17 +1259,17 @@ RC ShiftVector(const double *lambda, double *source, const double *deriv, double
 
     // Initializations
 
-    slitParam=(Feno->indexFwhmParam[0]!=ITEM_NONE)?((TabCross[Feno->indexFwhmParam[0]].FitParam!=ITEM_NONE)?(double)Param[TabCross[Feno->indexFwhmParam[0]].FitParam]:(double)TabCross[Feno->indexFwhmParam[0]].InitParam):(double)0.;
+    slitParam=(pFeno->indexFwhmParam[0]!=ITEM_NONE)?((TabCross[pFeno->indexFwhmParam[0]].FitParam!=ITEM_NONE)?(double)Param[TabCross[pFeno->indexFwhmParam[0]].FitParam]:(double)TabCross[pFeno->indexFwhmParam[0]].InitParam):(double)0.;
 
     if (pKuruczOptions->fwhmType==SLIT_TYPE_INVPOLY)
      slitParam2=(double)pKuruczOptions->invPolyDegree;
-    else if (((pKuruczOptions->fwhmType==SLIT_TYPE_ERF) || (pKuruczOptions->fwhmType==SLIT_TYPE_AGAUSS) || (pKuruczOptions->fwhmType==SLIT_TYPE_SUPERGAUSS) || (pKuruczOptions->fwhmType==SLIT_TYPE_VOIGT)) && (Feno->indexFwhmParam[1]!=ITEM_NONE))
-     slitParam2=(TabCross[Feno->indexFwhmParam[1]].FitParam!=ITEM_NONE)?(double)Param[TabCross[Feno->indexFwhmParam[1]].FitParam]:(double)TabCross[Feno->indexFwhmParam[1]].InitParam;
+    else if (((pKuruczOptions->fwhmType==SLIT_TYPE_ERF) || (pKuruczOptions->fwhmType==SLIT_TYPE_AGAUSS) || (pKuruczOptions->fwhmType==SLIT_TYPE_SUPERGAUSS) || (pKuruczOptions->fwhmType==SLIT_TYPE_VOIGT)) && (pFeno->indexFwhmParam[1]!=ITEM_NONE))
+     slitParam2=(TabCross[pFeno->indexFwhmParam[1]].FitParam!=ITEM_NONE)?(double)Param[TabCross[pFeno->indexFwhmParam[1]].FitParam]:(double)TabCross[pFeno->indexFwhmParam[1]].InitParam;
     else
      slitParam2=(double)0.;
 
     if (pKuruczOptions->fwhmType==SLIT_TYPE_SUPERGAUSS)
-     slitParam3=(TabCross[Feno->indexFwhmParam[2]].FitParam!=ITEM_NONE)?(double)Param[TabCross[Feno->indexFwhmParam[2]].FitParam]:(double)TabCross[Feno->indexFwhmParam[2]].InitParam;
+     slitParam3=(TabCross[pFeno->indexFwhmParam[2]].FitParam!=ITEM_NONE)?(double)Param[TabCross[pFeno->indexFwhmParam[2]].FitParam]:(double)TabCross[pFeno->indexFwhmParam[2]].InitParam;
     else
      slitParam3=(double)0.;
 
@@ -1281,7 +1282,7 @@ RC ShiftVector(const double *lambda, double *source, const double *deriv, double
 
       rc=SPLINE_Vector(KURUCZ_buffers[indexFenoColumn].hrSolar.matrix[0],KURUCZ_buffers[indexFenoColumn].hrSolar.matrix[1],
                        KURUCZ_buffers[indexFenoColumn].hrSolar.deriv2[1],KURUCZ_buffers[indexFenoColumn].hrSolar.nl,
-                       ANALYSE_shift,source,n_wavel,pAnalysisOptions->interpol);
+                       ws->shift,source,n_wavel,pAnalysisOptions->interpol);
 
      }
     else
@@ -1324,10 +1325,10 @@ RC ShiftVector(const double *lambda, double *source, const double *deriv, double
 
         SPLINE_Deriv2(pKURUCZ_fft->fftIn+1,pKURUCZ_fft->invFftOut+1,pKURUCZ_fft->invFftIn+1,pKURUCZ_fft->oldSize,__func__);
 
-        memcpy(&source[LimMin],&ANALYSE_shift[LimMin],sizeof(double)*LimN);
+        memcpy(&source[ws->limMin],&ws->shift[ws->limMin],sizeof(double)*ws->limN);
 
         SPLINE_Vector(pKURUCZ_fft->fftIn+1,pKURUCZ_fft->invFftOut+1,pKURUCZ_fft->invFftIn+1,pKURUCZ_fft->oldSize,
-                      &ANALYSE_shift[LimMin],&target[LimMin],LimN,pAnalysisOptions->interpol);
+                      &ws->shift[ws->limMin],&target[ws->limMin],ws->limN,pAnalysisOptions->interpol);
       } else {
            MATRIX_OBJECT xsNew;
            MATRIX_OBJECT slitMatrix[NSFP];
@@ -1348,7 +1349,7 @@ RC ShiftVector(const double *lambda, double *source, const double *deriv, double
          }
         else
          {
-          memcpy(xsNew.matrix[0],ANALYSE_shift,sizeof(double)*n_wavel);
+          memcpy(xsNew.matrix[0],ws->shift,sizeof(double)*n_wavel);
           memcpy(xsNew.matrix[1],target,sizeof(double)*n_wavel);
 
           slitType=pKuruczOptions->fwhmType;
@@ -1360,12 +1361,12 @@ RC ShiftVector(const double *lambda, double *source, const double *deriv, double
 
             shiftIndex=(nc==2)?0:1;
 
-            fwhmStretch1=(Feno->indexFwhmParam[0]!=ITEM_NONE)?
-              ((TabCross[Feno->indexFwhmParam[0]].FitParam!=ITEM_NONE)?(double)Param[TabCross[Feno->indexFwhmParam[0]].FitParam]:(double)TabCross[Feno->indexFwhmParam[0]].InitParam)
+            fwhmStretch1=(pFeno->indexFwhmParam[0]!=ITEM_NONE)?
+              ((TabCross[pFeno->indexFwhmParam[0]].FitParam!=ITEM_NONE)?(double)Param[TabCross[pFeno->indexFwhmParam[0]].FitParam]:(double)TabCross[pFeno->indexFwhmParam[0]].InitParam)
               :(double)1.;
 
-            fwhmStretch2=(Feno->indexFwhmParam[1]!=ITEM_NONE)?
-              ((TabCross[Feno->indexFwhmParam[1]].FitParam!=ITEM_NONE)?(double)Param[TabCross[Feno->indexFwhmParam[1]].FitParam]:(double)TabCross[Feno->indexFwhmParam[1]].InitParam)
+            fwhmStretch2=(pFeno->indexFwhmParam[1]!=ITEM_NONE)?
+              ((TabCross[pFeno->indexFwhmParam[1]].FitParam!=ITEM_NONE)?(double)Param[TabCross[pFeno->indexFwhmParam[1]].FitParam]:(double)TabCross[pFeno->indexFwhmParam[1]].InitParam)
               :(double)1.;
 
            if (MATRIX_Allocate(&slitMatrix[0],nl,nc,0,0,1,"ShiftVector (slitMatrix)"))
@@ -1420,12 +1421,12 @@ RC ShiftVector(const double *lambda, double *source, const double *deriv, double
             slitOptions.slitParam2=slitParam2;
             slitOptions.slitParam3=slitParam3;
 
-            memcpy(&source[LimMin],&ANALYSE_shift[LimMin],sizeof(double)*LimN);
+            memcpy(&source[ws->limMin],&ws->shift[ws->limMin],sizeof(double)*ws->limN);
             rc=XSCONV_LoadSlitFunction(slitMatrix,&slitOptions,NULL,&slitType);
            }
 
           if (!rc &&
-               !(rc=XSCONV_TypeStandard(&xsNew,LimMin,LimMax+1,&KURUCZ_buffers[indexFenoColumn].hrSolar,
+               !(rc=XSCONV_TypeStandard(&xsNew,ws->limMin,ws->limMax+1,&KURUCZ_buffers[indexFenoColumn].hrSolar,
                                         &KURUCZ_buffers[indexFenoColumn].hrSolar,NULL,slitType,slitMatrix,slitParamVector,0)))
 
             memcpy(target,xsNew.matrix[1],sizeof(double)*n_wavel);
@@ -1439,20 +1440,20 @@ RC ShiftVector(const double *lambda, double *source, const double *deriv, double
 
     }
 
-    if (hFilterRefLog && !(rc=SPLINE_Vector(KURUCZ_buffers[indexFenoColumn].lambdaF,KURUCZ_buffers[indexFenoColumn].solarF,KURUCZ_buffers[indexFenoColumn].solarF2,n_wavel+2*KURUCZ_buffers[indexFenoColumn].solarFGap,ANALYSE_shift+LimMin,source+LimMin,LimN,pAnalysisOptions->interpol))) {
+    if (ws->hFilterRefLog && !(rc=SPLINE_Vector(KURUCZ_buffers[indexFenoColumn].lambdaF,KURUCZ_buffers[indexFenoColumn].solarF,KURUCZ_buffers[indexFenoColumn].solarF2,n_wavel+2*KURUCZ_buffers[indexFenoColumn].solarFGap,ws->shift+ws->limMin,source+ws->limMin,ws->limN,pAnalysisOptions->interpol))) {
       int i;
-      for (i=LimMin;(i<=LimMax) && (source[i]>(double)0.) && (target[i]>(double)0.);i++)
+      for (i=ws->limMin;(i<=ws->limMax) && (source[i]>(double)0.) && (target[i]>(double)0.);i++)
         target[i]=log(target[i]/source[i]);
 
-      if (i<=LimMax)
+      if (i<=ws->limMax)
         rc=ERROR_SetLast(__func__,ERROR_TYPE_WARNING,ERROR_ID_LOG,analyseIndexRecord);
     }
   }
-  else if (!fwhmFlag && slitFlag && (Feno->analysisType==ANALYSIS_TYPE_FWHM_SLIT) && (KURUCZ_buffers[indexFenoColumn].hrSolarGridded.matrix!=NULL) &&  
+  else if (!fwhmFlag && slitFlag && (pFeno->analysisType==ANALYSIS_TYPE_FWHM_SLIT) && (KURUCZ_buffers[indexFenoColumn].hrSolarGridded.matrix!=NULL) &&  
            !(rc=SPLINE_Vector(KURUCZ_buffers[indexFenoColumn].hrSolarGridded.matrix[0],
                               KURUCZ_buffers[indexFenoColumn].hrSolarGridded.matrix[1],
                               KURUCZ_buffers[indexFenoColumn].hrSolarGridded.deriv2[1],
-                              KURUCZ_buffers[indexFenoColumn].hrSolarGridded.nl,&ANALYSE_shift[LimMin],&target[LimMin],LimN,pAnalysisOptions->interpol))) 
+                              KURUCZ_buffers[indexFenoColumn].hrSolarGridded.nl,&ws->shift[ws->limMin],&target[ws->limMin],ws->limN,pAnalysisOptions->interpol))) 
    {
 //     if (hFilterRefLog && !(rc=SPLINE_Vector(KURUCZ_buffers[indexFenoColumn].lambdaF,KURUCZ_buffers[indexFenoColumn].solarF,KURUCZ_buffers[indexFenoColumn].solarF2,n_wavel+2*KURUCZ_buffers[indexFenoColumn].solarFGap,ANALYSE_shift+LimMin,source+LimMin,LimN,pAnalysisOptions->interpol))) {
 //       int i;
@@ -1465,7 +1466,12 @@ RC ShiftVector(const double *lambda, double *source, const double *deriv, double
       
    }
   else if (!fwhmFlag && !slitFlag) 
-   rc=SPLINE_Vector(lambda,source,deriv,n_wavel,&ANALYSE_shift[LimMin],&target[LimMin],LimN,pAnalysisOptions->interpol); 
+   rc=SPLINE_Vector(lambda,source,deriv,n_wavel,&ws->shift[ws->limMin],&target[ws->limMin],ws->limN,pAnalysisOptions->interpol); 
+
+  if (stepVector!=NULL)
+   MEMORY_ReleaseScratchDVector(__func__,"stepVector",stepVector,0);
+  if (fwhmVector!=NULL)
+   MEMORY_ReleaseScratchDVector(__func__,"fwhmVector",fwhmVector,0);
     
   // Return
 
@@ -2050,10 +2056,11 @@ RC AnalyseLoadVector(const char *function, const char *fileName, double *lambda,
 // AnalyseFwhmCorrectionK : resolution adjustment between spectrum and reference using fwhms fitted by Kurucz
 // ----------------------------------------------------------------------------------------------------------
 
-RC AnalyseFwhmCorrectionK(const double *Spectre, const double *Sref,double *SpecTrav,double *RefTrav, const int n_wavel, INDEX indexFenoColumn)
+RC AnalyseFwhmCorrectionK(const struct analysis_workspace *ws,const double *Spectre, const double *Sref,double *SpecTrav,double *RefTrav, const int n_wavel, INDEX indexFenoColumn)
 {
   // Declarations
 
+  const FENO *pFeno=ws->feno;
   MATRIX_OBJECT slitMatrix[NSFP];
   double specFwhm,refFwhm,*xsTrav;
   INDEX j;
@@ -2080,19 +2087,19 @@ RC AnalyseFwhmCorrectionK(const double *Spectre, const double *Sref,double *Spec
 
   // Second derivatives computation for spectrum and reference
 
-  else if (!(rc=SPLINE_Deriv2(LambdaSpec,Spectre,SplineSpec,n_wavel,"AnalyseFwhmCorrectionK (Lambda) ")) &&  // !!! Lambda -> LambdaSpec
-           !(rc=SPLINE_Deriv2(Lambda,Sref,SplineRef,n_wavel,"AnalyseFwhmCorrectionK (Lambda) ")))
+  else if (!(rc=SPLINE_Deriv2(ws->lambdaSpec,Spectre,ws->splineSpec,n_wavel,"AnalyseFwhmCorrectionK (Lambda) ")) &&  // !!! Lambda -> LambdaSpec
+           !(rc=SPLINE_Deriv2(ws->lambda,Sref,ws->splineRef,n_wavel,"AnalyseFwhmCorrectionK (Lambda) ")))
    {
     memcpy(xsTrav,ANALYSE_zeros,sizeof(double)*n_wavel);
 
     // Fwhm ajustment between spectrum and reference
 
-    for (j=LimMin;(j<=LimMax) && !rc;j++)
+    for (j=ws->limMin;(j<=ws->limMax) && !rc;j++)
      {
       // Retrieve fwhm from fwhm vectors build by Kurucz procedure
 
       specFwhm=KURUCZ_buffers[indexFenoColumn].fwhmVector[0][j];
-      refFwhm=Feno->fwhmVector[0][j];
+      refFwhm=pFeno->fwhmVector[0][j];
 
       if ((specFwhm<=(double)0.) || (refFwhm<=(double)0.))
        rc=ERROR_SetLast(__func__,ERROR_TYPE_WARNING,ERROR_ID_SQRT_ARG);
@@ -2103,8 +2110,8 @@ RC AnalyseFwhmCorrectionK(const double *Spectre, const double *Sref,double *Spec
        {
         xsTrav[j]=specFwhm;
         specFwhm=sqrt(specFwhm*specFwhm-refFwhm*refFwhm);
-        rc=XSCONV_TypeGauss(Lambda,Sref,SplineRef,Lambda[j],(Lambda[j+1]-Lambda[j]),&RefTrav[j],specFwhm,
-                            (Feno->fwhmVector[1]!=NULL)?Feno->fwhmVector[1][j]:(double)0.,pKuruczOptions->fwhmType, n_wavel);
+        rc=XSCONV_TypeGauss(ws->lambda,Sref,ws->splineRef,ws->lambda[j],(ws->lambda[j+1]-ws->lambda[j]),&RefTrav[j],specFwhm,
+                            (pFeno->fwhmVector[1]!=NULL)?pFeno->fwhmVector[1][j]:(double)0.,pKuruczOptions->fwhmType, n_wavel);
        }
 
       // Case 2 : spectrum has highest resolution => degrade spectrum
@@ -2113,8 +2120,8 @@ RC AnalyseFwhmCorrectionK(const double *Spectre, const double *Sref,double *Spec
        {
         xsTrav[j]=refFwhm;
         specFwhm=sqrt(refFwhm*refFwhm-specFwhm*specFwhm);
-        rc=XSCONV_TypeGauss(LambdaSpec,Spectre,SplineSpec,Lambda[j],(Lambda[j+1]-Lambda[j]),&SpecTrav[j],specFwhm,
-                            (Feno->fwhmVector[1]!=NULL)?Feno->fwhmVector[1][j]:(double)0.,pKuruczOptions->fwhmType, n_wavel);
+        rc=XSCONV_TypeGauss(ws->lambdaSpec,Spectre,ws->splineSpec,ws->lambda[j],(ws->lambda[j+1]-ws->lambda[j]),&SpecTrav[j],specFwhm,
+                            (pFeno->fwhmVector[1]!=NULL)?pFeno->fwhmVector[1][j]:(double)0.,pKuruczOptions->fwhmType, n_wavel);
        }
 
       // Case 3 : spectrum and reference have the same resolution
@@ -2147,11 +2154,11 @@ RC AnalyseFwhmCorrectionK(const double *Spectre, const double *Sref,double *Spec
 // SVD WORKSPACE MEMORY MANAGEMENT
 // ===============================
 
-// ------------------------------------------
-// AnalyseSvdGlobalAlloc : Global allocations
-// ------------------------------------------
+// --------------------------------------------------------------------
+// ANALYSE_WorkspaceAlloc : Allocate the per-fit buffers of a workspace
+// --------------------------------------------------------------------
 
-RC AnalyseSvdGlobalAlloc(void)
+RC ANALYSE_WorkspaceAlloc(struct analysis_workspace *ws,int size)
 {
 #if defined(__DEBUG_) && __DEBUG_
   DEBUG_FunctionBegin(__func__, DEBUG_FCTTYPE_MEM);
@@ -2161,6 +2168,155 @@ RC AnalyseSvdGlobalAlloc(void)
 
   RC rc=ERROR_ID_NO;
 
+  memset(ws,0,sizeof(*ws));
+  ws->size=size;
+
+  // Allocation
+
+  if (((ws->fitp=(double *)MEMORY_AllocDVector(__func__,"fitp",0,MAX_FIT*4))==NULL)  ||
+      ((ws->fitDeltap=(double *)MEMORY_AllocDVector(__func__,"fitDeltap",0,MAX_FIT*4))==NULL) ||
+      ((ws->fitMinp=(double *)MEMORY_AllocDVector(__func__,"fitMinp",0,MAX_FIT*4))==NULL) ||
+      ((ws->fitMaxp=(double *)MEMORY_AllocDVector(__func__,"fitMaxp",0,MAX_FIT*4))==NULL) ||
+      ((ws->b=(double *)MEMORY_AllocDVector(__func__,"b",1,size))==NULL) ||
+      ((ws->x=(double *)MEMORY_AllocDVector(__func__,"x",0,MAX_FIT))==NULL) ||
+      ((ws->sigma=(double *)MEMORY_AllocDVector(__func__,"sigma",0,MAX_FIT))==NULL) ||
+      ((ws->shift=(double *)MEMORY_AllocDVector(__func__,"shift",0,size-1))==NULL) ||
+      ((ws->splineX=(double *)MEMORY_AllocDVector(__func__,"splineX",0,size-1))==NULL) ||
+      ((ws->absolu=(double *)MEMORY_AllocDVector(__func__,"absolu",0,size))==NULL) ||
+      ((ws->t=(double *)MEMORY_AllocDVector(__func__,"t",0,size))==NULL) ||
+      ((ws->tc=(double *)MEMORY_AllocDVector(__func__,"tc",0,size))==NULL) ||
+      ((ws->xsTrav=(double *)MEMORY_AllocDVector(__func__,"xsTrav",0,size-1))==NULL) ||
+      ((ws->xsTrav2=(double *)MEMORY_AllocDVector(__func__,"xsTrav2",0,size-1))==NULL) ||
+      ((ws->secX=(double *)MEMORY_AllocDVector(__func__,"secX",0,size))==NULL) ||
+      ((ws->splineSpec=(double *)MEMORY_AllocDVector(__func__,"splineSpec",0,size-1))==NULL) ||
+      ((ws->splineRef=(double *)MEMORY_AllocDVector(__func__,"splineRef",0,size-1))==NULL) ||
+      ((rc=MEMORY_AllocArena(__func__,&ws->scratch,ANALYSE_SCRATCH_SIZE(size)))!=ERROR_ID_NO))
+
+   rc=ERROR_ID_ALLOC;
+
+  else
+   ws->sigma[0]=ws->x[0]=(double)0.;
+
+#if defined(__DEBUG_) && __DEBUG_
+  DEBUG_FunctionStop(__func__,rc);
+#endif
+
+  return rc;
+}
+
+// ----------------------------------------------------------
+// ANALYSE_WorkspaceFree : Release the buffers of a workspace
+// ----------------------------------------------------------
+
+void ANALYSE_WorkspaceFree(struct analysis_workspace *ws)
+{
+  if (ws->fitp!=NULL)
+   MEMORY_ReleaseDVector(__func__,"fitp",ws->fitp,0);
+  if (ws->fitDeltap!=NULL)
+   MEMORY_ReleaseDVector(__func__,"fitDeltap",ws->fitDeltap,0);
+  if (ws->fitMinp!=NULL)
+   MEMORY_ReleaseDVector(__func__,"fitMinp",ws->fitMinp,0);
+  if (ws->fitMaxp!=NULL)
+   MEMORY_ReleaseDVector(__func__,"fitMaxp",ws->fitMaxp,0);
+  if (ws->b!=NULL)
+   MEMORY_ReleaseDVector(__func__,"b",ws->b,1);
+  if (ws->x!=NULL)
+   MEMORY_ReleaseDVector(__func__,"x",ws->x,0);
+  if (ws->sigma!=NULL)
+   MEMORY_ReleaseDVector(__func__,"sigma",ws->sigma,0);
+  if (ws->shift!=NULL)
+   MEMORY_ReleaseDVector(__func__,"shift",ws->shift,0);
+  if (ws->splineX!=NULL)
+   MEMORY_ReleaseDVector(__func__,"splineX",ws->splineX,0);
+  if (ws->absolu!=NULL)
+   MEMORY_ReleaseDVector(__func__,"absolu",ws->absolu,0);
+  if (ws->t!=NULL)
+   MEMORY_ReleaseDVector(__func__,"t",ws->t,0);
+  if (ws->tc!=NULL)
+   MEMORY_ReleaseDVector(__func__,"tc",ws->tc,0);
+  if (ws->xsTrav!=NULL)
+   MEMORY_ReleaseDVector(__func__,"xsTrav",ws->xsTrav,0);
+  if (ws->xsTrav2!=NULL)
+   MEMORY_ReleaseDVector(__func__,"xsTrav2",ws->xsTrav2,0);
+  if (ws->secX!=NULL)
+   MEMORY_ReleaseDVector(__func__,"secX",ws->secX,0);
+  if (ws->splineSpec!=NULL)
+   MEMORY_ReleaseDVector(__func__,"splineSpec",ws->splineSpec,0);
+  if (ws->splineRef!=NULL)
+   MEMORY_ReleaseDVector(__func__,"splineRef",ws->splineRef,0);
+
+  MEMORY_ReleaseArena(__func__,&ws->scratch);
+
+  CURFIT_ReleaseWorkers(ws);
+
+  memset(ws,0,sizeof(*ws));
+}
+
+// ----------------------------------------------------------------------------
+// ANALYSE_WorkspaceCopy : Allocate a workspace bound to the same fit as source
+// ----------------------------------------------------------------------------
+
+// The copy shares the analysis window and the wavelength calibrations with source
+// but has its own buffers, so that ANALYSE_Function can be evaluated with both
+// workspaces at the same time.  The abscissa and the second derivatives of the
+// spectrum and the reference calculated in ANALYSE_CurFitMethod are duplicated.
+
+RC ANALYSE_WorkspaceCopy(struct analysis_workspace *target,const struct analysis_workspace *source)
+{
+  RC rc;
+
+  if ((rc=ANALYSE_WorkspaceAlloc(target,source->size))!=ERROR_ID_NO)
+   ANALYSE_WorkspaceFree(target);
+  else
+   ANALYSE_WorkspaceSync(target,source);
+
+  return rc;
+}
+
+// -------------------------------------------------------------------------
+// ANALYSE_WorkspaceSync : Bind a workspace to the current fit of source
+// -------------------------------------------------------------------------
+
+// Same as ANALYSE_WorkspaceCopy for a workspace already allocated with the size
+// of source : the buffers of target are kept.
+
+void ANALYSE_WorkspaceSync(struct analysis_workspace *target,const struct analysis_workspace *source)
+{
+  struct analysis_workspace buffers=*target;
+
+  *target=*source;
+
+  target->fitp=buffers.fitp;
+  target->fitDeltap=buffers.fitDeltap;
+  target->fitMinp=buffers.fitMinp;
+  target->fitMaxp=buffers.fitMaxp;
+  target->b=buffers.b;
+  target->x=buffers.x;
+  target->sigma=buffers.sigma;
+  target->shift=buffers.shift;
+  target->splineX=buffers.splineX;
+  target->absolu=buffers.absolu;
+  target->t=buffers.t;
+  target->tc=buffers.tc;
+  target->xsTrav=buffers.xsTrav;
+  target->xsTrav2=buffers.xsTrav2;
+  target->secX=buffers.secX;
+  target->splineSpec=buffers.splineSpec;
+  target->splineRef=buffers.splineRef;
+  target->scratch=buffers.scratch;
+  target->curfitWorkers=buffers.curfitWorkers;
+
+  memcpy(target->splineX,source->splineX,sizeof(double)*source->size);
+  memcpy(target->splineSpec,source->splineSpec,sizeof(double)*source->size);
+  memcpy(target->splineRef,source->splineRef,sizeof(double)*source->size);
+}
+
+// ------------------------------------------
+// AnalyseSvdGlobalAlloc : Global allocations
+// ------------------------------------------
+
+RC AnalyseSvdGlobalAlloc(void)
+{
   // take maximum detector size to make sure that buffers allocated
   // here are big enough
   int max_ndet = 0;
@@ -2169,41 +2325,16 @@ RC AnalyseSvdGlobalAlloc(void)
       max_ndet = NDET[i];
   }
 
-  // Allocation
-
-  if (((Fitp=(double *)MEMORY_AllocDVector(__func__,"Fitp",0,MAX_FIT*4))==NULL)  ||
-      ((FitDeltap=(double *)MEMORY_AllocDVector(__func__,"FitDeltap",0,MAX_FIT*4))==NULL) ||
-      ((FitMinp=(double *)MEMORY_AllocDVector(__func__,"FitMinp",0,MAX_FIT*4))==NULL) ||
-      ((FitMaxp=(double *)MEMORY_AllocDVector(__func__,"FitMaxp",0,MAX_FIT*4))==NULL) ||
-      ((a=(double *)MEMORY_AllocDVector(__func__,"a",1,max_ndet))==NULL) ||
-      ((b=(double *)MEMORY_AllocDVector(__func__,"b",1,max_ndet))==NULL) ||
-      ((x=(double *)MEMORY_AllocDVector(__func__,"x",0,MAX_FIT))==NULL) ||
-      ((Sigma=(double *)MEMORY_AllocDVector(__func__,"Sigma",0,MAX_FIT))==NULL) ||
-      ((ANALYSE_shift=(double *)MEMORY_AllocDVector(__func__,"ANALYSE_shift",0,max_ndet-1))==NULL) ||
-      ((ANALYSE_pixels=(double *)MEMORY_AllocDVector(__func__,"ANALYSE_pixels",0,max_ndet-1))==NULL) ||
-      ((ANALYSE_splineX=(double *)MEMORY_AllocDVector(__func__,"ANALYSE_splineX",0,max_ndet-1))==NULL) ||
-      ((ANALYSE_absolu=(double *)MEMORY_AllocDVector(__func__,"ANALYSE_absolu",0,max_ndet))==NULL) ||
-      ((ANALYSE_t=(double *)MEMORY_AllocDVector(__func__,"ANALYSE_t",0,max_ndet))==NULL) ||
-      ((ANALYSE_tc=(double *)MEMORY_AllocDVector(__func__,"ANALYSE_tc",0,max_ndet))==NULL) ||
-      ((ANALYSE_xsTrav=(double *)MEMORY_AllocDVector(__func__,"ANALYSE_xsTrav",0,max_ndet-1))==NULL) ||
-      ((ANALYSE_xsTrav2=(double *)MEMORY_AllocDVector(__func__,"ANALYSE_xsTrav2",0,max_ndet-1))==NULL) ||
-      ((ANALYSE_secX=(double *)MEMORY_AllocDVector(__func__,"ANALYSE_secX",0,max_ndet))==NULL) ||
-      ((SplineSpec=(double *)MEMORY_AllocDVector(__func__,"SplineSpec",0,max_ndet-1))==NULL) ||
-      ((SplineRef=(double *)MEMORY_AllocDVector(__func__,"SplineRef",0,max_ndet-1))==NULL))
+  RC rc=ERROR_ID_NO;
 
+  if ((ANALYSE_pixels=(double *)MEMORY_AllocDVector(__func__,"ANALYSE_pixels",0,max_ndet-1))==NULL)
    rc=ERROR_ID_ALLOC;
-
   else {
-    // Initializations
-    Sigma[0]=x[0]=(double)0.;
-
     for (int i=0;i<max_ndet;i++)
       ANALYSE_pixels[i]= i+1;
-  }
 
-#if defined(__DEBUG_) && __DEBUG_
-  DEBUG_FunctionStop(__func__,rc);
-#endif
+    rc=ANALYSE_WorkspaceAlloc(&ANALYSE_mainWorkspace,max_ndet);
+  }
 
   return rc;
 }
@@ -2217,7 +2348,7 @@ RC AnalyseSvdGlobalAlloc(void)
 //                   determination and concentrations computation
 // --------------------------------------------------------------------------
 
-RC ANALYSE_SvdInit(FENO* pFeno, struct fit_properties *fit, const int n_wavel, const double *lambda)
+RC ANALYSE_SvdInit(struct analysis_workspace *ws,FENO* pFeno, struct fit_properties *fit, const int n_wavel, const double *lambda)
 {
   // Declarations
 
@@ -2233,10 +2364,11 @@ RC ANALYSE_SvdInit(FENO* pFeno, struct fit_properties *fit, const int n_wavel, c
 
   // Initializations
 
-  memcpy(ANALYSE_splineX,lambda,sizeof(*lambda)*n_wavel);
+  ws->feno=pFeno;
+  memcpy(ws->splineX,lambda,sizeof(*lambda)*n_wavel);
 
-  OrthoSet=pFeno->OrthoSet;
-  NOrtho=pFeno->NOrtho;
+  ws->orthoSet=pFeno->OrthoSet;
+  ws->nOrtho=pFeno->NOrtho;
 
   temp=(double)0.;
 
@@ -2247,17 +2379,17 @@ RC ANALYSE_SvdInit(FENO* pFeno, struct fit_properties *fit, const int n_wavel, c
   //    if ((ANALYSE_phFilter->type!=PRJCT_FILTER_TYPE_NONE) && (ANALYSE_phFilter->type!=PRJCT_FILTER_TYPE_ODDEVEN))
   //     temp+=ANALYSE_phFilter->filterEffWidth;
 
-  ANALYSE_nFree=floor(fit->DimL/((temp>(double)1.e-6)?temp:(double)1.)+0.5)-fit->nFit;
+  ws->nFree=floor(fit->DimL/((temp>(double)1.e-6)?temp:(double)1.)+0.5)-fit->nFit;
 
-  if (ANALYSE_nFree<=(double)0.)
+  if (ws->nFree<=(double)0.)
     rc=ERROR_SetLast("SvdInit",ERROR_TYPE_FATAL,ERROR_ID_NFREE);
   else {
-    global_doas_spectrum = fit->specrange;
+    ws->specrange = fit->specrange;
 
-    SvdPDeb=spectrum_start(fit->specrange);
-    SvdPFin=spectrum_end(fit->specrange);
+    ws->svdPDeb=spectrum_start(fit->specrange);
+    ws->svdPFin=spectrum_end(fit->specrange);
 
-    lambda0 = (!pFeno->hidden)? pFeno->lambda0:center_pixel_wavelength(SvdPDeb, SvdPFin);
+    lambda0 = (!pFeno->hidden)? pFeno->lambda0:center_pixel_wavelength(ws->splineX,ws->svdPDeb, ws->svdPFin);
 
     int Dim=0;
 
@@ -2269,10 +2401,10 @@ RC ANALYSE_SvdInit(FENO* pFeno, struct fit_properties *fit, const int n_wavel, c
 
     Dim=max(Dim,pAnalysisOptions->securityGap);
 
-    LimMin=max(SvdPDeb-Dim,0);
-    LimMax=min(SvdPFin+Dim,n_wavel-1);
+    ws->limMin=max(ws->svdPDeb-Dim,0);
+    ws->limMax=min(ws->svdPFin+Dim,n_wavel-1);
 
-    LimN=LimMax-LimMin+1;
+    ws->limN=ws->limMax-ws->limMin+1;
 
     // Set non linear normalization factors
 
@@ -2280,29 +2412,29 @@ RC ANALYSE_SvdInit(FENO* pFeno, struct fit_properties *fit, const int n_wavel, c
 
     doas_iterator my_iterator;
     for( int i = iterator_start(&my_iterator, fit->specrange); i != ITERATOR_FINISHED; i=iterator_next(&my_iterator)) {
-      deltaX=(double)(ANALYSE_splineX[i]-lambda0)*(ANALYSE_splineX[i]-lambda0);
+      deltaX=(double)(ws->splineX[i]-lambda0)*(ws->splineX[i]-lambda0);
 
       norm1+=deltaX;
       norm2+=deltaX*deltaX;
     }
 
-    for (j=LimMin,StretchFact1=StretchFact2=(double)0.;j<=LimMax;j++) {
-      deltaX=(ANALYSE_splineX[j]-lambda0);
+    for (j=ws->limMin,ws->stretchFact1=ws->stretchFact2=(double)0.;j<=ws->limMax;j++) {
+      deltaX=(ws->splineX[j]-lambda0);
 
-      deltaX=ANALYSE_splineX[j]-lambda0-pFeno->Stretch*deltaX-pFeno->Stretch2*deltaX*deltaX;
+      deltaX=ws->splineX[j]-lambda0-pFeno->Stretch*deltaX-pFeno->Stretch2*deltaX*deltaX;
       deltaX*=deltaX;
 
-      StretchFact1+=deltaX;
-      StretchFact2+=deltaX*deltaX;
+      ws->stretchFact1+=deltaX;
+      ws->stretchFact2+=deltaX*deltaX;
     }
 
     if ((norm1<=(double)0.) || (norm2<=(double)0.) ||
-        (StretchFact1<=(double)0.) || (StretchFact2<=(double)0.)) {
+        (ws->stretchFact1<=(double)0.) || (ws->stretchFact2<=(double)0.)) {
 
       rc=ERROR_SetLast(__func__,ERROR_TYPE_WARNING,ERROR_ID_SQRT_ARG);
     } else {
-      StretchFact1=(double)1./sqrt(StretchFact1);
-      StretchFact2=(double)1./sqrt(StretchFact2);
+      ws->stretchFact1=(double)1./sqrt(ws->stretchFact1);
+      ws->stretchFact2=(double)1./sqrt(ws->stretchFact2);
 
       for (i=0,norm1=sqrt(norm1),norm2=sqrt(norm2);i<pFeno->NTabCross;i++) {
         pTabCross=&pFeno->TabCross[i];
@@ -2314,8 +2446,8 @@ RC ANALYSE_SvdInit(FENO* pFeno, struct fit_properties *fit, const int n_wavel, c
         else if ((i==pFeno->indexOffsetOrder2) || (i==pFeno->indexFwhmOrder2))
           pTabCross->Fact=norm2;
 
-        pTabCross->InitStretch/=StretchFact1;
-        pTabCross->InitStretch2/=StretchFact2;
+        pTabCross->InitStretch/=ws->stretchFact1;
+        pTabCross->InitStretch2/=ws->stretchFact2;
 
         // Fill, 'Fit' vectors with data on parameters to fit
 
@@ -2326,7 +2458,7 @@ RC ANALYSE_SvdInit(FENO* pFeno, struct fit_properties *fit, const int n_wavel, c
           // FitMinp and FitMaxp are in parameters of ANALYSE_Function (called by curfit)
           //
 
-          FitDeltap[pTabCross->FitConc]=pTabCross->DeltaConc;
+          ws->fitDeltap[pTabCross->FitConc]=pTabCross->DeltaConc;
 
           if ((fabs(pTabCross->InitConc)>EPSILON) || (fabs(pTabCross->MinConc)>EPSILON) || (fabs(pTabCross->MaxConc)>EPSILON)) {
             norm=(double)0.;
@@ -2339,52 +2471,52 @@ RC ANALYSE_SvdInit(FENO* pFeno, struct fit_properties *fit, const int n_wavel, c
             else {
               norm=sqrt(norm);
 
-              Fitp[pTabCross->FitConc]=(fabs(pTabCross->InitConc)>EPSILON)?pTabCross->InitConc*norm:(double)0.;
-              FitMinp[pTabCross->FitConc]=(fabs(pTabCross->MinConc)>EPSILON)?(double)pTabCross->MinConc*norm:(double)0.;
-              FitMaxp[pTabCross->FitConc]=(fabs(pTabCross->MaxConc)>EPSILON)?(double)pTabCross->MaxConc*norm:(double)0.;
+              ws->fitp[pTabCross->FitConc]=(fabs(pTabCross->InitConc)>EPSILON)?pTabCross->InitConc*norm:(double)0.;
+              ws->fitMinp[pTabCross->FitConc]=(fabs(pTabCross->MinConc)>EPSILON)?(double)pTabCross->MinConc*norm:(double)0.;
+              ws->fitMaxp[pTabCross->FitConc]=(fabs(pTabCross->MaxConc)>EPSILON)?(double)pTabCross->MaxConc*norm:(double)0.;
             }
           } else {
-            Fitp[pTabCross->FitConc]=FitMinp[pTabCross->FitConc]=FitMaxp[pTabCross->FitConc]=(double)0.;
+            ws->fitp[pTabCross->FitConc]=ws->fitMinp[pTabCross->FitConc]=ws->fitMaxp[pTabCross->FitConc]=(double)0.;
           }
         }
         // ---------------------------------------------------------------------------
         if ((pTabCross->FitParam!=ITEM_NONE) && !pTabCross->IndSvdP) {
-          Fitp[pTabCross->FitParam]=pTabCross->InitParam;
-          FitDeltap[pTabCross->FitParam]=pTabCross->DeltaParam;
-          FitMinp[pTabCross->FitParam]=pTabCross->MinParam;
-          FitMaxp[pTabCross->FitParam]=pTabCross->MaxParam;
+          ws->fitp[pTabCross->FitParam]=pTabCross->InitParam;
+          ws->fitDeltap[pTabCross->FitParam]=pTabCross->DeltaParam;
+          ws->fitMinp[pTabCross->FitParam]=pTabCross->MinParam;
+          ws->fitMaxp[pTabCross->FitParam]=pTabCross->MaxParam;
         }
         // ---------------------------------------------------------------------------
         if (pTabCross->FitShift!=ITEM_NONE) {
-          Fitp[pTabCross->FitShift]=pTabCross->InitShift;
-          FitDeltap[pTabCross->FitShift]=pTabCross->DeltaShift;
-          FitMinp[pTabCross->FitShift]=pTabCross->MinShift;
-          FitMaxp[pTabCross->FitShift]=pTabCross->MaxShift;
+          ws->fitp[pTabCross->FitShift]=pTabCross->InitShift;
+          ws->fitDeltap[pTabCross->FitShift]=pTabCross->DeltaShift;
+          ws->fitMinp[pTabCross->FitShift]=pTabCross->MinShift;
+          ws->fitMaxp[pTabCross->FitShift]=pTabCross->MaxShift;
         }
         // ---------------------------------------------------------------------------
         if (pTabCross->FitStretch!=ITEM_NONE) {
-          Fitp[pTabCross->FitStretch]=pTabCross->InitStretch;
-          FitDeltap[pTabCross->FitStretch]=pTabCross->DeltaStretch;
-          FitMinp[pTabCross->FitStretch]=(double)0.;
-          FitMaxp[pTabCross->FitStretch]=(double)0.;
+          ws->fitp[pTabCross->FitStretch]=pTabCross->InitStretch;
+          ws->fitDeltap[pTabCross->FitStretch]=pTabCross->DeltaStretch;
+          ws->fitMinp[pTabCross->FitStretch]=(double)0.;
+          ws->fitMaxp[pTabCross->FitStretch]=(double)0.;
         }
         // ---------------------------------------------------------------------------
         if (pTabCross->FitStretch2!=ITEM_NONE) {
-          Fitp[pTabCross->FitStretch2]=pTabCross->InitStretch2;
-          FitDeltap[pTabCross->FitStretch2]=pTabCross->DeltaStretch2;
-          FitMinp[pTabCross->FitStretch2]=(double)0.;
-          FitMaxp[pTabCross->FitStretch2]=(double)0.;
+          ws->fitp[pTabCross->FitStretch2]=pTabCross->InitStretch2;
+          ws->fitDeltap[pTabCross->FitStretch2]=pTabCross->DeltaStretch2;
+          ws->fitMinp[pTabCross->FitStretch2]=(double)0.;
+          ws->fitMaxp[pTabCross->FitStretch2]=(double)0.;
         }
         // ---------------------------------------------------------------------------
       }
 
       for (i=0;i<fit->NF;i++) {
-        if ((FitMinp[i]!=(double)0.) && (FitMinp[i]==FitMaxp[i]))
-          FitMinp[i]=-FitMaxp[i];
-        if (FitMinp[i]>FitMaxp[i]) {
-          swap=FitMinp[i];
-          FitMinp[i]=FitMaxp[i];
-          FitMaxp[i]=swap;
+        if ((ws->fitMinp[i]!=(double)0.) && (ws->fitMinp[i]==ws->fitMaxp[i]))
+          ws->fitMinp[i]=-ws->fitMaxp[i];
+        if (ws->fitMinp[i]>ws->fitMaxp[i]) {
+          swap=ws->fitMinp[i];
+          ws->fitMinp[i]=ws->fitMaxp[i];
+          ws->fitMaxp[i]=swap;
         }
       }
     }
@@ -2404,14 +2536,14 @@ RC ANALYSE_SvdInit(FENO* pFeno, struct fit_properties *fit, const int n_wavel, c
 // Because we use the existing analysis settings, no shift/stretch is
 // fit if the analysis window is not configured to use shift and
 // stretch.
-RC ANALYSE_fit_shift_stretch(int indexFeno, int indexFenoColumn, const double *spec1, const double *spec2,
+RC ANALYSE_fit_shift_stretch(struct analysis_workspace *ws,int indexFeno, int indexFenoColumn, const double *spec1, const double *spec2,
                      double *shift, double *stretch, double *stretch2,
                      double *sigma_shift, double *sigma_stretch, double *sigma_stretch2) {
   FENO copy = TabFeno[indexFenoColumn][indexFeno]; // local working copy
-  Feno=&copy;
-  Feno->fit_properties.linfit = NULL;
-  Feno->Shift=Feno->Stretch=Feno->Stretch2=0.;
-  NDET[indexFenoColumn]=Feno->NDET;
+  FENO *pFeno=&copy;
+  pFeno->fit_properties.linfit = NULL;
+  pFeno->Shift=pFeno->Stretch=pFeno->Stretch2=0.;
+  NDET[indexFenoColumn]=pFeno->NDET;
   
   //int molecularRingFlag=Feno->molecularCorrection;
   
@@ -2436,43 +2568,43 @@ RC ANALYSE_fit_shift_stretch(int indexFeno, int indexFenoColumn, const double *s
 //      }
 //    } 
 
-  memcpy(Feno->Lambda,Feno->LambdaK,sizeof(*Feno->Lambda)*Feno->NDET); // CHECK: why this copy?
-  LambdaSpec=Feno->Lambda; // now pointer LambdaSpec== pointer Feno->Lambda, and buffer content is Feno->LambdaK
+  memcpy(pFeno->Lambda,pFeno->LambdaK,sizeof(*pFeno->Lambda)*pFeno->NDET); // CHECK: why this copy?
+  ws->lambdaSpec=pFeno->Lambda; // now pointer LambdaSpec== pointer Feno->Lambda, and buffer content is Feno->LambdaK
 
-  Feno->Decomp=1;
-  Feno->amfFlag=0;
-  Feno->indexReference=ITEM_NONE;
+  pFeno->Decomp=1;
+  pFeno->amfFlag=0;
+  pFeno->indexReference=ITEM_NONE;
   
   RC rc;
   
-  if (!(rc=ANALYSE_SvdInit(Feno, &Feno->fit_properties, Feno->NDET,Feno->Lambda)) && 
-     (!Feno->molecularCorrection || !(rc=Analyse_Molecular_Ring_Init(Feno,Feno->LambdaK,Feno->NDET))))  
+  if (!(rc=ANALYSE_SvdInit(ws,pFeno, &pFeno->fit_properties, pFeno->NDET,pFeno->Lambda)) && 
+     (!pFeno->molecularCorrection || !(rc=Analyse_Molecular_Ring_Init(pFeno,pFeno->LambdaK,pFeno->NDET))))  
   
   // TODO: when we call curfitmethod here, absorber constraints between analysis windows will not work. is this ok?
-       rc=ANALYSE_CurFitMethod(indexFenoColumn,
+       rc=ANALYSE_CurFitMethod(ws,indexFenoColumn,
                                spec1,                       // etalon reference spectrum
                                NULL,                        // error on raw spectrum
                                spec2,                       // reference spectrum
-                               Feno->NDET,
+                               pFeno->NDET,
                                NULL,
-                               &Square,                     // returned stretch order 2
+                               &ws->square,                     // returned stretch order 2
                                NULL,                        // number of iterations in Curfit
                                1.,
                                1.,
-                               &Feno->fit_properties);
+                               &pFeno->fit_properties);
   
-  if (Feno->molecularCorrection)
-      Analyse_Molecular_Ring_End(Feno,Feno->NDET);    
+  if (pFeno->molecularCorrection)
+      Analyse_Molecular_Ring_End(pFeno,pFeno->NDET);    
   
-  LINEAR_free(Feno->fit_properties.linfit);
+  LINEAR_free(pFeno->fit_properties.linfit);
   
   //Feno->molecularCorrection=molecularRingFlag;
 
   if(rc>=THREAD_EVENT_STOP) {
-    return ERROR_SetLast(__func__,ERROR_TYPE_WARNING,ERROR_ID_REF_ALIGNMENT,Feno->windowName);
+    return ERROR_SetLast(__func__,ERROR_TYPE_WARNING,ERROR_ID_REF_ALIGNMENT,pFeno->windowName);
   }
 
-  const CROSS_RESULTS *pResults=&Feno->TabCrossResults[Feno->indexSpectrum];
+  const CROSS_RESULTS *pResults=&pFeno->TabCrossResults[pFeno->indexSpectrum];
   *shift=pResults->Shift;
   *stretch=pResults->Stretch;
   *stretch2=pResults->Stretch2;
@@ -2489,13 +2621,15 @@ RC ANALYSE_fit_shift_stretch(int indexFeno, int indexFenoColumn, const double *s
 //  refFlag==0 : GB, file mode selection or satellite, file mode selection, radasref as ref1
 //  refFlag==1 : GB, automatic mode selection or satellite
 //  refFlag==2 : Satellites, automatic mode  , file mode selection, radasref && kurucz on irradiance
-RC ANALYSE_AlignReference(ENGINE_CONTEXT *pEngineContext,int refFlag,void *responseHandle,INDEX indexFenoColumn) {
+RC ANALYSE_AlignReference(struct analysis_workspace *ws,ENGINE_CONTEXT *pEngineContext,int refFlag,void *responseHandle,INDEX indexFenoColumn) {
   RC rc = ERROR_ID_NO;
   
   for (int WrkFeno=0; WrkFeno<NFeno && !rc; WrkFeno++) {
 
     const FENO *pFeno = &TabFeno[indexFenoColumn][WrkFeno];
 
+    TabFeno[indexFenoColumn][WrkFeno].warmStartN=0;                             // the reference may change, don't start the next fit from the previous one
+
     if (((pEngineContext->project.instrumental.readOutFormat==PRJCT_INSTR_FORMAT_GOME1_NETCDF) ||
          (pEngineContext->project.instrumental.readOutFormat==PRJCT_INSTR_FORMAT_TROPOMI) ||
          (pEngineContext->project.instrumental.readOutFormat==PRJCT_INSTR_FORMAT_APEX) ||
@@ -2514,7 +2648,7 @@ RC ANALYSE_AlignReference(ENGINE_CONTEXT *pEngineContext,int refFlag,void *respo
         && !VECTOR_Equal(pFeno->SrefEtalon,pFeno->Sref,pFeno->NDET,0.) ) {
      double shift, stretch, stretch2, sigma_shift, sigma_stretch, sigma_stretch2;
 
-      rc=ANALYSE_fit_shift_stretch(WrkFeno, indexFenoColumn, pFeno->SrefEtalon, pFeno->Sref, &shift, &stretch, &stretch2, &sigma_shift, &sigma_stretch, &sigma_stretch2);
+      rc=ANALYSE_fit_shift_stretch(ws,WrkFeno, indexFenoColumn, pFeno->SrefEtalon, pFeno->Sref, &shift, &stretch, &stretch2, &sigma_shift, &sigma_stretch, &sigma_stretch2);
       
       double *lambda=pFeno->Lambda; // CHECK: this used to be the global pointer 'Lambda'. changed it to a local pointer
       const double lambda0=pFeno->lambda0;
@@ -2533,10 +2667,10 @@ RC ANALYSE_AlignReference(ENGINE_CONTEXT *pEngineContext,int refFlag,void *respo
 
         char refTitle[256];
 
-        memcpy(ANALYSE_secX,ANALYSE_zeros,sizeof(*ANALYSE_secX)*pFeno->NDET);
+        memcpy(ws->secX,ANALYSE_zeros,sizeof(*ws->secX)*pFeno->NDET);
 
-        for (int i=SvdPDeb;i<=SvdPFin;i++)
-          ANALYSE_secX[i]=exp(log(pFeno->SrefEtalon[i])+ANALYSE_absolu[i]);
+        for (int i=ws->svdPDeb;i<=ws->svdPFin;i++)
+          ws->secX[i]=exp(log(pFeno->SrefEtalon[i])+ws->absolu[i]);
 
         if (ANALYSE_swathSize==1)
          sprintf(refTitle,"Ref1/Ref2 in %s",pFeno->windowName);
@@ -2545,8 +2679,8 @@ RC ANALYSE_AlignReference(ENGINE_CONTEXT *pEngineContext,int refFlag,void *respo
 
         plot_data_t spectrumData[2];
         const int indexPage=plotPageRef; // (pEngineContext->satelliteFlag || (ANALYSE_swathSize>1))?plotPageRef:WrkFeno+plotPageAnalysis-1;
-        mediateAllocateAndSetPlotData(&spectrumData[0],"Measured",&lambda[SvdPDeb],&pFeno->SrefEtalon[SvdPDeb],SvdPFin-SvdPDeb+1,Line);
-        mediateAllocateAndSetPlotData(&spectrumData[1],"Calculated",&lambda[SvdPDeb],&ANALYSE_secX[SvdPDeb],SvdPFin-SvdPDeb+1,Line);
+        mediateAllocateAndSetPlotData(&spectrumData[0],"Measured",&lambda[ws->svdPDeb],&pFeno->SrefEtalon[ws->svdPDeb],ws->svdPFin-ws->svdPDeb+1,Line);
+        mediateAllocateAndSetPlotData(&spectrumData[1],"Calculated",&lambda[ws->svdPDeb],&ws->secX[ws->svdPDeb],ws->svdPFin-ws->svdPDeb+1,Line);
         mediateResponsePlotData(indexPage,spectrumData,2,Spectrum,forceAutoScale,refTitle,"Wavelength (nm)","Intensity", responseHandle);
         mediateResponseLabelPage(indexPage,pEngineContext->fileInfo.fileName, "Reference", responseHandle);
         mediateReleasePlotData(&spectrumData[1]);
@@ -2574,8 +2708,9 @@ RC ANALYSE_AlignReference(ENGINE_CONTEXT *pEngineContext,int refFlag,void *respo
   return rc;
 }
 
-RC AnalyseSaveResiduals(char *fileName,ENGINE_CONTEXT *pEngineContext, const int n_wavel)
+RC AnalyseSaveResiduals(const struct analysis_workspace *ws,char *fileName,ENGINE_CONTEXT *pEngineContext, const int n_wavel)
 {
+  const FENO *pFeno=ws->feno;
   RC rc;
   char *fileNamePtr,*ptr,resFile[MAX_ITEM_TEXT_LEN],ext[MAX_ITEM_TEXT_LEN];
   FILE *fp;
@@ -2595,7 +2730,7 @@ RC AnalyseSaveResiduals(char *fileName,ENGINE_CONTEXT *pEngineContext, const int
     if ((ptr=strrchr(fileNamePtr,'.'))!=NULL)
      *ptr=0;
 
-    sprintf(ext,"_%s.%s",Feno->windowName,FILES_types[FILE_TYPE_RES].fileExt);
+    sprintf(ext,"_%s.%s",pFeno->windowName,FILES_types[FILE_TYPE_RES].fileExt);
     strcat(fileNamePtr,ext);
    }
 
@@ -2608,7 +2743,7 @@ RC AnalyseSaveResiduals(char *fileName,ENGINE_CONTEXT *pEngineContext, const int
       fprintf(fp,"0 0 0 ");
 
       for(int i=0; i<n_wavel; ++i) {
-       fprintf(fp,"%.14le ",Feno->Lambda[i]);
+       fprintf(fp,"%.14le ",pFeno->Lambda[i]);
       }
       fprintf(fp,"\n");
      }
@@ -2618,7 +2753,7 @@ RC AnalyseSaveResiduals(char *fileName,ENGINE_CONTEXT *pEngineContext, const int
 
     int curPixel = 0;
     doas_iterator my_iterator;
-    doas_interval *nextinterval = iterator_start_interval(&my_iterator, Feno->fit_properties.specrange);
+    doas_interval *nextinterval = iterator_start_interval(&my_iterator, pFeno->fit_properties.specrange);
     while (curPixel < n_wavel) {
      int stop = (nextinterval != NULL)
        ? interval_start(nextinterval)
@@ -2634,7 +2769,7 @@ RC AnalyseSaveResiduals(char *fileName,ENGINE_CONTEXT *pEngineContext, const int
 
       // print residual for every pixel inside the current range.
       while(curPixel <= end) {
-       fprintf(fp,"%.14le ",ANALYSE_absolu[curPixel]);
+       fprintf(fp,"%.14le ",ws->absolu[curPixel]);
        ++curPixel;
       }
       nextinterval = iterator_next_interval(&my_iterator);
@@ -2648,20 +2783,129 @@ RC AnalyseSaveResiduals(char *fileName,ENGINE_CONTEXT *pEngineContext, const int
   return rc;
 }
 
+static RC AnalyseUsampBuild(const struct analysis_workspace *ws,int analysisFlag,int gomeFlag,int indexFenoColumn);
+
+// ----------------------------------------------------------------------------------------------
+// AnalyseFreeColumns : number of columns of the SVD matrix whose concentrations are fitted linearly
+// ----------------------------------------------------------------------------------------------
+
+// Fixed concentrations are not taken into account for singular value decomposition
+
+static int AnalyseFreeColumns(const FENO *pFeno,const struct fit_properties *fitprops)
+{
+  const CROSS_REFERENCE *TabCross=pFeno->TabCross;
+  int NewDimC=fitprops->DimC;
+
+  for (int i=0;i<pFeno->NTabCross && (NewDimC==fitprops->DimC);i++)
+   if ((pFeno->analysisMethod==OPTICAL_DENSITY_FIT) && (TabCross[i].FitConc==0) &&
+       (TabCross[i].DeltaConc==(double)0.) && TabCross[i].IndSvdA && (TabCross[i].IndSvdA<=NewDimC))
+
+    NewDimC=TabCross[i].IndSvdA-1;
+
+  return NewDimC;
+}
+
+// ------------------------------------------------------------------------------------------------------
+// AnalyseFixedColumns : columns of the SVD matrix that are the same for all the evaluations of a fit
+// ------------------------------------------------------------------------------------------------------
+
+// fixed[1..DimC] is set to 1 for the columns that ANALYSE_Function builds from
+// vectors which depend neither on the non linear parameters nor on the aligned
+// spectrum (polynomials, unshifted cross sections, ...)
+
+static void AnalyseFixedColumns(const struct analysis_workspace *ws,const struct fit_properties *fitprops,int *fixed)
+{
+  const FENO *pFeno=ws->feno;
+  const CROSS_REFERENCE *TabCross=pFeno->TabCross;
+  const int realTimeXs=(pFeno->hidden==1) && pFeno->xsToConvolute && pKuruczOptions->fwhmFit;      // cross sections convoluted at each evaluation
+  const int autoUsamp=pFeno->useUsamp && (pUsamp->method==PRJCT_USAMP_AUTOMATIC);                  // undersampling cross sections built at each evaluation
+
+  for (int j=0;j<=fitprops->DimC;j++)
+   fixed[j]=1;
+
+  for (int i=0;i<pFeno->NTabCross;i++) {
+    const int indexSvdA=TabCross[i].IndSvdA;
+
+    if (indexSvdA<=0)
+     continue;
+
+    const char *symbolName=WorkSpace[TabCross[i].Comp].symbolName;
+
+    switch(WorkSpace[TabCross[i].Comp].type) {
+     case WRK_SYMBOL_CROSS :
+      fixed[indexSvdA]=!realTimeXs &&
+                       (TabCross[i].FitShift==ITEM_NONE) && (TabCross[i].FitStretch==ITEM_NONE) && (TabCross[i].FitStretch2==ITEM_NONE);
+     break;
+     case WRK_SYMBOL_PREDEFINED :
+      if ((i==pFeno->indexUsamp1) || (i==pFeno->indexUsamp2))
+       fixed[indexSvdA]=!autoUsamp;
+     break;
+     case WRK_SYMBOL_CONTINUOUS :
+      // polynomials of order n are calculated from the column of order n-1; the linear offset
+      // normalized w.r.t. the spectrum depends on the aligned spectrum
+
+      if (((strlen(symbolName)==2) && (symbolName[0]=='x') && (symbolName[1]!='0')) ||
+          ((strlen(symbolName)==5) && !strncmp(symbolName,"offl",4) && (symbolName[4]!='0')))
+       fixed[indexSvdA]=fixed[indexSvdA-1];
+      else if ((strlen(symbolName)==5) && !strncmp(symbolName,"offl",4))
+       fixed[indexSvdA]=(pFeno->analysisMethod!=OPTICAL_DENSITY_FIT) || (pFeno->linear_offset_mode!=LINEAR_OFFSET_RAD);
+     break;
+     default :
+     break;
+    }
+  }
+
+  // Differences of cross sections (XsDifferences)
+
+  for (int i=0;i<pFeno->NTabCross;i++)
+   if (TabCross[i].IndSvdA && (TabCross[i].IndSubtract!=ITEM_NONE))
+    fixed[TabCross[i].IndSvdA]&=fixed[TabCross[TabCross[i].IndSubtract].IndSvdA];
+
+  // Orthogonalization : the orthogonalized columns depend on all the vectors of the base
+
+  if (ws->nOrtho) {
+    int allFixed=1;
+
+    for (int i=0;i<pFeno->NTabCross;i++)
+     if (TabCross[i].IndSvdA && (TabCross[i].IndOrthog!=ITEM_NONE))
+      allFixed&=fixed[TabCross[i].IndSvdA];
+
+    if (!allFixed)
+     for (int i=0;i<pFeno->NTabCross;i++)
+      if (TabCross[i].IndSvdA && (TabCross[i].IndOrthog!=ITEM_NONE))
+       fixed[TabCross[i].IndSvdA]=0;
+  }
+}
+
+// -----------------------------------------------------------------------------------------------
+// ANALYSE_SetQRUpdate : keep the decomposition of the columns that don't change during a fit
+// -----------------------------------------------------------------------------------------------
+
+// When enabled, ANALYSE_Function declares the fixed columns of the SVD matrix
+// (AnalyseFixedColumns) to the linear system of the fit, so that their QR
+// decomposition is calculated once per fit instead of at each evaluation
+
+void ANALYSE_SetQRUpdate(int enable)
+{
+  analyseQRUpdate=enable;
+}
+
 // --------------------------------------------------------------------------------------------------------
 // Function : Cross sections and spectrum alignment using spline fitting functions and new Yfit computation
 // --------------------------------------------------------------------------------------------------------
 
-RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *SigmaY, double *Yfit, int Npts,
+RC ANALYSE_Function(struct analysis_workspace *ws,double *spectrum_orig, double *reference, const double *SigmaY, double *Yfit, int Npts,
                      double *fitParamsC, double *fitParamsF,INDEX indexFenoColumn, struct fit_properties *fitprops)
 {
   // Declarations
 
+  FENO *pFeno=ws->feno;
   double *XTrav,*YTrav,*newXsTrav,*spec_nolog,*spectrum_interpolated,*reference_shifted, deltaX;
   CROSS_REFERENCE *TabCross,*pTabCross;
   int NewDimC,offsetOrder;
   INDEX indexSvdA,indexSvdP,polyOrder,polyFlag;
   double lambda0,slitParam[NSFP];
+  MEMORY_ARENA *pArena;
   RC rc;
 
 #if defined(__DEBUG_) && __DEBUG_
@@ -2670,25 +2914,25 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
 
   // Initializations
   const int n_wavel = NDET[indexFenoColumn];
-  TabCross=Feno->TabCross;
+  TabCross=pFeno->TabCross;
   XTrav=YTrav=newXsTrav=spectrum_interpolated=reference_shifted=spec_nolog=NULL;
+  pArena=MEMORY_SelectArena(&ws->scratch);                                       // temporary vectors (also used by FILTER_Vector)
 
   for (int i=0;i<NSFP;i++)
-   if (Feno->indexFwhmParam[i]!=ITEM_NONE)
-    slitParam[i]=(TabCross[Feno->indexFwhmParam[i]].FitParam!=ITEM_NONE)?fitParamsF[TabCross[Feno->indexFwhmParam[i]].FitParam]:TabCross[Feno->indexFwhmParam[i]].InitParam;
+   if (pFeno->indexFwhmParam[i]!=ITEM_NONE)
+    slitParam[i]=(TabCross[pFeno->indexFwhmParam[i]].FitParam!=ITEM_NONE)?fitParamsF[TabCross[pFeno->indexFwhmParam[i]].FitParam]:TabCross[pFeno->indexFwhmParam[i]].InitParam;
 
   polyFlag=0;
-  NewDimC=fitprops->DimC;
 
-  lambda0 = (!Feno->hidden)?Feno->lambda0:center_pixel_wavelength(SvdPDeb, SvdPFin);
+  lambda0 = (!pFeno->hidden)?pFeno->lambda0:center_pixel_wavelength(ws->splineX,ws->svdPDeb, ws->svdPFin);
 
   rc=ERROR_ID_NO;
 
   // Real time convolution for Kurucz
 
-  if ((Feno->hidden==1) && Feno->xsToConvolute && pKuruczOptions->fwhmFit) {
+  if ((pFeno->hidden==1) && pFeno->xsToConvolute && pKuruczOptions->fwhmFit) {
 
-    rc=ANALYSE_XsConvolution(Feno,Lambda,NULL,slitParam,pKuruczOptions->fwhmType,indexFenoColumn,(pKuruczOptions->fwhmType==SLIT_TYPE_FILE)?1:0);
+    rc=ANALYSE_XsConvolution(pFeno,ws->lambda,NULL,slitParam,pKuruczOptions->fwhmType,indexFenoColumn,(pKuruczOptions->fwhmType==SLIT_TYPE_FILE)?1:0);
     if(rc) {
       goto EndFunction;
     }
@@ -2696,20 +2940,16 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
 
   // Don't take fixed concentrations into account for singular value decomposition
 
-  for (int i=0;i<Feno->NTabCross && (NewDimC==fitprops->DimC);i++)
-   if ((Feno->analysisMethod==OPTICAL_DENSITY_FIT) && (TabCross[i].FitConc==0) &&
-       (TabCross[i].DeltaConc==(double)0.) && TabCross[i].IndSvdA && (TabCross[i].IndSvdA<=NewDimC))
-
-    NewDimC=TabCross[i].IndSvdA-1;
+  NewDimC=AnalyseFreeColumns(pFeno,fitprops);
 
   // Buffers allocation
 
-  if (((XTrav=MEMORY_AllocDVector(__func__,"XTrav",0,Npts-1))==NULL) ||                  // raw spectrum
-      ((YTrav=MEMORY_AllocDVector(__func__,"YTrav",0,Npts-1))==NULL) ||                  // reference spectrum
-      ((spec_nolog=MEMORY_AllocDVector(__func__,"spec_nolog",0,Npts-1))==NULL) ||
-      ((newXsTrav=MEMORY_AllocDVector(__func__,"newXsTrav",0,n_wavel-1))==NULL) ||
-      ((spectrum_interpolated=MEMORY_AllocDVector(__func__,"spectrum_interpolated",0,n_wavel-1))==NULL) || // spectrum interpolated on reference wavelength grid
-      ((reference_shifted=MEMORY_AllocDVector(__func__,"reference_shifted",0,n_wavel-1))==NULL))
+  if (((XTrav=MEMORY_AllocScratchDVector(__func__,"XTrav",0,Npts-1))==NULL) ||                  // raw spectrum
+      ((YTrav=MEMORY_AllocScratchDVector(__func__,"YTrav",0,Npts-1))==NULL) ||                  // reference spectrum
+      ((spec_nolog=MEMORY_AllocScratchDVector(__func__,"spec_nolog",0,Npts-1))==NULL) ||
+      ((newXsTrav=MEMORY_AllocScratchDVector(__func__,"newXsTrav",0,n_wavel-1))==NULL) ||
+      ((spectrum_interpolated=MEMORY_AllocScratchDVector(__func__,"spectrum_interpolated",0,n_wavel-1))==NULL) || // spectrum interpolated on reference wavelength grid
+      ((reference_shifted=MEMORY_AllocScratchDVector(__func__,"reference_shifted",0,n_wavel-1))==NULL))
 
    rc=ERROR_ID_ALLOC;
 
@@ -2726,24 +2966,24 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
    // ---------------------------------
 
     double shift_rad, stretch_rad, stretch2_rad;
-    if(Feno->indexSpectrum!=ITEM_NONE) {
-      shift_rad = (TabCross[Feno->indexSpectrum].FitShift!=ITEM_NONE)
-        ? fitParamsF[TabCross[Feno->indexSpectrum].FitShift]
-        : TabCross[Feno->indexSpectrum].InitShift;
-      stretch_rad = (TabCross[Feno->indexSpectrum].FitStretch!=ITEM_NONE)
-        ? fitParamsF[TabCross[Feno->indexSpectrum].FitStretch]
-        : TabCross[Feno->indexSpectrum].InitStretch;
-      stretch2_rad = (TabCross[Feno->indexSpectrum].FitStretch2!=ITEM_NONE)
-        ? fitParamsF[TabCross[Feno->indexSpectrum].FitStretch2]
-        : TabCross[Feno->indexSpectrum].InitStretch2;
+    if(pFeno->indexSpectrum!=ITEM_NONE) {
+      shift_rad = (TabCross[pFeno->indexSpectrum].FitShift!=ITEM_NONE)
+        ? fitParamsF[TabCross[pFeno->indexSpectrum].FitShift]
+        : TabCross[pFeno->indexSpectrum].InitShift;
+      stretch_rad = (TabCross[pFeno->indexSpectrum].FitStretch!=ITEM_NONE)
+        ? fitParamsF[TabCross[pFeno->indexSpectrum].FitStretch]
+        : TabCross[pFeno->indexSpectrum].InitStretch;
+      stretch2_rad = (TabCross[pFeno->indexSpectrum].FitStretch2!=ITEM_NONE)
+        ? fitParamsF[TabCross[pFeno->indexSpectrum].FitStretch2]
+        : TabCross[pFeno->indexSpectrum].InitStretch2;
     } else {
       shift_rad = stretch_rad = stretch2_rad = 0.;
     }
 
-    if ( (rc=ShiftVector(LambdaSpec, spectrum_orig, SplineSpec, spectrum_interpolated, n_wavel,
+    if ( (rc=ShiftVector(ws,ws->lambdaSpec, spectrum_orig, ws->splineSpec, spectrum_interpolated, n_wavel,
                          shift_rad, stretch_rad, stretch2_rad, //
                          0., 0., 0., fitParamsF, -1, 0, 0, indexFenoColumn))!=ERROR_ID_NO ||
-         (Feno->useUsamp && pUsamp->method==PRJCT_USAMP_AUTOMATIC && (rc=ANALYSE_UsampBuild(2,ITEM_NONE,indexFenoColumn))!=ERROR_ID_NO) )
+         (pFeno->useUsamp && pUsamp->method==PRJCT_USAMP_AUTOMATIC && (rc=AnalyseUsampBuild(ws,2,ITEM_NONE,indexFenoColumn))!=ERROR_ID_NO) )
 
       goto EndFunction;
 
@@ -2753,8 +2993,8 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
 
    // Filter real time only when fitting difference of resolution between spectrum and reference
 
-   if ((Feno->analysisType==ANALYSIS_TYPE_FWHM_NLFIT) && (ANALYSE_plFilter->filterFunction!=NULL) &&
-       ((rc=FILTER_Vector(ANALYSE_plFilter,&spectrum_interpolated[LimMin],&spectrum_interpolated[LimMin],NULL,LimN,PRJCT_FILTER_OUTPUT_LOW))!=0)) {
+   if ((pFeno->analysisType==ANALYSIS_TYPE_FWHM_NLFIT) && (ANALYSE_plFilter->filterFunction!=NULL) &&
+       ((rc=FILTER_Vector(ANALYSE_plFilter,&spectrum_interpolated[ws->limMin],&spectrum_interpolated[ws->limMin],NULL,ws->limN,PRJCT_FILTER_OUTPUT_LOW))!=0)) {
      rc=ERROR_SetLast("EndFunction",ERROR_TYPE_WARNING,ERROR_ID_ANALYSIS,analyseIndexRecord,"Filter");
      goto EndFunction;
     }
@@ -2763,47 +3003,47 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
    // Calculate the mean
    //-------------------
    doas_iterator my_iterator;
-   Feno->xmean=(double)0.;
-   for(int i = iterator_start(&my_iterator, global_doas_spectrum); i != ITERATOR_FINISHED; i=iterator_next(&my_iterator))
-    Feno->xmean+=(double)spectrum_interpolated[i];
+   pFeno->xmean=(double)0.;
+   for(int i = iterator_start(&my_iterator, ws->specrange); i != ITERATOR_FINISHED; i=iterator_next(&my_iterator))
+    pFeno->xmean+=(double)spectrum_interpolated[i];
 
-   Feno->xmean/=Npts;
+   pFeno->xmean/=Npts;
 
    // -------------------------------
    // Spectrum correction with offset
    // -------------------------------
 
-   if (Feno->analysisMethod!=INTENSITY_FIT) {
+   if (pFeno->analysisMethod!=INTENSITY_FIT) {
      offsetOrder=-1;
 
-     if ((Feno->indexOffsetConst!=ITEM_NONE) && ((TabCross[Feno->indexOffsetConst].FitParam!=ITEM_NONE) || (TabCross[Feno->indexOffsetConst].InitParam!=(double)0.)))
+     if ((pFeno->indexOffsetConst!=ITEM_NONE) && ((TabCross[pFeno->indexOffsetConst].FitParam!=ITEM_NONE) || (TabCross[pFeno->indexOffsetConst].InitParam!=(double)0.)))
       offsetOrder=0;
-     if ((Feno->indexOffsetOrder1!=ITEM_NONE) && ((TabCross[Feno->indexOffsetOrder1].FitParam!=ITEM_NONE) || (TabCross[Feno->indexOffsetOrder1].InitParam!=(double)0.)))
+     if ((pFeno->indexOffsetOrder1!=ITEM_NONE) && ((TabCross[pFeno->indexOffsetOrder1].FitParam!=ITEM_NONE) || (TabCross[pFeno->indexOffsetOrder1].InitParam!=(double)0.)))
       offsetOrder=1;
-     if ((Feno->indexOffsetOrder2!=ITEM_NONE) && ((TabCross[Feno->indexOffsetOrder2].FitParam!=ITEM_NONE) || (TabCross[Feno->indexOffsetOrder2].InitParam!=(double)0.)))
+     if ((pFeno->indexOffsetOrder2!=ITEM_NONE) && ((TabCross[pFeno->indexOffsetOrder2].FitParam!=ITEM_NONE) || (TabCross[pFeno->indexOffsetOrder2].InitParam!=(double)0.)))
       offsetOrder=2;
 
      if (offsetOrder>=0) {
-       for (int i=LimMin;i<=LimMax;i++) {
-         deltaX=(double)(ANALYSE_splineX[i]-lambda0);
+       for (int i=ws->limMin;i<=ws->limMax;i++) {
+         deltaX=(double)(ws->splineX[i]-lambda0);
 
-         double offset=(TabCross[Feno->indexOffsetConst].FitParam!=ITEM_NONE)
-           ? fitParamsF[TabCross[Feno->indexOffsetConst].FitParam]
-           : TabCross[Feno->indexOffsetConst].InitParam;
+         double offset=(TabCross[pFeno->indexOffsetConst].FitParam!=ITEM_NONE)
+           ? fitParamsF[TabCross[pFeno->indexOffsetConst].FitParam]
+           : TabCross[pFeno->indexOffsetConst].InitParam;
 
          if (offsetOrder>=1) {
-           const double val = (TabCross[Feno->indexOffsetOrder1].FitParam!=ITEM_NONE)
-             ? fitParamsF[TabCross[Feno->indexOffsetOrder1].FitParam]/TabCross[Feno->indexOffsetOrder1].Fact
-             : TabCross[Feno->indexOffsetOrder1].InitParam;
+           const double val = (TabCross[pFeno->indexOffsetOrder1].FitParam!=ITEM_NONE)
+             ? fitParamsF[TabCross[pFeno->indexOffsetOrder1].FitParam]/TabCross[pFeno->indexOffsetOrder1].Fact
+             : TabCross[pFeno->indexOffsetOrder1].InitParam;
            offset+=val*deltaX;
          }
          if (offsetOrder>=2) {
-           const double val = (TabCross[Feno->indexOffsetOrder2].FitParam!=ITEM_NONE)
-             ? fitParamsF[TabCross[Feno->indexOffsetOrder2].FitParam]/TabCross[Feno->indexOffsetOrder2].Fact
-             : TabCross[Feno->indexOffsetOrder2].InitParam;
+           const double val = (TabCross[pFeno->indexOffsetOrder2].FitParam!=ITEM_NONE)
+             ? fitParamsF[TabCross[pFeno->indexOffsetOrder2].FitParam]/TabCross[pFeno->indexOffsetOrder2].Fact
+             : TabCross[pFeno->indexOffsetOrder2].InitParam;
            offset+=val*deltaX*deltaX;
          }
-         spectrum_interpolated[i] -= offset*Feno->xmean;
+         spectrum_interpolated[i] -= offset*pFeno->xmean;
        }
      }
    }
@@ -2811,25 +3051,25 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
    // ------------------------------------------
    // Backup of spectrum before taking logarithm
    // ------------------------------------------
-   for( int k=0,l=iterator_start(&my_iterator, global_doas_spectrum); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
+   for( int k=0,l=iterator_start(&my_iterator, ws->specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
      spec_nolog[k]=spectrum_interpolated[l];
 
    // -------------------------------
    // High-pass filtering on spectrum
    // -------------------------------
 
-   if ((Feno->analysisMethod==OPTICAL_DENSITY_FIT) && !hFilterSpecLog &&  // logarithms are not calculated and filtered before entering this function
-       (((rc=VECTOR_Log(&spectrum_interpolated[LimMin],&spectrum_interpolated[LimMin],LimN,"ANALYSE_Function (Spec) "))!=0) ||
+   if ((pFeno->analysisMethod==OPTICAL_DENSITY_FIT) && !ws->hFilterSpecLog &&  // logarithms are not calculated and filtered before entering this function
+       (((rc=VECTOR_Log(&spectrum_interpolated[ws->limMin],&spectrum_interpolated[ws->limMin],ws->limN,"ANALYSE_Function (Spec) "))!=0) ||
         ((ANALYSE_phFilter->filterFunction!=NULL) &&
-         ((!Feno->hidden && ANALYSE_phFilter->hpFilterAnalysis) || ((Feno->hidden==1) && ANALYSE_phFilter->hpFilterCalib)) &&
-         ((rc=FILTER_Vector(ANALYSE_phFilter,&spectrum_interpolated[LimMin],&spectrum_interpolated[LimMin],NULL,LimN,PRJCT_FILTER_OUTPUT_HIGH_SUB))!=0))))
+         ((!pFeno->hidden && ANALYSE_phFilter->hpFilterAnalysis) || ((pFeno->hidden==1) && ANALYSE_phFilter->hpFilterCalib)) &&
+         ((rc=FILTER_Vector(ANALYSE_phFilter,&spectrum_interpolated[ws->limMin],&spectrum_interpolated[ws->limMin],NULL,ws->limN,PRJCT_FILTER_OUTPUT_HIGH_SUB))!=0))))
     goto EndFunction;
 
    // ----------------------------
    // Transfer to working variable
    // ----------------------------
 
-   for( int k=0,l=iterator_start(&my_iterator, global_doas_spectrum); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator)) {
+   for( int k=0,l=iterator_start(&my_iterator, ws->specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator)) {
      XTrav[k]=spectrum_interpolated[l];
    }
 
@@ -2841,8 +3081,8 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
    // Build svd matrix
    // ----------------
    
-   if (Feno->Decomp) {
-     for (int i=0;i<Feno->NTabCross;i++)
+   if (pFeno->Decomp) {
+     for (int i=0;i<pFeno->NTabCross;i++)
 
        if ((indexSvdA=TabCross[i].IndSvdA)>0) {
          pTabCross=&TabCross[i];
@@ -2850,34 +3090,34 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
 
          // Fill SVD matrix with predefined components
 
-         int numpixels = spectrum_length(global_doas_spectrum);
+         int numpixels = spectrum_length(ws->specrange);
 
          if (WorkSpace[pTabCross->Comp].type==WRK_SYMBOL_PREDEFINED) {
            doas_iterator my_iterator;
-           if (i==Feno->indexOffsetConst)
+           if (i==pFeno->indexOffsetConst)
              for (int k=1; k<=numpixels; k++)
                fitprops->A[indexSvdA][k]=1.;
-           else if (i==Feno->indexOffsetOrder1) {
-             for( int k=1,l=iterator_start(&my_iterator, global_doas_spectrum); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
-               fitprops->A[indexSvdA][k]=(double)(ANALYSE_splineX[l]-lambda0);
+           else if (i==pFeno->indexOffsetOrder1) {
+             for( int k=1,l=iterator_start(&my_iterator, ws->specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
+               fitprops->A[indexSvdA][k]=(double)(ws->splineX[l]-lambda0);
            }
-           else if (i==Feno->indexOffsetOrder2) {
-             for( int k=1,l=iterator_start(&my_iterator, global_doas_spectrum); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
-               fitprops->A[indexSvdA][k]=(double)(ANALYSE_splineX[l]-lambda0)*(ANALYSE_splineX[l]-lambda0);
+           else if (i==pFeno->indexOffsetOrder2) {
+             for( int k=1,l=iterator_start(&my_iterator, ws->specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
+               fitprops->A[indexSvdA][k]=(double)(ws->splineX[l]-lambda0)*(ws->splineX[l]-lambda0);
            }
-           else if ((i==Feno->indexCommonResidual) || (i==Feno->indexUsamp1) || (i==Feno->indexUsamp2)) {
-             for( int k=1, l=iterator_start(&my_iterator, global_doas_spectrum); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
-               fitprops->A[indexSvdA][k]=(Feno->analysisMethod==OPTICAL_DENSITY_FIT) ?
+           else if ((i==pFeno->indexCommonResidual) || (i==pFeno->indexUsamp1) || (i==pFeno->indexUsamp2)) {
+             for( int k=1, l=iterator_start(&my_iterator, ws->specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
+               fitprops->A[indexSvdA][k]=(pFeno->analysisMethod==OPTICAL_DENSITY_FIT) ?
                  -pTabCross->vector[l] : pTabCross->vector[l];
            }
-           else if (i==Feno->indexResol) {
+           else if (i==pFeno->indexResol) {
 
              double resolDelta=0.05;                                                   // small increment to calculate the derivative
-             double resolCoeff=Feno->resolFwhm/resolDelta;
+             double resolCoeff=pFeno->resolFwhm/resolDelta;
              double resolX=resolDelta*sqrt((double)1.+2.*resolCoeff);
 
-             for( int k=1, l=max(iterator_start(&my_iterator, global_doas_spectrum),1); (l != ITERATOR_FINISHED) && !rc; k++,l=iterator_next(&my_iterator))
-               if (!(rc=XSCONV_TypeGauss(ANALYSE_splineX,reference,SplineRef,ANALYSE_splineX[l],ANALYSE_splineX[l]-ANALYSE_splineX[l-1],&pTabCross->vector[l],resolX,(double)0.,SLIT_TYPE_GAUSS, n_wavel)))
+             for( int k=1, l=max(iterator_start(&my_iterator, ws->specrange),1); (l != ITERATOR_FINISHED) && !rc; k++,l=iterator_next(&my_iterator))
+               if (!(rc=XSCONV_TypeGauss(ws->splineX,reference,ws->splineRef,ws->splineX[l],ws->splineX[l]-ws->splineX[l-1],&pTabCross->vector[l],resolX,(double)0.,SLIT_TYPE_GAUSS, n_wavel)))
                  fitprops->A[indexSvdA][k]=pTabCross->vector[l]=(reference[l]!=0)?resolCoeff*(pTabCross->vector[l]/reference[l]-1):(double)0.;
            }
          }
@@ -2898,31 +3138,31 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
              polyOrder=ITEM_NONE;
 
            if (polyFlag && polyOrder == 0 ) {
-             for( int k=1,l=iterator_start(&my_iterator, global_doas_spectrum); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
+             for( int k=1,l=iterator_start(&my_iterator, ws->specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
                fitprops->A[indexSvdA][k]=pTabCross->vector[l];
            }
            else if (polyOrder > 0) {
              // in order to have geophysical values of the polynomial in output,
-             for( int k=1,l=iterator_start(&my_iterator, global_doas_spectrum); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
-               fitprops->A[indexSvdA][k]=pTabCross->vector[l]=fitprops->A[indexSvdA-1][k]*(ANALYSE_splineX[l]-lambda0);
+             for( int k=1,l=iterator_start(&my_iterator, ws->specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
+               fitprops->A[indexSvdA][k]=pTabCross->vector[l]=fitprops->A[indexSvdA-1][k]*(ws->splineX[l]-lambda0);
            }
-           else if (Feno->analysisMethod==OPTICAL_DENSITY_FIT) { // SVD method, polyOrder == 0, polyFlag == 0 -> linear offset, order 0
+           else if (pFeno->analysisMethod==OPTICAL_DENSITY_FIT) { // SVD method, polyOrder == 0, polyFlag == 0 -> linear offset, order 0
 
-             switch (Feno->linear_offset_mode) {
+             switch (pFeno->linear_offset_mode) {
              case LINEAR_OFFSET_RAD: // normalized w.r.t. the spectrum
-               for( int k=1,l=iterator_start(&my_iterator, global_doas_spectrum); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator)) {
+               for( int k=1,l=iterator_start(&my_iterator, ws->specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator)) {
                  fitprops->A[indexSvdA][k]= pTabCross->vector[l] = (fabs(spec_nolog[k-1])> 1.e-14) // 1e-6
-                   ? -Feno->xmean/spec_nolog[k-1]
+                   ? -pFeno->xmean/spec_nolog[k-1]
                    : 0.;
                }
                break;
              case LINEAR_OFFSET_REF: {
                // offset normalized w.r.t. the reference.
                const double * const offset_ref = reference;
-               for (int k=0;k<Feno->NDET;k++)
-              for( int k=1,l=iterator_start(&my_iterator, global_doas_spectrum); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator)) {
+               for (int k=0;k<pFeno->NDET;k++)
+              for( int k=1,l=iterator_start(&my_iterator, ws->specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator)) {
                  fitprops->A[indexSvdA][k]=pTabCross->vector[l]= (fabs(offset_ref[l])> 1.e-14) // 1e-6
-                   ? Feno->ymean/offset_ref[l]  // !!!! XMEAN -> YMEAN
+                   ? pFeno->ymean/offset_ref[l]  // !!!! XMEAN -> YMEAN
                    : 0.;
 
                }
@@ -2935,8 +3175,8 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
              }
            } else { // linear offset, Marquardt+SVD method -> normalized w.r.t. the reference
 
-             for( int k=1,l=iterator_start(&my_iterator, global_doas_spectrum); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
-               fitprops->A[indexSvdA][k]=pTabCross->vector[l]=(fabs(reference[l])>(double)1.e-6)?(double)Feno->xmean/reference[l] :(double)0.;
+             for( int k=1,l=iterator_start(&my_iterator, ws->specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
+               fitprops->A[indexSvdA][k]=pTabCross->vector[l]=(fabs(reference[l])>(double)1.e-6)?(double)pFeno->xmean/reference[l] :(double)0.;
            }
          }
 
@@ -2946,24 +3186,24 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
           {
            // Use substitution vectors for cross sections because of AMF correction or Pukite terms
 
-           memcpy(ANALYSE_xsTrav,pTabCross->vector,sizeof(double)*n_wavel);
-           memcpy(ANALYSE_xsTrav2,pTabCross->Deriv2,sizeof(double)*n_wavel);
+           memcpy(ws->xsTrav,pTabCross->vector,sizeof(double)*n_wavel);
+           memcpy(ws->xsTrav2,pTabCross->Deriv2,sizeof(double)*n_wavel);
 
            // --------------
            // AMF correction
            // --------------
 
-           if ((Feno->amfFlag && ((rc=OUTPUT_GetWveAmf(&Feno->TabCrossResults[i],ZM,Lambda,ANALYSE_xsTrav,n_wavel))!=0)) ||
+           if ((pFeno->amfFlag && ((rc=OUTPUT_GetWveAmf(&pFeno->TabCrossResults[i],ws->zm,ws->lambda,ws->xsTrav,n_wavel))!=0)) ||
 
                // ---------------------------------------
                // Wavelength alignment (AMF) for cross sections
                // ---------------------------------------
 
-                ((rc=ShiftVector(ANALYSE_splineX,ANALYSE_xsTrav /* (0:n_wavel-1) */,ANALYSE_xsTrav2 /* (0:n_wavel-1) */,newXsTrav /* (0:n_wavel-1) */, n_wavel,
+                ((rc=ShiftVector(ws,ws->splineX,ws->xsTrav /* (0:n_wavel-1) */,ws->xsTrav2 /* (0:n_wavel-1) */,newXsTrav /* (0:n_wavel-1) */, n_wavel,
                                  (pTabCross->FitShift!=ITEM_NONE)?(double)fitParamsF[pTabCross->FitShift]:(double)pTabCross->InitShift,
                                  (pTabCross->FitStretch!=ITEM_NONE)?(double)fitParamsF[pTabCross->FitStretch]:(double)pTabCross->InitStretch,
                                  (pTabCross->FitStretch2!=ITEM_NONE)?(double)fitParamsF[pTabCross->FitStretch2]:(double)pTabCross->InitStretch2,
-                                 Feno->Shift,Feno->Stretch,Feno->Stretch2,
+                                 pFeno->Shift,pFeno->Stretch,pFeno->Stretch2,
                                  NULL,0,0,0,indexFenoColumn))!=ERROR_ID_NO))
 
             goto EndFunction;
@@ -2971,62 +3211,57 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
            else
             {
              doas_iterator my_iterator;
-             for( int k=1,l=iterator_start(&my_iterator, global_doas_spectrum); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
+             for( int k=1,l=iterator_start(&my_iterator, ws->specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
               fitprops->A[indexSvdA][k]=newXsTrav[l];
             }
           }
         }
 
-      XsDifferences(fitprops->A,fitprops->DimL);                                // Calculate differences of cross sections before orthogonalizations
-      Orthogonalization(fitprops->A,fitprops->DimL);
+      XsDifferences(ws,fitprops->A,fitprops->DimL);                                // Calculate differences of cross sections before orthogonalizations
+      Orthogonalization(ws,fitprops->A,fitprops->DimL);
 
       // ----------------------------------------------------
       // In optical density fitting mode, allocate linear fitting environment for cross sections:
       // ----------------------------------------------------
       
-      if (Feno->analysisMethod==OPTICAL_DENSITY_FIT) {
-        // clean up old linear fit environment:
-        LINEAR_free(fitprops->linfit);
-        fitprops->linfit = LINEAR_alloc(Npts,NewDimC,DECOMP_EIGEN_QR);
+      if (pFeno->analysisMethod==OPTICAL_DENSITY_FIT) {
+        // reuse the linear fit environment of the previous evaluation:
+        if (fitprops->linfit==NULL)
+          fitprops->linfit = LINEAR_alloc(Npts,NewDimC,DECOMP_EIGEN_QR);
+        else
+          LINEAR_reset(fitprops->linfit,Npts,NewDimC);
+
+        // columns 1..NewDimC of the SVD matrix are the cross sections for which we fit the concentration
+        LINEAR_wrap_matrix(fitprops->linfit,(const double *const *)fitprops->A,fitprops->ldA);
+
+        // only the columns that change with the non linear parameters need a new decomposition
+        if (analyseQRUpdate) {
+          int fixed[MAX_FIT+1];
+          AnalyseFixedColumns(ws,fitprops,fixed);
+          LINEAR_set_fixed_columns(fitprops->linfit,fixed);
+        } else
+          LINEAR_set_fixed_columns(fitprops->linfit,NULL);
       }
 
       // ----------------------------------------------------
       // Cross sections correction with non linear parameters
       // ----------------------------------------------------
 
-      for (int i=0;i<Feno->NTabCross;i++) {
-        pTabCross=&TabCross[i];
+      if (pFeno->analysisMethod==INTENSITY_FIT)
+       for (int i=0;i<pFeno->NTabCross;i++) {
+         pTabCross=&TabCross[i];
 
-        if ((indexSvdA=pTabCross->IndSvdA)>0) {
-          // ----------------------------------------------------
-          // Cross sections correction with non linear parameters
-          // ----------------------------------------------------
-
-          if (indexSvdA <=  NewDimC) {
-            switch (Feno->analysisMethod) {
-            case OPTICAL_DENSITY_FIT:
-              // ----------------------------------------------------
-              // Copy cross sections for which we fit the concentration to linear fit system
-              // ----------------------------------------------------
-              LINEAR_set_column(fitprops->linfit, indexSvdA, fitprops->A[indexSvdA]);
-              break;
-            case INTENSITY_FIT:
-              // Calculate norm
-              pTabCross->Fact = sqrt(VECTOR_Norm(fitprops->A[indexSvdA],Npts));
-              break;
-            default:
-              assert(false); // bug, analysisMethod should be either OPTICAL_DENSITY_FIT or ...SVDMARQUARDT
-              break;
-            }
-          }
-        }
-      }
+         // Calculate norm
+
+         if (((indexSvdA=pTabCross->IndSvdA)>0) && (indexSvdA <=  NewDimC))
+          pTabCross->Fact = sqrt(VECTOR_Norm(fitprops->A[indexSvdA],Npts));
+       }
 
       // -----------------
       // SVD or QR decomposition
       // -----------------
 
-      if (Feno->analysisMethod==OPTICAL_DENSITY_FIT) {
+      if (pFeno->analysisMethod==OPTICAL_DENSITY_FIT) {
         LINEAR_set_weight(fitprops->linfit, SigmaY);
         rc = LINEAR_decompose(fitprops->linfit,fitprops->SigmaSqr,fitprops->covar);
         
@@ -3035,8 +3270,8 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
       }
 
         // We only need to recalculate the svd decomposition if the matrix can be chagned by non-linear fit parameters (NP), weighting by spectrum errors (SigmaY), or linear offset:
-      if (!Feno->fit_properties.NP && (SigmaY==NULL) && ( (Feno->linear_offset_mode != LINEAR_OFFSET_RAD) || (Feno->analysisMethod==INTENSITY_FIT))) {
-        Feno->Decomp=0;
+      if (!pFeno->fit_properties.NP && (SigmaY==NULL) && ( (pFeno->linear_offset_mode != LINEAR_OFFSET_RAD) || (pFeno->analysisMethod==INTENSITY_FIT))) {
+        pFeno->Decomp=0;
       }
     }
 
@@ -3049,34 +3284,34 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
     // ----------------------------------
 
     double shift_ref, stretch_ref, stretch2_ref;
-    if (Feno->indexReference!=ITEM_NONE) {
-      shift_ref = (TabCross[Feno->indexReference].FitShift!=ITEM_NONE)
-        ? fitParamsF[TabCross[Feno->indexReference].FitShift]
-        : TabCross[Feno->indexReference].InitShift;
-      stretch_ref = (TabCross[Feno->indexReference].FitStretch!=ITEM_NONE)
-        ? fitParamsF[TabCross[Feno->indexReference].FitStretch]
-        : TabCross[Feno->indexReference].InitStretch;
-      stretch2_ref = (TabCross[Feno->indexReference].FitStretch2!=ITEM_NONE)
-        ? fitParamsF[TabCross[Feno->indexReference].FitStretch2]
-        : TabCross[Feno->indexReference].InitStretch2;
+    if (pFeno->indexReference!=ITEM_NONE) {
+      shift_ref = (TabCross[pFeno->indexReference].FitShift!=ITEM_NONE)
+        ? fitParamsF[TabCross[pFeno->indexReference].FitShift]
+        : TabCross[pFeno->indexReference].InitShift;
+      stretch_ref = (TabCross[pFeno->indexReference].FitStretch!=ITEM_NONE)
+        ? fitParamsF[TabCross[pFeno->indexReference].FitStretch]
+        : TabCross[pFeno->indexReference].InitStretch;
+      stretch2_ref = (TabCross[pFeno->indexReference].FitStretch2!=ITEM_NONE)
+        ? fitParamsF[TabCross[pFeno->indexReference].FitStretch2]
+        : TabCross[pFeno->indexReference].InitStretch2;
     } else {
       shift_ref = stretch_ref = stretch2_ref = 0;
     }
 
-    if ((rc=ShiftVector(ANALYSE_splineX,reference,SplineRef,reference_shifted,n_wavel,
+    if ((rc=ShiftVector(ws,ws->splineX,reference,ws->splineRef,reference_shifted,n_wavel,
                         shift_ref,stretch_ref,stretch2_ref,
                         (double)0.,(double)0.,(double)0., fitParamsF,1,
-                        (Feno->analysisType==ANALYSIS_TYPE_FWHM_KURUCZ)?1:0,
-                        (Feno->analysisType==ANALYSIS_TYPE_FWHM_SLIT) && (KURUCZ_buffers[indexFenoColumn].hrSolarGridded.matrix!=NULL)?1:0,
+                        (pFeno->analysisType==ANALYSIS_TYPE_FWHM_KURUCZ)?1:0,
+                        (pFeno->analysisType==ANALYSIS_TYPE_FWHM_SLIT) && (KURUCZ_buffers[indexFenoColumn].hrSolarGridded.matrix!=NULL)?1:0,
                         indexFenoColumn))!=ERROR_ID_NO)
 
      goto EndFunction;
 
 #if defined(__DEBUG_) && __DEBUG_  && defined(__DEBUG_DOAS_SHIFT_) && __DEBUG_DOAS_SHIFT_
     if (((analyseDebugMask&DEBUG_FCTTYPE_MATH)!=0) && analyseDebugVar &&
-        (Feno->indexReference!=ITEM_NONE) &&
-        ((TabCross[Feno->indexReference].FitShift!=ITEM_NONE) || (TabCross[Feno->indexReference].InitShift!=(double)0.)))
-     DEBUG_PrintVar("Interpolation of the reference",ANALYSE_splineX,LimMin,LimMax,Y,LimMin,LimMax,SplineRef,LimMin,LimMax,reference_shifted,LimMin,LimMax,NULL);
+        (pFeno->indexReference!=ITEM_NONE) &&
+        ((TabCross[pFeno->indexReference].FitShift!=ITEM_NONE) || (TabCross[pFeno->indexReference].InitShift!=(double)0.)))
+     DEBUG_PrintVar("Interpolation of the reference",ws->splineX,ws->limMin,ws->limMax,Y,ws->limMin,ws->limMax,ws->splineRef,ws->limMin,ws->limMax,reference_shifted,ws->limMin,ws->limMax,NULL);
 #endif
 
     // -------------------------------
@@ -3085,8 +3320,8 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
 
     // Filter real time only when fitting difference of resolution between spectrum and reference
 
-    if ((Feno->analysisType==ANALYSIS_TYPE_FWHM_NLFIT) && (ANALYSE_plFilter->filterFunction!=NULL) &&
-        ((rc=FILTER_Vector(ANALYSE_plFilter,&reference_shifted[LimMin],&reference_shifted[LimMin],NULL,LimN,PRJCT_FILTER_OUTPUT_LOW))!=0))
+    if ((pFeno->analysisType==ANALYSIS_TYPE_FWHM_NLFIT) && (ANALYSE_plFilter->filterFunction!=NULL) &&
+        ((rc=FILTER_Vector(ANALYSE_plFilter,&reference_shifted[ws->limMin],&reference_shifted[ws->limMin],NULL,ws->limN,PRJCT_FILTER_OUTPUT_LOW))!=0))
      {
       rc=ERROR_SetLast("EndFunction",ERROR_TYPE_WARNING,ERROR_ID_ANALYSIS,analyseIndexRecord,"Filter");
       goto EndFunction;
@@ -3096,13 +3331,13 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
     // Reference correction with non linear parameters
     // ----------------------------------------------
 
-    if ((Feno->analysisMethod!=INTENSITY_FIT) &&
-        (Feno->indexSol!=ITEM_NONE) &&
-        ((TabCross[Feno->indexSol].FitParam!=ITEM_NONE) ||
-         ((TabCross[Feno->indexSol].InitParam!=(double)0.)&&(TabCross[Feno->indexSol].InitParam!=(double)1.))))
+    if ((pFeno->analysisMethod!=INTENSITY_FIT) &&
+        (pFeno->indexSol!=ITEM_NONE) &&
+        ((TabCross[pFeno->indexSol].FitParam!=ITEM_NONE) ||
+         ((TabCross[pFeno->indexSol].InitParam!=(double)0.)&&(TabCross[pFeno->indexSol].InitParam!=(double)1.))))
 
-     for (int i=LimMin;i<=LimMax;i++)
-      reference_shifted[i]=pow(reference_shifted[i],(TabCross[Feno->indexSol].FitParam!=ITEM_NONE)?(double)fitParamsF[TabCross[Feno->indexSol].FitParam]:(double)TabCross[Feno->indexSol].InitParam);
+     for (int i=ws->limMin;i<=ws->limMax;i++)
+      reference_shifted[i]=pow(reference_shifted[i],(TabCross[pFeno->indexSol].FitParam!=ITEM_NONE)?(double)fitParamsF[TabCross[pFeno->indexSol].FitParam]:(double)TabCross[pFeno->indexSol].InitParam);
 
     // --------------------------------
     // High pass filtering on reference
@@ -3110,11 +3345,11 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
 
     // logarithms are not calculated and filtered before entering this function
 
-    if ((Feno->analysisMethod==OPTICAL_DENSITY_FIT) && !hFilterRefLog &&  // logarithms are not calculated and filtered before entering this function
-        (((rc=VECTOR_Log(&reference_shifted[LimMin],&reference_shifted[LimMin],LimN,"ANALYSE_Function (Ref) "))!=0) ||
+    if ((pFeno->analysisMethod==OPTICAL_DENSITY_FIT) && !ws->hFilterRefLog &&  // logarithms are not calculated and filtered before entering this function
+        (((rc=VECTOR_Log(&reference_shifted[ws->limMin],&reference_shifted[ws->limMin],ws->limN,"ANALYSE_Function (Ref) "))!=0) ||
          ((ANALYSE_phFilter->filterFunction!=NULL) &&
-          ((!Feno->hidden && ANALYSE_phFilter->hpFilterAnalysis) || ((Feno->hidden==1) && ANALYSE_phFilter->hpFilterCalib)) &&
-          ((rc=FILTER_Vector(ANALYSE_phFilter,&reference_shifted[LimMin],&reference_shifted[LimMin],NULL,LimN,PRJCT_FILTER_OUTPUT_HIGH_SUB))!=0))))
+          ((!pFeno->hidden && ANALYSE_phFilter->hpFilterAnalysis) || ((pFeno->hidden==1) && ANALYSE_phFilter->hpFilterCalib)) &&
+          ((rc=FILTER_Vector(ANALYSE_phFilter,&reference_shifted[ws->limMin],&reference_shifted[ws->limMin],NULL,ws->limN,PRJCT_FILTER_OUTPUT_HIGH_SUB))!=0))))
     {
      rc=ERROR_SetLast("EndFunction",ERROR_TYPE_WARNING,ERROR_ID_ANALYSIS,analyseIndexRecord,"Error with the selected reference spectrum");
      goto EndFunction;
@@ -3124,14 +3359,14 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
     // Transfer to working variable
     // ----------------------------
 
-    for( int k=0,l=iterator_start(&my_iterator, global_doas_spectrum); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
+    for( int k=0,l=iterator_start(&my_iterator, ws->specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
      YTrav[k]=reference_shifted[l];
 
     //
     // OPTICAL THICKNESS FITTING (SVD)
     //
 
-    if (Feno->analysisMethod==OPTICAL_DENSITY_FIT) {
+    if (pFeno->analysisMethod==OPTICAL_DENSITY_FIT) {
       // ---------------------
       // SVD back substitution
       // ---------------------
@@ -3139,17 +3374,17 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
       // N.B. : YTrav -> reference spectrum, shifted and stretched
       //        XTrav -> raw spectrum, shifted and stretched
 
-      for(int k=1; k<=spectrum_length(global_doas_spectrum); k++) {
-        b[k]=YTrav[k-1]-XTrav[k-1];
+      for(int k=1; k<=spectrum_length(ws->specrange); k++) {
+        ws->b[k]=YTrav[k-1]-XTrav[k-1];
 
         for (int l=NewDimC+1;l<=fitprops->DimC;l++)
-          b[k]-=fitprops->A[l][k]*fitParamsC[l];
+          ws->b[k]-=fitprops->A[l][k]*fitParamsC[l];
 
         if (SigmaY!=NULL)
-          b[k]/=SigmaY[k-1];
+          ws->b[k]/=SigmaY[k-1];
       }
 
-      rc = LINEAR_solve(fitprops->linfit, b, fitParamsC);
+      rc = LINEAR_solve(fitprops->linfit, ws->b, fitParamsC);
       if (rc != ERROR_ID_NO)
         goto EndFunction;
 
@@ -3157,7 +3392,7 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
       // Yfit computation with the solution of the system
       // ------------------------------------------------
 
-      for (int l=0;l<Feno->NTabCross;l++) {
+      for (int l=0;l<pFeno->NTabCross;l++) {
         int svdIndex = TabCross[l].IndSvdA;
         double weight = (svdIndex <= NewDimC)
           ? fitParamsC[svdIndex]/TabCross[l].Fact
@@ -3171,15 +3406,15 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
         Yfit[k-1]=YTrav[k-1]-XTrav[k-1]; // NB : logarithm test on YTrav has been made in the previous loop
       }
 
-    } else if (Feno->analysisMethod==INTENSITY_FIT) {
+    } else if (pFeno->analysisMethod==INTENSITY_FIT) {
 
       // ------------------------------------------------------------
       // INTENSITY FITTING
       // ------------------------------------------------------------
 
-      for (int k=1,i=iterator_start(&my_iterator, global_doas_spectrum); i != ITERATOR_FINISHED; k++,i=iterator_next(&my_iterator)) {
+      for (int k=1,i=iterator_start(&my_iterator, ws->specrange); i != ITERATOR_FINISHED; k++,i=iterator_next(&my_iterator)) {
         double tau = 0.;
-        for (int l=0;l<Feno->NTabCross;l++) {
+        for (int l=0;l<pFeno->NTabCross;l++) {
           pTabCross=&TabCross[l];
 
           if (pTabCross->IndSvdA > 0 && WorkSpace[pTabCross->Comp].type==WRK_SYMBOL_CROSS) {
@@ -3198,19 +3433,19 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
           goto EndFunction;
         }
 
-        ANALYSE_t[i]=exp(-tau); // exp(-tau)
-        ANALYSE_tc[i]=XTrav[k-1]/YTrav[k-1];  // I/I0
-        b[k] = ANALYSE_tc[i];
+        ws->t[i]=exp(-tau); // exp(-tau)
+        ws->tc[i]=XTrav[k-1]/YTrav[k-1];  // I/I0
+        ws->b[k] = ws->tc[i];
       }
 
-      for (int l=0;l<Feno->NTabCross;l++) {
+      for (int l=0;l<pFeno->NTabCross;l++) {
         pTabCross=&TabCross[l];
 
         if (((indexSvdA=pTabCross->IndSvdA)>0) && ((indexSvdP=pTabCross->IndSvdP)>0)) {
-          for( int k=1,i=iterator_start(&my_iterator, global_doas_spectrum); i != ITERATOR_FINISHED; k++,i=iterator_next(&my_iterator)) {
+          for( int k=1,i=iterator_start(&my_iterator, ws->specrange); i != ITERATOR_FINISHED; k++,i=iterator_next(&my_iterator)) {
             if (WorkSpace[pTabCross->Comp].type==WRK_SYMBOL_CONTINUOUS && WorkSpace[pTabCross->Comp].symbolName[0]!='o') {
               // Polynomial
-              fitprops->P[indexSvdP][k]=ANALYSE_t[i]*fitprops->A[indexSvdA][k]; ///pTabCross->Fact;
+              fitprops->P[indexSvdP][k]=ws->t[i]*fitprops->A[indexSvdA][k]; ///pTabCross->Fact;
             } else {
               // Linear offset normalized w.r.t. the reference spectrum and other parameters (Ring ...)
               fitprops->P[indexSvdP][k]=fitprops->A[indexSvdA][k]; ///pTabCross->Fact;
@@ -3218,19 +3453,23 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
           }
         }
       }
-      LINEAR_free(fitprops->linfit);
-      fitprops->linfit = LINEAR_from_matrix((const double **)fitprops->P, Npts,fitprops->DimP,DECOMP_EIGEN_QR);
+      if (fitprops->linfit==NULL)
+        fitprops->linfit = LINEAR_alloc(Npts,fitprops->DimP,DECOMP_EIGEN_QR);
+      else
+        LINEAR_reset(fitprops->linfit,Npts,fitprops->DimP);
+
+      LINEAR_wrap_matrix(fitprops->linfit,(const double *const *)fitprops->P,fitprops->ldP);
       if (SigmaY != NULL) {
         LINEAR_set_weight(fitprops->linfit, SigmaY);
         for (int i=0; i<fitprops->DimP; ++i) {
-          b[1+i] /= SigmaY[i];
+          ws->b[1+i] /= SigmaY[i];
         }
       }
 
       rc = LINEAR_decompose(fitprops->linfit, fitprops->SigmaSqr, fitprops->covar);
       double *xP = malloc(fitprops->DimP * sizeof(*xP));
       double *fitParamsP=xP-1; // linear fitting functions assume index starts at 1.
-      if (rc == ERROR_ID_NO) rc = LINEAR_solve(fitprops->linfit, b, fitParamsP);
+      if (rc == ERROR_ID_NO) rc = LINEAR_solve(fitprops->linfit, ws->b, fitParamsP);
       if (rc != ERROR_ID_NO)
         goto EndFunction;
 
@@ -3238,14 +3477,14 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
       // Yfit computation with the solution of the system
       // ------------------------------------------------
 
-      for (int i=0;i<Feno->NTabCross;i++)
+      for (int i=0;i<pFeno->NTabCross;i++)
        if (((indexSvdA=TabCross[i].IndSvdA)>0) && ((indexSvdP=TabCross[i].IndSvdP)>0))
         fitParamsC[indexSvdA]=fitParamsP[indexSvdP];
 
-      for (int k=1,i=iterator_start(&my_iterator, global_doas_spectrum); i != ITERATOR_FINISHED; k++,i=iterator_next(&my_iterator)) {
+      for (int k=1,i=iterator_start(&my_iterator, ws->specrange); i != ITERATOR_FINISHED; k++,i=iterator_next(&my_iterator)) {
         double tau = 0.;
         double offset = 0.;
-        for (int l=0;l<Feno->NTabCross;l++)
+        for (int l=0;l<pFeno->NTabCross;l++)
          if (((indexSvdA=TabCross[l].IndSvdA)>0) && ((indexSvdP=TabCross[l].IndSvdP)>0))
           {
            if ((WorkSpace[TabCross[l].Comp].type==WRK_SYMBOL_CONTINUOUS) && (WorkSpace[TabCross[l].Comp].symbolName[0]!='o'))      // Polynomial
@@ -3254,10 +3493,10 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
             offset+=fitParamsP[indexSvdP]*fitprops->A[indexSvdA][k];
           }
 
-        ANALYSE_tc[i]-=offset;            // I/I0 - offset/I0
-        ANALYSE_t[i]*=tau;                // tau*exp(-optical depth)
+        ws->tc[i]-=offset;            // I/I0 - offset/I0
+        ws->t[i]*=tau;                // tau*exp(-optical depth)
 
-        Yfit[k-1]=ANALYSE_t[i]-ANALYSE_tc[i];
+        Yfit[k-1]=ws->t[i]-ws->tc[i];
       }
       free(xP);
     }
@@ -3267,18 +3506,394 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
 
  EndFunction :
 
-  if (XTrav!=NULL)
-   MEMORY_ReleaseDVector(__func__,"XTrav",XTrav,0);
-  if (YTrav!=NULL)
-   MEMORY_ReleaseDVector(__func__,"YTrav",YTrav,0);
-  if (newXsTrav!=NULL)
-   MEMORY_ReleaseDVector(__func__,"newXsTrav",newXsTrav,0);
-  if (spectrum_interpolated!= NULL)
-   MEMORY_ReleaseDVector(__func__,"spectrum_interpolated",spectrum_interpolated,0);
-  if (reference_shifted != NULL)
-   MEMORY_ReleaseDVector(__func__,"reference_shifted",reference_shifted,0);
-  if (spec_nolog != NULL)
-   MEMORY_ReleaseDVector(__func__,"spec_nolog",spec_nolog,0);
+  MEMORY_ReleaseScratchDVector(__func__,"XTrav",XTrav,0);
+  MEMORY_ReleaseScratchDVector(__func__,"YTrav",YTrav,0);
+  MEMORY_ReleaseScratchDVector(__func__,"newXsTrav",newXsTrav,0);
+  MEMORY_ReleaseScratchDVector(__func__,"spectrum_interpolated",spectrum_interpolated,0);
+  MEMORY_ReleaseScratchDVector(__func__,"reference_shifted",reference_shifted,0);
+  MEMORY_ReleaseScratchDVector(__func__,"spec_nolog",spec_nolog,0);
+
+  MEMORY_SelectArena(pArena);
+
+  // Return
+
+#if defined(__DEBUG_) && __DEBUG_
+  DEBUG_FunctionStop(__func__,rc);
+#endif
+
+  return rc;
+}
+
+// -------------------------------------------------------------------------------------
+// AnalyseParamIsUnique : check that a non linear parameter is used by one item only
+// -------------------------------------------------------------------------------------
+
+// Parameters linked between several items (same symbol in different lists) affect
+// more than one term of the fitting function
+
+static int AnalyseParamIsUnique(const FENO *pFeno,INDEX indexParam)
+{
+  int n=0;
+
+  for (int i=0;i<pFeno->NTabCross;i++) {
+    const CROSS_REFERENCE *pTabCross=&pFeno->TabCross[i];
+
+    n+=(pTabCross->FitConc==indexParam)+(pTabCross->FitParam==indexParam)+
+       (pTabCross->FitShift==indexParam)+(pTabCross->FitStretch==indexParam)+(pTabCross->FitStretch2==indexParam);
+  }
+
+  return (n==1)?1:0;
+}
+
+// ---------------------------------------------------------------------------------------------
+// AnalyseAlignDeriv : shifted vector and its derivative in wavelength on the shifted grid
+// ---------------------------------------------------------------------------------------------
+
+// Same grid as ShiftVector without second shift and stretch; ws->shift is left untouched
+
+static RC AnalyseAlignDeriv(const struct analysis_workspace *ws,const double *lambda,const double *source,const double *deriv2,int n_wavel,
+                            double DSH,double DST,double DST2,double lambda0,double *grid,double *target,double *slope)
+{
+  RC rc;
+
+  for (int j=ws->limMin;j<=ws->limMax;j++) {
+    const double x0=ws->splineX[j]-lambda0;
+    grid[j]=ws->splineX[j]-(DSH+DST*x0*ws->stretchFact1+DST2*x0*x0*ws->stretchFact2);
+  }
+
+  if (!(rc=SPLINE_Vector(lambda,source,deriv2,n_wavel,&grid[ws->limMin],&target[ws->limMin],ws->limN,pAnalysisOptions->interpol)))
+    rc=SPLINE_Deriv1Vector(lambda,source,deriv2,n_wavel,&grid[ws->limMin],&slope[ws->limMin],ws->limN,pAnalysisOptions->interpol);
+
+  return rc;
+}
+
+// --------------------------------------------------------------------------------------------
+// AnalyseShiftDeriv : derivative of a shifted vector in its shift (order 0) or stretch (order 1 or 2)
+// --------------------------------------------------------------------------------------------
+
+static void AnalyseShiftDeriv(const struct analysis_workspace *ws,const double *slope,int order,double lambda0,double *dTarget)
+{
+  for (int j=ws->limMin;j<=ws->limMax;j++) {
+    const double x0=ws->splineX[j]-lambda0;
+    dTarget[j]=-slope[j]*((order==0)?(double)1.:(order==1)?x0*ws->stretchFact1:x0*x0*ws->stretchFact2);
+  }
+}
+
+// -------------------------------------------------------------------------------------------
+// AnalyseLogDeriv : derivative of the logarithm of a vector followed by the high-pass filtering
+// -------------------------------------------------------------------------------------------
+
+// Nothing to do when the logarithm has been calculated and filtered before the fit (ANALYSE_CurFitMethod)
+
+static RC AnalyseLogDeriv(const struct analysis_workspace *ws,int logFiltered,const double *value,double *dValue)
+{
+  FENO *pFeno=ws->feno;
+  RC rc=ERROR_ID_NO;
+
+  if (!logFiltered) {
+    for (int j=ws->limMin;j<=ws->limMax;j++)
+     if (value[j]<=(double)0.)
+      return ERROR_ID_LOG;                                                      // already reported by ANALYSE_Function
+     else
+      dValue[j]/=value[j];
+
+    if ((ANALYSE_phFilter->filterFunction!=NULL) &&
+        ((!pFeno->hidden && ANALYSE_phFilter->hpFilterAnalysis) || ((pFeno->hidden==1) && ANALYSE_phFilter->hpFilterCalib)))
+     rc=FILTER_Vector(ANALYSE_phFilter,&dValue[ws->limMin],&dValue[ws->limMin],NULL,ws->limN,PRJCT_FILTER_OUTPUT_HIGH_SUB);
+  }
+
+  return rc;
+}
+
+// -----------------------------------------------------------------------------------------------
+// AnalyseDerivColumn : derivative of Yfit from the derivative of the optical depth (YTrav-XTrav)
+// -----------------------------------------------------------------------------------------------
+
+// The concentrations fitted linearly are the solution of the same linear system with
+// a different right-hand side, so that their derivative is obtained with the
+// decomposition of the last call to ANALYSE_Function
+
+static RC AnalyseDerivColumn(const FENO *pFeno,const double *dTau,const double *SigmaY,int Npts,int NewDimC,
+                             const struct fit_properties *fitprops,double *b,double *dx,double *deriv)
+{
+  const CROSS_REFERENCE *TabCross=pFeno->TabCross;
+  RC rc;
+
+  for (int k=1;k<=Npts;k++)
+   b[k]=(SigmaY!=NULL)?dTau[k-1]/SigmaY[k-1]:dTau[k-1];
+
+  if ((rc=LINEAR_solve(fitprops->linfit,b,dx))==ERROR_ID_NO) {
+    memcpy(deriv,dTau,sizeof(double)*Npts);
+
+    for (int l=0;l<pFeno->NTabCross;l++) {
+      const int svdIndex=TabCross[l].IndSvdA;
+
+      if ((svdIndex>0) && (svdIndex<=NewDimC))
+       for (int k=1;k<=Npts;k++)
+        deriv[k-1]-=fitprops->A[svdIndex][k]*dx[svdIndex]/TabCross[l].Fact;
+    }
+  }
+
+  return rc;
+}
+
+// -------------------------------------------------------------------------------------------------------
+// ANALYSE_FunctionDeriv : Analytic derivatives of Yfit in the shift, stretch and offset of spectrum and reference
+// -------------------------------------------------------------------------------------------------------
+
+// Evaluated at the point of the last call to ANALYSE_Function (fitParamsF and the
+// decomposition of the SVD matrix in fitprops->linfit).  Only parameters that change
+// the spectrum or the reference are concerned : the SVD matrix doesn't depend on them,
+// so the derivative only needs one back substitution instead of a new evaluation of the
+// fitting function.  Parameters of cross sections, the resolution and other predefined
+// parameters keep numeric derivatives (see CurfitDerivFunc).
+//
+// analytic[i] is set to 1 for each non linear parameter i whose derivative has been
+// calculated in deriv[i].  In case of error, no derivative is calculated analytically.
+
+RC ANALYSE_FunctionDeriv(struct analysis_workspace *ws,const double *spectrum_orig,const double *reference,const double *SigmaY,int Npts,
+                         const double *fitParamsF,INDEX indexFenoColumn,const struct fit_properties *fitprops,double **deriv,int *analytic)
+{
+  // Declarations
+
+  FENO *pFeno=ws->feno;
+  CROSS_REFERENCE *TabCross=pFeno->TabCross;
+  INDEX specParam[3],refParam[3],offsetParam[3],indexOffset[3];
+  double *grid,*value,*slope,*offset,*dValue,*dTau,*b,*dx;
+  double param[3],lambda0,xmean,dxmean;
+  MEMORY_ARENA *pArena;
+  doas_iterator my_iterator;
+  int NewDimC,nSpec,nRef,offsetOrder;
+  RC rc;
+
+  // Initializations
+
+  const int n_wavel=NDET[indexFenoColumn];
+  grid=value=slope=offset=dValue=dTau=b=dx=NULL;
+  nSpec=nRef=0;
+  rc=ERROR_ID_NO;
+
+  memset(analytic,0,sizeof(int)*fitprops->NF);
+
+  // The SVD matrix must not depend on the spectrum (linear offset normalized w.r.t. the spectrum)
+  // and the spectrum and the reference must be interpolated by ShiftVector without convolution
+
+  if ((pFeno->analysisMethod!=OPTICAL_DENSITY_FIT) || (fitprops->linfit==NULL) ||
+      ((pFeno->analysisType!=ANALYSIS_TYPE_FWHM_NONE) && (pFeno->analysisType!=ANALYSIS_TYPE_FWHM_CORRECTION)) ||
+      (pFeno->useUsamp && (pUsamp->method==PRJCT_USAMP_AUTOMATIC)))
+
+   return ERROR_ID_NO;
+
+  for (int i=0;i<pFeno->NTabCross;i++)
+   if ((TabCross[i].IndSvdA>0) && (pFeno->linear_offset_mode==LINEAR_OFFSET_RAD) &&
+       (WorkSpace[TabCross[i].Comp].type==WRK_SYMBOL_CONTINUOUS) &&
+       (strlen(WorkSpace[TabCross[i].Comp].symbolName)==5) && !strncmp(WorkSpace[TabCross[i].Comp].symbolName,"offl",4))
+
+    return ERROR_ID_NO;
+
+  // Select the non linear parameters
+
+  indexOffset[0]=pFeno->indexOffsetConst;
+  indexOffset[1]=pFeno->indexOffsetOrder1;
+  indexOffset[2]=pFeno->indexOffsetOrder2;
+
+  for (int i=0;i<3;i++) {
+    specParam[i]=refParam[i]=ITEM_NONE;
+    offsetParam[i]=(indexOffset[i]!=ITEM_NONE)?TabCross[indexOffset[i]].FitParam:ITEM_NONE;
+  }
+
+  if (pFeno->indexSpectrum!=ITEM_NONE) {
+    specParam[0]=TabCross[pFeno->indexSpectrum].FitShift;
+    specParam[1]=TabCross[pFeno->indexSpectrum].FitStretch;
+    specParam[2]=TabCross[pFeno->indexSpectrum].FitStretch2;
+  }
+
+  // The reference must not be scaled (Sol parameter)
+
+  if ((pFeno->indexReference!=ITEM_NONE) &&
+      ((pFeno->indexSol==ITEM_NONE) ||
+       ((TabCross[pFeno->indexSol].FitParam==ITEM_NONE) &&
+        ((TabCross[pFeno->indexSol].InitParam==(double)0.) || (TabCross[pFeno->indexSol].InitParam==(double)1.))))) {
+
+    refParam[0]=TabCross[pFeno->indexReference].FitShift;
+    refParam[1]=TabCross[pFeno->indexReference].FitStretch;
+    refParam[2]=TabCross[pFeno->indexReference].FitStretch2;
+  }
+
+  for (int i=0;i<3;i++) {
+    if ((specParam[i]!=ITEM_NONE) && !AnalyseParamIsUnique(pFeno,specParam[i]))
+     specParam[i]=ITEM_NONE;
+    if ((offsetParam[i]!=ITEM_NONE) && !AnalyseParamIsUnique(pFeno,offsetParam[i]))
+     offsetParam[i]=ITEM_NONE;
+    if ((refParam[i]!=ITEM_NONE) && !AnalyseParamIsUnique(pFeno,refParam[i]))
+     refParam[i]=ITEM_NONE;
+
+    nSpec+=(specParam[i]!=ITEM_NONE)+(offsetParam[i]!=ITEM_NONE);
+    nRef+=(refParam[i]!=ITEM_NONE);
+  }
+
+  if (!nSpec && !nRef)
+   return ERROR_ID_NO;
+
+#if defined(__DEBUG_) && __DEBUG_
+  DEBUG_FunctionBegin(__func__,DEBUG_FCTTYPE_APPL|DEBUG_FCTTYPE_MEM);
+#endif
+
+  NewDimC=AnalyseFreeColumns(pFeno,fitprops);
+  pArena=MEMORY_SelectArena(&ws->scratch);
+  lambda0=(!pFeno->hidden)?pFeno->lambda0:center_pixel_wavelength(ws->splineX,ws->svdPDeb,ws->svdPFin);
+
+  // Buffers allocation
+
+  if (((grid=MEMORY_AllocScratchDVector(__func__,"grid",0,n_wavel-1))==NULL) ||
+      ((value=MEMORY_AllocScratchDVector(__func__,"value",0,n_wavel-1))==NULL) ||
+      ((slope=MEMORY_AllocScratchDVector(__func__,"slope",0,n_wavel-1))==NULL) ||
+      ((offset=MEMORY_AllocScratchDVector(__func__,"offset",0,n_wavel-1))==NULL) ||
+      ((dValue=MEMORY_AllocScratchDVector(__func__,"dValue",0,n_wavel-1))==NULL) ||
+      ((dTau=MEMORY_AllocScratchDVector(__func__,"dTau",0,Npts-1))==NULL) ||
+      ((b=MEMORY_AllocScratchDVector(__func__,"b",1,Npts))==NULL) ||
+      ((dx=MEMORY_AllocScratchDVector(__func__,"dx",1,max(NewDimC,1)))==NULL))
+
+   rc=ERROR_ID_ALLOC;
+
+  // ========
+  // SPECTRUM
+  // ========
+
+  if (!rc && nSpec) {
+    for (int i=0;i<3;i++)
+     param[i]=(double)0.;
+
+    if (pFeno->indexSpectrum!=ITEM_NONE) {
+      param[0]=(TabCross[pFeno->indexSpectrum].FitShift!=ITEM_NONE)?fitParamsF[TabCross[pFeno->indexSpectrum].FitShift]:TabCross[pFeno->indexSpectrum].InitShift;
+      param[1]=(TabCross[pFeno->indexSpectrum].FitStretch!=ITEM_NONE)?fitParamsF[TabCross[pFeno->indexSpectrum].FitStretch]:TabCross[pFeno->indexSpectrum].InitStretch;
+      param[2]=(TabCross[pFeno->indexSpectrum].FitStretch2!=ITEM_NONE)?fitParamsF[TabCross[pFeno->indexSpectrum].FitStretch2]:TabCross[pFeno->indexSpectrum].InitStretch2;
+    }
+
+    if ((rc=AnalyseAlignDeriv(ws,ws->lambdaSpec,spectrum_orig,ws->splineSpec,n_wavel,param[0],param[1],param[2],lambda0,grid,value,slope))!=ERROR_ID_NO)
+     goto EndFunctionDeriv;
+
+    xmean=(double)0.;
+    for (int i=iterator_start(&my_iterator,ws->specrange);i!=ITERATOR_FINISHED;i=iterator_next(&my_iterator))
+     xmean+=value[i];
+    xmean/=Npts;
+
+    // Offset as applied in ANALYSE_Function
+
+    offsetOrder=-1;
+
+    for (int i=0;i<3;i++)
+     if ((indexOffset[i]!=ITEM_NONE) && ((TabCross[indexOffset[i]].FitParam!=ITEM_NONE) || (TabCross[indexOffset[i]].InitParam!=(double)0.)))
+      offsetOrder=i;
+
+    for (int j=ws->limMin;j<=ws->limMax;j++) {
+      const double deltaX=ws->splineX[j]-lambda0;
+      offset[j]=(double)0.;
+
+      if (offsetOrder>=0)
+       offset[j]=(TabCross[indexOffset[0]].FitParam!=ITEM_NONE)?fitParamsF[TabCross[indexOffset[0]].FitParam]:TabCross[indexOffset[0]].InitParam;
+      if (offsetOrder>=1)
+       offset[j]+=((TabCross[indexOffset[1]].FitParam!=ITEM_NONE)?fitParamsF[TabCross[indexOffset[1]].FitParam]/TabCross[indexOffset[1]].Fact:TabCross[indexOffset[1]].InitParam)*deltaX;
+      if (offsetOrder>=2)
+       offset[j]+=((TabCross[indexOffset[2]].FitParam!=ITEM_NONE)?fitParamsF[TabCross[indexOffset[2]].FitParam]/TabCross[indexOffset[2]].Fact:TabCross[indexOffset[2]].InitParam)*deltaX*deltaX;
+
+      value[j]-=offset[j]*xmean;
+    }
+
+    // Shift and stretch of the spectrum : the mean of the spectrum used for the offset also moves
+
+    for (int order=0;order<3;order++)
+     if (specParam[order]!=ITEM_NONE) {
+       AnalyseShiftDeriv(ws,slope,order,lambda0,dValue);
+
+       dxmean=(double)0.;
+       for (int i=iterator_start(&my_iterator,ws->specrange);i!=ITERATOR_FINISHED;i=iterator_next(&my_iterator))
+        dxmean+=dValue[i];
+       dxmean/=Npts;
+
+       for (int j=ws->limMin;j<=ws->limMax;j++)
+        dValue[j]-=offset[j]*dxmean;
+
+       if ((rc=AnalyseLogDeriv(ws,ws->hFilterSpecLog,value,dValue))!=ERROR_ID_NO)
+        goto EndFunctionDeriv;
+
+       for (int k=0,l=iterator_start(&my_iterator,ws->specrange);l!=ITERATOR_FINISHED;k++,l=iterator_next(&my_iterator))
+        dTau[k]=-dValue[l];
+
+       if ((rc=AnalyseDerivColumn(pFeno,dTau,SigmaY,Npts,NewDimC,fitprops,b,dx,deriv[specParam[order]]))!=ERROR_ID_NO)
+        goto EndFunctionDeriv;
+
+       analytic[specParam[order]]=1;
+     }
+
+    // Offset (constant, order 1 and order 2)
+
+    for (int order=0;order<3;order++)
+     if (offsetParam[order]!=ITEM_NONE) {
+       for (int j=ws->limMin;j<=ws->limMax;j++) {
+         const double deltaX=ws->splineX[j]-lambda0;
+         dValue[j]=-xmean*((order==0)?(double)1.:((order==1)?deltaX:deltaX*deltaX)/TabCross[indexOffset[order]].Fact);
+       }
+
+       if ((rc=AnalyseLogDeriv(ws,ws->hFilterSpecLog,value,dValue))!=ERROR_ID_NO)
+        goto EndFunctionDeriv;
+
+       for (int k=0,l=iterator_start(&my_iterator,ws->specrange);l!=ITERATOR_FINISHED;k++,l=iterator_next(&my_iterator))
+        dTau[k]=-dValue[l];
+
+       if ((rc=AnalyseDerivColumn(pFeno,dTau,SigmaY,Npts,NewDimC,fitprops,b,dx,deriv[offsetParam[order]]))!=ERROR_ID_NO)
+        goto EndFunctionDeriv;
+
+       analytic[offsetParam[order]]=1;
+     }
+  }
+
+  // =========
+  // REFERENCE
+  // =========
+
+  if (!rc && nRef) {
+    param[0]=(TabCross[pFeno->indexReference].FitShift!=ITEM_NONE)?fitParamsF[TabCross[pFeno->indexReference].FitShift]:TabCross[pFeno->indexReference].InitShift;
+    param[1]=(TabCross[pFeno->indexReference].FitStretch!=ITEM_NONE)?fitParamsF[TabCross[pFeno->indexReference].FitStretch]:TabCross[pFeno->indexReference].InitStretch;
+    param[2]=(TabCross[pFeno->indexReference].FitStretch2!=ITEM_NONE)?fitParamsF[TabCross[pFeno->indexReference].FitStretch2]:TabCross[pFeno->indexReference].InitStretch2;
+
+    if ((rc=AnalyseAlignDeriv(ws,ws->splineX,reference,ws->splineRef,n_wavel,param[0],param[1],param[2],lambda0,grid,value,slope))!=ERROR_ID_NO)
+     goto EndFunctionDeriv;
+
+    for (int order=0;order<3;order++)
+     if (refParam[order]!=ITEM_NONE) {
+       AnalyseShiftDeriv(ws,slope,order,lambda0,dValue);
+
+       if ((rc=AnalyseLogDeriv(ws,ws->hFilterRefLog,value,dValue))!=ERROR_ID_NO)
+        goto EndFunctionDeriv;
+
+       for (int k=0,l=iterator_start(&my_iterator,ws->specrange);l!=ITERATOR_FINISHED;k++,l=iterator_next(&my_iterator))
+        dTau[k]=dValue[l];
+
+       if ((rc=AnalyseDerivColumn(pFeno,dTau,SigmaY,Npts,NewDimC,fitprops,b,dx,deriv[refParam[order]]))!=ERROR_ID_NO)
+        goto EndFunctionDeriv;
+
+       analytic[refParam[order]]=1;
+     }
+  }
+
+  // Release allocated buffers
+
+ EndFunctionDeriv :
+
+  if (rc!=ERROR_ID_NO)
+   memset(analytic,0,sizeof(int)*fitprops->NF);
+
+  MEMORY_ReleaseScratchDVector(__func__,"grid",grid,0);
+  MEMORY_ReleaseScratchDVector(__func__,"value",value,0);
+  MEMORY_ReleaseScratchDVector(__func__,"slope",slope,0);
+  MEMORY_ReleaseScratchDVector(__func__,"offset",offset,0);
+  MEMORY_ReleaseScratchDVector(__func__,"dValue",dValue,0);
+  MEMORY_ReleaseScratchDVector(__func__,"dTau",dTau,0);
+  MEMORY_ReleaseScratchDVector(__func__,"b",b,1);
+  MEMORY_ReleaseScratchDVector(__func__,"dx",dx,1);
+
+  MEMORY_SelectArena(pArena);
 
   // Return
 
@@ -3289,6 +3904,96 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
   return rc;
 }
 
+// -----------------------------------------------------------------------------------------------
+// ANALYSE_SetWarmStart : start the fits from the last converged fit of the same window and row
+// -----------------------------------------------------------------------------------------------
+
+// When enabled, ANALYSE_CurFitMethod initializes the non linear parameters
+// (shifts, stretches, offsets, Ring...) of an analysis window with the values
+// of the last converged fit of the same window for the same row instead of the
+// initial values of the project.  These parameters change slowly from one
+// scanline to the next one for imagers and within a scan for MAX-DOAS, so
+// that the Marquardt-Levenberg iterations converge faster.
+//
+// The initial values are used again after a fit that failed or didn't converge,
+// when the chi square of a warm started fit is more than
+// ANALYSE_WARM_START_CHISQR_JUMP times the one of the fit it started from,
+// and when the reference spectrum changes (ANALYSE_AlignReference, new
+// reference of a MAX-DOAS scan).
+
+void ANALYSE_SetWarmStart(int enable)
+{
+  analyseWarmStart=enable;
+}
+
+// -----------------------------------------------------------------------------
+// AnalyseWarmStartGet : initialize the non linear parameters from the last converged fit
+// -----------------------------------------------------------------------------
+
+// fitParamsF is left unchanged if there is no fit to start from; returns 1 if
+// the parameters have been initialized from the previous fit.
+
+static int AnalyseWarmStartGet(const struct analysis_workspace *ws,double *fitParamsF,int NF)
+{
+  const FENO *pFeno=ws->feno;
+
+  if ((pFeno->warmStartParams==NULL) || (pFeno->warmStartN!=NF))
+    return 0;
+
+  memcpy(fitParamsF,pFeno->warmStartParams,sizeof(double)*NF);
+
+  // stretches are saved unnormalized because the normalization factors depend on the wavelength calibration
+
+  for (int i=0;i<pFeno->NTabCross;i++) {
+    const CROSS_REFERENCE *pTabCross=&pFeno->TabCross[i];
+
+    if (pTabCross->FitStretch!=ITEM_NONE)
+      fitParamsF[pTabCross->FitStretch]/=ws->stretchFact1;
+    if (pTabCross->FitStretch2!=ITEM_NONE)
+      fitParamsF[pTabCross->FitStretch2]/=ws->stretchFact2;
+  }
+
+  return 1;
+}
+
+// -----------------------------------------------------------------------------
+// AnalyseWarmStartSet : keep the non linear parameters of a converged fit
+// -----------------------------------------------------------------------------
+
+// The next fit of the same window and row starts from the initial values if
+// this fit didn't converge or if its chi square jumped (see ANALYSE_SetWarmStart).
+
+static void AnalyseWarmStartSet(const struct analysis_workspace *ws,const double *fitParamsF,int NF,double chisqr,int warmStarted,int converged)
+{
+  FENO *pFeno=ws->feno;
+
+  if (!converged || !isfinite(chisqr) ||
+      (warmStarted && (chisqr>ANALYSE_WARM_START_CHISQR_JUMP*pFeno->warmStartChisqr))) {
+    pFeno->warmStartN=0;
+    return;
+  }
+
+  if ((pFeno->warmStartParams==NULL) &&
+      ((pFeno->warmStartParams=(double *)MEMORY_AllocDVector(__func__,"warmStartParams",0,MAX_FIT*4))==NULL)) {
+    pFeno->warmStartN=0;
+    return;
+  }
+
+  memcpy(pFeno->warmStartParams,fitParamsF,sizeof(double)*NF);
+
+  for (int i=0;i<pFeno->NTabCross;i++) {
+    const CROSS_REFERENCE *pTabCross=&pFeno->TabCross[i];
+
+    if (pTabCross->FitStretch!=ITEM_NONE)
+      pFeno->warmStartParams[pTabCross->FitStretch]*=ws->stretchFact1;
+    if (pTabCross->FitStretch2!=ITEM_NONE)
+      pFeno->warmStartParams[pTabCross->FitStretch2]*=ws->stretchFact2;
+  }
+
+  pFeno->warmStartChisqr=chisqr;
+  pFeno->warmStartN=NF;
+}
+
 /*                                                                           */
 /*  ANALYSE_CurFitMethod ( Spectre, Spreflog, Absolu, Square ) :             */
 /*  ==========================================================               */
@@ -3299,7 +4004,8 @@ RC ANALYSE_Function(double *spectrum_orig, double *reference, const double *Sigm
 /*         and are computed by singular value decomposition of cross         */
 /*         sections matrix.                                                  */
 /*                                                                           */
-RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, TROPOMI, GEMS
+RC ANALYSE_CurFitMethod(struct analysis_workspace *ws,   // workspace of the current fit (see ANALYSE_SvdInit)
+                        INDEX indexFenoColumn,          // for imagers as OMI, TROPOMI, GEMS
                         const double *Spectre,          // raw spectrum
                         const double *SigmaSpec,        // error on raw spectrum
                         const double *Sref,             // reference spectrum
@@ -3313,6 +4019,7 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
 {
   // Declarations
 
+  FENO *pFeno=ws->feno;
   CROSS_REFERENCE *TabCross,*pTabCross;
   CROSS_RESULTS *pResults;
   double OldChisqr,                                      // chi square a step before
@@ -3330,6 +4037,7 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
   //  int i,j,k,l;                                             // indexes for loops and arrays
   int useErrors;
   int niter;
+  int warmStart,warmStarted;                             // warm start from the last converged fit (see ANALYSE_SetWarmStart)
   RC rc;                                                 // return code
 
 #if defined(__DEBUG_) && __DEBUG_
@@ -3338,12 +4046,12 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
 
   // Initializations
 
-  TabCross=Feno->TabCross;                               // symbol cross reference
-  useErrors=((Feno->analysisMethod==OPTICAL_DENSITY_FIT) && (pAnalysisOptions->fitWeighting!=PRJCT_ANLYS_FIT_WEIGHTING_NONE) && (SigmaSpec!=NULL) && (Feno->SrefSigma!=NULL))?1:0;
+  TabCross=pFeno->TabCross;                               // symbol cross reference
+  useErrors=((pFeno->analysisMethod==OPTICAL_DENSITY_FIT) && (pAnalysisOptions->fitWeighting!=PRJCT_ANLYS_FIT_WEIGHTING_NONE) && (SigmaSpec!=NULL) && (pFeno->SrefSigma!=NULL))?1:0;
   
   fitParamsC=fitParamsF=Deltap=Sigmaa=Y0=SpecTrav=RefTrav=SigmaY=NULL;          // pointers
-  hFilterSpecLog=0;
-  hFilterRefLog=0;
+  ws->hFilterSpecLog=0;
+  ws->hFilterRefLog=0;
   rc=ERROR_ID_NO;                                      // return code
 
   /*  ==================  */
@@ -3382,11 +4090,11 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
     // Fwhm adjustment between spectrum and reference
     // ----------------------------------------------
 
-    if (!Feno->hidden && (Feno->useKurucz!=ANLYS_KURUCZ_SPEC)) {
+    if (!pFeno->hidden && (pFeno->useKurucz!=ANLYS_KURUCZ_SPEC)) {
       // Resolution adjustment using fwhm(lambda) found by Kurucz procedure for spectrum and reference
 
-      if (pKuruczOptions->fwhmFit && (Feno->useKurucz==ANLYS_KURUCZ_REF_AND_SPEC))
-        rc=AnalyseFwhmCorrectionK(Spectre,Sref,SpecTrav,RefTrav,n_wavel,indexFenoColumn);
+      if (pKuruczOptions->fwhmFit && (pFeno->useKurucz==ANLYS_KURUCZ_REF_AND_SPEC))
+        rc=AnalyseFwhmCorrectionK(ws,Spectre,Sref,SpecTrav,RefTrav,n_wavel,indexFenoColumn);
 
       if (rc)
         goto EndCurFitMethod;
@@ -3399,11 +4107,11 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
     // Low pass filtering
 
     if ((ANALYSE_plFilter->filterFunction!=NULL) &&                   // low pass filtering is requested
-        (Feno->analysisType!=ANALYSIS_TYPE_FWHM_NLFIT) &&     // doesn't fit the resolution (FWHM) between the reference and the spectrum as a non linear parameter
-        !Feno->hidden &&                                      // low pass filtering is disabled for calibration in order not to degrade the spectrum to calibrate
+        (pFeno->analysisType!=ANALYSIS_TYPE_FWHM_NLFIT) &&     // doesn't fit the resolution (FWHM) between the reference and the spectrum as a non linear parameter
+        !pFeno->hidden &&                                      // low pass filtering is disabled for calibration in order not to degrade the spectrum to calibrate
 
-        (((rc=FILTER_Vector(ANALYSE_plFilter,&SpecTrav[LimMin],&SpecTrav[LimMin],NULL,LimN,PRJCT_FILTER_OUTPUT_LOW))!=0) ||
-         ((rc=FILTER_Vector(ANALYSE_plFilter,&RefTrav[LimMin],&RefTrav[LimMin],NULL,LimN,PRJCT_FILTER_OUTPUT_LOW))!=0)))
+        (((rc=FILTER_Vector(ANALYSE_plFilter,&SpecTrav[ws->limMin],&SpecTrav[ws->limMin],NULL,ws->limN,PRJCT_FILTER_OUTPUT_LOW))!=0) ||
+         ((rc=FILTER_Vector(ANALYSE_plFilter,&RefTrav[ws->limMin],&RefTrav[ws->limMin],NULL,ws->limN,PRJCT_FILTER_OUTPUT_LOW))!=0)))
      {
       rc=ERROR_SetLast(__func__,ERROR_TYPE_WARNING,ERROR_ID_ANALYSIS,analyseIndexRecord,"Filter");
       goto EndCurFitMethod;
@@ -3412,21 +4120,21 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
     // High pass filtering (spectrum)
 
     if ((ANALYSE_phFilter->filterFunction!=NULL) &&           // high pass filtering is requested
-        ((!Feno->hidden && ANALYSE_phFilter->hpFilterAnalysis) || ((Feno->hidden==1) && ANALYSE_phFilter->hpFilterCalib)) &&
-        (Feno->analysisType!=ANALYSIS_TYPE_FWHM_NLFIT) &&     // doesn't fit the resolution (FWHM) between the reference and the spectrum as a non linear parameter
-        (Feno->analysisMethod==OPTICAL_DENSITY_FIT) &&     // only implemented in optical density fitting
+        ((!pFeno->hidden && ANALYSE_phFilter->hpFilterAnalysis) || ((pFeno->hidden==1) && ANALYSE_phFilter->hpFilterCalib)) &&
+        (pFeno->analysisType!=ANALYSIS_TYPE_FWHM_NLFIT) &&     // doesn't fit the resolution (FWHM) between the reference and the spectrum as a non linear parameter
+        (pFeno->analysisMethod==OPTICAL_DENSITY_FIT) &&     // only implemented in optical density fitting
 
                                                               // if offset is applied on spectrum, filter spectrum and reference at each iteration in Function
                                                               // otherwise, filter logarithms
 
-        ((Feno->indexOffsetConst==ITEM_NONE) || (TabCross[Feno->indexOffsetConst].FitParam==ITEM_NONE)) &&
-        ((Feno->indexOffsetOrder1==ITEM_NONE) || (TabCross[Feno->indexOffsetOrder1].FitParam==ITEM_NONE)) &&
-        ((Feno->indexOffsetOrder2==ITEM_NONE) || (TabCross[Feno->indexOffsetOrder2].FitParam==ITEM_NONE)))
+        ((pFeno->indexOffsetConst==ITEM_NONE) || (TabCross[pFeno->indexOffsetConst].FitParam==ITEM_NONE)) &&
+        ((pFeno->indexOffsetOrder1==ITEM_NONE) || (TabCross[pFeno->indexOffsetOrder1].FitParam==ITEM_NONE)) &&
+        ((pFeno->indexOffsetOrder2==ITEM_NONE) || (TabCross[pFeno->indexOffsetOrder2].FitParam==ITEM_NONE)))
      {
-      hFilterSpecLog=1;
+      ws->hFilterSpecLog=1;
 
-      if (((rc=VECTOR_Log(&SpecTrav[LimMin],&SpecTrav[LimMin],LimN,"ANALYSE_CurFitMethod (Ref) "))!=0) ||           // !!!
-          ((rc=FILTER_Vector(ANALYSE_phFilter,&SpecTrav[LimMin],&SpecTrav[LimMin],NULL,LimN,PRJCT_FILTER_OUTPUT_HIGH_SUB))!=0))        // !!!
+      if (((rc=VECTOR_Log(&SpecTrav[ws->limMin],&SpecTrav[ws->limMin],ws->limN,"ANALYSE_CurFitMethod (Ref) "))!=0) ||           // !!!
+          ((rc=FILTER_Vector(ANALYSE_phFilter,&SpecTrav[ws->limMin],&SpecTrav[ws->limMin],NULL,ws->limN,PRJCT_FILTER_OUTPUT_HIGH_SUB))!=0))        // !!!
 
        goto EndCurFitMethod;
      }
@@ -3434,34 +4142,34 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
     // High pass filtering (Reference)
 
     if ((ANALYSE_phFilter->filterFunction!=NULL) &&                   // high pass filtering is requested
-        ((!Feno->hidden && ANALYSE_phFilter->hpFilterAnalysis) || ((Feno->hidden==1) && ANALYSE_phFilter->hpFilterCalib)) &&
+        ((!pFeno->hidden && ANALYSE_phFilter->hpFilterAnalysis) || ((pFeno->hidden==1) && ANALYSE_phFilter->hpFilterCalib)) &&
 
-        (Feno->analysisType!=ANALYSIS_TYPE_FWHM_NLFIT) &&     // doesn't fit the resolution (FWHM) between the reference and the spectrum as a non linear parameter
-        (Feno->analysisType!=ANALYSIS_TYPE_FWHM_KURUCZ) &&
-        (Feno->analysisMethod==OPTICAL_DENSITY_FIT) &&       // only implemented in optical density fitting
-        ((Feno->indexSol==ITEM_NONE) || (TabCross[Feno->indexSol].FitParam==ITEM_NONE)))
+        (pFeno->analysisType!=ANALYSIS_TYPE_FWHM_NLFIT) &&     // doesn't fit the resolution (FWHM) between the reference and the spectrum as a non linear parameter
+        (pFeno->analysisType!=ANALYSIS_TYPE_FWHM_KURUCZ) &&
+        (pFeno->analysisMethod==OPTICAL_DENSITY_FIT) &&       // only implemented in optical density fitting
+        ((pFeno->indexSol==ITEM_NONE) || (TabCross[pFeno->indexSol].FitParam==ITEM_NONE)))
      {
-      hFilterRefLog=1;
+      ws->hFilterRefLog=1;
 
-      if (((rc=VECTOR_Log(&RefTrav[LimMin],&RefTrav[LimMin],LimN,"ANALYSE_CurFitMethod (Ref) "))!=0) ||
-          ((rc=FILTER_Vector(ANALYSE_phFilter,&RefTrav[LimMin],&RefTrav[LimMin],NULL,LimN,PRJCT_FILTER_OUTPUT_HIGH_SUB))!=0))
+      if (((rc=VECTOR_Log(&RefTrav[ws->limMin],&RefTrav[ws->limMin],ws->limN,"ANALYSE_CurFitMethod (Ref) "))!=0) ||
+          ((rc=FILTER_Vector(ANALYSE_phFilter,&RefTrav[ws->limMin],&RefTrav[ws->limMin],NULL,ws->limN,PRJCT_FILTER_OUTPUT_HIGH_SUB))!=0))
 
        goto EndCurFitMethod;
      }
 
-    Feno->ymean=(double)0.;
+    pFeno->ymean=(double)0.;
     doas_iterator my_iterator;
-    for( int i=iterator_start(&my_iterator, global_doas_spectrum); i != ITERATOR_FINISHED;i=iterator_next(&my_iterator))
-     Feno->ymean+=(double)RefTrav[i];
+    for( int i=iterator_start(&my_iterator, ws->specrange); i != ITERATOR_FINISHED;i=iterator_next(&my_iterator))
+     pFeno->ymean+=(double)RefTrav[i];
 
-    Feno->ymean/=fit->DimL;
+    pFeno->ymean/=fit->DimL;
 
     // ---------------------------------
     // Calculation of second derivatives
     // ---------------------------------
 
-    if (((rc=SPLINE_Deriv2(LambdaSpec,SpecTrav,SplineSpec,n_wavel,"ANALYSE_CurFitMethod (LambdaSpec) "))!=0) || // !!! ANALYSE_splineX -> LambdaSpec
-        ((rc=SPLINE_Deriv2(ANALYSE_splineX,RefTrav,SplineRef,n_wavel,"ANALYSE_CurFitMethod (ANALYSE_splineX) "))!=0))
+    if (((rc=SPLINE_Deriv2(ws->lambdaSpec,SpecTrav,ws->splineSpec,n_wavel,"ANALYSE_CurFitMethod (LambdaSpec) "))!=0) || // !!! ANALYSE_splineX -> LambdaSpec
+        ((rc=SPLINE_Deriv2(ws->splineX,RefTrav,ws->splineRef,n_wavel,"ANALYSE_CurFitMethod (ANALYSE_splineX) "))!=0))
 
 //    if (((rc=SPLINE_Deriv2(&LambdaSpec[LimMin],&SpecTrav[LimMin],&SplineSpec[LimMin],LimN,"ANALYSE_CurFitMethod (LambdaSpec) "))!=0) || // !!! ANALYSE_splineX -> LambdaSpec
 //        ((rc=SPLINE_Deriv2(&ANALYSE_splineX[LimMin],&RefTrav[LimMin],&SplineRef[LimMin],LimN,"ANALYSE_CurFitMethod (ANALYSE_splineX) "))!=0))     
@@ -3475,10 +4183,12 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
     int indexFeno; // TODO: this search fails for calls from alignreference because we work with a different copy of Feno
     for (indexFeno=0;indexFeno<NFeno;indexFeno++)
      if (!TabFeno[indexFenoColumn][indexFeno].hidden &&
-         (Feno==&TabFeno[indexFenoColumn][indexFeno]))
+         (pFeno==&TabFeno[indexFenoColumn][indexFeno]))
       break;
 
-    for (int i=0;i<Feno->NTabCross;i++)                        // parameters initialization
+    warmStart=(analyseWarmStart && (indexFeno<NFeno))?1:0;                      // only for the analysis windows, not for the working copies
+
+    for (int i=0;i<pFeno->NTabCross;i++)                        // parameters initialization
      {
       if (TabCross[i].IndSvdA)
        {
@@ -3486,8 +4196,8 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
 
         if ((WorkSpace[TabCross[i].Comp].type==WRK_SYMBOL_CROSS) && (indexFeno<NFeno) &&
             (TabCross[i].FitFromPrevious==1) && (TabCross[i].InitConc==(double)0.) &&
-            (((Feno->analysisMethod==OPTICAL_DENSITY_FIT) && (TabCross[i].FitConc==0)) ||
-             ((Feno->analysisMethod==INTENSITY_FIT) && (TabCross[i].FitConc==ITEM_NONE))))
+            (((pFeno->analysisMethod==OPTICAL_DENSITY_FIT) && (TabCross[i].FitConc==0)) ||
+             ((pFeno->analysisMethod==INTENSITY_FIT) && (TabCross[i].FitConc==ITEM_NONE))))
          {
           bool found_previous = false;
           for (int indexFeno2=indexFeno-1;indexFeno2>=0 && !found_previous; indexFeno2--) {
@@ -3514,7 +4224,7 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
 
     if (useErrors)
      {
-      for( int k=0,i=iterator_start(&my_iterator, global_doas_spectrum); i != ITERATOR_FINISHED; k++,i=iterator_next(&my_iterator))
+      for( int k=0,i=iterator_start(&my_iterator, ws->specrange); i != ITERATOR_FINISHED; k++,i=iterator_next(&my_iterator))
        if ((SpecTrav[i]==(double)0.) || (RefTrav[i]==(double)0.))
         rc=ERROR_SetLast(__func__,ERROR_TYPE_WARNING,ERROR_ID_DIVISION_BY_0,"try to divide errors by a zero");
        else {
@@ -3522,17 +4232,23 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
         double Ispec = speNormFact * Spectre[i]; // spectrum intensity
         double Iref = refNormFact * Sref[i]; // reference intensity
         SigmaY[k]=(double)sqrt( (SigmaSpec[i]*SigmaSpec[i])/(Ispec*Ispec)
-                                + (Feno->SrefSigma[i]*Feno->SrefSigma[i])/(Iref*Iref) );
+                                + (pFeno->SrefSigma[i]*pFeno->SrefSigma[i])/(Iref*Iref) );
        }
       if (rc!=0)
        goto EndCurFitMethod;
      }
 
-    if ((fit->NF==0) && ((rc=ANALYSE_Function(SpecTrav,RefTrav,SigmaY,Yfit,fit->DimL,fitParamsC,fitParamsF,indexFenoColumn, fit))<THREAD_EVENT_STOP))
-     *Chisqr=(double)Fchisq(pAnalysisOptions->fitWeighting,(int)ANALYSE_nFree,Y0,Yfit,SigmaY,fit->DimL);
+    // new spectrum and errors : the decomposition of the columns that don't change during the fit has to be calculated again
+
+    LINEAR_forget_fixed_columns(fit->linfit);
+
+    if ((fit->NF==0) && ((rc=ANALYSE_Function(ws,SpecTrav,RefTrav,SigmaY,Yfit,fit->DimL,fitParamsC,fitParamsF,indexFenoColumn, fit))<THREAD_EVENT_STOP))
+     *Chisqr=(double)Fchisq(pAnalysisOptions->fitWeighting,(int)ws->nFree,Y0,Yfit,SigmaY,fit->DimL);
     else if (fit->NF)
      {
-      for (int i=0; i<fit->NF; i++ ) { fitParamsF[i] = Fitp[i]; Deltap[i] = FitDeltap[i]; }
+      for (int i=0; i<fit->NF; i++ ) { fitParamsF[i] = ws->fitp[i]; Deltap[i] = ws->fitDeltap[i]; }
+
+      warmStarted=(warmStart)?AnalyseWarmStartGet(ws,fitParamsF,fit->NF):0;
 
       /*  ==============  */
       /*  Loop on Chisqr  */
@@ -3546,41 +4262,45 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
       do {
         OldChisqr = *Chisqr;
 
-        if ((rc=Curfit(pAnalysisOptions->fitWeighting, niter, ANALYSE_nFree,SpecTrav,RefTrav,Y0,SigmaY,fit->DimL,
-                       fitParamsC,fitParamsF,Deltap,Sigmaa,FitMinp,FitMaxp,fit->NF,Yfit,&Lamda,Chisqr,indexFenoColumn,fit))>=THREAD_EVENT_STOP)
+        if ((rc=Curfit(ws,pAnalysisOptions->fitWeighting, niter, ws->nFree,SpecTrav,RefTrav,Y0,SigmaY,fit->DimL,
+                       fitParamsC,fitParamsF,Deltap,Sigmaa,ws->fitMinp,ws->fitMaxp,fit->NF,Yfit,&Lamda,Chisqr,indexFenoColumn,fit))>=THREAD_EVENT_STOP)
          break;
 
         for (int i=0; i<fit->NF; i++ ) Deltap[i] *= 0.4;
         niter++;
       } while ( *Chisqr != 0.
                 && fabs(*Chisqr-OldChisqr)/(*Chisqr) > pAnalysisOptions->convergence
-                && (Feno->hidden || !pAnalysisOptions->maxIterations || niter<pAnalysisOptions->maxIterations) );
+                && (pFeno->hidden || !pAnalysisOptions->maxIterations || niter<pAnalysisOptions->maxIterations) );
 
       if (pNiter!=NULL)
         *pNiter=niter;
+
+      if (warmStart)
+        AnalyseWarmStartSet(ws,fitParamsF,fit->NF,*Chisqr,warmStarted,
+                            (rc==ERROR_ID_NO) && (!pAnalysisOptions->maxIterations || (niter<pAnalysisOptions->maxIterations)));
      }
 
     if (rc<THREAD_EVENT_STOP) {
       /*  ====================  */
       /*  Residual Computation  */
       /*  ====================  */
-      for( int k=0,i=iterator_start(&my_iterator, global_doas_spectrum); i != ITERATOR_FINISHED; k++,i=iterator_next(&my_iterator)) {
-        ANALYSE_absolu[i]  =  (Yfit[k]-Y0[k]);
-        if (Feno->analysisMethod!=OPTICAL_DENSITY_FIT)
-         ANALYSE_t[i]=(ANALYSE_tc[i]!=(double)0.)?(double)1.+ANALYSE_absolu[i]/ANALYSE_tc[i]:(double)0.;
+      for( int k=0,i=iterator_start(&my_iterator, ws->specrange); i != ITERATOR_FINISHED; k++,i=iterator_next(&my_iterator)) {
+        ws->absolu[i]  =  (Yfit[k]-Y0[k]);
+        if (pFeno->analysisMethod!=OPTICAL_DENSITY_FIT)
+         ws->t[i]=(ws->tc[i]!=(double)0.)?(double)1.+ws->absolu[i]/ws->tc[i]:(double)0.;
       }
 
       if (residuals != NULL)
-        memcpy(residuals,ANALYSE_absolu,n_wavel * sizeof(*residuals));
+        memcpy(residuals,ws->absolu,n_wavel * sizeof(*residuals));
 
       scalingFactor=(pAnalysisOptions->fitWeighting==PRJCT_ANLYS_FIT_WEIGHTING_NONE)?(*Chisqr):(double)1.;
 
-      for (int i=0;i<Feno->NTabCross;i++) {
-        pResults=&Feno->TabCrossResults[i];
+      for (int i=0;i<pFeno->NTabCross;i++) {
+        pResults=&pFeno->TabCrossResults[i];
         pTabCross=&TabCross[i];
 
         // in Intensity fitting mode, fitted concentrations are scaled by the cross section normalization factor:
-        if (Feno->analysisMethod==INTENSITY_FIT) {
+        if (pFeno->analysisMethod==INTENSITY_FIT) {
           if (pTabCross->IndSvdA > 0
               && WorkSpace[pTabCross->Comp].type==WRK_SYMBOL_CROSS
               && pTabCross->FitConc > ITEM_NONE) {
@@ -3595,19 +4315,19 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
 
         if (pTabCross->IndSvdA) { // Cross section, polynomial, linear offset, undersampling, resol, common residual
 
-          if ((Feno->analysisMethod==OPTICAL_DENSITY_FIT && pTabCross->FitParam==ITEM_NONE) || pTabCross->IndSvdP) {
+          if ((pFeno->analysisMethod==OPTICAL_DENSITY_FIT && pTabCross->FitParam==ITEM_NONE) || pTabCross->IndSvdP) {
             // Linear fitting:
             // OD mode: cross sections, polynomial, pre-defined parameters (except non-linear offset)
             // Intensity fitting mode: polynomial, pre-defined parameters Resol, Usamp, Comon residual
-            pResults->SlntCol=x[pTabCross->IndSvdA] = fitParamsC[pTabCross->IndSvdA];
+            pResults->SlntCol=ws->x[pTabCross->IndSvdA] = fitParamsC[pTabCross->IndSvdA];
             // In intensity fitting mode, use SvdP index:
             int linear_index = pTabCross->IndSvdP ? pTabCross->IndSvdP : pTabCross->IndSvdA;
-            pResults->SlntErr=Sigma[pTabCross->IndSvdA]= (pTabCross->FitConc!=0)
+            pResults->SlntErr=ws->sigma[pTabCross->IndSvdA]= (pTabCross->FitConc!=0)
               ? sqrt(fit->SigmaSqr[linear_index]*scalingFactor)
               : 0.;
 
             if (WorkSpace[pTabCross->Comp].type==WRK_SYMBOL_CONTINUOUS
-                && !Feno->hidden) {
+                && !pFeno->hidden) {
               // Intensity fitting but polynomial is fitted linearly
 
               if ((pTabCross->IndSvdP) && (fabs(refNormFact)>EPSILON)) {                    // polynomial : the output differs from the display in order
@@ -3625,10 +4345,10 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
             }
           } else {
             // Non-linear fitting: cross sections in Intensity fitting mode or Raman in OD mode
-            pResults->SlntCol=x[pTabCross->IndSvdA] = (pTabCross->FitConc!=ITEM_NONE)
+            pResults->SlntCol=ws->x[pTabCross->IndSvdA] = (pTabCross->FitConc!=ITEM_NONE)
               ? fitParamsF[pTabCross->FitConc]
               : fitParamsC[TabCross[i].IndSvdA];
-            pResults->SlntErr=Sigma[pTabCross->IndSvdA] = (pTabCross->FitConc!=ITEM_NONE)
+            pResults->SlntErr=ws->sigma[pTabCross->IndSvdA] = (pTabCross->FitConc!=ITEM_NONE)
               ? Sigmaa[pTabCross->FitConc]
               : 0.;
 
@@ -3647,12 +4367,12 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
         }
 
         pResults->Shift = ( pTabCross->FitShift != ITEM_NONE ) ? (double) fitParamsF[pTabCross->FitShift] : pTabCross->InitShift;
-        pResults->Stretch = ( pTabCross->FitStretch != ITEM_NONE ) ? (double) fitParamsF[pTabCross->FitStretch]*StretchFact1 : pTabCross->InitStretch*StretchFact1;
-        pResults->Stretch2 = ( pTabCross->FitStretch2 != ITEM_NONE ) ? (double) fitParamsF[pTabCross->FitStretch2]*StretchFact2 : pTabCross->InitStretch2*StretchFact2;
+        pResults->Stretch = ( pTabCross->FitStretch != ITEM_NONE ) ? (double) fitParamsF[pTabCross->FitStretch]*ws->stretchFact1 : pTabCross->InitStretch*ws->stretchFact1;
+        pResults->Stretch2 = ( pTabCross->FitStretch2 != ITEM_NONE ) ? (double) fitParamsF[pTabCross->FitStretch2]*ws->stretchFact2 : pTabCross->InitStretch2*ws->stretchFact2;
 
         pResults->SigmaShift = (pTabCross->FitShift != ITEM_NONE) ? Sigmaa[pTabCross->FitShift] : (double)1.;
-        pResults->SigmaStretch = (pTabCross->FitStretch != ITEM_NONE) ? Sigmaa[pTabCross->FitStretch]*StretchFact1 : (double)1.;
-        pResults->SigmaStretch2 = (pTabCross->FitStretch2 != ITEM_NONE) ? Sigmaa[pTabCross->FitStretch2]*StretchFact2 : (double)1.;
+        pResults->SigmaStretch = (pTabCross->FitStretch != ITEM_NONE) ? Sigmaa[pTabCross->FitStretch]*ws->stretchFact1 : (double)1.;
+        pResults->SigmaStretch2 = (pTabCross->FitStretch2 != ITEM_NONE) ? Sigmaa[pTabCross->FitStretch2]*ws->stretchFact2 : (double)1.;
        }
      }
    }
@@ -3663,13 +4383,13 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
 
  EndCurFitMethod :
 
-  for (int i=0;i<Feno->NTabCross;i++)
+  for (int i=0;i<pFeno->NTabCross;i++)
    {
     pTabCross=&TabCross[i];
 
     pTabCross->InitParam*=pTabCross->Fact;
-    pTabCross->InitStretch*=StretchFact1;
-    pTabCross->InitStretch2*=StretchFact2;
+    pTabCross->InitStretch*=ws->stretchFact1;
+    pTabCross->InitStretch2*=ws->stretchFact2;
    }
 
   if (Sigmaa!=NULL)
@@ -3704,7 +4424,7 @@ RC ANALYSE_CurFitMethod(INDEX indexFenoColumn,          // for imagers as OMI, T
 // ANALYSE_Spectrum : Spectrum record analysis
 // -------------------------------------------
 
-RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
+RC ANALYSE_Spectrum(struct analysis_workspace *ws,ENGINE_CONTEXT *pEngineContext,void *responseHandle)
 {
   // Declarations
 
@@ -3713,6 +4433,7 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
   BUFFERS *pBuffers;                                                            // pointer to the buffers part of the engine context
   RECORD_INFO *pRecord;                                                         // pointer to the record part of the engine context
 
+  FENO *pFeno;                               // analysis window being processed
   CROSS_REFERENCE *TabCross;                 // list of symbols hold by a analysis window
   CROSS_RESULTS *Results;                    // corresponding results
   char windowTitle[MAX_ITEM_TEXT_LEN];    // window title for graphs
@@ -3760,17 +4481,17 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
 
   const int n_wavel = NDET[pRecord->i_crosstrack];
 
-  memcpy(ANALYSE_t,ANALYSE_zeros,sizeof(double)*n_wavel);
-  memcpy(ANALYSE_tc,ANALYSE_zeros,sizeof(double)*n_wavel);
+  memcpy(ws->t,ANALYSE_zeros,sizeof(double)*n_wavel);
+  memcpy(ws->tc,ANALYSE_zeros,sizeof(double)*n_wavel);
 
   speNormFact=1.;
-  ZM=pRecord->Zm;
-  TDET=pRecord->TDet;
+  ws->zm=pRecord->Zm;
+  ws->tdet=pRecord->TDet;
 
   saveFlag=(int)pEngineContext->project.spectra.displayDataFlag;
   SpectreK=LambdaK=Sref=Trend=offset=NULL;
   molecularRing_a=(is_satellite(pEngineContext->project.instrumental.readOutFormat) ||
-                  (pEngineContext->project.instrumental.readOutFormat==PRJCT_INSTR_FORMAT_APEX))?(double)1./cos(ZM*DegToRad)/((double)1./cos(ZM*DegToRad)+(double)1./cos(pRecord->zenithViewAngle*DegToRad)):(double)1.;
+                  (pEngineContext->project.instrumental.readOutFormat==PRJCT_INSTR_FORMAT_APEX))?(double)1./cos(ws->zm*DegToRad)/((double)1./cos(ws->zm*DegToRad)+(double)1./cos(pRecord->zenithViewAngle*DegToRad)):(double)1.;
   useKurucz=0;
 
 
@@ -3816,7 +4537,7 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
         memcpy(SpectreK,Spectre,sizeof(double)*n_wavel);
 
         if (((pEngineContext->project.instrumental.readOutFormat!=PRJCT_INSTR_FORMAT_GEMS) || !(rc=GEMS_LoadCalib(pEngineContext,indexFenoColumn,responseHandle))) &&
-            !(rc=KURUCZ_Spectrum(pBuffers->lambda,LambdaK,SpectreK,KURUCZ_buffers[indexFenoColumn].solar,pBuffers->instrFunction,
+            !(rc=KURUCZ_Spectrum(ws,pBuffers->lambda,LambdaK,SpectreK,KURUCZ_buffers[indexFenoColumn].solar,pBuffers->instrFunction,
                                  1,"Calibration applied on spectrum",KURUCZ_buffers[indexFenoColumn].fwhmPolySpec,KURUCZ_buffers[indexFenoColumn].fwhmVector,KURUCZ_buffers[indexFenoColumn].fwhmDeriv2,saveFlag,
                                  KURUCZ_buffers[indexFenoColumn].indexKurucz,responseHandle,indexFenoColumn))) {
 
@@ -3852,7 +4573,7 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
       // Browse analysis windows
       for (int WrkFeno=0; (WrkFeno != NFeno) && (rc<THREAD_EVENT_STOP); ++WrkFeno) {
        indexPage=WrkFeno+plotPageAnalysis;
-        Feno=&TabFeno[indexFenoColumn][WrkFeno];
+        pFeno=&TabFeno[indexFenoColumn][WrkFeno];
         if (((pEngineContext->project.instrumental.readOutFormat==PRJCT_INSTR_FORMAT_GOME1_NETCDF) ||
              (pEngineContext->project.instrumental.readOutFormat==PRJCT_INSTR_FORMAT_TROPOMI) ||
              (pEngineContext->project.instrumental.readOutFormat==PRJCT_INSTR_FORMAT_OMI) ||
@@ -3860,26 +4581,26 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
              (pEngineContext->project.instrumental.readOutFormat==PRJCT_INSTR_FORMAT_APEX) ||
              (pEngineContext->project.instrumental.readOutFormat==PRJCT_INSTR_FORMAT_GEMS))
          &&
-            !Feno->useRefRow) continue;
+            !pFeno->useRefRow) continue;
 
         // MAXDOAS measurements : Thomas Wagner request -> add the possibility to select a reference spectrum with an elevation angle different from zenith.
         // This should be improved and move to engine.c in one of the functions dedicated to the selection of the reference spectrum
 
-        if (!Feno->hidden &&
-            (VECTOR_Equal(Spectre,Feno->Sref,n_wavel, 1.e-7) ||
-             (!pEngineContext->satelliteFlag && Feno->refSpectrumSelectionMode==ANLYS_REF_SELECTION_MODE_AUTOMATIC &&
-              (( Feno->refMaxdoasSelectionMode==ANLYS_MAXDOAS_REF_SZA &&             // Additional security (in principle, if one twilight is missing,
-                 ((pRecord->localTimeDec<=12. && Feno->indexRefMorning==ITEM_NONE) || // use ref of the other twilight, if both twilights are missing, exit)
-                  (pRecord->localTimeDec>12. && Feno->indexRefAfternoon==ITEM_NONE))) ||
+        if (!pFeno->hidden &&
+            (VECTOR_Equal(Spectre,pFeno->Sref,n_wavel, 1.e-7) ||
+             (!pEngineContext->satelliteFlag && pFeno->refSpectrumSelectionMode==ANLYS_REF_SELECTION_MODE_AUTOMATIC &&
+              (( pFeno->refMaxdoasSelectionMode==ANLYS_MAXDOAS_REF_SZA &&             // Additional security (in principle, if one twilight is missing,
+                 ((pRecord->localTimeDec<=12. && pFeno->indexRefMorning==ITEM_NONE) || // use ref of the other twilight, if both twilights are missing, exit)
+                  (pRecord->localTimeDec>12. && pFeno->indexRefAfternoon==ITEM_NONE))) ||
 
-               (Feno->refMaxdoasSelectionMode==ANLYS_MAXDOAS_REF_SCAN &&
+               (pFeno->refMaxdoasSelectionMode==ANLYS_MAXDOAS_REF_SCAN &&
                 pRecord->elevationViewAngle>=pEngineContext->project.spectra.refAngle-pEngineContext->project.spectra.refTol &&
                 pRecord->elevationViewAngle<=pEngineContext->project.spectra.refAngle+pEngineContext->project.spectra.refTol))))) {
-          Feno->rc = -1;
+          pFeno->rc = -1;
         } else {
-          Feno->rc = ERROR_ID_NO;
+          pFeno->rc = ERROR_ID_NO;
         }
-        sprintf(windowTitle,"Analysis results for %s window",Feno->windowName);
+        sprintf(windowTitle,"Analysis results for %s window",pFeno->windowName);
 
         // OMI/OMPS/TROPOMI : at this step, the irradiance is not available yet (in separate files)
 
@@ -3888,66 +4609,66 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
            case PRJCT_INSTR_FORMAT_OMIV4:
            case PRJCT_INSTR_FORMAT_OMPS:
            case PRJCT_INSTR_FORMAT_TROPOMI:
-             memcpy(Feno->Lambda,pBuffers->lambda,sizeof(double)*n_wavel);
+             memcpy(pFeno->Lambda,pBuffers->lambda,sizeof(double)*n_wavel);
              break;
            default:
-             memcpy(Feno->Lambda,Feno->LambdaK,sizeof(double)*n_wavel);
+             memcpy(pFeno->Lambda,pFeno->LambdaK,sizeof(double)*n_wavel);
              break;
         }
 
         if (ANALYSE_swathSize == 1) {
-          sprintf(tabTitle,"%s results (%d/%d)",Feno->windowName,pEngineContext->indexRecord,pEngineContext->recordNumber);
+          sprintf(tabTitle,"%s results (%d/%d)",pFeno->windowName,pEngineContext->indexRecord,pEngineContext->recordNumber);
         } else {
           sprintf(tabTitle,"%s results (record %d/%d, measurement %d/%d, row %d/%d)",
-                  Feno->windowName,pEngineContext->indexRecord,pEngineContext->recordNumber,
+                  pFeno->windowName,pEngineContext->indexRecord,pEngineContext->recordNumber,
                   1+pEngineContext->recordInfo.i_alongtrack,pEngineContext->n_alongtrack,
                   1+pEngineContext->recordInfo.i_crosstrack,pEngineContext->n_crosstrack);
         }
 
-        displayFlag=Feno->displaySpectrum+                            //  force display spectrum
-          Feno->displayResidue+                                       //  force display residue
-          Feno->displayTrend+                                         //  force display trend
-          Feno->displayRefEtalon+                                     //  force display alignment of reference on etalon
-          Feno->displayFits+                                          //  force display fits
-          Feno->displayPredefined+                                    //  force display predefined parameters
-          Feno->displayRef;
+        displayFlag=pFeno->displaySpectrum+                            //  force display spectrum
+          pFeno->displayResidue+                                       //  force display residue
+          pFeno->displayTrend+                                         //  force display trend
+          pFeno->displayRefEtalon+                                     //  force display alignment of reference on etalon
+          pFeno->displayFits+                                          //  force display fits
+          pFeno->displayPredefined+                                    //  force display predefined parameters
+          pFeno->displayRef;
 
         if (displayFlag)
          mediateResponseLabelPage(indexPage,pEngineContext->fileInfo.fileName,tabTitle,responseHandle);
 
-        if (!Feno->hidden && (Feno->rcKurucz==ERROR_ID_NO) &&
-            ((Feno->useKurucz==ANLYS_KURUCZ_SPEC) || !Feno->rc)) {
-          memcpy(ANALYSE_absolu,ANALYSE_zeros,sizeof(double)*n_wavel);
+        if (!pFeno->hidden && (pFeno->rcKurucz==ERROR_ID_NO) &&
+            ((pFeno->useKurucz==ANLYS_KURUCZ_SPEC) || !pFeno->rc)) {
+          memcpy(ws->absolu,ANALYSE_zeros,sizeof(double)*n_wavel);
 
-          if (Feno->amfFlag ||
-              ((Feno->useKurucz==ANLYS_KURUCZ_REF_AND_SPEC) && Feno->xsToConvolute) ||
-              ( (Feno->linear_offset_mode == LINEAR_OFFSET_RAD) && (Feno->analysisMethod==OPTICAL_DENSITY_FIT))) {
+          if (pFeno->amfFlag ||
+              ((pFeno->useKurucz==ANLYS_KURUCZ_REF_AND_SPEC) && pFeno->xsToConvolute) ||
+              ( (pFeno->linear_offset_mode == LINEAR_OFFSET_RAD) && (pFeno->analysisMethod==OPTICAL_DENSITY_FIT))) {
             // fit a linear offset using the inverse of the spectrum
-            Feno->Decomp=1;
+            pFeno->Decomp=1;
           }
 
           // Local variables initializations
 
           Niter=0;
           NbFeno++;
-          TabCross=Feno->TabCross;
-          Results=Feno->TabCrossResults;
+          TabCross=pFeno->TabCross;
+          Results=pFeno->TabCrossResults;
 
           // Reference spectrum
 
-          if (Feno->refSpectrumSelectionMode==ANLYS_REF_SELECTION_MODE_AUTOMATIC) {
+          if (pFeno->refSpectrumSelectionMode==ANLYS_REF_SELECTION_MODE_AUTOMATIC) {
             switch(pEngineContext->project.instrumental.readOutFormat) {
             case PRJCT_INSTR_FORMAT_OMPS:
               rc=ERROR_SetLast(__func__, ERROR_TYPE_FATAL, ERROR_ID_NETCDF, "Automatic reference selection not implemented for this file format");
               break;
             case PRJCT_INSTR_FORMAT_GDP_BIN:                                          // GOME1NETCDF !!!!!!
-              rc = GDP_BIN_get_vza_ref(pRecord->gome.pixelType, WrkFeno, Feno);
+              rc = GDP_BIN_get_vza_ref(pRecord->gome.pixelType, WrkFeno, pFeno);
               break;
             case PRJCT_INSTR_FORMAT_GOME2:
-              rc = GOME2_get_vza_ref(pRecord->satellite.vza, WrkFeno, Feno);
+              rc = GOME2_get_vza_ref(pRecord->satellite.vza, WrkFeno, pFeno);
               break;
             case PRJCT_INSTR_FORMAT_SCIA_PDS:
-              rc = SCIA_get_vza_ref(pRecord->satellite.vza, WrkFeno, Feno);
+              rc = SCIA_get_vza_ref(pRecord->satellite.vza, WrkFeno, pFeno);
               break;
             default:
               break;
@@ -3956,9 +4677,9 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
           if (rc)
             goto EndAnalysis;
 
-          memcpy(Sref,Feno->Sref,sizeof(double)*n_wavel);
-          Lambda=Feno->LambdaK;
-          LambdaSpec=Feno->Lambda;
+          memcpy(Sref,pFeno->Sref,sizeof(double)*n_wavel);
+          ws->lambda=pFeno->LambdaK;
+          ws->lambdaSpec=pFeno->Lambda;
 
           // For OMI, OMPS, Tropomi and GOME-2, interpolate earthshine          // FRM4DOAS : check with Michel what to do with ASCII spectra
           // spectrum onto the solar reference wavelength grid
@@ -3975,7 +4696,7 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
             double *spec_deriv2 = malloc(n_wavel * sizeof(*spec_deriv2));
             rc = SPLINE_Deriv2(pBuffers->lambda, pBuffers->spectrum, spec_deriv2, n_wavel, __func__);
             if (rc == ERROR_ID_NO)
-              rc = SPLINE_Vector(pBuffers->lambda, pBuffers->spectrum, spec_deriv2, n_wavel, Feno->LambdaRef, Spectre, n_wavel, SPLINE_CUBIC);
+              rc = SPLINE_Vector(pBuffers->lambda, pBuffers->spectrum, spec_deriv2, n_wavel, pFeno->LambdaRef, Spectre, n_wavel, SPLINE_CUBIC);
             free(spec_deriv2);
             if (rc == ERROR_ID_NO)
               rc=VECTOR_NormalizeVector(Spectre-1,n_wavel,&speNormFact,__func__);
@@ -3985,38 +4706,38 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
             // after putting earthshine on reference grid, assign the
             // Kurucz-corrected reference grid LambdaK to the
             // earthshine spectrum as well
-            LambdaSpec = Feno->LambdaK;
+            ws->lambdaSpec = pFeno->LambdaK;
           }
 
           // Make a backup of spectral window limits + gaps
 
-          old_range = spectrum_copy(Feno->fit_properties.specrange);
+          old_range = spectrum_copy(pFeno->fit_properties.specrange);
 
           if ((pInstrumental->readOutFormat==PRJCT_INSTR_FORMAT_OMI) &&
               pInstrumental->omi.pixelQFRejectionFlag &&
-              (pEngineContext->buffers.pixel_QF!=NULL) && (Feno->omiRejPixelsQF!=NULL)) {
+              (pEngineContext->buffers.pixel_QF!=NULL) && (pFeno->omiRejPixelsQF!=NULL)) {
             unsigned short *pixelQF=(unsigned short *)pEngineContext->buffers.pixel_QF;
 
-            memset(Feno->omiRejPixelsQF,0,sizeof(int)*Feno->NDET);
+            memset(pFeno->omiRejPixelsQF,0,sizeof(int)*pFeno->NDET);
             int start = spectrum_start(old_range);
             int end = spectrum_end(old_range);
             for (int j= start; j<= end; j++) {
               if ( ((pixelQF[j]&pInstrumental->omi.pixelQFMask)!=0) &&
-                   (spectrum_num_windows(Feno->fit_properties.specrange)<=pInstrumental->omi.pixelQFMaxGaps)) {
-                spectrum_remove_pixel(Feno->fit_properties.specrange,j);
-                Feno->omiRejPixelsQF[j]=1;
+                   (spectrum_num_windows(pFeno->fit_properties.specrange)<=pInstrumental->omi.pixelQFMaxGaps)) {
+                spectrum_remove_pixel(pFeno->fit_properties.specrange,j);
+                pFeno->omiRejPixelsQF[j]=1;
               }
             }
 
-            if ((spectrum_num_windows(Feno->fit_properties.specrange) > pInstrumental->omi.pixelQFMaxGaps) ||
-                ((rc=reinit_analysis(Feno, n_wavel))!=ERROR_ID_NO)) {
-              spectrum_destroy(Feno->fit_properties.specrange);
-              Feno->fit_properties.specrange = old_range;
+            if ((spectrum_num_windows(pFeno->fit_properties.specrange) > pInstrumental->omi.pixelQFMaxGaps) ||
+                ((rc=reinit_analysis(ws,pFeno, n_wavel))!=ERROR_ID_NO)) {
+              spectrum_destroy(pFeno->fit_properties.specrange);
+              pFeno->fit_properties.specrange = old_range;
 
               rc=ERROR_SetLast(__func__,ERROR_TYPE_WARNING,ERROR_ID_OMI_PIXELQF);
               goto EndAnalysis;
             }
-          } else if ((rc=ANALYSE_SvdInit(Feno,&Feno->fit_properties, n_wavel, Feno->LambdaK))!=ERROR_ID_NO) {
+          } else if ((rc=ANALYSE_SvdInit(ws,pFeno,&pFeno->fit_properties, n_wavel, pFeno->LambdaK))!=ERROR_ID_NO) {
             goto restore_specrange;
           }
 
@@ -4041,22 +4762,22 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
           // Display spectrum in the current analysis window
 
           if (strlen(pRecord->Nom))
-           sprintf(windowTitle,"Analysis of %s in %s window",pRecord->Nom,Feno->windowName);
+           sprintf(windowTitle,"Analysis of %s in %s window",pRecord->Nom,pFeno->windowName);
           else
-           sprintf(windowTitle,"Analysis of spectrum %d/%d in %s window",pEngineContext->indexRecord,pEngineContext->recordNumber,Feno->windowName);
+           sprintf(windowTitle,"Analysis of spectrum %d/%d in %s window",pEngineContext->indexRecord,pEngineContext->recordNumber,pFeno->windowName);
 
-          if (Feno->displaySpectrum)
+          if (pFeno->displaySpectrum)
            {
             double *spectre_plot = malloc(n_wavel * sizeof(double));
             // in case spectrum & reference have different wavelength grids (shift in pixels): interpolate Spectre on the grid of the reference
-            rc = SPLINE_Vector(LambdaSpec, Spectre, NULL, n_wavel, Feno->LambdaK, spectre_plot, n_wavel, SPLINE_LINEAR);
+            rc = SPLINE_Vector(ws->lambdaSpec, Spectre, NULL, n_wavel, pFeno->LambdaK, spectre_plot, n_wavel, SPLINE_LINEAR);
 
-            double *curves[2][2] = {{Feno->LambdaK, spectre_plot},
-                                    {Feno->LambdaK, Sref}};
-            if (!Feno->longPathFlag)
-             plot_curves(indexPage, curves, 2, Spectrum, forceAutoScale, "Spectrum and reference", responseHandle, Feno->fit_properties.specrange);
+            double *curves[2][2] = {{pFeno->LambdaK, spectre_plot},
+                                    {pFeno->LambdaK, Sref}};
+            if (!pFeno->longPathFlag)
+             plot_curves(indexPage, curves, 2, Spectrum, forceAutoScale, "Spectrum and reference", responseHandle, pFeno->fit_properties.specrange);
             else
-             plot_curves(indexPage, curves, 1, Spectrum, forceAutoScale, "Spectrum", responseHandle, Feno->fit_properties.specrange);
+             plot_curves(indexPage, curves, 1, Spectrum, forceAutoScale, "Spectrum", responseHandle, pFeno->fit_properties.specrange);
 
             free(spectre_plot);
             if (rc)
@@ -4074,7 +4795,7 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
           memcpy(residuals, ANALYSE_zeros, n_wavel * sizeof(*residuals));
 
           for(i = 0; i<n_wavel;i++)
-           Feno->spikes[i] = 0;
+           pFeno->spikes[i] = 0;
 
           double rms_residual=0,rms_residual_old=0.;
           int max_repeats_spikes = MAX_REPEAT_CURFIT;
@@ -4082,160 +4803,160 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
           int num_repeats_spikes = 0;
           int num_repeats_ring = 0;
 
-          if (Feno->molecularCorrection && ((rc=Analyse_Molecular_Ring_Init(Feno,Feno->LambdaK,n_wavel))>THREAD_EVENT_STOP))
+          if (pFeno->molecularCorrection && ((rc=Analyse_Molecular_Ring_Init(pFeno,pFeno->LambdaK,n_wavel))>THREAD_EVENT_STOP))
             goto restore_specrange;
 
           do {
-            if ((num_repeats_ring && ((rc=Analyse_Molecular_Ring_Calculate(Feno,Feno->LambdaK,n_wavel,molecularRing_a))!=ERROR_ID_NO)) ||
-               ((rc=ANALYSE_CurFitMethod(indexFenoColumn,
-                                    (Feno->useKurucz==ANLYS_KURUCZ_REF_AND_SPEC)?SpectreK:Spectre, // raw spectrum
+            if ((num_repeats_ring && ((rc=Analyse_Molecular_Ring_Calculate(pFeno,pFeno->LambdaK,n_wavel,molecularRing_a))!=ERROR_ID_NO)) ||
+               ((rc=ANALYSE_CurFitMethod(ws,indexFenoColumn,
+                                    (pFeno->useKurucz==ANLYS_KURUCZ_REF_AND_SPEC)?SpectreK:Spectre, // raw spectrum
                                     (pRecord->useErrors)?pBuffers->sigmaSpec:NULL, // error on raw spectrum
                                     Sref, // reference spectrum
                                     n_wavel,
                                     residuals,
-                                    &Feno->chiSquare, // returned stretch order 2
+                                    &pFeno->chiSquare, // returned stretch order 2
                                     &Niter, // number of iterations in Curfit
                                     speNormFact,
-                                    Feno->refNormFact,
-                                    &Feno->fit_properties))!=ERROR_ID_NO))
+                                    pFeno->refNormFact,
+                                    &pFeno->fit_properties))!=ERROR_ID_NO))
              break;
 
             rms_residual_old=rms_residual;
-            rms_residual = root_mean_square(residuals, Feno->fit_properties.specrange);
+            rms_residual = root_mean_square(residuals, pFeno->fit_properties.specrange);
           }
-          while(!Feno->hidden && !rc && // no spike removal, no molecular ring for calibration
+          while(!pFeno->hidden && !rc && // no spike removal, no molecular ring for calibration
 
                ((!num_repeats_ring &&                                                           // spike removal should be performed only one time before molecular ring loop
-                 remove_spikes(residuals, rms_residual * pAnalysisOptions->spike_tolerance, Feno->fit_properties.specrange, Feno->spikes) && // repeat as long as spikes are found
+                 remove_spikes(residuals, rms_residual * pAnalysisOptions->spike_tolerance, pFeno->fit_properties.specrange, pFeno->spikes) && // repeat as long as spikes are found
               (++num_repeats_spikes < max_repeats_spikes)) ||
-              (Feno->molecularCorrection && (++num_repeats_ring <= max_repeats_ring))) &&
+              (pFeno->molecularCorrection && (++num_repeats_ring <= max_repeats_ring))) &&
 
               ((num_repeats_ring<=1) || ((fabs(rms_residual_old)>EPSILON) && (fabs(rms_residual-rms_residual_old)>pAnalysisOptions->convergence))) &&
-              !(rc=reinit_analysis(Feno, n_wavel))); // SVD matrix must be initialized again when pixels are removed.
+              !(rc=reinit_analysis(ws,pFeno, n_wavel))); // SVD matrix must be initialized again when pixels are removed.
           free(residuals);
 
           #if defined(__DEBUG_) && __DEBUG_
           // DEBUG_Stop("Test");
           #endif
 
-          if (Feno->molecularCorrection)
-           Analyse_Molecular_Ring_End(Feno,n_wavel);
+          if (pFeno->molecularCorrection)
+           Analyse_Molecular_Ring_End(pFeno,n_wavel);
 
           if (rc == THREAD_EVENT_STOP || ERROR_Fatal())
            goto restore_specrange;
           else if (rc>THREAD_EVENT_STOP)
-           Feno->rc=rc;
+           pFeno->rc=rc;
 
-          pRecord->BestShift+=(double)Feno->TabCrossResults[Feno->indexSpectrum].Shift;
-          Feno->nIter=Niter;
+          pRecord->BestShift+=(double)pFeno->TabCrossResults[pFeno->indexSpectrum].Shift;
+          pFeno->nIter=Niter;
 
-          Feno->RMS = root_mean_square(ANALYSE_absolu, Feno->fit_properties.specrange);
+          pFeno->RMS = root_mean_square(ws->absolu, pFeno->fit_properties.specrange);
 
           // Display residual spectrum
 
-          if  (Feno->displayResidue) {
-            if (Feno->analysisMethod!=OPTICAL_DENSITY_FIT)
-              for (int j=SvdPDeb;j<=SvdPFin;j++)
-                ANALYSE_absolu[j]=(ANALYSE_tc[j]!=(double)0.)?ANALYSE_absolu[j]/ANALYSE_tc[j]:(double)0.;
+          if  (pFeno->displayResidue) {
+            if (pFeno->analysisMethod!=OPTICAL_DENSITY_FIT)
+              for (int j=ws->svdPDeb;j<=ws->svdPFin;j++)
+                ws->absolu[j]=(ws->tc[j]!=(double)0.)?ws->absolu[j]/ws->tc[j]:(double)0.;
 
-            sprintf(graphTitle,"%s (%.2le)",(Feno->analysisMethod!=OPTICAL_DENSITY_FIT)?"Normalized Residual":"Residual",Feno->RMS);
+            sprintf(graphTitle,"%s (%.2le)",(pFeno->analysisMethod!=OPTICAL_DENSITY_FIT)?"Normalized Residual":"Residual",pFeno->RMS);
 
-            double *curves[1][2] = {{Feno->LambdaK,ANALYSE_absolu}};
-            plot_curves(indexPage,curves,1,Residual,0,graphTitle, responseHandle, Feno->fit_properties.specrange);
+            double *curves[1][2] = {{pFeno->LambdaK,ws->absolu}};
+            plot_curves(indexPage,curves,1,Residual,0,graphTitle, responseHandle, pFeno->fit_properties.specrange);
           }
 
-          if (Feno->analysisMethod!=OPTICAL_DENSITY_FIT)
-           for (int j=SvdPDeb;j<=SvdPFin;j++)
-             ANALYSE_absolu[j]= (ANALYSE_t[j]>0.) ? log(ANALYSE_t[j]) : 0.;
+          if (pFeno->analysisMethod!=OPTICAL_DENSITY_FIT)
+           for (int j=ws->svdPDeb;j<=ws->svdPFin;j++)
+             ws->absolu[j]= (ws->t[j]>0.) ? log(ws->t[j]) : 0.;
 
-          if (Feno->saveResidualsFlag && (Feno->residualSpectrum!=NULL))
-           memcpy(Feno->residualSpectrum,&ANALYSE_absolu[SvdPDeb],sizeof(double)*Feno->fit_properties.DimL);
-          else if (strlen(Feno->residualsFile))
-           rc=AnalyseSaveResiduals(Feno->residualsFile,pEngineContext,n_wavel);
+          if (pFeno->saveResidualsFlag && (pFeno->residualSpectrum!=NULL))
+           memcpy(pFeno->residualSpectrum,&ws->absolu[ws->svdPDeb],sizeof(double)*pFeno->fit_properties.DimL);
+          else if (strlen(pFeno->residualsFile))
+           rc=AnalyseSaveResiduals(ws,pFeno->residualsFile,pEngineContext,n_wavel);
 
           if (rc!=ERROR_ID_NO)  
            goto restore_specrange;
 
-          if  (Feno->displayResidue && (Feno->analysisMethod!=OPTICAL_DENSITY_FIT))
+          if  (pFeno->displayResidue && (pFeno->analysisMethod!=OPTICAL_DENSITY_FIT))
            {
-            double * curves[1][2] = {{Feno->LambdaK,ANALYSE_absolu}};
-            plot_curves(indexPage,curves,1,Residual,allowFixedScale,"OD Residual", responseHandle, Feno->fit_properties.specrange);
+            double * curves[1][2] = {{pFeno->LambdaK,ws->absolu}};
+            plot_curves(indexPage,curves,1,Residual,allowFixedScale,"OD Residual", responseHandle, pFeno->fit_properties.specrange);
            }
 
           // Store fits
 
-          memcpy(ANALYSE_secX,ANALYSE_zeros,sizeof(double)*n_wavel);
+          memcpy(ws->secX,ANALYSE_zeros,sizeof(double)*n_wavel);
           memcpy(Trend,ANALYSE_zeros,sizeof(double)*n_wavel);
           memcpy(offset,ANALYSE_zeros,sizeof(double)*n_wavel);
           maxOffset=(double)0.;
 
           // if analysis has failed, don't try to plot results (some
           // buffers contain garbage data which can make Qwt crash)
-          if (Feno->rc) goto SKIP_PLOTS;
+          if (pFeno->rc) goto SKIP_PLOTS;
 
           // Display Offset
 
-          if  (Feno->displayPredefined &&
-               ((Feno->indexOffsetConst!=ITEM_NONE) ||
-                (Feno->indexOffsetOrder1!=ITEM_NONE) ||
-                (Feno->indexOffsetOrder2!=ITEM_NONE)) &&
+          if  (pFeno->displayPredefined &&
+               ((pFeno->indexOffsetConst!=ITEM_NONE) ||
+                (pFeno->indexOffsetOrder1!=ITEM_NONE) ||
+                (pFeno->indexOffsetOrder2!=ITEM_NONE)) &&
 
-               ((TabCross[Feno->indexOffsetConst].FitParam!=ITEM_NONE) ||
-                (TabCross[Feno->indexOffsetOrder1].FitParam!=ITEM_NONE) ||
-                (TabCross[Feno->indexOffsetOrder2].FitParam!=ITEM_NONE) ||
-                (TabCross[Feno->indexOffsetConst].InitParam!=0.) ||
-                (TabCross[Feno->indexOffsetOrder1].InitParam!=0.) ||
-                (TabCross[Feno->indexOffsetOrder2].InitParam!=0.))) {
-             lambda0=Feno->lambda0;
+               ((TabCross[pFeno->indexOffsetConst].FitParam!=ITEM_NONE) ||
+                (TabCross[pFeno->indexOffsetOrder1].FitParam!=ITEM_NONE) ||
+                (TabCross[pFeno->indexOffsetOrder2].FitParam!=ITEM_NONE) ||
+                (TabCross[pFeno->indexOffsetConst].InitParam!=0.) ||
+                (TabCross[pFeno->indexOffsetOrder1].InitParam!=0.) ||
+                (TabCross[pFeno->indexOffsetOrder2].InitParam!=0.))) {
+             lambda0=pFeno->lambda0;
 
             doas_iterator my_iterator;
-            for (int l=iterator_start(&my_iterator, Feno->fit_properties.specrange); l != ITERATOR_FINISHED; l=iterator_next(&my_iterator)) {
+            for (int l=iterator_start(&my_iterator, pFeno->fit_properties.specrange); l != ITERATOR_FINISHED; l=iterator_next(&my_iterator)) {
               // log(I+offset)=log(I)+log(1+offset/I)
-              newVal = 1.-Feno->xmean*(Results[Feno->indexOffsetConst].Param+
-                                       Results[Feno->indexOffsetOrder1].Param*(ANALYSE_splineX[l]-lambda0)+
-                                       Results[Feno->indexOffsetOrder2].Param*(ANALYSE_splineX[l]-lambda0)*(ANALYSE_splineX[l]-lambda0))/Spectre[l];
+              newVal = 1.-pFeno->xmean*(Results[pFeno->indexOffsetConst].Param+
+                                       Results[pFeno->indexOffsetOrder1].Param*(ws->splineX[l]-lambda0)+
+                                       Results[pFeno->indexOffsetOrder2].Param*(ws->splineX[l]-lambda0)*(ws->splineX[l]-lambda0))/Spectre[l];
 
-              ANALYSE_absolu[l]+=(newVal > 0. ? log(newVal) : 0. )-ANALYSE_secX[l];
-              ANALYSE_secX[l]=newVal > 0. ? log(newVal) : 0.;
+              ws->absolu[l]+=(newVal > 0. ? log(newVal) : 0. )-ws->secX[l];
+              ws->secX[l]=newVal > 0. ? log(newVal) : 0.;
             }
 
-            double *curves[2][2] = {{Feno->LambdaK, ANALYSE_absolu},
-                                    {Feno->LambdaK, ANALYSE_secX}};
-            plot_curves(indexPage,curves,2,Residual,allowFixedScale,"Offset", responseHandle, Feno->fit_properties.specrange);
+            double *curves[2][2] = {{pFeno->LambdaK, ws->absolu},
+                                    {pFeno->LambdaK, ws->secX}};
+            plot_curves(indexPage,curves,2,Residual,allowFixedScale,"Offset", responseHandle, pFeno->fit_properties.specrange);
           }
 
           // Display fits
 
-          for (int i=0;i<Feno->NTabCross;i++) {
+          for (int i=0;i<pFeno->NTabCross;i++) {
             if (TabCross[i].IndSvdA) {
               if (((WorkSpace[TabCross[i].Comp].type==WRK_SYMBOL_CROSS) ||
                    (WorkSpace[TabCross[i].Comp].type==WRK_SYMBOL_PREDEFINED)) &&
-                  Feno->displayFits && TabCross[i].display) {
+                  pFeno->displayFits && TabCross[i].display) {
 
                 doas_iterator my_iterator;
-                for (int k=1,l=iterator_start(&my_iterator, Feno->fit_properties.specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator)) {
-                  newVal=x[TabCross[i].IndSvdA]*Feno->fit_properties.A[TabCross[i].IndSvdA][k];
-                  ANALYSE_absolu[l]+=newVal-ANALYSE_secX[l];
-                  ANALYSE_secX[l]=newVal;
+                for (int k=1,l=iterator_start(&my_iterator, pFeno->fit_properties.specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator)) {
+                  newVal=ws->x[TabCross[i].IndSvdA]*pFeno->fit_properties.A[TabCross[i].IndSvdA][k];
+                  ws->absolu[l]+=newVal-ws->secX[l];
+                  ws->secX[l]=newVal;
                 }
 
                 sprintf(graphTitle,"%s (%.2le)",WorkSpace[TabCross[i].Comp].symbolName,Results[i].SlntCol);
-                double *curves[2][2] = {{Feno->LambdaK, ANALYSE_absolu},
-                                        {Feno->LambdaK, ANALYSE_secX}};
-                plot_curves(indexPage,curves,2,Residual,allowFixedScale,graphTitle, responseHandle, Feno->fit_properties.specrange);
+                double *curves[2][2] = {{pFeno->LambdaK, ws->absolu},
+                                        {pFeno->LambdaK, ws->secX}};
+                plot_curves(indexPage,curves,2,Residual,allowFixedScale,graphTitle, responseHandle, pFeno->fit_properties.specrange);
 
-              } else if ((WorkSpace[TabCross[i].Comp].type==WRK_SYMBOL_CONTINUOUS) && Feno->displayTrend) {
+              } else if ((WorkSpace[TabCross[i].Comp].type==WRK_SYMBOL_CONTINUOUS) && pFeno->displayTrend) {
 
                 doas_iterator my_iterator;
                 if ((tolower(WorkSpace[TabCross[i].Comp].symbolName[0])=='x') ||
                     (tolower(WorkSpace[TabCross[i].Comp].symbolName[2])=='x')) { // polynomial
-                  for (int k=1,l=iterator_start(&my_iterator, Feno->fit_properties.specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
-                    Trend[l]+=x[TabCross[i].IndSvdA]*Feno->fit_properties.A[TabCross[i].IndSvdA][k];
+                  for (int k=1,l=iterator_start(&my_iterator, pFeno->fit_properties.specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
+                    Trend[l]+=ws->x[TabCross[i].IndSvdA]*pFeno->fit_properties.A[TabCross[i].IndSvdA][k];
                 } else if (!strncmp( WorkSpace[TabCross[i].Comp].symbolName, "offl", 4) ) { // linear offset
-                  for (int k=1,l=iterator_start(&my_iterator, Feno->fit_properties.specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
-                    offset[l]+=x[TabCross[i].IndSvdA]*Feno->fit_properties.A[TabCross[i].IndSvdA][k];
+                  for (int k=1,l=iterator_start(&my_iterator, pFeno->fit_properties.specrange); l != ITERATOR_FINISHED; k++,l=iterator_next(&my_iterator))
+                    offset[l]+=ws->x[TabCross[i].IndSvdA]*pFeno->fit_properties.A[TabCross[i].IndSvdA][k];
 
-                  for (int l=iterator_start(&my_iterator, Feno->fit_properties.specrange); l != ITERATOR_FINISHED; l=iterator_next(&my_iterator))
+                  for (int l=iterator_start(&my_iterator, pFeno->fit_properties.specrange); l != ITERATOR_FINISHED; l=iterator_next(&my_iterator))
                     if (fabs(offset[l])>maxOffset)
                       maxOffset=fabs(offset[l]);
                 }
@@ -4245,40 +4966,40 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
 
           // Display Trend
 
-          if (Feno->displayTrend) {
+          if (pFeno->displayTrend) {
             doas_iterator my_iterator;
-            for (int l=iterator_start(&my_iterator, Feno->fit_properties.specrange); l != ITERATOR_FINISHED; l=iterator_next(&my_iterator))
-             ANALYSE_absolu[l]+=Trend[l]-ANALYSE_secX[l];
+            for (int l=iterator_start(&my_iterator, pFeno->fit_properties.specrange); l != ITERATOR_FINISHED; l=iterator_next(&my_iterator))
+             ws->absolu[l]+=Trend[l]-ws->secX[l];
 
-            double *curves[2][2] = {{Feno->LambdaK,ANALYSE_absolu},
-                                    {Feno->LambdaK,Trend}};
-            plot_curves(indexPage,curves,2,Residual,allowFixedScale,"Polynomial", responseHandle, Feno->fit_properties.specrange);
+            double *curves[2][2] = {{pFeno->LambdaK,ws->absolu},
+                                    {pFeno->LambdaK,Trend}};
+            plot_curves(indexPage,curves,2,Residual,allowFixedScale,"Polynomial", responseHandle, pFeno->fit_properties.specrange);
 
             if (maxOffset > 0.) {
               doas_iterator my_iterator;
-              if (Feno->analysisMethod==INTENSITY_FIT)
-               for (int l=iterator_start(&my_iterator, Feno->fit_properties.specrange); l != ITERATOR_FINISHED; l=iterator_next(&my_iterator))
+              if (pFeno->analysisMethod==INTENSITY_FIT)
+               for (int l=iterator_start(&my_iterator, pFeno->fit_properties.specrange); l != ITERATOR_FINISHED; l=iterator_next(&my_iterator))
                 offset[l]=-offset[l];           // inverse the sign in order to have the same display as in SVD method
 
 
-              for (int l=iterator_start(&my_iterator, Feno->fit_properties.specrange); l != ITERATOR_FINISHED; l=iterator_next(&my_iterator))
-               ANALYSE_absolu[l]+=offset[l]-Trend[l];
+              for (int l=iterator_start(&my_iterator, pFeno->fit_properties.specrange); l != ITERATOR_FINISHED; l=iterator_next(&my_iterator))
+               ws->absolu[l]+=offset[l]-Trend[l];
 
-              double *curves[2][2] = {{Feno->LambdaK, ANALYSE_absolu},
-                                      {Feno->LambdaK, offset}};
-              plot_curves(indexPage, curves, 2, Residual, allowFixedScale, "Linear offset",responseHandle, Feno->fit_properties.specrange);
+              double *curves[2][2] = {{pFeno->LambdaK, ws->absolu},
+                                      {pFeno->LambdaK, offset}};
+              plot_curves(indexPage, curves, 2, Residual, allowFixedScale, "Linear offset",responseHandle, pFeno->fit_properties.specrange);
             }
           }  // end displayTrend
 
          SKIP_PLOTS:
 
-          if (!Feno->rc)
+          if (!pFeno->rc)
            nrc++;
           else
            irc++;
 
           if (displayFlag && saveFlag) {
-            indexLine = Feno->displayLineIndex;
+            indexLine = pFeno->displayLineIndex;
             indexColumn=2;
 
             mediateResponseCellDataString(indexPage,indexLine,indexColumn,tabTitle,responseHandle);
@@ -4288,21 +5009,21 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
              mediateResponseCellInfoNoLabel(indexPage,indexLine,indexColumn,responseHandle,
                                             "Spike removal: the following pixels were excluded after %d iterations",num_repeats_spikes);
              for (i = 0; i< n_wavel; i++)
-              if(Feno->spikes[i])
+              if(pFeno->spikes[i])
                mediateResponseCellInfoNoLabel(indexPage,indexLine++,indexColumn+1, responseHandle,"%d",i);
 
              indexLine++;
             }
 
-            if (Feno->molecularCorrection)
+            if (pFeno->molecularCorrection)
              {
               mediateResponseCellInfoNoLabel(indexPage,indexLine++,indexColumn,responseHandle,
                                             "Molecular ring processed in %d iterations",num_repeats_ring-1);
               indexLine++;
              }
 
-            mediateResponseCellInfo(indexPage,indexLine++,indexColumn,responseHandle,"OD ChiSquare","%.5le",Feno->chiSquare);
-            mediateResponseCellInfo(indexPage,indexLine++,indexColumn,responseHandle,"RMS Residual","%.5le",Feno->RMS);
+            mediateResponseCellInfo(indexPage,indexLine++,indexColumn,responseHandle,"OD ChiSquare","%.5le",pFeno->chiSquare);
+            mediateResponseCellInfo(indexPage,indexLine++,indexColumn,responseHandle,"RMS Residual","%.5le",pFeno->RMS);
             mediateResponseCellInfo(indexPage,indexLine,indexColumn,responseHandle,"Iterations","%d",Niter);
 
             indexLine+=2;
@@ -4313,7 +5034,7 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
 
             indexLine++;
 
-            for (i=0;i<Feno->NTabCross;i++) {
+            for (i=0;i<pFeno->NTabCross;i++) {
               mediateResponseCellDataString(indexPage,indexLine,indexColumn,WorkSpace[TabCross[i].Comp].symbolName,responseHandle);
               // -------------------------------------------------------------------
               if (TabCross[i].IndSvdA)
@@ -4338,12 +5059,12 @@ RC ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
 
           // Recover spectral window limits and gaps which were possibly modified after spike removal
         restore_specrange:
-          if (!spectrum_isequal(old_range,Feno->fit_properties.specrange)) {
+          if (!spectrum_isequal(old_range,pFeno->fit_properties.specrange)) {
             //AnalyseCopyFenetre(Feno->fit_properties.Fenetre,&Feno->fit_properties.Z,oldFenetre,oldZ);
-            spectrum_destroy(Feno->fit_properties.specrange);
-            Feno->fit_properties.specrange = old_range;
-            Feno->fit_properties.DimL = spectrum_length(Feno->fit_properties.specrange);
-            Feno->Decomp = 1;
+            spectrum_destroy(pFeno->fit_properties.specrange);
+            pFeno->fit_properties.specrange = old_range;
+            pFeno->fit_properties.DimL = spectrum_length(pFeno->fit_properties.specrange);
+            pFeno->Decomp = 1;
           } else {
             spectrum_destroy(old_range);
           }
@@ -4434,12 +5155,24 @@ void ANALYSE_ResetData(void)
     ANALYSE_plFilter->filterFunction=NULL;
    }
 
+  if (ANALYSE_plFilter->composedFunction!=NULL)
+   {
+    MEMORY_ReleaseDVector(__func__,"FILTER_composedFunction",ANALYSE_plFilter->composedFunction,1);
+    ANALYSE_plFilter->composedFunction=NULL;
+   }
+
   if (ANALYSE_phFilter->filterFunction!=NULL)
    {
     MEMORY_ReleaseDVector(__func__,"FILTER_function",ANALYSE_phFilter->filterFunction,1);
     ANALYSE_phFilter->filterFunction=NULL;
    }
 
+  if (ANALYSE_phFilter->composedFunction!=NULL)
+   {
+    MEMORY_ReleaseDVector(__func__,"FILTER_composedFunction",ANALYSE_phFilter->composedFunction,1);
+    ANALYSE_phFilter->composedFunction=NULL;
+   }
+
   // List of all symbols in a project
 
   for (indexWorkSpace=0;indexWorkSpace<NWorkSpace;indexWorkSpace++)
@@ -4487,6 +5220,8 @@ void ANALYSE_ResetData(void)
        MEMORY_ReleaseDVector(__func__,"Deriv2RadAsRef2",pTabFeno->Deriv2RadAsRef2,0);
       if (pTabFeno->residualSpectrum!=NULL)
        MEMORY_ReleaseDVector(__func__,"residualSpectrum",pTabFeno->residualSpectrum,0); 
+      if (pTabFeno->warmStartParams!=NULL)
+       MEMORY_ReleaseDVector(__func__,"warmStartParams",pTabFeno->warmStartParams,0);
 
       // SVD matrices
 
@@ -4631,68 +5366,16 @@ void ANALYSE_ResetData(void)
 
   // Release global buffers
 
-  if (Fitp!=NULL)
-   MEMORY_ReleaseDVector(__func__,"Fitp",Fitp,0);
-  if (FitDeltap!=NULL)
-   MEMORY_ReleaseDVector(__func__,"FitDeltap",FitDeltap,0);
-  if (FitMinp!=NULL)
-   MEMORY_ReleaseDVector(__func__,"FitMinp",FitMinp,0);
-  if (FitMaxp!=NULL)
-   MEMORY_ReleaseDVector(__func__,"FitMaxp",FitMaxp,0);
-  if (a!=NULL)
-   MEMORY_ReleaseDVector(__func__,"a",a,1);
-  if (b!=NULL)
-   MEMORY_ReleaseDVector(__func__,"b",b,1);
-  if (x!=NULL)
-   MEMORY_ReleaseDVector(__func__,"x",x,0);
-  if (Sigma!=NULL)
-   MEMORY_ReleaseDVector(__func__,"Sigma",Sigma,0);
-  if (ANALYSE_shift!=NULL)
-   MEMORY_ReleaseDVector(__func__,"ANALYSE_shift",ANALYSE_shift,0);
+  ANALYSE_WorkspaceFree(&ANALYSE_mainWorkspace);
+
   if (ANALYSE_pixels!=NULL)
    MEMORY_ReleaseDVector(__func__,"ANALYSE_pixels",ANALYSE_pixels,0);
-  if (ANALYSE_splineX!=NULL)
-   MEMORY_ReleaseDVector(__func__,"ANALYSE_splineX",ANALYSE_splineX,0);
-  if (ANALYSE_absolu!=NULL)
-   MEMORY_ReleaseDVector(__func__,"ANALYSE_absolu",ANALYSE_absolu,0);
-  if (ANALYSE_t!=NULL)
-   MEMORY_ReleaseDVector(__func__,"ANALYSE_t",ANALYSE_t,0);
-  if (ANALYSE_tc!=NULL)
-   MEMORY_ReleaseDVector(__func__,"ANALYSE_tc",ANALYSE_tc,0);
-  if (ANALYSE_xsTrav!=NULL)
-   MEMORY_ReleaseDVector(__func__,"ANALYSE_xsTrav",ANALYSE_xsTrav,0);
-  if (ANALYSE_xsTrav2!=NULL)
-   MEMORY_ReleaseDVector(__func__,"ANALYSE_xsTrav2",ANALYSE_xsTrav2,0);
-  if (ANALYSE_secX!=NULL)
-   MEMORY_ReleaseDVector(__func__,"ANALYSE_secX",ANALYSE_secX,0);
-  if (SplineSpec!=NULL)
-   MEMORY_ReleaseDVector(__func__,"SplineSpec",SplineSpec,0);
-  if (SplineRef!=NULL)
-   MEMORY_ReleaseDVector(__func__,"SplineRef",SplineRef,0);
   if (ANALYSE_zeros!=NULL)
    MEMORY_ReleaseDVector(__func__,"ANALYSE_zeros",ANALYSE_zeros,0);
   if (ANALYSE_ones!=NULL)
    MEMORY_ReleaseDVector(__func__,"ANALYSE_ones",ANALYSE_ones,0);
 
-  Fitp=
-    FitDeltap=
-    FitMinp=
-    FitMaxp=
-    a=
-    b=
-    x=
-    Sigma=
-    ANALYSE_shift=
-    ANALYSE_pixels=
-    ANALYSE_splineX=
-    ANALYSE_absolu=
-    ANALYSE_secX=
-    ANALYSE_t=
-    ANALYSE_tc=
-    ANALYSE_xsTrav=
-    ANALYSE_xsTrav2=
-    SplineSpec=
-    SplineRef=
+  ANALYSE_pixels=
     ANALYSE_zeros=
     ANALYSE_ones=NULL;
 
@@ -6302,6 +6985,7 @@ RC ANALYSE_SetInit(ENGINE_CONTEXT *pEngineContext)
   ANALYSE_phFilter=&pEngineContext->project.hfilter;
 
   ANALYSE_plFilter->filterFunction=ANALYSE_phFilter->filterFunction=NULL;
+  ANALYSE_plFilter->composedFunction=ANALYSE_phFilter->composedFunction=NULL;
   ANALYSE_plFilter->filterSize=ANALYSE_phFilter->filterSize=0;
   ANALYSE_plFilter->filterEffWidth=ANALYSE_phFilter->filterEffWidth=1.;
 
@@ -6434,11 +7118,13 @@ void ANALYSE_Free(void)
 
 
 // -----------------------------------------------------------------------------
-// FUNCTION      ANALYSE_UsampBuild
+// FUNCTION      AnalyseUsampBuild
 // -----------------------------------------------------------------------------
 // PURPOSE       Build undersampling cross sections during analysis process.
 //
-// INPUT         analysisFlag :
+// INPUT         ws : workspace of the current fit (analysisFlag 2 only)
+//
+//               analysisFlag :
 //
 //                   0 : file reference selection mode
 //                   1 : automatic reference selection mode
@@ -6485,7 +7171,7 @@ void ANALYSE_Free(void)
 //               between Ref2 and Ref1;
 //               so this function is called after ANALYSE_Spectrum.
 // -----------------------------------------------------------------------------
-RC ANALYSE_UsampBuild(int analysisFlag,int gomeFlag,int indexFenoColumn)
+static RC AnalyseUsampBuild(const struct analysis_workspace *ws,int analysisFlag,int gomeFlag,int indexFenoColumn)
 {
   // Declarations
 
@@ -6536,7 +7222,7 @@ RC ANALYSE_UsampBuild(int analysisFlag,int gomeFlag,int indexFenoColumn)
          ((gomeFlag==ITEM_NONE) || (pTabFeno->gomeRefFlag==gomeFlag)) &&
          (((analysisFlag==0) && (pTabFeno->refSpectrumSelectionMode==ANLYS_REF_SELECTION_MODE_FILE) && (pUsamp->method==PRJCT_USAMP_FIXED)) ||
           ((analysisFlag==1) && (pTabFeno->refSpectrumSelectionMode==ANLYS_REF_SELECTION_MODE_AUTOMATIC) && (pUsamp->method==PRJCT_USAMP_FIXED)) ||
-          ((analysisFlag==2) && (pTabFeno==Feno))))
+          ((analysisFlag==2) && (pTabFeno==ws->feno))))
       {
        // Build lambda for second phase
 
@@ -6561,7 +7247,7 @@ RC ANALYSE_UsampBuild(int analysisFlag,int gomeFlag,int indexFenoColumn)
         for (i=indexPixMin+1,lambda2[indexPixMin]=lambda[indexPixMin]-pUsamp->phase;i<indexPixMax;i++)
          lambda2[i]=lambda[i]-pUsamp->phase; //  (double)(1.-pUsamp->phase)*lambda[i-1]+pUsamp->phase*lambda[i];
        else
-        memcpy(lambda2,ANALYSE_shift,sizeof(double)*pTabFeno->NDET);
+        memcpy(lambda2,ws->shift,sizeof(double)*pTabFeno->NDET);
 
        // Not allowed combinations :
        //
@@ -6688,6 +7374,18 @@ RC ANALYSE_UsampBuild(int analysisFlag,int gomeFlag,int indexFenoColumn)
   return rc;
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      ANALYSE_UsampBuild
+// -----------------------------------------------------------------------------
+// PURPOSE       Build undersampling cross sections outside a fit (see
+//               AnalyseUsampBuild for the combinations of flags).
+// -----------------------------------------------------------------------------
+
+RC ANALYSE_UsampBuild(int analysisFlag,int gomeFlag,int indexFenoColumn)
+{
+  return AnalyseUsampBuild(&ANALYSE_mainWorkspace,analysisFlag,gomeFlag,indexFenoColumn);
+}
+
 // ==================
 // BUFFERS ALLOCATION
 // ==================
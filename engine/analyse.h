@@ -234,6 +234,9 @@ struct _feno {
                   RMS;
   char           *ref_description;                                              // string describing spectra used in automatic reference.
   int             nIter;                                                        // number of iterations
+  double         *warmStartParams;                                              // non linear parameters of the last converged fit of the window for this row (see ANALYSE_SetWarmStart)
+  double          warmStartChisqr;                                              // chi square of this fit
+  int             warmStartN;                                                   // number of parameters in warmStartParams, 0 to start the next fit from the initial values
   int             Decomp;                                                       // force SVD decomposition
   struct  fit_properties fit_properties;
   CROSS_REFERENCE TabCross[MAX_FIT];                                            // symbol cross reference
@@ -290,7 +293,46 @@ struct _feno {
 };
 #pragma pack(pop)
 
-extern FENO         **TabFeno,*Feno;
+extern FENO         **TabFeno;
+
+// Per-fit analysis state.  Everything ANALYSE_SvdInit, ANALYSE_CurFitMethod
+// and ANALYSE_Function read or write while fitting one analysis window lives
+// here, so that several windows (e.g. different detector rows) can be fitted
+// concurrently, each one with its own workspace.
+
+struct analysis_workspace {
+  FENO           *feno;                                                         // analysis window being fitted
+  doas_spectrum  *specrange;                                                    // spectral ranges of the current fit
+  int             size;                                                         // number of pixels the buffers have been allocated for
+  int             svdPDeb,svdPFin,                                              // analysis window limits
+                  limMin,limMax,limN;                                           // analysis window limits extended by the filter/security gap
+  int             nOrtho,                                                       // number of cross sections in the orthogonal base
+                 *orthoSet;                                                     // cross sections in the orthogonal base
+  int             hFilterSpecLog,hFilterRefLog;                                 // flags set when the logarithm of spectrum/reference has been high-pass filtered
+  double          nFree;                                                        // number of free degrees
+  double          stretchFact1,stretchFact2;                                    // normalization factors for stretch orders 1 and 2
+  double          square;                                                       // chi square of the last fit
+  double          zm,tdet;                                                      // solar zenith angle and detector temperature of the current record
+  double         *lambda,                                                       // wavelength calibration of the reference (not allocated)
+                 *lambdaSpec,                                                   // wavelength calibration of the spectrum (not allocated)
+                 *splineX,                                                      // abscissa used for spectra, in the units selected by user
+                 *absolu,                                                       // residual spectrum
+                 *secX,                                                         // residual spectrum + the contribution of a cross section for fit display
+                 *t,                                                            // residual transmission in Marquardt-Levenberg not linear method
+                 *tc,                                                           // residual transmission in Marquardt-Levenberg not linear method
+                 *xsTrav,                                                       // temporary buffer for processing on cross sections
+                 *xsTrav2,                                                      // cross sections second derivatives
+                 *shift,                                                        // shifted and stretched wavelength grid
+                 *splineSpec,                                                   // second derivatives of the spectrum
+                 *splineRef,                                                    // second derivatives of the reference
+                 *fitp,*fitDeltap,*fitMinp,*fitMaxp,                            // non linear parameters : initial values, steps and bounds
+                 *b,                                                            // right-hand side of the linear system
+                 *x,*sigma;                                                     // linear fit results and their errors
+  MEMORY_ARENA    scratch;                                                      // temporary vectors of ANALYSE_Function and the derivatives
+  struct curfit_workers *curfitWorkers;                                         // buffers of the numeric derivatives evaluated in parallel (see curfit.c)
+};
+
+extern struct analysis_workspace ANALYSE_mainWorkspace;                         // workspace used by the sequential processing
 
 extern int    ANALYSE_plotKurucz,ANALYSE_plotRef,ANALYSE_indexLine;
 extern int    ANALYSE_swathSize;
@@ -300,19 +342,10 @@ extern char *ANLYS_amf[ANLYS_AMF_TYPE_MAX];
 
 extern PRJCT_FILTER *ANALYSE_plFilter,*ANALYSE_phFilter;
 extern MATRIX_OBJECT ANALYSIS_slitMatrix[NSFP],O3TD;
-extern double *x,*Lambda,*LambdaSpec,
-                    ANALYSIS_slitParam[NSFP],
+extern double ANALYSIS_slitParam[NSFP],
                     *ANALYSE_pixels,
-                    *ANALYSE_splineX,              // abscissa used for spectra, in the units selected by user
-                    *ANALYSE_absolu,               // residual spectrum
-                    *ANALYSE_secX,                 // residual spectrum + the contribution of a cross section for fit display
-                    *ANALYSE_t,                    // residual transmission in Marquadt-Levenberg not linear method
-                    *ANALYSE_tc,                   // residual transmission in Marquadt-Levenberg not linear method
-                    *ANALYSE_xsTrav,
-                    *ANALYSE_shift,
                     *ANALYSE_zeros,
-                    *ANALYSE_ones,
-  ANALYSE_nFree;
+                    *ANALYSE_ones;
 
 // ----------
 // PROTOTYPES
@@ -320,8 +353,10 @@ extern double *x,*Lambda,*LambdaSpec,
 
 void ANALYSE_InitResults(void);
 
-RC ANALYSE_Function (double *X, double *Y, const double *SigmaY, double *Yfit, int Npts,
+RC ANALYSE_Function (struct analysis_workspace *ws,double *X, double *Y, const double *SigmaY, double *Yfit, int Npts,
                       double *fitParamsC, double *fitParamsF,INDEX indexFenoColumn, struct fit_properties *fitprops);
+RC   ANALYSE_FunctionDeriv(struct analysis_workspace *ws,const double *spectrum_orig,const double *reference,const double *SigmaY,int Npts,
+                           const double *fitParamsF,INDEX indexFenoColumn,const struct fit_properties *fitprops,double **deriv,int *analytic);
 RC   ANALYSE_CheckLambda(WRK_SYMBOL *pWrkSymbol, const double *lambda, const int n_wavel);
 RC   ANALYSE_XsInterpolation(FENO *pTabFeno, const double *newLambda,INDEX indexFenoColumn);
 RC   ANALYSE_ConvoluteXs(const FENO *pTabFeno,int action,double conc,const MATRIX_OBJECT *pXs,
@@ -329,15 +364,21 @@ RC   ANALYSE_ConvoluteXs(const FENO *pTabFeno,int action,double conc,const MATRI
                          const double *newlambda, double *output, INDEX indexlambdaMin, INDEX indexlambdaMax, const int n_wavel,
                          INDEX indexFenoColumn, int wveDptFlag);
 RC   ANALYSE_XsConvolution(FENO *pTabFeno,double *newLambda,MATRIX_OBJECT *slitMatrix,double *slitParam,int slitType,INDEX indexFenoColumn,int wveDptFlag);
-RC   ANALYSE_SvdInit(FENO *feno, struct fit_properties *fit, const int n_wavel, const double *lambda);
-RC   ANALYSE_CurFitMethod(INDEX indexFenoColumn, const double *Spectre, const double *SigmaSpec, const double *Sref, int n_wavel, double *residuals, double *Chisqr,int *pNiter,double speNormFact,double refNormFact, struct fit_properties *fit);
+RC   ANALYSE_SvdInit(struct analysis_workspace *ws,FENO *feno, struct fit_properties *fit, const int n_wavel, const double *lambda);
+RC   ANALYSE_CurFitMethod(struct analysis_workspace *ws,INDEX indexFenoColumn, const double *Spectre, const double *SigmaSpec, const double *Sref, int n_wavel, double *residuals, double *Chisqr,int *pNiter,double speNormFact,double refNormFact, struct fit_properties *fit);
 void ANALYSE_ResetData(void);
 RC   ANALYSE_SetInit(ENGINE_CONTEXT *pEngineContext);
-RC ANALYSE_fit_shift_stretch(int indexFeno, int indexFenoColumn, const double *spec1, const double *spec2, double *shift, double *stretch, double *stretch2, double *sigma_shift, double *sigma_stretch, double *sigma_stretch2);
-RC   ANALYSE_AlignReference(ENGINE_CONTEXT *pEngineContext,int refFlag,void *responseHandle,INDEX indexFenoColumn);
-RC   ANALYSE_Spectrum(ENGINE_CONTEXT *pEngineContext,void *responseHandle);
+RC ANALYSE_fit_shift_stretch(struct analysis_workspace *ws,int indexFeno, int indexFenoColumn, const double *spec1, const double *spec2, double *shift, double *stretch, double *stretch2, double *sigma_shift, double *sigma_stretch, double *sigma_stretch2);
+RC   ANALYSE_AlignReference(struct analysis_workspace *ws,ENGINE_CONTEXT *pEngineContext,int refFlag,void *responseHandle,INDEX indexFenoColumn);
+RC   ANALYSE_Spectrum(struct analysis_workspace *ws,ENGINE_CONTEXT *pEngineContext,void *responseHandle);
+RC   ANALYSE_WorkspaceAlloc(struct analysis_workspace *ws,int size);
+void ANALYSE_WorkspaceFree(struct analysis_workspace *ws);
+RC   ANALYSE_WorkspaceCopy(struct analysis_workspace *target,const struct analysis_workspace *source);
+void ANALYSE_WorkspaceSync(struct analysis_workspace *target,const struct analysis_workspace *source);
 
 void ANALYSE_SetAnalysisType(INDEX indexFenoColumn);
+void ANALYSE_SetQRUpdate(int enable);
+void ANALYSE_SetWarmStart(int enable);
 RC   ANALYSE_LoadRef(ENGINE_CONTEXT *pEngineContext,INDEX indexFenoColumn);
 RC   ANALYSE_LoadCross(ENGINE_CONTEXT *pEngineContext, const ANALYSIS_CROSS *crossSectionList,int nCross, const double *lambda,INDEX indexFenoColumn);
 RC   ANALYSE_LoadLinear(ANALYSE_LINEAR_PARAMETERS *linearList,int nLinear,INDEX indexFenoColumn);
@@ -364,6 +405,6 @@ enum _pixelSelection {
 
 RC FNPixel (double *lambdaVector, double lambdaValue, int npts,int pixelSelection);
 
-extern double center_pixel_wavelength(int first, int last);
+extern double center_pixel_wavelength(const double *lambda,int first, int last);
 
 #endif
@@ -33,9 +33,13 @@
 //  FILE PROCESSING
 //  ===============
 //
+//  AsciiAddOffset - add the offset of a record to the index of the file;
 //  AsciiSkip - skip a given number of records in ASCII files;
 //  ASCII_Set - set file pointers for ASCII files and get the number of records;
+//  AsciiRead - read a record from the ASCII file (ASCII_Read, ASCII_ReadHeader);
 //  ASCII_Read - read a record from the ASCII file;
+//  ASCII_ReadHeader - read the information on a record without its spectrum;
+//  ASCII_Free - release the buffers allocated for the current file;
 //
 //  ----------------------------------------------------------------------------
 
@@ -65,6 +69,7 @@
 // #define COMMENT_LINE " %1[*;#]%*[^\n]"
 
 #define NEXT_DOUBLE "%lf%*[^0-9.\n\r-]"
+#define SKIP_DOUBLE "%*f%n%*[^0-9.\n\r-]"
 #define NEXT_FLOAT "%f%*[^0-9.\n\r-]"
 #define NEXT_DATE "%d/%d/%d%*[^\n\r0-9.-]"
 #define COMMENT_LINE " %1[*;#]%*[^\n\r]"
@@ -85,6 +90,10 @@ static INDEX asciiLastRecord=ITEM_NONE;
 static INDEX asciiLastDataSet=ITEM_NONE;
 static MATRIX_OBJECT asciiMatrix;
 
+static long *asciiRecordOffset=NULL;                                            // offsets in the file of the records (line format) or data sets (column format)
+static int   asciiRecordOffsetN=0;                                              // number of offsets in the index
+static int   asciiRecordAllocatedSize=0;                                        // number of offsets the index can hold
+
 // ===============
 // FILE PROCESSING
 // ===============
@@ -101,6 +110,59 @@ static inline bool line_ends(FILE *fp) {
   }
 }
 
+// Helper function to pass over the next value in a file (header only reads):
+// same format as NEXT_DOUBLE, returns false if no value could be read
+static inline bool skip_double(FILE *fp) {
+  int n = -1;
+  if (fscanf(fp, SKIP_DOUBLE, &n) == EOF)
+    return false;
+  return (n >= 0);
+}
+
+// -----------------------------------------------------------------------------
+// FUNCTION        AsciiAddOffset
+// -----------------------------------------------------------------------------
+// PURPOSE         add the offset of a record to the index of the file
+//
+// INPUT           offset : the offset of the record in the file
+//
+// RETURN          ERROR_ID_ALLOC if the allocation of the index failed;
+//                 ERROR_ID_NO in case of success.
+// -----------------------------------------------------------------------------
+
+static RC AsciiAddOffset(long offset)
+ {
+  // Declarations
+
+  long *recordOffset;                                                           // the new index
+  int allocatedSize;                                                            // its size
+
+  // The index is full : double its size
+
+  if (asciiRecordOffsetN==asciiRecordAllocatedSize)
+   {
+    allocatedSize=(asciiRecordAllocatedSize)?2*asciiRecordAllocatedSize:1024;
+
+    if ((recordOffset=(long *)MEMORY_AllocBuffer(__func__,"asciiRecordOffset",allocatedSize,sizeof(long),0,MEMORY_TYPE_LONG))==NULL)
+     return ERROR_ID_ALLOC;
+
+    if (asciiRecordOffset!=NULL)
+     {
+      memcpy(recordOffset,asciiRecordOffset,sizeof(long)*asciiRecordOffsetN);
+      MEMORY_ReleaseBuffer(__func__,"asciiRecordOffset",asciiRecordOffset);
+     }
+
+    asciiRecordOffset=recordOffset;
+    asciiRecordAllocatedSize=allocatedSize;
+   }
+
+  asciiRecordOffset[asciiRecordOffsetN++]=offset;
+
+  // Return
+
+  return ERROR_ID_NO;
+ }
+
 // -----------------------------------------------------------------------------
 // FUNCTION        AsciiSkip
 // -----------------------------------------------------------------------------
@@ -112,60 +174,30 @@ static inline bool line_ends(FILE *fp) {
 //
 // RETURN          ERROR_ID_FILE_NOT_FOUND if the input file pointer is NULL;
 //                 ERROR_ID_FILE_END if the end of file is reached;
-//                 ERROR_ID_ALLOC if the allocation of a buffer failed;
 //                 ERROR_ID_NO in case of success.
+//
+// REMARK          the offsets of the records are indexed by ASCII_Set, so the
+//                 file doesn't need to be scanned again from its beginning.
 // -----------------------------------------------------------------------------
 
 RC AsciiSkip(ENGINE_CONTEXT *pEngineContext,FILE *specFp,int nSkip)
  {
   // Declarations
-  int itemCount,recordCount,maxCount;                                           // counters
-  PRJCT_INSTRUMENTAL *pInstr;                                                   // pointer to the instrumental part of the pEngineContext structure
   RC rc;                                                                        // return code
 
   // Initializations
 
-  pInstr=&pEngineContext->project.instrumental;
-  maxCount=NDET[0]+pInstr->ascii.szaSaveFlag+pInstr->ascii.azimSaveFlag+pInstr->ascii.elevSaveFlag+pInstr->ascii.timeSaveFlag+pInstr->ascii.dateSaveFlag;
   rc=ERROR_ID_NO;
 
-  // Buffer allocation
-
   if (specFp==NULL)
    rc=ERROR_ID_FILE_NOT_FOUND;
-  else if (nSkip>=pEngineContext->recordNumber)
+  else if ((nSkip>=pEngineContext->recordNumber) || (nSkip>=asciiRecordOffsetN))
    rc=ERROR_ID_FILE_END;
-  else
 
-  // Skip the nSkip first spectra
-   {
-    fseek(specFp,0L,SEEK_SET);
-    recordCount=0;
-    itemCount=0;
+  // Goto the record following the nSkip first spectra
 
-    char c[2];
-    int n_scan = 0;
-    while (recordCount<nSkip
-           && (n_scan = fscanf(specFp, " %1[^*;#\n\r]%*[^\n\r]", c) ) != EOF ) {
-      if (n_scan == 1) {
-        // no * or ; at start -> line is (part of) a record
-        if (pInstr->ascii.format==PRJCT_INSTR_ASCII_FORMAT_LINE) {
-          // Each line of the file is a spectrum record
-          ++recordCount;
-        } else {
-          // Spectra records are saved in successive columns
-          ++itemCount;
-          if (itemCount == maxCount) {
-            ++recordCount;
-            itemCount=0;
-          }
-        }
-      }
-    }
-    // Reach the end of the file
-    if (recordCount<nSkip)
-      rc=ERROR_ID_FILE_END;
-   }
+  else
+   fseek(specFp,asciiRecordOffset[nSkip],SEEK_SET);
 
   // Return
 
@@ -182,6 +214,9 @@ RC AsciiSkip(ENGINE_CONTEXT *pEngineContext,FILE *specFp,int nSkip)
 //
 // OUTPUT          pEngineContext->recordNumber, the number of records
 //
+// REMARK          the offsets of the records (line format) or of the data sets
+//                 (column format) are indexed for AsciiSkip.
+//
 // RETURN          ERROR_ID_FILE_NOT_FOUND if the input file pointer is NULL;
 //                 ERROR_ID_ALLOC if the allocation of a buffer failed;
 //                 ERROR_ID_NO in case of success.
@@ -191,6 +226,7 @@ RC ASCII_Set(ENGINE_CONTEXT *pEngineContext,FILE *specFp)
  {
   // Declarations
   int itemCount,startCount,maxCount;                                            // counters
+  int lineCount,dataSetSize;                                                    // lines of the current data set (column format)
   PRJCT_INSTRUMENTAL *pInstr;                                                   // pointer to the instrumental part of the pEngineContext structure
   double tempValue;
   int nc;
@@ -205,6 +241,7 @@ RC ASCII_Set(ENGINE_CONTEXT *pEngineContext,FILE *specFp)
   pInstr=&pEngineContext->project.instrumental;
   startCount=pInstr->ascii.szaSaveFlag+pInstr->ascii.azimSaveFlag+pInstr->ascii.elevSaveFlag+pInstr->ascii.timeSaveFlag+pInstr->ascii.dateSaveFlag;
   maxCount=NDET[0];
+  dataSetSize=NDET[0]+startCount;
   rc=ERROR_ID_NO;
   nc=0;
 
@@ -217,11 +254,16 @@ RC ASCII_Set(ENGINE_CONTEXT *pEngineContext,FILE *specFp)
   else {
     // Get the number of records in the file
     fseek(specFp,0L,SEEK_SET);
-    itemCount=0;
+    itemCount=lineCount=0;
+
+    // the first record starts at the beginning of the file, the next ones
+    // after the last line of the previous one
+
+    rc=AsciiAddOffset(0L);
 
     char c[2];
     int n_scan = 0;
-    while ( (n_scan = fscanf(specFp, " %1[^*;#\n\r]", c) ) != EOF) {
+    while (!rc && (n_scan = fscanf(specFp, " %1[^*;#\n\r]", c) ) != EOF) {
       if (n_scan == 0) {
         // commment, ignore and scan ahead until end of line
         fscanf(specFp, "%*[^\n\r]");
@@ -233,6 +275,7 @@ RC ASCII_Set(ENGINE_CONTEXT *pEngineContext,FILE *specFp)
         // Each line of the file is a spectrum record
         pEngineContext->recordNumber++;
         fscanf(specFp, "%*[^\n\r]");
+        rc=AsciiAddOffset(ftell(specFp));
       } else {
         // Spectra records are saved in successive columns
 
@@ -264,6 +307,11 @@ RC ASCII_Set(ENGINE_CONTEXT *pEngineContext,FILE *specFp)
           else
             pEngineContext->recordNumber++;
         }
+
+        if (!rc && (++lineCount==dataSetSize)) {
+          lineCount=0;
+          rc=AsciiAddOffset(ftell(specFp));
+        }
       }
     }
   }
@@ -273,7 +321,7 @@ RC ASCII_Set(ENGINE_CONTEXT *pEngineContext,FILE *specFp)
  }
 
 // -----------------------------------------------------------------------------
-// FUNCTION        ASCII_Read
+// FUNCTION        AsciiRead
 // -----------------------------------------------------------------------------
 // PURPOSE         Read a record from the ASCII file
 //
@@ -283,6 +331,9 @@ RC ASCII_Set(ENGINE_CONTEXT *pEngineContext,FILE *specFp)
 //                 localDay  : if dateFlag is 1, the calendar day for the
 //                             reference spectrum to search for
 //                 specFp    : pointer to the ASCII file
+//                 headerOnly : 1 to skip the read out of the spectrum (its
+//                              values are only counted, the format is checked
+//                              as for a complete read)
 //
 // OUTPUT          information on the read out record
 //
@@ -294,7 +345,7 @@ RC ASCII_Set(ENGINE_CONTEXT *pEngineContext,FILE *specFp)
 //                 ERROR_ID_NO in case of success.
 // -----------------------------------------------------------------------------
 
-RC ASCII_Read(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp)
+static RC AsciiRead(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp,int headerOnly)
  {
   // Declarations
 
@@ -345,7 +396,7 @@ RC ASCII_Read(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int local
     rc=ERROR_ID_FILE_END;
   else if (((ndataSet!=ITEM_NONE) && (ndataSet==asciiLastDataSet)) || (recordNo-asciiLastRecord==1) || !(rc=AsciiSkip(pEngineContext,specFp,(ndataSet!=ITEM_NONE)?ndataSet:recordNo-1)))
    {
-    asciiLastRecord=recordNo;
+    asciiLastRecord=recordNo;                                                   // the spectrum is passed over in header only reads
 
     // ------------------------------------------
     // EACH LINE OF THE FILE IS A SPECTRUM RECORD
@@ -406,12 +457,12 @@ RC ASCII_Read(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int local
           return ERROR_SetLast(__func__,ERROR_TYPE_FATAL,ERROR_ID_FILE_BAD_FORMAT,pEngineContext->fileInfo.fileName);
       }
 
-      // Read the spectrum
+      // Read the spectrum (or only count its values)
       for (i=0; i<n_wavel; ++i) {
         if (line_ends(specFp) )
           return ERROR_SetLast(__func__,ERROR_TYPE_FATAL,ERROR_ID_FILE_BAD_FORMAT,pEngineContext->fileInfo.fileName);
 
-        n_scan = fscanf(specFp,NEXT_DOUBLE,&spectrum[i]);
+        n_scan = (!headerOnly)?fscanf(specFp,NEXT_DOUBLE,&spectrum[i]):skip_double(specFp);
 
         if (n_scan != 1)
           return ERROR_SetLast(__func__,ERROR_TYPE_FATAL,ERROR_ID_FILE_BAD_FORMAT,pEngineContext->fileInfo.fileName);
@@ -469,10 +520,11 @@ RC ASCII_Read(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int local
       if (timeFlag)
         pRecordInfo->TimeDec=asciiMatrix.matrix[ndataRecord][count++];
 
-      if (lambdaFlag)
+      if (lambdaFlag && !headerOnly)
         memcpy(lambda,asciiMatrix.matrix[0]+count,sizeof(double)*n_wavel);
 
-      memcpy(spectrum,asciiMatrix.matrix[ndataRecord]+count,sizeof(double)*n_wavel);
+      if (!headerOnly)
+        memcpy(spectrum,asciiMatrix.matrix[ndataRecord]+count,sizeof(double)*n_wavel);
     } else {
       // Read the solar zenith angle
 
@@ -513,16 +565,16 @@ RC ASCII_Read(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int local
           return ERROR_ID_FILE_END;
       }
 
-      // Read the spectrum and if selected, the wavelength calibration
+      // Read the spectrum and if selected, the wavelength calibration (or only count their lines)
       if (lambdaFlag) {
         // wavelength and spectrum
         for (i=0; i<n_wavel;) {
           if (fscanf(specFp, COMMENT_LINE, c) == 1)
             continue;
           // read two doubles before end of line:
-          if (fscanf(specFp, NEXT_DOUBLE, &lambda[i]) != 1 || line_ends(specFp) )
+          if (((!headerOnly)?fscanf(specFp, NEXT_DOUBLE, &lambda[i]):skip_double(specFp)) != 1 || line_ends(specFp) )
             return ERROR_ID_FILE_END;
-          if (fscanf(specFp, NEXT_DOUBLE, &spectrum[i]) != 1 || !line_ends(specFp) )
+          if (((!headerOnly)?fscanf(specFp, NEXT_DOUBLE, &spectrum[i]):skip_double(specFp)) != 1 || !line_ends(specFp) )
             return ERROR_ID_FILE_END;
           ++i;
         }
@@ -531,7 +583,7 @@ RC ASCII_Read(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int local
         for (i=0; i<n_wavel; ) {
           if (fscanf(specFp, COMMENT_LINE, c) == 1)
             continue;
-          if ((fscanf(specFp,NEXT_DOUBLE,&spectrum[i]) != 1)
+          if ((((!headerOnly)?fscanf(specFp,NEXT_DOUBLE,&spectrum[i]):skip_double(specFp)) != 1)
               || (!line_ends(specFp) && !feof(specFp)) )
             return ERROR_ID_FILE_END;
           ++i;
@@ -579,7 +631,37 @@ RC ASCII_Read(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int local
   return rc;
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION        ASCII_Read
+// -----------------------------------------------------------------------------
+// PURPOSE         Read a record from the ASCII file
+// -----------------------------------------------------------------------------
+
+RC ASCII_Read(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp)
+ {
+  return AsciiRead(pEngineContext,recordNo,dateFlag,localDay,specFp,0);
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION        ASCII_ReadHeader
+// -----------------------------------------------------------------------------
+// PURPOSE         Read the information on a record (date, time, angles)
+//                 without its spectrum; same arguments and return codes as
+//                 ASCII_Read.
+// -----------------------------------------------------------------------------
+
+RC ASCII_ReadHeader(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp)
+ {
+  return AsciiRead(pEngineContext,recordNo,dateFlag,localDay,specFp,1);
+ }
+
 void ASCII_Free(const char *functionStr) {
   MATRIX_Free(&asciiMatrix,functionStr);
   memset(&asciiMatrix,0,sizeof(MATRIX_OBJECT));
+
+  if (asciiRecordOffset!=NULL)
+    MEMORY_ReleaseBuffer(functionStr,"asciiRecordOffset",asciiRecordOffset);
+
+  asciiRecordOffset=NULL;
+  asciiRecordOffsetN=asciiRecordAllocatedSize=0;
 }
@@ -49,6 +49,15 @@ extern "C" {
 // COMPILATION CONTROL
 // ===================
 
+// Storage class of the static variables private to each thread (spectra
+// analysed concurrently, see doas_cl -threads)
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 // ===============
 // INCLUDE HEADERS
 // ===============
@@ -393,6 +402,8 @@ ERROR_DESCRIPTION;
 RC ERROR_DisplayMessage(void *responseHandle);
 RC ERROR_SetLast(const char *callingFunction,int errorType,RC errorId,...);
 RC ERROR_GetLast(ERROR_DESCRIPTION *pError);
+int ERROR_Save(ERROR_DESCRIPTION **pErrors);
+void ERROR_Restore(ERROR_DESCRIPTION *errors,int nErrors);
 bool ERROR_Fatal(void);
 
 // ===============
@@ -402,6 +413,7 @@ bool ERROR_Fatal(void);
 // Constants definition
 
 #define MEMORY_STACK_SIZE        5000                                           // maximum objets allowed in the stack
+#define MEMORY_ALIGNMENT           64                                           // alignment in bytes of the columns of MEMORY_AllocAlignedDMatrix
 
 // type of objects
 
@@ -438,6 +450,16 @@ typedef struct _memory
  }
 MEMORY;
 
+// Scratch arena for temporary vectors (see MEMORY_AllocScratchDVector)
+
+typedef struct _memoryArena
+ {
+  double *buffer;                                                               // the space of the arena
+  int     size;                                                                 // the number of doubles in buffer
+  int     used;                                                                 // the number of doubles currently allocated
+ }
+MEMORY_ARENA;
+
 // Global variables
 
 extern int MEMORY_stackSize;                                                    // the size of the stack of allocated objects
@@ -450,6 +472,14 @@ double  *MEMORY_AllocDVector(const char *callingFunctionName, const char *buffer
 void     MEMORY_ReleaseDVector(const char *callingFunctionName, const char *bufferName,double *v,int nl);
 double **MEMORY_AllocDMatrix(const char *callingFunctionName, const char *bufferName,int nrl,int nrh,int ncl,int nch);
 void     MEMORY_ReleaseDMatrix(const char *callingFunctionName, const char *bufferName,double **m,int ncl,int nrl);
+double **MEMORY_AllocAlignedDMatrix(const char *callingFunctionName, const char *bufferName,int nrl,int nrh,int ncl,int nch,int *pLd);
+void     MEMORY_ReleaseAlignedDMatrix(const char *callingFunctionName, const char *bufferName,double **m,int ncl,int nrl);
+
+RC       MEMORY_AllocArena(const char *callingFunctionName,MEMORY_ARENA *pArena,int size);
+void     MEMORY_ReleaseArena(const char *callingFunctionName,MEMORY_ARENA *pArena);
+MEMORY_ARENA *MEMORY_SelectArena(MEMORY_ARENA *pArena);
+double  *MEMORY_AllocScratchDVector(const char *callingFunctionName, const char *bufferName,int nl,int nh);
+void     MEMORY_ReleaseScratchDVector(const char *callingFunctionName, const char *bufferName,double *v,int nl);
 
 RC       MEMORY_Alloc(void);
 RC       MEMORY_End(void);
@@ -32,12 +32,20 @@
 //  CurfitNumDeriv - evaluate the derivative of a general function to a fitted
 //                   non linear parameter
 //
+//  CurfitNumDerivParallel - evaluate the derivatives of the fitting function to
+//                           several non linear parameters at the same time
+//
 //  CurfitDerivFunc
 //
 //       Evaluate the partial derivatives of the fitting function in non linear parameters.
 //       If possible, derivatives are calculated analytically in order to avoid two evaluations
 //       of the fitting function.
 //
+//  CURFIT_ReleaseWorkers - release the buffers used to evaluate the derivatives
+//                          in parallel
+//
+//  CURFIT_SetThreads - set the number of threads used to evaluate the derivatives
+//
 //  Curfit - make a least-squares fit to a non-linear function with a
 //           linearization of the fitting function
 //
@@ -59,14 +67,21 @@
 #include <string.h>
 #include <stdio.h>
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
 #include "doas.h"
 #include "winthrd.h"
 #include "analyse.h"
+#include "engine_context.h"
 
 #include "curfit.h"
 
 #define CURFIT_MAX_ITER 100
 
+static int curfitThreadsN=1;                                                    // number of threads used to evaluate the numeric derivatives
+
 // -----------------------------------------------------------------------------
 // FUNCTION      Fchisq
 // -----------------------------------------------------------------------------
@@ -314,7 +329,8 @@ RC CurfitMatinv(double **array,int nOrder,double *pDet)
 // PURPOSE       Includes in the error message the name of the parameter
 //               responsible of the error
 //
-// INPUT         indexError - the index of the parameter to search for
+// INPUT         pFeno      - the analysis window being fitted
+//               indexError - the index of the parameter to search for
 //               p, deltap  - the non linear parameters and delta values
 //
 // OUTPUT        string  - the final error message
@@ -322,11 +338,11 @@ RC CurfitMatinv(double **array,int nOrder,double *pDet)
 // RETURN        a pointer to the final error message
 // -----------------------------------------------------------------------------
 
-char *CurfitError(char *string,INDEX indexError,double *p,double *deltap)
+char *CurfitError(const FENO *pFeno,char *string,INDEX indexError,double *p,double *deltap)
  {
      // Declarations
 
-  CROSS_REFERENCE *pTabCross;                                                   // settings of a parameter to fit
+  const CROSS_REFERENCE *pTabCross;                                             // settings of a parameter to fit
   char param[MAX_ITEM_NAME_LEN+1];                                             // the name of the parameter
   INDEX i;                                                                      // browse parameters to fit
 
@@ -337,9 +353,9 @@ char *CurfitError(char *string,INDEX indexError,double *p,double *deltap)
 
   // Browse parameters to fit
 
-  for (i=0;i<Feno->NTabCross;i++)
+  for (i=0;i<pFeno->NTabCross;i++)
    {
-    pTabCross=&Feno->TabCross[i];
+    pTabCross=&pFeno->TabCross[i];
 
     if (pTabCross->FitShift==indexError)
      strcpy(param,"Shift");
@@ -367,7 +383,7 @@ char *CurfitError(char *string,INDEX indexError,double *p,double *deltap)
 // -----------------------------------------------------------------------------
 // PURPOSE       Evaluate the derivative of a general function to a fitted non linear parameter
 //
-// INPUT
+// INPUT         ws      - workspace of the current fit
 //               specX   - the spectrum to evaluate
 //               srefX   - the control spectrum (also called reference spectrum)
 //               n_wavel - the size of previous vectors (depending on the size of the detector)
@@ -385,7 +401,7 @@ char *CurfitError(char *string,INDEX indexError,double *p,double *deltap)
 //               ERROR_ID_NO if successful
 // -----------------------------------------------------------------------------
 
-static RC CurfitNumDeriv(double *specX, double *srefX, const double *sigmaY, int nY, const double *Yfit,
+static RC CurfitNumDeriv(struct analysis_workspace *ws,double *specX, double *srefX, const double *sigmaY, int nY, const double *Yfit,
                          double *P, double *A, double *deltaA,int indexA,double **deriv,INDEX indexFenoColumn, struct fit_properties *fitprops)
  {
   // Declarations
@@ -393,6 +409,7 @@ static RC CurfitNumDeriv(double *specX, double *srefX, const double *sigmaY, int
   int      i;                                                                   // browse pixels
   double  *Yfit2;                                                               // results of the fitting function evaluated for Aj+Dj
   double  *Pj;
+  MEMORY_ARENA *pArena;                                                         // arena previously selected
   RC       rc;                                                                  // return code
 
   #if defined(__DEBUG_) && __DEBUG_
@@ -404,11 +421,13 @@ static RC CurfitNumDeriv(double *specX, double *srefX, const double *sigmaY, int
   // Initializations
 
   rc=ERROR_ID_NO;
+  Yfit2=Pj=NULL;
+  pArena=MEMORY_SelectArena(&ws->scratch);
 
   // Buffers allocation
 
-  if (((Yfit2=MEMORY_AllocDVector(__func__,"Yfit2",0,nY-1))==NULL) ||
-     (nP && ((Pj=MEMORY_AllocDVector(__func__,"Pj",0,nP-1))==NULL)))
+  if (((Yfit2=MEMORY_AllocScratchDVector(__func__,"Yfit2",0,nY-1))==NULL) ||
+     (nP && ((Pj=MEMORY_AllocScratchDVector(__func__,"Pj",0,nP-1))==NULL)))
    {
     
     rc = ERROR_ID_ALLOC;
@@ -428,7 +447,7 @@ static RC CurfitNumDeriv(double *specX, double *srefX, const double *sigmaY, int
 
     A[indexA]=Aj+Dj;
 
-    if ((rc=ANALYSE_Function(specX,srefX,sigmaY,Yfit2,nY,P,A,indexFenoColumn,fitprops))>=THREAD_EVENT_STOP)
+    if ((rc=ANALYSE_Function(ws,specX,srefX,sigmaY,Yfit2,nY,P,A,indexFenoColumn,fitprops))>=THREAD_EVENT_STOP)
      goto EndNumDeriv;
 
      // Calculate the partial derivative of the function for the non linear parameter
@@ -449,10 +468,10 @@ static RC CurfitNumDeriv(double *specX, double *srefX, const double *sigmaY, int
 
   // Release allocated buffer
 
-  if (Yfit2!=NULL)
-   MEMORY_ReleaseDVector(__func__,"Yfit2",Yfit2,0);
-  if (Pj!=NULL)
-   MEMORY_ReleaseDVector(__func__,"Pj",Pj,0);
+  MEMORY_ReleaseScratchDVector(__func__,"Yfit2",Yfit2,0);
+  MEMORY_ReleaseScratchDVector(__func__,"Pj",Pj,0);
+
+  MEMORY_SelectArena(pArena);
 
 #if defined(__DEBUG_) && __DEBUG_
   DEBUG_FunctionStop(__func__,rc);
@@ -461,6 +480,345 @@ static RC CurfitNumDeriv(double *specX, double *srefX, const double *sigmaY, int
   return rc;
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      CurfitNumDerivParallel
+// -----------------------------------------------------------------------------
+// PURPOSE       Evaluate the derivatives of the fitting function to several non
+//               linear parameters at the same time (see CurfitNumDeriv)
+//
+// INPUT         ws        - workspace of the current fit
+//               specX     - the spectrum to evaluate
+//               srefX     - the control spectrum (also called reference spectrum)
+//               sigmaY    - standard deviations for Y data points
+//               nY        - number of data points in Y
+//               Yfit      - vector of calculated values of Y
+//               P         - values of parameters fitted linearly in the fitting function
+//               A         - values of parameters to fit non linearly
+//               deltaA    - increments for non linear parameters in A
+//               indexList - indexes of the non linear parameters selected for the calculation of the derivatives
+//               nDeriv    - the number of indexes in indexList
+//
+// OUTPUT        deriv     - partial derivatives of the function to the selected non linear parameters
+//
+// RETURN        ERROR_ID_NO if successful; any other value if the derivatives have
+//               to be evaluated by CurfitNumDeriv (errors are not registered).
+//
+// REMARK        Each thread evaluates ANALYSE_Function with its own copy of the
+//               workspace, of the analysis window and of the fit properties, so
+//               the derivatives are the same as the ones calculated by
+//               CurfitNumDeriv.  Configurations for which ANALYSE_Function writes
+//               in buffers shared with other analysis windows (real time
+//               convolution, undersampling, Kurucz) are not supported.
+//
+//               The copies are allocated once for the analysis window and kept
+//               in the workspace until the fit of another window or the release
+//               of the workspace (see CURFIT_ReleaseWorkers).  They are updated
+//               at the first evaluation of the derivatives of each fit (see
+//               Curfit); ANALYSE_Function rebuilds the columns of the fit from
+//               the parameters (pFeno->Decomp), so that only the parameters are
+//               copied for the next evaluations.
+// -----------------------------------------------------------------------------
+
+typedef struct _curfitWorker
+ {
+  struct analysis_workspace ws;                                                 // own buffers for the fitting function
+  FENO *pFeno;                                                                  // copy of the analysis window
+  double *vectors[MAX_FIT];                                                     // own vectors for predefined parameters and polynomials
+  struct fit_properties fit;                                                    // own linear system
+  double *Yfit2,*P,*A;                                                          // results and parameters of the fitting function
+ }
+CURFIT_WORKER;
+
+struct curfit_workers
+ {
+  const FENO *pFeno;                                                            // analysis window the workers have been allocated for
+  int n_wavel,nY,nA,DimL,DimC,DimP;                                             // sizes of the buffers of the workers
+  int nWorkers;                                                                 // number of workers
+  int synced;                                                                   // set when the workers have been updated with the state of the current fit
+  unsigned linfitGeneration;                                                    // generation of the fixed columns of the linear system of the fit (see LINEAR_fixed_columns_generation)
+  CURFIT_WORKER *workers;
+ };
+
+static void CurfitWorkerFree(CURFIT_WORKER *pWorker)
+ {
+  for (int i=0;i<MAX_FIT;i++)
+   if (pWorker->vectors[i]!=NULL)
+    MEMORY_ReleaseDVector(__func__,"vectors",pWorker->vectors[i],0);
+
+  pWorker->fit.specrange=NULL;                                                  // shared with the fit of the analysis window
+  if ((pWorker->fit.A!=NULL) || (pWorker->fit.linfit!=NULL))
+   FIT_PROPERTIES_free(__func__,&pWorker->fit);
+
+  if (pWorker->Yfit2!=NULL)
+   MEMORY_ReleaseDVector(__func__,"Yfit2",pWorker->Yfit2,0);
+  if (pWorker->P!=NULL)
+   MEMORY_ReleaseDVector(__func__,"P",pWorker->P,0);
+  if (pWorker->A!=NULL)
+   MEMORY_ReleaseDVector(__func__,"A",pWorker->A,0);
+  if (pWorker->pFeno!=NULL)
+   MEMORY_ReleaseBuffer(__func__,"pFeno",pWorker->pFeno);
+
+  ANALYSE_WorkspaceFree(&pWorker->ws);
+ }
+
+static RC CurfitWorkerAlloc(CURFIT_WORKER *pWorker,struct analysis_workspace *ws,int nY,int nA,struct fit_properties *fitprops)
+ {
+  RC rc=ERROR_ID_NO;
+
+  memset(pWorker,0,sizeof(CURFIT_WORKER));
+
+  pWorker->fit=*fitprops;
+  pWorker->fit.linfit=NULL;
+  pWorker->fit.A=pWorker->fit.P=pWorker->fit.covar=NULL;
+  pWorker->fit.SigmaSqr=NULL;
+
+  if (((pWorker->pFeno=(FENO *)MEMORY_AllocBuffer(__func__,"pFeno",1,sizeof(FENO),0,MEMORY_TYPE_STRUCT))==NULL) ||
+      ((pWorker->Yfit2=MEMORY_AllocDVector(__func__,"Yfit2",0,nY-1))==NULL) ||
+      ((pWorker->P=MEMORY_AllocDVector(__func__,"P",0,fitprops->DimC))==NULL) ||
+      ((pWorker->A=MEMORY_AllocDVector(__func__,"A",0,nA-1))==NULL) ||
+      ((rc=ANALYSE_WorkspaceCopy(&pWorker->ws,ws))!=ERROR_ID_NO) ||
+      ((rc=FIT_PROPERTIES_alloc(__func__,&pWorker->fit))!=ERROR_ID_NO))
+
+   rc=ERROR_ID_ALLOC;
+
+  return rc;
+ }
+
+// Update a worker with the state of the current fit : the analysis window is copied
+// with its list of cross sections; the vectors that ANALYSE_Function recalculates
+// (offsets, polynomials, resol) are duplicated.  The decomposition of the fixed
+// columns kept by the linear system of the worker (doas_cl -qr-update) is
+// forgotten when the one of the fit has been (new spectrum, new errors)
+
+static RC CurfitWorkerSync(CURFIT_WORKER *pWorker,struct analysis_workspace *ws,int n_wavel,struct fit_properties *fitprops,int forgetFixedColumns)
+ {
+  FENO *pFeno=ws->feno;
+  struct fit_properties fit=pWorker->fit;                                       // buffers of the worker
+  RC rc=ERROR_ID_NO;
+
+  if (forgetFixedColumns)
+   LINEAR_forget_fixed_columns(fit.linfit);
+
+  ANALYSE_WorkspaceSync(&pWorker->ws,ws);
+  memcpy(pWorker->pFeno,pFeno,sizeof(FENO));
+  pWorker->ws.feno=pWorker->pFeno;
+
+  for (int i=0;(i<pFeno->NTabCross) && !rc;i++)
+   {
+    CROSS_REFERENCE *pTabCross=&pWorker->pFeno->TabCross[i];
+
+    if ((pTabCross->IndSvdA>0) && (pTabCross->vector!=NULL) && (WorkSpace[pTabCross->Comp].type!=WRK_SYMBOL_CROSS))
+     {
+      if ((pWorker->vectors[i]==NULL) &&
+          ((pWorker->vectors[i]=MEMORY_AllocDVector(__func__,"vectors",0,n_wavel-1))==NULL))
+       rc=ERROR_ID_ALLOC;
+      else
+       {
+        memcpy(pWorker->vectors[i],pTabCross->vector,sizeof(double)*n_wavel);
+        pTabCross->vector=pWorker->vectors[i];
+       }
+     }
+   }
+
+  pWorker->fit=*fitprops;
+  pWorker->fit.linfit=fit.linfit;
+  pWorker->fit.A=fit.A;
+  pWorker->fit.P=fit.P;
+  pWorker->fit.ldA=fit.ldA;
+  pWorker->fit.ldP=fit.ldP;
+  pWorker->fit.covar=fit.covar;
+  pWorker->fit.SigmaSqr=fit.SigmaSqr;
+
+  for (int j=0;(j<=fitprops->DimC) && !rc;j++)
+   memcpy(&pWorker->fit.A[j][1],&fitprops->A[j][1],sizeof(double)*fitprops->DimL);
+  for (int j=0;(j<=fitprops->DimP) && (fitprops->P!=NULL) && !rc;j++)
+   memcpy(&pWorker->fit.P[j][1],&fitprops->P[j][1],sizeof(double)*fitprops->DimL);
+
+  return rc;
+ }
+
+// Get the workers of the workspace, allocated again if the analysis window or the
+// sizes of the fit changed and updated once per fit
+
+static RC CurfitGetWorkers(struct analysis_workspace *ws,int nWorkers,int nY,int nA,INDEX indexFenoColumn,struct fit_properties *fitprops,CURFIT_WORKER **pWorkers)
+ {
+  struct curfit_workers *pCache=ws->curfitWorkers;
+  int n_wavel=NDET[indexFenoColumn];
+  RC rc=ERROR_ID_NO;
+
+  if ((pCache==NULL) || (pCache->pFeno!=ws->feno) || (pCache->nWorkers<nWorkers) ||
+      (pCache->n_wavel!=n_wavel) || (pCache->nY!=nY) || (pCache->nA!=nA) ||
+      (pCache->DimL!=fitprops->DimL) || (pCache->DimC!=fitprops->DimC) || (pCache->DimP!=fitprops->DimP))
+   {
+    CURFIT_ReleaseWorkers(ws);
+
+    if (((pCache=(struct curfit_workers *)MEMORY_AllocBuffer(__func__,"curfitWorkers",1,sizeof(struct curfit_workers),0,MEMORY_TYPE_STRUCT))==NULL) ||
+        ((pCache->workers=(CURFIT_WORKER *)MEMORY_AllocBuffer(__func__,"workers",nWorkers,sizeof(CURFIT_WORKER),0,MEMORY_TYPE_STRUCT))==NULL))
+     {
+      if (pCache!=NULL)
+       MEMORY_ReleaseBuffer(__func__,"curfitWorkers",pCache);
+      return ERROR_ID_ALLOC;
+     }
+
+    memset(pCache->workers,0,sizeof(CURFIT_WORKER)*nWorkers);
+
+    pCache->pFeno=ws->feno;
+    pCache->n_wavel=n_wavel;
+    pCache->nY=nY;
+    pCache->nA=nA;
+    pCache->DimL=fitprops->DimL;
+    pCache->DimC=fitprops->DimC;
+    pCache->DimP=fitprops->DimP;
+    pCache->nWorkers=nWorkers;
+    pCache->synced=0;
+    pCache->linfitGeneration=LINEAR_fixed_columns_generation(fitprops->linfit);
+
+    ws->curfitWorkers=pCache;
+
+    for (int k=0;(k<nWorkers) && !rc;k++)
+     rc=CurfitWorkerAlloc(&pCache->workers[k],ws,nY,nA,fitprops);
+   }
+
+  unsigned linfitGeneration=LINEAR_fixed_columns_generation(fitprops->linfit);
+
+  for (int k=0;(k<nWorkers) && !pCache->synced && !rc;k++)
+   rc=CurfitWorkerSync(&pCache->workers[k],ws,n_wavel,fitprops,(linfitGeneration!=pCache->linfitGeneration)?1:0);
+
+  pCache->linfitGeneration=linfitGeneration;
+  pCache->synced=1;
+
+  if (rc)
+   CURFIT_ReleaseWorkers(ws);
+  else
+   *pWorkers=pCache->workers;
+
+  return rc;
+ }
+
+static RC CurfitNumDerivParallel(struct analysis_workspace *ws,double *specX, double *srefX, double *sigmaY, int nY, const double *Yfit,
+                                 double *P, double *A, double *deltaA,const int *indexList,int nDeriv,double **deriv,INDEX indexFenoColumn,
+                                 struct fit_properties *fitprops)
+ {
+  // Declarations
+
+  FENO *pFeno=ws->feno;
+  CURFIT_WORKER *workers;
+  ERROR_DESCRIPTION *pendingErrors;
+  int nA,nP,nWorkers,nPendingErrors;
+  double lastP;
+  RC rc;
+
+  #if defined(_OPENMP)
+  if (omp_in_parallel())                                                        // the fits are already run at the same time (see KURUCZ_Spectrum)
+   return ERROR_ID_OPTIONS;
+  #endif
+
+  // Check that ANALYSE_Function only modifies the workspace, the analysis window and the fit properties
+
+  if (!pFeno->Decomp ||
+      ((pFeno->hidden==1) && pFeno->xsToConvolute && pKuruczOptions->fwhmFit) ||
+      (pFeno->analysisType==ANALYSIS_TYPE_FWHM_KURUCZ) ||
+      (pFeno->useUsamp && (pUsamp->method==PRJCT_USAMP_AUTOMATIC)))
+
+   return ERROR_ID_OPTIONS;
+
+  // Initializations
+
+  nA=fitprops->NF;
+  nP=fitprops->DimC;
+  nWorkers=min(curfitThreadsN,nDeriv);
+  lastP=(double)0.;
+
+  if ((rc=CurfitGetWorkers(ws,nWorkers,nY,nA,indexFenoColumn,fitprops,&workers))!=ERROR_ID_NO)
+   return rc;
+
+  // The errors of the evaluations are not reported (the derivatives are evaluated
+  // again by CurfitNumDeriv) : keep the errors already registered by this thread
+
+  nPendingErrors=ERROR_Save(&pendingErrors);
+
+  // Evaluate the function for Aj+Dj; each thread uses its own worker
+
+  #if defined(_OPENMP)
+  #pragma omp parallel for num_threads(nWorkers) schedule(static,1)
+  #endif
+  for (int i=0;i<nDeriv;i++)
+   {
+    #if defined(_OPENMP)
+    CURFIT_WORKER *pWorker=&workers[omp_get_thread_num()];
+    #else
+    CURFIT_WORKER *pWorker=&workers[0];
+    #endif
+    int indexA=indexList[i];
+    double Dj=deltaA[indexA];
+    RC rcDeriv;
+
+    memcpy(pWorker->A,A,sizeof(double)*nA);
+    memcpy(pWorker->P,P,sizeof(double)*(nP+1));
+
+    pWorker->A[indexA]=A[indexA]+Dj;
+
+    if (((rcDeriv=ANALYSE_Function(&pWorker->ws,specX,srefX,sigmaY,pWorker->Yfit2,nY,pWorker->P,pWorker->A,indexFenoColumn,&pWorker->fit))==ERROR_ID_NO) &&
+        (Dj==0.))
+     rcDeriv=ERROR_ID_DIVISION_BY_0;
+
+    if (rcDeriv==ERROR_ID_NO)
+     for (int j=0;j<nY;j++)
+      deriv[indexA][j]=(pWorker->Yfit2[j]-Yfit[j])/Dj;
+    else
+     {
+      ERROR_DESCRIPTION errorDescription;
+
+      #if defined(_OPENMP)
+      #pragma omp critical (curfit_deriv_rc)
+      #endif
+      rc=rcDeriv;
+
+      while (ERROR_GetLast(&errorDescription)!=0);
+     }
+
+    // CurfitNumDeriv only restores P[0..DimC-1]; keep the same value for P[DimC]
+
+    if (i==nDeriv-1)
+     lastP=pWorker->P[nP];
+   }
+
+  ERROR_Restore(pendingErrors,nPendingErrors);
+
+  if (!rc)
+   P[nP]=lastP;
+
+  return rc;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      CURFIT_ReleaseWorkers
+// -----------------------------------------------------------------------------
+// PURPOSE       Release the buffers used by a workspace to evaluate the numeric
+//               derivatives in parallel (see CurfitNumDerivParallel)
+//
+// INPUT         ws - the workspace (see ANALYSE_WorkspaceFree)
+// -----------------------------------------------------------------------------
+
+void CURFIT_ReleaseWorkers(struct analysis_workspace *ws)
+ {
+  struct curfit_workers *pCache=ws->curfitWorkers;
+
+  if (pCache!=NULL)
+   {
+    if (pCache->workers!=NULL)
+     {
+      for (int k=0;k<pCache->nWorkers;k++)
+       CurfitWorkerFree(&pCache->workers[k]);
+
+      MEMORY_ReleaseBuffer(__func__,"workers",pCache->workers);
+     }
+
+    MEMORY_ReleaseBuffer(__func__,"curfitWorkers",pCache);
+    ws->curfitWorkers=NULL;
+   }
+ }
+
 // -----------------------------------------------------------------------------
 // FUNCTION      CurfitDerivFunc
 // -----------------------------------------------------------------------------
@@ -468,7 +826,7 @@ static RC CurfitNumDeriv(double *specX, double *srefX, const double *sigmaY, int
 //               If possible, derivatives are calculated analytically in order to avoid two evaluations
 //               of the fitting function.
 //
-// INPUT
+// INPUT         ws      - workspace of the current fit
 //               specX   - the spectrum to evaluate
 //               srefX   - the control spectrum (also called reference spectrum)
 //
@@ -490,13 +848,21 @@ static RC CurfitNumDeriv(double *specX, double *srefX, const double *sigmaY, int
 //               ERROR_ID_NO if successful
 // -----------------------------------------------------------------------------
 
-static RC CurfitDerivFunc(double *specX, double *srefX, double *sigmaY,int nY, const double *Yfit,
+static RC CurfitDerivFunc(struct analysis_workspace *ws,double *specX, double *srefX, double *sigmaY,int nY, const double *Yfit,
                    double *P, double *A, double *deltaA,double **deriv,INDEX indexFenoColumn,struct fit_properties *fitprops) {
 
-  CROSS_REFERENCE *TabCross=Feno->TabCross; // the list of cross sections involved in the fitting
+  FENO *pFeno=ws->feno;
+  CROSS_REFERENCE *TabCross=pFeno->TabCross; // the list of cross sections involved in the fitting
+  int indexList[MAX_FIT*4];                  // non linear parameters for which the derivative is calculated numerically
+  int analytic[MAX_FIT*4];                   // flags set for the non linear parameters whose derivative is calculated analytically
+  int nDeriv=0,nNumeric=0;
+
+  // Analytic derivatives in shift, stretch and offset of the spectrum and of the reference;
+  // in case of error, all the derivatives are calculated numerically
+
+  ANALYSE_FunctionDeriv(ws,specX,srefX,sigmaY,nY,A,indexFenoColumn,fitprops,deriv,analytic);
 
-  for (int i=0;i<Feno->NTabCross;i++) {
-    int rc = ERROR_ID_NO;
+  for (int i=0;i<pFeno->NTabCross;i++) {
 
     // ===============================================
     // Numeric derivatives in the following situations
@@ -505,43 +871,89 @@ static RC CurfitDerivFunc(double *specX, double *srefX, double *sigmaY,int nY, c
     //    concentrations of the molecules in the case of SVD+Marquardt analysis method
     //    predefined parameters as offset, undersampling, raman, common residual are fitted linearly
 
-    if (((Feno->analysisMethod==INTENSITY_FIT) &&
-         (TabCross[i].FitConc!=ITEM_NONE) && ((rc=CurfitNumDeriv(specX,srefX,sigmaY,nY, Yfit, P,A,deltaA,TabCross[i].FitConc,deriv,indexFenoColumn,fitprops))>=THREAD_EVENT_STOP)) ||
+    if ((pFeno->analysisMethod==INTENSITY_FIT) && (TabCross[i].FitConc!=ITEM_NONE))
+      indexList[nDeriv++]=TabCross[i].FitConc;
 
     // SVD : concentrations of molecules fitted linearly
     //       second derivatives of non linear parameters (predefined parameters, shift, stretch)
     //         calculated numerically
 
-        ((TabCross[i].FitParam!=ITEM_NONE) &&
-       (((i!=Feno->indexOffsetConst) &&
-         (i!=Feno->indexOffsetOrder1) &&
-         (i!=Feno->indexOffsetOrder2) &&
-         (i!=Feno->indexCommonResidual) &&
-         (i!=Feno->indexUsamp1) &&
-         (i!=Feno->indexUsamp2) &&
-         (i!=Feno->indexResol)) ||
-         (Feno->analysisMethod==OPTICAL_DENSITY_FIT)) &&
-         ((rc=CurfitNumDeriv(specX,srefX,sigmaY,nY, Yfit, P,A,deltaA,TabCross[i].FitParam,deriv,indexFenoColumn,fitprops))>=THREAD_EVENT_STOP)) ||
+    if ((TabCross[i].FitParam!=ITEM_NONE) &&
+       (((i!=pFeno->indexOffsetConst) &&
+         (i!=pFeno->indexOffsetOrder1) &&
+         (i!=pFeno->indexOffsetOrder2) &&
+         (i!=pFeno->indexCommonResidual) &&
+         (i!=pFeno->indexUsamp1) &&
+         (i!=pFeno->indexUsamp2) &&
+         (i!=pFeno->indexResol)) ||
+         (pFeno->analysisMethod==OPTICAL_DENSITY_FIT)))
+      indexList[nDeriv++]=TabCross[i].FitParam;
+
+    //    derivatives of the fitting function in shift, stretch and scaling of cross sections are always numeric undependantly on the method of analysis
+
+    if (TabCross[i].FitShift!=ITEM_NONE)
+      indexList[nDeriv++]=TabCross[i].FitShift;
+    if (TabCross[i].FitStretch!=ITEM_NONE)
+      indexList[nDeriv++]=TabCross[i].FitStretch;
+    if (TabCross[i].FitStretch2!=ITEM_NONE)
+      indexList[nDeriv++]=TabCross[i].FitStretch2;
+   }
+
+  for (int i=0;i<nDeriv;i++)
+    if (!analytic[indexList[i]])
+      indexList[nNumeric++]=indexList[i];
+
+  nDeriv=nNumeric;
 
-    //    derivatives of the fitting function in shift, stretch and scaling are always numeric undependantly on the method of analysis
+  // Evaluate the derivatives at the same time; in case of error, the serial
+  // evaluation below reports it exactly as before
 
-        ((TabCross[i].FitShift!=ITEM_NONE) && ((rc=CurfitNumDeriv(specX,srefX,sigmaY,nY, Yfit, P,A,deltaA,TabCross[i].FitShift,deriv,indexFenoColumn,fitprops))>=THREAD_EVENT_STOP)) ||
-        ((TabCross[i].FitStretch!=ITEM_NONE) && ((rc=CurfitNumDeriv(specX,srefX,sigmaY,nY,Yfit, P,A,deltaA,TabCross[i].FitStretch,deriv,indexFenoColumn,fitprops))>=THREAD_EVENT_STOP)) ||
-        ((TabCross[i].FitStretch2!=ITEM_NONE) && ((rc=CurfitNumDeriv(specX,srefX,sigmaY,nY, Yfit, P,A,deltaA,TabCross[i].FitStretch2,deriv,indexFenoColumn,fitprops))>=THREAD_EVENT_STOP)))
+  if ((curfitThreadsN>1) && (nDeriv>1) &&
+      (CurfitNumDerivParallel(ws,specX,srefX,sigmaY,nY,Yfit,P,A,deltaA,indexList,nDeriv,deriv,indexFenoColumn,fitprops)==ERROR_ID_NO))
+    return ERROR_ID_NO;
 
+  for (int i=0;i<nDeriv;i++) {
+    RC rc=CurfitNumDeriv(ws,specX,srefX,sigmaY,nY,Yfit,P,A,deltaA,indexList[i],deriv,indexFenoColumn,fitprops);
+
+    if (rc>=THREAD_EVENT_STOP)
       return rc;
    }
 
   return ERROR_ID_NO;
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      CURFIT_SetThreads
+// -----------------------------------------------------------------------------
+// PURPOSE       Set the number of threads used to evaluate the numeric derivatives
+//               of the fitting function.
+//
+// INPUT         nThreads - the number of threads (1 to evaluate the derivatives
+//                          one after the other)
+//
+// REMARK        Only use several threads when the fits themselves are not run
+//               in parallel (see doas_cl -threads).  Without OpenMP support, the
+//               derivatives are always evaluated one after the other.
+// -----------------------------------------------------------------------------
+
+void CURFIT_SetThreads(int nThreads)
+ {
+  #if defined(_OPENMP)
+  curfitThreadsN=(nThreads>1)?nThreads:1;
+  #else
+  curfitThreadsN=1;
+  #endif
+ }
+
 // -----------------------------------------------------------------------------
 // FUNCTION      Curfit
 // -----------------------------------------------------------------------------
 // PURPOSE       Make a least-squares fit to a non-linear function with a
 //               linearization of the fitting function
 //
-// INPUT         mode    - determine the method of weighting least-squares fit
+// INPUT         ws      - workspace of the current fit (see ANALYSE_SvdInit)
+//
+//               mode    - determine the method of weighting least-squares fit
 //
 //                 PRJCT_ANLYS_FIT_WEIGHTING_INSTRUMENTAL (instrumental) weight(i)=1./sigmay(i)**2
 //                 PRJCT_ANLYS_FIT_WEIGHTING_NONE         (no weighting) weight(i)=1.
@@ -582,7 +994,8 @@ static RC CurfitDerivFunc(double *specX, double *srefX, double *sigmaY,int nY, c
 //               ERROR_ID_CONVERGENCE if the algorithm can not converge
 // -----------------------------------------------------------------------------
 
-RC Curfit(int     mode,                                                         // I   method of weighting least-squares fit
+RC Curfit(struct analysis_workspace *ws,                                        // I/O workspace of the current fit
+          int     mode,                                                         // I   method of weighting least-squares fit
           int niter,                                                            // current number of iterations
           int     nFree,                                                        // I   the number of degrees of freedom
           double *specX,                                                        // I   the spectrum to evaluate
@@ -681,12 +1094,15 @@ RC Curfit(int     mode,
        alpha[j][k]=0.;
      }
 
-    if (niter == 0) // Only for the first iteration: initial evaluation of fit function.
-      rc=ANALYSE_Function(specX,srefX,sigmaY,Yfit,nY,P,A,indexFenoColumn,fitprops);
+    if (niter == 0) { // Only for the first iteration: initial evaluation of fit function.
+      if (ws->curfitWorkers!=NULL)
+        ws->curfitWorkers->synced=0;  // new fit : the workers of the numeric derivatives have to be updated
+      rc=ANALYSE_Function(ws,specX,srefX,sigmaY,Yfit,nY,P,A,indexFenoColumn,fitprops);
+    }
     if (rc >= THREAD_EVENT_STOP)
       goto EndCurfit;
 
-    rc=CurfitDerivFunc(specX,srefX,sigmaY,nY, Yfit, P,A,deltaA,deriv,indexFenoColumn,fitprops);
+    rc=CurfitDerivFunc(ws,specX,srefX,sigmaY,nY, Yfit, P,A,deltaA,deriv,indexFenoColumn,fitprops);
     if (rc>=THREAD_EVENT_STOP )
       goto EndCurfit;
 
@@ -721,7 +1137,7 @@ RC Curfit(int     mode,
          {
           if (alpha[j][j]*alpha[k][k]<=0.)
            {
-            rc=ERROR_SetLast("Curfit1",ERROR_TYPE_WARNING,ERROR_ID_SQRT_ARG,CurfitError(string,(alpha[j][j]<=0.)?j:k,A,deltaA));
+            rc=ERROR_SetLast("Curfit1",ERROR_TYPE_WARNING,ERROR_ID_SQRT_ARG,CurfitError(ws->feno,string,(alpha[j][j]<=0.)?j:k,A,deltaA));
             goto EndCurfit;
            }
 
@@ -744,7 +1160,7 @@ RC Curfit(int     mode,
          {
           if (alpha[j][j]*alpha[k][k]<=0.)
            {
-            rc=ERROR_SetLast("Curfit2",ERROR_TYPE_WARNING,ERROR_ID_SQRT_ARG,CurfitError(string,(alpha[j][j]<=0.)?j:k,A,deltaA));
+            rc=ERROR_SetLast("Curfit2",ERROR_TYPE_WARNING,ERROR_ID_SQRT_ARG,CurfitError(ws->feno,string,(alpha[j][j]<=0.)?j:k,A,deltaA));
             goto EndCurfit;
            }
 
@@ -754,7 +1170,7 @@ RC Curfit(int     mode,
 
       // If the Chi square increased,increase pLambda and try again
 
-      if ((rc=ANALYSE_Function(specX,srefX,sigmaY,Yfit,nY,P,B,indexFenoColumn,fitprops))>=THREAD_EVENT_STOP) goto EndCurfit;
+      if ((rc=ANALYSE_Function(ws,specX,srefX,sigmaY,Yfit,nY,P,B,indexFenoColumn,fitprops))>=THREAD_EVENT_STOP) goto EndCurfit;
 
       chisqr=(double)Fchisq(mode,nFree,Y,Yfit,sigmaY,nY);
       if (chisq1<chisqr)
@@ -791,7 +1207,7 @@ RC Curfit(int     mode,
 
     if (outOfRange)
      {
-       if ((rc=ANALYSE_Function(specX,srefX,sigmaY,Yfit,nY,P,B,indexFenoColumn,fitprops))>=THREAD_EVENT_STOP)
+       if ((rc=ANALYSE_Function(ws,specX,srefX,sigmaY,Yfit,nY,P,B,indexFenoColumn,fitprops))>=THREAD_EVENT_STOP)
        goto EndCurfit;
       chisqr=(double)Fchisq(mode,nFree,Y,Yfit,sigmaY,nY);
      }
@@ -804,7 +1220,7 @@ RC Curfit(int     mode,
 
       if (array[j][j]/alpha[j][j]*chisqr<=0.)
        {
-           rc=ERROR_SetLast("Curfit3",ERROR_TYPE_WARNING,ERROR_ID_SQRT_ARG,CurfitError(string,j,A,deltaA));
+           rc=ERROR_SetLast("Curfit3",ERROR_TYPE_WARNING,ERROR_ID_SQRT_ARG,CurfitError(ws->feno,string,j,A,deltaA));
         goto EndCurfit;
        }
 
@@ -4,8 +4,14 @@
 #include "comdefs.h"
 
 double Fchisq(int mode,int nFree,double *Y,double *Yfit,double *sigmay,int nY);
+void CURFIT_SetThreads(int nThreads);
 
-RC Curfit(int     mode,                                                         // I   method of weighting least-squares fit
+struct analysis_workspace;
+
+void CURFIT_ReleaseWorkers(struct analysis_workspace *ws);
+
+RC Curfit(struct analysis_workspace *ws,                                        // I/O workspace of the current fit
+          int     mode,                                                         // I   method of weighting least-squares fit
           int niter,                                                            // current number of iterations
           int     nFree,                                                        // I   the number of degrees of freedom
           double *specX,                                                        // I   the spectrum to evaluate
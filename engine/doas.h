@@ -81,7 +81,7 @@ typedef struct _engineContext ENGINE_CONTEXT;
 // ----------------
 extern int NWorkSpace;
 extern int NDET[MAX_SWATHSIZE];
-extern int NFeno,SvdPDeb,SvdPFin;
+extern int NFeno;
 extern WRK_SYMBOL   *WorkSpace;
 
 extern PRJCT_ANLYS  *pAnalysisOptions;             // analysis options
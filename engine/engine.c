@@ -64,6 +64,7 @@
 #include "analyse.h"
 #include "vector.h"
 #include "winthrd.h"
+#include "filter.h"
 #include "kurucz.h"
 #include "mediate.h"
 #include "stdfunc.h"
@@ -73,6 +74,7 @@
 #include "gome2_read.h"
 #include "scia-read.h"
 #include "tropomi_read.h"
+#include "l1_preload.h"
 #include "omps_read.h"
 #include "omi_read.h"
 #include "omiv4_read.h"
@@ -855,30 +857,22 @@ RC EngineSetFile(ENGINE_CONTEXT *pEngineContext,const char *fileName,void *respo
  }
 
 // -----------------------------------------------------------------------------
-// FUNCTION      EngineReadFile
+// FUNCTION      EngineResetRecord
 // -----------------------------------------------------------------------------
-// PURPOSE       Dispatch the reading command according to the file format
+// PURPOSE       Reset the information on the record before reading it
 //
 // INPUT         pEngineContext     pointer to the engine context
 //               indexRecord        index of the record to read
-//               dateFlag           1 to search for a reference spectrum (GB)
-//               localDay           if dateFlag is 1, the calendar day for the
-//                                  reference spectrum to search for
 // -----------------------------------------------------------------------------
 
-RC EngineReadFile(ENGINE_CONTEXT *pEngineContext,int indexRecord,int dateFlag,int localCalDay)
+static void EngineResetRecord(ENGINE_CONTEXT *pEngineContext,int indexRecord)
  {
    // Declarations
 
    RECORD_INFO *pRecord;                                                         // pointer to the record part of the engine context
-   FILE_INFO *pFile;                                                             // pointer to the file part of the engine context
-   INDEX indexSite;
-   OBSERVATION_SITE *pSite;
-   double longit,latit;
 
    // Initializations
 
-   pFile=&pEngineContext->fileInfo;
    pRecord=&pEngineContext->recordInfo;
 
    memset(pRecord->Nom,0,20);
@@ -922,6 +916,80 @@ RC EngineReadFile(ENGINE_CONTEXT *pEngineContext,int indexRecord,int dateFlag,in
      pRecord->i_alongtrack=(indexRecord-1)/ANALYSE_swathSize;
      pRecord->i_crosstrack=0;
     }
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      EngineSetRecordSite
+// -----------------------------------------------------------------------------
+// PURPOSE       Complete the information on a record that has been read :
+//               correction of the solar zenith angle with the geolocation of
+//               the specified observation site
+//
+// INPUT         pEngineContext     pointer to the engine context
+//               indexRecord        index of the record
+// -----------------------------------------------------------------------------
+
+static void EngineSetRecordSite(ENGINE_CONTEXT *pEngineContext,int indexRecord)
+ {
+   // Declarations
+
+   RECORD_INFO *pRecord;                                                         // pointer to the record part of the engine context
+   INDEX indexSite;
+   OBSERVATION_SITE *pSite;
+   double longit,latit;
+
+   // Initializations
+
+   pRecord=&pEngineContext->recordInfo;
+
+   pEngineContext->indexRecord=indexRecord;
+   if (pRecord->oldZm<(double)0.)
+     pRecord->oldZm=pRecord->Zm;
+
+   // Correction of the solar zenith angle with the geolocation of the specified observation site
+
+   if ((indexSite=SITES_GetIndex(pEngineContext->project.instrumental.observationSite))!=ITEM_NONE) {
+     pSite=&SITES_itemList[indexSite];
+
+     longit=-pSite->longitude;   // !!! sign is inverted
+
+     pRecord->longitude=-longit;
+     pRecord->latitude=latit=(double)pSite->latitude;
+
+     if (pSite->altitude>(double)0.)
+       pRecord->altitude=pSite->altitude*0.001;
+
+     pRecord->Zm=(pRecord->Tm!=(double)0.)?ZEN_FNTdiz(ZEN_FNCrtjul(&pRecord->Tm),&longit,&latit,&pRecord->Azimuth):(double)-1.;
+     if (pEngineContext->project.instrumental.saaConvention==PRJCT_INSTR_SAA_NORTH)
+      pRecord->Azimuth+=180.;
+   }
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      EngineReadFile
+// -----------------------------------------------------------------------------
+// PURPOSE       Dispatch the reading command according to the file format
+//
+// INPUT         pEngineContext     pointer to the engine context
+//               indexRecord        index of the record to read
+//               dateFlag           1 to search for a reference spectrum (GB)
+//               localDay           if dateFlag is 1, the calendar day for the
+//                                  reference spectrum to search for
+// -----------------------------------------------------------------------------
+
+RC EngineReadFile(ENGINE_CONTEXT *pEngineContext,int indexRecord,int dateFlag,int localCalDay)
+ {
+   // Declarations
+
+   RECORD_INFO *pRecord;                                                         // pointer to the record part of the engine context
+   FILE_INFO *pFile;                                                             // pointer to the file part of the engine context
+
+   // Initializations
+
+   pFile=&pEngineContext->fileInfo;
+   pRecord=&pEngineContext->recordInfo;
+
+   EngineResetRecord(pEngineContext,indexRecord);
 
    switch((int)pEngineContext->project.instrumental.readOutFormat)
     {
@@ -1083,27 +1151,74 @@ RC EngineReadFile(ENGINE_CONTEXT *pEngineContext,int indexRecord,int dateFlag,in
    if (pRecord->rc)
      return pRecord->rc;
 
-   pEngineContext->indexRecord=indexRecord;
-   if (pRecord->oldZm<(double)0.)
-     pRecord->oldZm=pRecord->Zm;
+   EngineSetRecordSite(pEngineContext,indexRecord);
 
-   // Correction of the solar zenith angle with the geolocation of the specified observation site
+   return pRecord->rc;
+ }
 
-   if ((indexSite=SITES_GetIndex(pEngineContext->project.instrumental.observationSite))!=ITEM_NONE) {
-     pSite=&SITES_itemList[indexSite];
+// -----------------------------------------------------------------------------
+// FUNCTION      EngineReadHeader
+// -----------------------------------------------------------------------------
+// PURPOSE       Read the information on a record (date and time, solar zenith
+//               angle, viewing angles, measurement type) without its spectrum.
+//
+// INPUT         same as EngineReadFile
+//
+// REMARK        Used by the passes that browse all the records of a file
+//               (scan indexes, list of reference spectra); the spectra are
+//               neither decoded nor corrected.  Formats without a dedicated
+//               header read out are read completely with EngineReadFile.
+// -----------------------------------------------------------------------------
 
-     longit=-pSite->longitude;   // !!! sign is inverted
+RC EngineReadHeader(ENGINE_CONTEXT *pEngineContext,int indexRecord,int dateFlag,int localCalDay)
+ {
+   // Declarations
 
-     pRecord->longitude=-longit;
-     pRecord->latitude=latit=(double)pSite->latitude;
+   RECORD_INFO *pRecord;                                                         // pointer to the record part of the engine context
+   FILE_INFO *pFile;                                                             // pointer to the file part of the engine context
+   PRJCT_INSTRUMENTAL *pInstr;                                                   // pointer to the instrumental part of the project
 
-     if (pSite->altitude>(double)0.)
-       pRecord->altitude=pSite->altitude*0.001;
+   // Initializations
 
-     pRecord->Zm=(pRecord->Tm!=(double)0.)?ZEN_FNTdiz(ZEN_FNCrtjul(&pRecord->Tm),&longit,&latit,&pRecord->Azimuth):(double)-1.;
-     if (pEngineContext->project.instrumental.saaConvention==PRJCT_INSTR_SAA_NORTH)
-      pRecord->Azimuth+=180.;
-   }
+   pFile=&pEngineContext->fileInfo;
+   pRecord=&pEngineContext->recordInfo;
+   pInstr=&pEngineContext->project.instrumental;
+
+   switch((int)pInstr->readOutFormat)
+    {
+     // ---------------------------------------------------------------------------
+    case PRJCT_INSTR_FORMAT_ASCII :
+      if ((pInstr->ascii.format!=PRJCT_INSTR_ASCII_FORMAT_LINE) && (pInstr->ascii.format!=PRJCT_INSTR_ASCII_FORMAT_COLUMN))
+       return EngineReadFile(pEngineContext,indexRecord,dateFlag,localCalDay);
+
+      EngineResetRecord(pEngineContext,indexRecord);
+      pRecord->rc=ASCII_ReadHeader(pEngineContext,indexRecord,dateFlag,localCalDay,pFile->specFp);
+      break;
+      // ---------------------------------------------------------------------------
+    case PRJCT_INSTR_FORMAT_MFC :
+      EngineResetRecord(pEngineContext,indexRecord);
+      pRecord->rc=ReliMFCHeader(pEngineContext,indexRecord,dateFlag,localCalDay,pFile->specFp,pInstr->mfc.mfcMaskSpec);
+      break;
+      // ---------------------------------------------------------------------------
+    case PRJCT_INSTR_FORMAT_MFC_STD :
+      EngineResetRecord(pEngineContext,indexRecord);
+      pRecord->rc=ReliMFCStdHeader(pEngineContext,indexRecord,dateFlag,localCalDay,pFile->specFp);
+      break;
+      // ---------------------------------------------------------------------------
+    case PRJCT_INSTR_FORMAT_MFC_BIRA :
+      EngineResetRecord(pEngineContext,indexRecord);
+      pRecord->rc=MFCBIRA_ReliHeader(pEngineContext,indexRecord,dateFlag,localCalDay,pFile->specFp);
+      break;
+      // ---------------------------------------------------------------------------
+    default :
+      return EngineReadFile(pEngineContext,indexRecord,dateFlag,localCalDay);
+      // ---------------------------------------------------------------------------
+    }
+
+   if (pRecord->rc)
+     return pRecord->rc;
+
+   EngineSetRecordSite(pEngineContext,indexRecord);
 
    return pRecord->rc;
  }
@@ -1233,6 +1348,10 @@ RC EngineRequestEndBrowseSpectra(ENGINE_CONTEXT *pEngineContext)
    pRef=&pEngineContext->analysisRef;
    rc=ERROR_ID_NO;
 
+   // Stop reading the L1B file in the background before writing the output files
+
+   L1_PreloadStop();
+
    if ((THRD_id!=THREAD_TYPE_NONE) && (THRD_id!=THREAD_TYPE_SPECTRA))
     {
      rc=OUTPUT_FlushBuffers(pEngineContext);   // For export option (without lambda and spectra), format is similar as ASCII results
@@ -1392,6 +1511,7 @@ RC EngineDestroyContext(ENGINE_CONTEXT *pEngineContext)
    rc=EngineEndCurrentSession(pEngineContext);
 
    RESOURCE_Free();
+   FILTER_ReleaseFFTPlans();
 
    if (GOME2_beatLoaded)
     {
@@ -1500,7 +1620,7 @@ RC EngineBuildScanIndex(ENGINE_CONTEXT *pEngineContext)
 
         // Read the next record
 
-        if (!(rc=EngineReadFile(pEngineContext,(!pEngineContext->mfcDoasisFlag)?indexRecord+1:1,0,0)))
+        if (!(rc=EngineReadHeader(pEngineContext,(!pEngineContext->mfcDoasisFlag)?indexRecord+1:1,0,0)))
          {
           // Get the local time of the current record
 
@@ -1649,7 +1769,7 @@ RC EngineBuildRefList(ENGINE_CONTEXT *pEngineContext)
       if (pEngineContext->mfcDoasisFlag)
        sprintf(ENGINE_contextRef.fileInfo.fileName,"%s%c%s",pMfc->filePath,PATH_SEP,&pMfc->fileNames[(indexRecord-1)*(DOAS_MAX_PATH_LEN+1)]);
 
-      if (!(rc=EngineReadFile(&ENGINE_contextRef,(!pEngineContext->mfcDoasisFlag)?indexRecord:1,1,localCalDay)) &&
+      if (!(rc=EngineReadHeader(&ENGINE_contextRef,(!pEngineContext->mfcDoasisFlag)?indexRecord:1,1,localCalDay)) &&
            (ENGINE_contextRef.recordInfo.Zm>(double)0.) && (ENGINE_contextRef.recordInfo.Zm<(double)96.))
        {
         // Data on record
@@ -2074,6 +2194,7 @@ RC EngineNewRef(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
                ((indexRefRecord==ITEM_NONE) && ((pTabFeno->refSpectrumSelectionScanMode==ANLYS_MAXDOAS_REF_SCAN_INTERPOLATE) || (indexScanBefore!=pTabFeno->indexRefScanBefore) || (indexScanAfter!=pTabFeno->indexRefScanAfter))))
         {
             pTabFeno->newrefFlag=1;
+            pTabFeno->warmStartN=0;                                             // new reference, don't start the next fit from the previous one
 
          if (!pEngineContext->mfcDoasisFlag)
           {
@@ -2271,10 +2392,10 @@ RC EngineNewRef(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
    // Reference alignment
 
    if (!rc && useKurucz)
-    rc=KURUCZ_Reference(ENGINE_contextRef.buffers.instrFunction,1,saveFlag,1,responseHandle,0);
+    rc=KURUCZ_Reference(&ANALYSE_mainWorkspace,ENGINE_contextRef.buffers.instrFunction,1,saveFlag,1,responseHandle,0);
 
    if (!rc && alignRef)
-    rc=ANALYSE_AlignReference(pEngineContext,1,responseHandle,0);
+    rc=ANALYSE_AlignReference(&ANALYSE_mainWorkspace,pEngineContext,1,responseHandle,0);
 
    if (!rc && useUsamp)
     rc=ANALYSE_UsampBuild(1,ITEM_NONE,0);
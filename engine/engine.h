@@ -21,9 +21,11 @@ extern double         ENGINE_localNoon;
 // PROTOTYPES
 // ==========
 
+void            EngineResetContext(ENGINE_CONTEXT *pEngineContext);
 RC              EngineCopyContext(ENGINE_CONTEXT *pEngineContextTarget,ENGINE_CONTEXT *pEngineContextSource);
 RC              EngineSetProject(ENGINE_CONTEXT *pEngineContext);
 RC              EngineReadFile(ENGINE_CONTEXT *pEngineContext,int indexRecord,int dateFlag,int localCalDay);
+RC              EngineReadHeader(ENGINE_CONTEXT *pEngineContext,int indexRecord,int dateFlag,int localCalDay);
 RC              EngineRequestBeginBrowseSpectra(ENGINE_CONTEXT *pEngineContext,const char *spectraFileName,void *responseHandle);
 RC              EngineRequestEndBrowseSpectra(ENGINE_CONTEXT *pEngineContext);
 RC              EngineNewRef(ENGINE_CONTEXT *pEngineContext,void *responseHandle);
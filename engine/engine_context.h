@@ -638,6 +638,8 @@ SLIT_MATRIX;
   int     filterAction;
   double *filterFunction;
   int     filterSize;
+  double *composedFunction;                              // filter function composed with itself filterNTimes times (built by FILTER_Build)
+  int     composedSize;
   double  filterEffWidth;
   int     hpFilterCalib;
   int     hpFilterAnalysis;
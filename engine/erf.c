@@ -35,6 +35,7 @@
 //
 //  ERF_GetValue - calculate the error function (if possible, interpolate the
 //                 pre-calculated vector);
+//  ERF_GetVector - calculate the error function on a vector of inputs;
 //
 //  ERF_Alloc - allocate vectors in order to save a pre-calculated error function
 //  ERF_Free - release the vectors allocated by ERF_Alloc
@@ -224,6 +225,76 @@ double ERF_GetValue(double newX)
   return newY;
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      ERF_GetVector
+// -----------------------------------------------------------------------------
+// PURPOSE       calculate the error function on a vector of inputs
+//
+// INPUT         newX : the inputs of the error function
+//               n    : the number of inputs
+//
+// OUTPUT        newY : the error function calculated (or interpolated) on newX
+//
+// REMARK        the pre-calculated grid is regular, so the interval of each input
+//               is calculated instead of searched and the interpolation loop has
+//               no branch (it can be vectorized).  Inside the grid, results are
+//               the ones of ERF_GetValue (same interval, same formula); outside
+//               the grid (|x|>3), erf of the C library replaces doas_erf (the
+//               absolute and relative differences, measured on |x|<=10, are
+//               below 1.1e-13).
+// -----------------------------------------------------------------------------
+
+void ERF_GetVector(const double *newX,double *newY,int n)
+ {
+  // Declarations
+
+  double absX,xMin,xMax,invStep,h,a,b,y;
+  int nGrid,i,k;
+
+  // No pre-calculated vector
+
+  if ((ERF_x==NULL) || (ERF_y==NULL) || (ERF_y2==NULL))
+   {
+    for (i=0;i<n;i++)
+     newY[i]=ERF_GetValue(newX[i]);
+
+    return;
+   }
+
+  // Initializations
+
+  nGrid=(int)(ERF_N);
+  xMin=ERF_x[0];
+  xMax=ERF_x[nGrid-1];
+  invStep=(double)(nGrid-1)/(xMax-xMin);
+
+  // Interpolate the pre-calculated vector (same cubic spline as SPLINE_Vector)
+
+  for (i=0;i<n;i++)
+   {
+    absX=fmin(fabs(newX[i]),xMax);
+
+    k=(int)((absX-xMin)*invStep);
+    k=(k<0)?0:(k>nGrid-2)?nGrid-2:k;
+    k-=((k>0) && (ERF_x[k]>=absX))?1:0;                                         // ERF_x[k]<absX<=ERF_x[k+1] as in SPLINE_Vector (the grid is built by accumulation)
+    k+=((k<nGrid-2) && (ERF_x[k+1]<absX))?1:0;
+
+    h=ERF_x[k+1]-ERF_x[k];
+    a=(ERF_x[k+1]-absX)/h;
+    b=1.-a;
+    y=a*ERF_y[k]+b*ERF_y[k+1]+((a*a*a-a)*ERF_y2[k]+(b*b*b-b)*ERF_y2[k+1])*(h*h)/6.;
+    y=(absX<=xMin)?ERF_y[0]:(absX>=xMax)?ERF_y[nGrid-1]:y;
+
+    newY[i]=(newX[i]<0)?-y:y;
+   }
+
+  // Inputs outside the grid
+
+  for (i=0;i<n;i++)
+   if (fabs(newX[i])>xMax)
+    newY[i]=erf(newX[i]);
+ }
+
 // -----------------------------------------------------------------------------
 // FUNCTION      ERF_Alloc
 // -----------------------------------------------------------------------------
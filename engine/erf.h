@@ -4,6 +4,7 @@
 double doas_erf ( double x );
 
 double ERF_GetValue(double newX);
+void   ERF_GetVector(const double *newX,double *newY,int n);
 RC     ERF_Alloc(void);
 void   ERF_Free(void);
 
@@ -27,6 +27,8 @@
 //
 //  ERROR_SetLast - save the information on the last error in a stack;
 //  ERROR_GetLast - retrieve the information about the last error in order to process it;
+//  ERROR_Save - move the errors of the stack of the current thread to a buffer;
+//  ERROR_Restore - register again in the stack errors saved by ERROR_Save;
 //
 //  ----------------------------------------------------------------------------
 //
@@ -47,6 +49,7 @@
 // =======
 
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -210,9 +213,11 @@ ERROR_TABLE errorTable[]=
  };
 
 // Definition of a structure for holding the last error
+// The stack is private to each thread so that spectra analysed concurrently
+// (doas_cl -threads) report their errors independently
 
-static ERROR_DESCRIPTION errorStack[ERROR_MAX_ERRORS+1];                        // the error stack
-static int errorStackN=0;                                                       // the number of errors in the stack
+static THREAD_LOCAL ERROR_DESCRIPTION errorStack[ERROR_MAX_ERRORS+1];           // the error stack
+static THREAD_LOCAL int errorStackN=0;                                          // the number of errors in the stack
 
 RC ERROR_DisplayMessage(void *responseHandle)
  {
@@ -347,6 +352,80 @@ RC ERROR_GetLast(ERROR_DESCRIPTION *pError)
   return (pError!=NULL)?pError->errorId:0;
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      ERROR_Save
+// -----------------------------------------------------------------------------
+// PURPOSE       Move the errors of the stack of the current thread to a buffer,
+//               in the order they were registered, and empty the stack.  Used
+//               to transmit the errors of a worker thread to another thread.
+//
+// OUTPUT        pErrors : the allocated buffer (NULL if the stack is empty), to
+//                         give back to ERROR_Restore or to release with free
+//
+// RETURN        the number of errors in the buffer
+// -----------------------------------------------------------------------------
+
+int ERROR_Save(ERROR_DESCRIPTION **pErrors)
+ {
+  int nErrors=errorStackN;
+
+  *pErrors=NULL;
+
+  if ((nErrors>0) && ((*pErrors=(ERROR_DESCRIPTION *)malloc(nErrors*sizeof(ERROR_DESCRIPTION)))!=NULL))
+   memcpy(*pErrors,errorStack,nErrors*sizeof(ERROR_DESCRIPTION));
+
+  errorStackN=0;
+
+  return (*pErrors!=NULL)?nErrors:0;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      ERROR_Restore
+// -----------------------------------------------------------------------------
+// PURPOSE       Register in the stack of the current thread the errors saved
+//               by ERROR_Save (same rules as ERROR_SetLast for errors already
+//               in the stack and for a full stack) and release the buffer.
+//
+// INPUT         errors  : the buffer returned by ERROR_Save;
+//               nErrors : the number of errors in the buffer
+// -----------------------------------------------------------------------------
+
+void ERROR_Restore(ERROR_DESCRIPTION *errors,int nErrors)
+ {
+  for (int indexError=0;indexError<nErrors;indexError++)
+   {
+    const ERROR_DESCRIPTION *pSaved=&errors[indexError];
+    int i;
+
+    for (i=0;i<errorStackN;i++)
+     if ((errorStack[i].errorId==pSaved->errorId) && (errorStack[i].errorType==pSaved->errorType))
+      break;
+
+    if ((i==errorStackN) && (errorStackN<=ERROR_MAX_ERRORS))
+     {
+      if (errorStackN<ERROR_MAX_ERRORS)
+       memcpy(&errorStack[errorStackN],pSaved,sizeof(ERROR_DESCRIPTION));
+      else
+       {
+        ERROR_DESCRIPTION *pError=&errorStack[errorStackN];
+
+        memset(pError,0,sizeof(ERROR_DESCRIPTION));
+        strncpy(pError->errorFunction,pSaved->errorFunction,MAX_FCT_LEN);
+
+        pError->errorType=ERROR_TYPE_WARNING;
+        pError->errorId=ERROR_ID_BUFFER_FULL;
+
+        strcpy(pError->errorString,"the stack of errors is full - can not register errors anymore");
+       }
+
+      errorStackN++;
+     }
+   }
+
+  if (errors!=NULL)
+   free(errors);
+ }
+
 // check if the error stack contains a fatal error
 bool ERROR_Fatal(void) {
   for(int i=0; i<errorStackN; ++i) {
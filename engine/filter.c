@@ -39,14 +39,21 @@
 //  FUNCTIONS
 //
 //  Fourier - fast Fourier Transform algorithm
+//  FilterFFTPlanFree - release the tables of a radix-2/4 fast Fourier Transform
+//  FilterFFTPlanCreate - precompute the tables of a radix-2/4 fast Fourier Transform
+//  FilterFFTPlan - get the cached tables of a radix-2/4 fast Fourier Transform
+//  FILTER_ReleaseFFTPlans - release the cached tables of the fast Fourier Transforms
+//  FilterFFT - radix-2/4 fast Fourier Transform
 //  realft - fast Fourier Transform of a real vector
 //  ModBessel - modified Bessel function of zeroth order
 //  Neq_Ripple - build a Kaizer filter
 //  FilterPinv - pseudoInverse function function
 //  FilterSavitskyGolay - build a Savitsky-Golay filter function
 //  FilterPascalTriangle - build a Pascal binomial filter function
+//  FilterCompose - compose the filter function with itself for the requested number of passes
 //  FILTER_Build - build a filter function
-//  FilterConv - apply a filter function on a vector by convolution on pixels
+//  FilterConv - apply a filter function on a range of pixels by convolution
+//  FilterConvComposed - apply the composed filter function on the interior pixels
 //  FILTER_Vector - apply a filter function on a vector
 //
 //  ----------------------------------------------------------------------------
@@ -56,6 +63,7 @@
 // ===============
 
 #include <string.h>
+#include <stdlib.h>
 #include <math.h>
 
 #include "filter.h"
@@ -68,6 +76,26 @@
 #define   MAXNP            150
 #define   EPS     (double)   2.2204e-016
 
+// Tables of the radix-2/4 fast Fourier Transform, cached per size (see FilterFFTPlan)
+
+#define   FILTER_FFT_PLANS_MAX    31
+
+typedef struct _filterFFTPlan
+ {
+  int     size;                                                                 // number of complex points (power of 2)
+  int     radix2;                                                               // 1 if log2(size) is odd (first stage is radix-2)
+  int    *bitrev;                                                               // bit-reversed index of each point
+  double *twiddleRe,*twiddleIm;                                                 // twiddle factors of the radix-4 stages
+  double *postRe,*postIm;                                                       // factors used by realft, index 0..size/2
+ }
+FILTER_FFT_PLAN;
+
+static FILTER_FFT_PLAN *filterFFTPlans[FILTER_FFT_PLANS_MAX];                   // plans shared by all threads (created in the filter_fft_plans critical section)
+static int filterFFTPlansGeneration=0;                                          // incremented when the plans are released
+
+static THREAD_LOCAL FILTER_FFT_PLAN *filterFFTLocalPlans[FILTER_FFT_PLANS_MAX];  // plans already used by the current thread
+static THREAD_LOCAL int filterFFTLocalGeneration=0;                             // value of filterFFTPlansGeneration for filterFFTLocalPlans
+
 // -----------------------------------------------------
 // FILTER_OddEvenCorrection : Odd/Even pixels correction
 // -----------------------------------------------------
@@ -221,6 +249,287 @@ void fourier(double *data,int nn,int is)
    }
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      FilterFFTPlanFree
+// -----------------------------------------------------------------------------
+// PURPOSE       Release a plan created by FilterFFTPlanCreate
+//
+// INPUT         pPlan  the plan to release (may be partially allocated)
+// -----------------------------------------------------------------------------
+
+static void FilterFFTPlanFree(FILTER_FFT_PLAN *pPlan)
+ {
+  if (pPlan!=NULL)
+   {
+    free(pPlan->bitrev);
+    free(pPlan->twiddleRe);
+    free(pPlan->twiddleIm);
+    free(pPlan->postRe);
+    free(pPlan->postIm);
+    free(pPlan);
+   }
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      FilterFFTPlanCreate
+// -----------------------------------------------------------------------------
+// PURPOSE       Precompute the tables used by FilterFFT for a given size
+//
+// INPUT         size      the number of complex points (power of 2)
+//               log2Size  log2(size)
+//
+// RETURN        the new plan, NULL on allocation error
+// -----------------------------------------------------------------------------
+
+static FILTER_FFT_PLAN *FilterFFTPlanCreate(int size,int log2Size)
+ {
+  // Declarations
+
+  FILTER_FFT_PLAN *pPlan;
+  int nTwiddles,L,k,j,r,b,offset;
+
+  // Total number of twiddle factors of the radix-4 stages (3*L per stage)
+
+  for (L=(log2Size%2)?2:1,nTwiddles=0;L<size;L*=4)
+   nTwiddles+=3*L;
+
+  if (((pPlan=(FILTER_FFT_PLAN *)calloc(1,sizeof(FILTER_FFT_PLAN)))==NULL) ||
+      ((pPlan->bitrev=(int *)malloc(size*sizeof(int)))==NULL) ||
+      ((pPlan->twiddleRe=(double *)malloc((nTwiddles+1)*sizeof(double)))==NULL) ||
+      ((pPlan->twiddleIm=(double *)malloc((nTwiddles+1)*sizeof(double)))==NULL) ||
+      ((pPlan->postRe=(double *)malloc((size/2+1)*sizeof(double)))==NULL) ||
+      ((pPlan->postIm=(double *)malloc((size/2+1)*sizeof(double)))==NULL))
+   {
+    FilterFFTPlanFree(pPlan);
+    return NULL;
+   }
+
+  pPlan->size=size;
+  pPlan->radix2=log2Size%2;
+
+  // Bit reversal permutation
+
+  for (j=0;j<size;j++)
+   {
+    for (b=0,r=0;b<log2Size;b++)
+     r|=((j>>b)&1)<<(log2Size-1-b);
+    pPlan->bitrev[j]=r;
+   }
+
+  // Twiddle factors exp(i*2*PI*m*k/(4L)) of the radix-4 stages, m=1,2,3 and k=0..L-1
+
+  for (L=(pPlan->radix2)?2:1,offset=0;L<size;offset+=3*L,L*=4)
+   for (k=0;k<L;k++)
+    for (j=1;j<=3;j++)
+     {
+      pPlan->twiddleRe[offset+(j-1)*L+k]=cos(PI2*j*k/(4*L));
+      pPlan->twiddleIm[offset+(j-1)*L+k]=sin(PI2*j*k/(4*L));
+     }
+
+  // Factors exp(i*PI*k/size) used by realft to separate the transforms of the odd and even points
+
+  for (k=0;k<=size/2;k++)
+   {
+    pPlan->postRe[k]=cos(DOAS_PI*k/size);
+    pPlan->postIm[k]=sin(DOAS_PI*k/size);
+   }
+
+  // Return
+
+  return pPlan;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      FilterFFTPlan
+// -----------------------------------------------------------------------------
+// PURPOSE       Get the cached plan of a given size
+//
+// INPUT         size  the number of complex points
+//
+// RETURN        the plan, NULL if size is not a power of 2 or on allocation error
+//
+// REMARK        plans are created on first use and kept until FILTER_ReleaseFFTPlans;
+//               they are never modified afterwards so that they can be shared by
+//               all threads.  Each thread keeps the plans it already used, so that
+//               the critical section is only entered the first time a thread uses
+//               a size.
+// -----------------------------------------------------------------------------
+
+static FILTER_FFT_PLAN *FilterFFTPlan(int size)
+ {
+  // Declarations
+
+  FILTER_FFT_PLAN *pPlan;
+  int log2Size;
+
+  // Initialization
+
+  pPlan=NULL;
+
+  for (log2Size=0;(log2Size<FILTER_FFT_PLANS_MAX) && ((1<<log2Size)<size);log2Size++);
+
+  if ((size>=1) && (log2Size<FILTER_FFT_PLANS_MAX) && ((1<<log2Size)==size))
+   {
+    // The plans of the thread have been released
+
+    if (filterFFTLocalGeneration!=filterFFTPlansGeneration)
+     {
+      memset(filterFFTLocalPlans,0,sizeof(filterFFTLocalPlans));
+      filterFFTLocalGeneration=filterFFTPlansGeneration;
+     }
+
+    if ((pPlan=filterFFTLocalPlans[log2Size])==NULL)
+     {
+      #if defined(_OPENMP)
+      #pragma omp critical (filter_fft_plans)
+      #endif
+       {
+        if ((pPlan=filterFFTPlans[log2Size])==NULL)
+         pPlan=filterFFTPlans[log2Size]=FilterFFTPlanCreate(size,log2Size);
+       }
+
+      filterFFTLocalPlans[log2Size]=pPlan;
+     }
+   }
+
+  // Return
+
+  return pPlan;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      FILTER_ReleaseFFTPlans
+// -----------------------------------------------------------------------------
+// PURPOSE       Release the cached tables of the fast Fourier Transforms
+//
+// REMARK        must be called outside of parallel regions; the plans kept by
+//               the threads are discarded on their next use.
+// -----------------------------------------------------------------------------
+
+void FILTER_ReleaseFFTPlans(void)
+ {
+  // Declarations
+
+  int i;
+
+  // Release the plans
+
+  for (i=0;i<FILTER_FFT_PLANS_MAX;i++)
+   {
+    FilterFFTPlanFree(filterFFTPlans[i]);
+    filterFFTPlans[i]=NULL;
+   }
+
+  filterFFTPlansGeneration++;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      FilterFFT
+// -----------------------------------------------------------------------------
+// PURPOSE       Radix-2/4 fast Fourier Transform; same conventions as fourier
+//
+// INPUT         pPlan  the plan of the transform
+//               is     +1 for the forward transform, -1 for the inverse one
+//
+// INPUT/OUTPUT  data   complex array of pPlan->size points (1-based, ie real
+//                      array of length 2*pPlan->size)
+//
+// RETURN        ERROR_ID_ALLOC if the working buffer can not be allocated
+//
+// REMARK        the transform is calculated on separated real and imaginary
+//               parts so that the inner loops of the butterflies run on
+//               contiguous arrays and can be vectorized by the compiler.
+// -----------------------------------------------------------------------------
+
+static RC FilterFFT(const FILTER_FFT_PLAN *pPlan,double *data,int is)
+ {
+  // Declarations
+
+  const double *c1,*s1,*c2,*s2,*c3,*s3;
+  double *re,*im,*r0,*r1,*r2,*r3,*i0,*i1,*i2,*i3;
+  double sg,t1r,t1i,t2r,t2i,t3r,t3i,ar,ai,br,bi,cr,ci,dr,di;
+  int size,L,j,k,offset;
+
+  // Initializations
+
+  size=pPlan->size;
+  sg=(is>=0)?(double)1.:(double)-1.;
+
+  if ((re=MEMORY_AllocScratchDVector(__func__,"re",0,2*size-1))==NULL)
+   return ERROR_ID_ALLOC;
+
+  im=re+size;
+
+  // Bit-reversal section
+
+  for (j=0;j<size;j++)
+   {
+    re[j]=data[2*pPlan->bitrev[j]+1];
+    im[j]=data[2*pPlan->bitrev[j]+2];
+   }
+
+  // Radix-2 first stage when log2(size) is odd
+
+  if (pPlan->radix2)
+   for (j=0;j<size;j+=2)
+    {
+     ar=re[j]; ai=im[j];
+     re[j]=ar+re[j+1];
+     im[j]=ai+im[j+1];
+     re[j+1]=ar-re[j+1];
+     im[j+1]=ai-im[j+1];
+    }
+
+  // Radix-4 stages; after the previous stage, the blocks of a group hold the transforms of the points 4n, 4n+2, 4n+1 and 4n+3
+
+  for (L=(pPlan->radix2)?2:1,offset=0;L<size;offset+=3*L,L*=4)
+   {
+    c1=pPlan->twiddleRe+offset; s1=pPlan->twiddleIm+offset;
+    c2=c1+L; s2=s1+L;
+    c3=c2+L; s3=s2+L;
+
+    for (j=0;j<size;j+=4*L)
+     {
+      r0=re+j; r1=r0+L; r2=r1+L; r3=r2+L;
+      i0=im+j; i1=i0+L; i2=i1+L; i3=i2+L;
+
+      for (k=0;k<L;k++)
+       {
+        t1r=c1[k]*r2[k]-sg*s1[k]*i2[k];                                         // W^k * transform of points 4n+1
+        t1i=c1[k]*i2[k]+sg*s1[k]*r2[k];
+        t2r=c2[k]*r1[k]-sg*s2[k]*i1[k];                                         // W^2k * transform of points 4n+2
+        t2i=c2[k]*i1[k]+sg*s2[k]*r1[k];
+        t3r=c3[k]*r3[k]-sg*s3[k]*i3[k];                                         // W^3k * transform of points 4n+3
+        t3i=c3[k]*i3[k]+sg*s3[k]*r3[k];
+
+        ar=r0[k]+t2r; ai=i0[k]+t2i;
+        br=r0[k]-t2r; bi=i0[k]-t2i;
+        cr=t1r+t3r;   ci=t1i+t3i;
+        dr=t1r-t3r;   di=t1i-t3i;
+
+        r0[k]=ar+cr;     i0[k]=ai+ci;
+        r1[k]=br-sg*di;  i1[k]=bi+sg*dr;
+        r2[k]=ar-cr;     i2[k]=ai-ci;
+        r3[k]=br+sg*di;  i3[k]=bi-sg*dr;
+       }
+     }
+   }
+
+  // Interleave the result
+
+  for (j=0;j<size;j++)
+   {
+    data[2*j+1]=re[j];
+    data[2*j+2]=im[j];
+   }
+
+  MEMORY_ReleaseScratchDVector(__func__,"re",re,0);
+
+  // Return
+
+  return ERROR_ID_NO;
+ }
+
 // -----------------------------------------------------------------------------
 // FUNCTION      realft
 // -----------------------------------------------------------------------------
@@ -241,6 +550,7 @@ void realft(double *source,double *buffer,int nn,int is)
   double wr,wi,wpr,wpi,wtemp,theta;
   double c1,c2,h1r,h1i,h2r,h2i,wrs,wis;
   int index,index1,index2,index3,index4,n2p3,ndemi;
+  const FILTER_FFT_PLAN *pPlan;
 
   // Make a copy of the original data
 
@@ -249,6 +559,7 @@ void realft(double *source,double *buffer,int nn,int is)
   // Initializations
 
   ndemi=nn/2;
+  pPlan=FilterFFTPlan(ndemi);                                                   // NULL if the tables are not available; the original algorithm is used then
   theta=DOAS_PI/(double)ndemi;
   c1=0.5;
 
@@ -257,7 +568,9 @@ void realft(double *source,double *buffer,int nn,int is)
   if (is==1)
    {
     c2=-0.5;
-    fourier(buffer,ndemi,is);
+
+    if ((pPlan==NULL) || FilterFFT(pPlan,buffer,is))
+     fourier(buffer,ndemi,is);
    }
 
   // Set up for an inverse transform
@@ -279,8 +592,8 @@ void realft(double *source,double *buffer,int nn,int is)
     index2=index1+1;
     index3=n2p3-index2;
     index4=index3+1;
-    wrs=(double)wr;
-    wis=(double)wi;
+    wrs=(pPlan!=NULL)?pPlan->postRe[index-1]:wr;
+    wis=(pPlan!=NULL)?is*pPlan->postIm[index-1]:wi;
     h1r=c1*(buffer[index1]+buffer[index3]);                                     // the two separate transforms are separated out of data
     h1i=c1*(buffer[index2]-buffer[index4]);
     h2r=-c2*(buffer[index2]+buffer[index4]);
@@ -305,7 +618,10 @@ void realft(double *source,double *buffer,int nn,int is)
     h1r=buffer[1];
     buffer[1]=c1*(h1r+buffer[2]);
     buffer[2]=c1*(h1r-buffer[2]);
-    fourier(buffer,ndemi,is);                                                   // inverse fourier transform
+
+    if ((pPlan==NULL) || FilterFFT(pPlan,buffer,is))                             // inverse fourier transform
+     fourier(buffer,ndemi,is);
+
     for (index=1;index<=nn;index++)
      buffer[index]/=ndemi;
    }
@@ -580,6 +896,86 @@ RC FilterPascalTriangle(double *coefficients,int power)
   return rc;
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      FilterCompose
+// -----------------------------------------------------------------------------
+// PURPOSE       Compose the filter function with itself filterNTimes times
+//
+// INPUT         pFilter          filter function and options
+//
+// OUTPUT        pFilter->composedFunction, pFilter->composedSize : half of the
+//               composed (symmetric) filter function, same layout as
+//               filterFunction (composedFunction[1] is the central value)
+//
+// RETURN        ERROR_ID_ALLOC if buffer allocation failed,
+//               0 on success
+//
+// NB            away from the edges, filterNTimes successive convolutions by
+//               FilterConv are equivalent to one convolution by the composed
+//               function.
+// -----------------------------------------------------------------------------
+
+static RC FilterCompose(PRJCT_FILTER *pFilter)
+ {
+  // Declarations
+
+  double *full,*conv;
+  int halfWidth,composedWidth,n,i,j;
+  RC rc;
+
+  // Initializations
+
+  halfWidth=pFilter->filterSize-1;
+  composedWidth=pFilter->filterNTimes*halfWidth;
+  full=conv=NULL;
+  rc=ERROR_ID_NO;
+
+  if ((pFilter->filterNTimes<=0) || (pFilter->filterSize<=0))
+   return rc;
+
+  // Buffers allocation (full composed function from -composedWidth to +composedWidth)
+
+  if (((full=(double *)MEMORY_AllocDVector("FilterCompose","full",-composedWidth,composedWidth))==NULL) ||
+      ((conv=(double *)MEMORY_AllocDVector("FilterCompose","conv",-composedWidth,composedWidth))==NULL) ||
+      ((pFilter->composedFunction=(double *)MEMORY_AllocDVector("FilterCompose","pFilter->composedFunction",1,composedWidth+1))==NULL))
+
+   rc=ERROR_ID_ALLOC;
+
+  else
+   {
+    for (i=-halfWidth;i<=halfWidth;i++)
+     full[i]=pFilter->filterFunction[abs(i)+1];
+
+    // Successive convolutions by the filter function
+
+    for (n=2;n<=pFilter->filterNTimes;n++)
+     {
+      for (i=-n*halfWidth;i<=n*halfWidth;i++)
+       conv[i]=(double)0.;
+
+      for (i=-(n-1)*halfWidth;i<=(n-1)*halfWidth;i++)
+       for (j=-halfWidth;j<=halfWidth;j++)
+        conv[i+j]+=full[i]*pFilter->filterFunction[abs(j)+1];
+
+      memcpy(full-n*halfWidth,conv-n*halfWidth,sizeof(double)*(2*n*halfWidth+1));
+     }
+
+    memcpy(pFilter->composedFunction+1,full,sizeof(double)*(composedWidth+1));
+    pFilter->composedSize=composedWidth+1;
+   }
+
+  // Release allocated buffers
+
+  if (conv!=NULL)
+   MEMORY_ReleaseDVector("FilterCompose","conv",conv,-composedWidth);
+  if (full!=NULL)
+   MEMORY_ReleaseDVector("FilterCompose","full",full,-composedWidth);
+
+  // Return
+
+  return rc;
+ }
+
 // -----------------------------------------------------------------------------
 // FUNCTION      FILTER_Build
 // -----------------------------------------------------------------------------
@@ -690,6 +1086,11 @@ RC FILTER_Build(PRJCT_FILTER *pFilter,double fa1,double fa2,double fa3)
     pFilter->filterEffWidth=(pFilter->filterFunction[1]>0)?(double)1.+2.*pFilter->filterEffWidth/pFilter->filterFunction[1]:1;
    }
 
+  // Composed filter function for the successive passes of FILTER_Vector
+
+  if (!rc && (pFilter->filterFunction!=NULL))
+   rc=FilterCompose(pFilter);
+
   // Return
 
   return rc;
@@ -698,65 +1099,86 @@ RC FILTER_Build(PRJCT_FILTER *pFilter,double fa1,double fa2,double fa3)
 // -----------------------------------------------------------------------------
 // FUNCTION      FilterConv
 // -----------------------------------------------------------------------------
-// PURPOSE       Apply a filter function on a vector by convolution on pixels
+// PURPOSE       Apply a filter function on a range of pixels by convolution
 //
 // INPUT         pFilter          filter function and options
 //               Input            vector to filter
 //               Size             the size of input vector
+//               iMin,iMax        the range of pixels to filter (iMin<=i<iMax)
 //
-// OUTPUT        output           the filtered vector
-//
-// RETURN        ERROR_ID_ALLOC if buffer allocation failed,
-//               0 on success
+// OUTPUT        Output           the filtered pixels (should not overlap Input)
 // -----------------------------------------------------------------------------
 
-RC FilterConv(PRJCT_FILTER *pFilter,double *Input,double *Output,int Size)
+static void FilterConv(PRJCT_FILTER *pFilter,const double *Input,double *Output,int Size,int iMin,int iMax)
  {
   // Declarations
 
-  int     i,j,k;
-  double *ftemp;
-  RC      rc;
+  const double *filterFunction;
+  double sum;
+  int     i,j,k,filterSize;
 
-  // Initialization
+  // Initializations
 
-  rc=ERROR_ID_NO;
+  filterFunction=pFilter->filterFunction;
+  filterSize=pFilter->filterSize;
 
-  // Temporary buffer allocation
+  // Filtering by convolution (mirrored around the current pixel at the edges)
 
-  if ((ftemp=(double *)MEMORY_AllocDVector("FILTER_Conv ","ftemp",0,Size-1))==NULL)
-   rc=ERROR_ID_ALLOC;
-  else
+  for (i=iMin;i<iMax;i++)
    {
-    // Initialize the temporary buffer
+    j=-(filterSize-1);
+    sum=(i-j<Size)?Input[(i-j)]*filterFunction[-j+1]:(double)0.;
+    for (j=j+1;j<filterSize;j++)
+     {
+      k=((i-j<Size)&&(i-j>=0))?i-j:i+j;
 
-    VECTOR_Init(ftemp,(double)0.,Size);
+      if ((k<Size) && (k>=0))
+       sum+=Input[k]*filterFunction[(j<=0)?-j+1:j+1];
+     }
 
-    // Filtering by convolution
+    Output[i]=sum;
+   }
+ }
 
-    for ( i=0; i<Size; i++ )
-      {
-        j=-(pFilter->filterSize-1);
-        ftemp[i]=(i-j<Size)?Input[(i-j)]*pFilter->filterFunction[-j+1]:(double)0.;
-        for (j=j+1;j<pFilter->filterSize;j++)
-         {
-          k=((i-j<Size)&&(i-j>=0))?i-j:i+j;
+// -----------------------------------------------------------------------------
+// FUNCTION      FilterConvComposed
+// -----------------------------------------------------------------------------
+// PURPOSE       Apply the composed filter function on the interior pixels
+//
+// INPUT         pFilter          filter function and options
+//               Input            vector to filter
+//               Size             the size of input vector
+//
+// OUTPUT        Output           the filtered vector from composedSize-1 to
+//                                Size-composedSize (other pixels are left unchanged)
+//
+// NB            the composed function is fully inside the vector for these
+//               pixels, so that the inner loop has no boundary test.
+// -----------------------------------------------------------------------------
 
-          if ((k<Size) && (k>=0))
-           ftemp[i]+=Input[k]*pFilter->filterFunction[(j<=0)?-j+1:j+1];
-         }
-      }
+static void FilterConvComposed(PRJCT_FILTER *pFilter,const double *Input,double *Output,int Size)
+ {
+  // Declarations
 
-    memcpy(Output,ftemp,Size*sizeof(double));
+  const double *composedFunction;
+  double sum;
+  int i,m,composedWidth;
 
-    // Release allocated buffer
+  // Initializations
 
-    MEMORY_ReleaseDVector("FILTER_Conv ","ftemp",ftemp,0);
-   }
+  composedFunction=pFilter->composedFunction;
+  composedWidth=pFilter->composedSize-1;
 
-  // return
+  // Symmetric function : pixels at the same distance are summed first
 
-  return rc;
+  for (i=composedWidth;i<Size-composedWidth;i++)
+   {
+    sum=composedFunction[1]*Input[i];
+    for (m=1;m<=composedWidth;m++)
+     sum+=composedFunction[m+1]*(Input[i-m]+Input[i+m]);
+
+    Output[i]=sum;
+   }
  }
 
 // -----------------------------------------------------------------------------
@@ -775,19 +1197,26 @@ RC FilterConv(PRJCT_FILTER *pFilter,double *Input,double *Output,int Size)
 // RETURN        ERROR_ID_ALLOC if buffer allocation failed,
 //               return code of the filtering function if any
 //               0 on success
+//
+// NB            the interior pixels are filtered in one pass with the composed
+//               function built by FILTER_Build;  the filterNTimes passes of
+//               FilterConv are only applied on both edges of the vector, on the
+//               pixels the edge pixels depend on.
 // -----------------------------------------------------------------------------
 
 RC FILTER_Vector(PRJCT_FILTER *pFilter,double *Input,double *Output,double *tmpVector,int Size,int outputType)
  {
   // Declarations
 
-  double *tempVector;
+  double *tempVector,*passVector[2];
+  const double *passInput;
+  int composedWidth,halfWidth,nPixels;
   INDEX i,j;
   RC rc;
 
   // Initializations
 
-  tempVector=NULL;
+  tempVector=passVector[0]=passVector[1]=NULL;
   rc=ERROR_ID_NO;
 
   if (Size>0)
@@ -796,35 +1225,63 @@ RC FILTER_Vector(PRJCT_FILTER *pFilter,double *Input,double *Output,double *tmpV
      for (i=0;i<Size;i++)
       tmpVector[i]=(double)0.;
 
-    if ((tempVector=(double *)MEMORY_AllocDVector("FILTER_vector ","tempVector",0,Size-1))==NULL)
+    if (((tempVector=(double *)MEMORY_AllocScratchDVector("FILTER_vector ","tempVector",0,Size-1))==NULL) ||
+        ((pFilter->filterNTimes>0) &&
+        (((passVector[0]=(double *)MEMORY_AllocScratchDVector("FILTER_vector ","passVector[0]",0,Size-1))==NULL) ||
+         ((passVector[1]=(double *)MEMORY_AllocScratchDVector("FILTER_vector ","passVector[1]",0,Size-1))==NULL))))
+
      rc=ERROR_ID_ALLOC;
+
     else
      {
-      memcpy(tempVector,Input,sizeof(double)*Size);
-      for (i=0;(i<pFilter->filterNTimes) && !rc;i++)
-       rc=FilterConv(pFilter,tempVector,tempVector,Size);
+      halfWidth=pFilter->filterSize-1;
+      composedWidth=(pFilter->composedFunction!=NULL)?pFilter->composedSize-1:Size;
+      passInput=Input;
+
+      if (pFilter->filterNTimes<=0)
+       memcpy(tempVector,Input,sizeof(double)*Size);
+
+      // Interior pixels in one pass, edges with the successive passes
+
+      else if (Size>4*composedWidth)
+       {
+        FilterConvComposed(pFilter,Input,tempVector,Size);
 
-      if (i==pFilter->filterNTimes)
+        for (i=1;i<=pFilter->filterNTimes;i++,passInput=passVector[i%2])
+         {
+          nPixels=2*composedWidth-i*halfWidth;
+          FilterConv(pFilter,passInput,(i<pFilter->filterNTimes)?passVector[(i+1)%2]:tempVector,Size,0,nPixels);
+          FilterConv(pFilter,passInput,(i<pFilter->filterNTimes)?passVector[(i+1)%2]:tempVector,Size,Size-nPixels,Size);
+         }
+       }
+
+      // Short vectors : successive passes on the whole vector
+
+      else
        {
-        if (tmpVector!=NULL)
-         memcpy(tmpVector,tempVector,sizeof(double)*Size);
-
-        if (outputType==PRJCT_FILTER_OUTPUT_LOW)
-         memcpy(Output,tempVector,sizeof(double)*Size);
-        else if (outputType==PRJCT_FILTER_OUTPUT_HIGH_SUB)
-         for (j=0;j<Size;j++)
-          Output[j]=Input[j]-tempVector[j];
-        else if (outputType==PRJCT_FILTER_OUTPUT_HIGH_DIV)
-         for (j=0;j<Size;j++)
-          Output[j]=(tempVector[j]!=(double)0.)?Input[j]/tempVector[j]:(double)0.;
+        for (i=1;i<=pFilter->filterNTimes;i++,passInput=passVector[i%2])
+         FilterConv(pFilter,passInput,(i<pFilter->filterNTimes)?passVector[(i+1)%2]:tempVector,Size,0,Size);
        }
+
+      if (tmpVector!=NULL)
+       memcpy(tmpVector,tempVector,sizeof(double)*Size);
+
+      if (outputType==PRJCT_FILTER_OUTPUT_LOW)
+       memcpy(Output,tempVector,sizeof(double)*Size);
+      else if (outputType==PRJCT_FILTER_OUTPUT_HIGH_SUB)
+       for (j=0;j<Size;j++)
+        Output[j]=Input[j]-tempVector[j];
+      else if (outputType==PRJCT_FILTER_OUTPUT_HIGH_DIV)
+       for (j=0;j<Size;j++)
+        Output[j]=(tempVector[j]!=(double)0.)?Input[j]/tempVector[j]:(double)0.;
      }
    }
 
-  // Release allocated vector
+  // Release allocated vectors (reverse order of the allocations)
 
-  if (tempVector!=NULL)
-   MEMORY_ReleaseDVector("FILTER_vector ","tempVector",tempVector,0);
+  MEMORY_ReleaseScratchDVector("FILTER_vector ","passVector[1]",passVector[1],0);
+  MEMORY_ReleaseScratchDVector("FILTER_vector ","passVector[0]",passVector[0],0);
+  MEMORY_ReleaseScratchDVector("FILTER_vector ","tempVector",tempVector,0);
 
   // Return
 
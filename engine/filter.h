@@ -9,5 +9,6 @@ RC   FILTER_OddEvenCorrection(double *lambdaData,double *specData,double *output
 RC   FILTER_Vector(PRJCT_FILTER *pFilter,double *Input,double *Output,double *tmpVector,int Size,int outputType);
 RC   FILTER_Build(PRJCT_FILTER *pFilter,double param1,double param2,double param3);
 RC   FILTER_LoadFilter(PRJCT_FILTER *pFilter);
+void FILTER_ReleaseFFTPlans(void);
 
 #endif
@@ -34,9 +34,9 @@ void FIT_PROPERTIES_free(const char *callingFunctionShort, struct fit_properties
   fitprops->linfit=NULL;
 
   if (fitprops->A!=NULL)
-   MEMORY_ReleaseDMatrix(functionNameShort,"A",fitprops->A,0,1);
+   MEMORY_ReleaseAlignedDMatrix(functionNameShort,"A",fitprops->A,0,1);
   if (fitprops->P!=NULL)
-   MEMORY_ReleaseDMatrix(functionNameShort,"P",fitprops->P,0,1);
+   MEMORY_ReleaseAlignedDMatrix(functionNameShort,"P",fitprops->P,0,1);
   if (fitprops->SigmaSqr!=NULL)
    MEMORY_ReleaseDVector(functionNameShort,"SigmaSqr",fitprops->SigmaSqr,0);
   if (fitprops->covar!=NULL)
@@ -62,10 +62,10 @@ RC FIT_PROPERTIES_alloc(const char *callingFunctionShort,struct fit_properties *
   // Allocation
 
   if (fitprops->DimC && fitprops->DimL) {
-    if (((fitprops->A=(double **)MEMORY_AllocDMatrix(__func__,"A",1,fitprops->DimL,0,fitprops->DimC))==NULL) ||
+    if (((fitprops->A=(double **)MEMORY_AllocAlignedDMatrix(__func__,"A",1,fitprops->DimL,0,fitprops->DimC,&fitprops->ldA))==NULL) ||
         ((fitprops->covar=(double **)MEMORY_AllocDMatrix(__func__,"covar",1,fitprops->DimC,1,fitprops->DimC))==NULL) ||
         ((fitprops->SigmaSqr=(double *)MEMORY_AllocDVector(__func__,"SigmaSqr",0,fitprops->DimC))==NULL) ||
-        ((fitprops->DimP>0) && ((fitprops->P=(double **)MEMORY_AllocDMatrix(__func__,"P",1,fitprops->DimL,0,fitprops->DimP))==NULL))) {
+        ((fitprops->DimP>0) && ((fitprops->P=(double **)MEMORY_AllocAlignedDMatrix(__func__,"P",1,fitprops->DimL,0,fitprops->DimP,&fitprops->ldP))==NULL))) {
 
       rc=ERROR_ID_ALLOC;
 
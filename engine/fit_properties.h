@@ -22,6 +22,7 @@ struct fit_properties {
   doas_spectrum *specrange;     // gaps and analysis window limits in pixels units
   double **A; // matrix of linear system in optical density fitting mode, cross sections in intensity fitting
   double **P; // matrix of linear system in  intensity fitting mode
+  int ldA, ldP; // leading dimensions of A and P : columns are stored one after the other in an aligned buffer
   double **covar, *SigmaSqr;
   int DimL, // number of rows in A,P => number of data points in the fit
     DimC, // number of columns in A
@@ -42,6 +42,7 @@
 //
 //  Voigtx - calculate the Voigt profile function in the region determined by
 //           the values of input x and y;
+//  VoigtVector - calculate the Voigt profile function on a vector of distances;
 //  ----------------------------------------------------------------------------
 
 // =======
@@ -466,6 +467,109 @@ double Voigtx(double x,double y)
   return rc;
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      VoigtVector
+// -----------------------------------------------------------------------------
+// PURPOSE       calculate the Voigt profile function on a vector of distances
+//               (same as Voigtx for each element)
+//
+// INPUT         x : the distances from the line center in units of Doppler halfwidths;
+//               n : the number of distances;
+//               y : the ratio of the Lorentzian halfwidth to the Doppler halfwidth;
+//
+// OUTPUT        voigt : the Voigt profile function calculated for each pair (x[i],y)
+//
+// REMARK        the region of each distance is determined first with the same
+//               tests as Voigtx; the runs of consecutive distances in the same
+//               region (long for the sorted distances of a slit function) are
+//               then evaluated by loops without branches that the compiler can
+//               vectorize (y is the same for the whole vector).  The formulas are
+//               the ones of Voigtx, so results are identical.  Points outside the
+//               domain of the approximation are set to 0 with one warning for the
+//               whole vector, as Voigtx does for each point.
+// -----------------------------------------------------------------------------
+
+#define VOIGT_BLOCK 256
+
+void VoigtVector(const double *x,int n,double y,double *voigt)
+ {
+  // Declarations
+
+  double absX,xy,xBad;
+  int    region[VOIGT_BLOCK],                                                   // the region of each distance of the block (0 for none)
+         i0,i,j,k,r,nb,nBad,nOverflow;
+
+  // Initializations
+
+  nBad=nOverflow=0;
+  xBad=(double)0.;
+
+  // Browse blocks of distances
+
+  for (i0=0;i0<n;i0+=VOIGT_BLOCK)
+   {
+    nb=min(VOIGT_BLOCK,n-i0);
+
+    // Region of each distance (same tests as Voigtx)
+
+    for (i=0;i<nb;i++)
+     {
+      absX=fabs(x[i0+i]);
+      xy=absX+y;
+
+      region[i]=(y*y-absX*absX>(double)700.)?-1:
+                (xy>(double)15.)?1:
+               ((xy>(double)5.5) && (xy<(double)15.))?2:
+               ((xy<(double)5.5) && (y>(double)0.195*absX-0.176))?3:
+               ((xy<(double)5.5) && (y<(double)0.195*absX-0.176))?4:0;
+     }
+
+    // Evaluate the runs of distances in the same region
+
+    for (i=0;i<nb;i=j)
+     {
+      r=region[i];
+
+      for (j=i+1;(j<nb) && (region[j]==r);j++);
+
+      if (r==1)
+       for (k=i0+i;k<i0+j;k++)
+        voigt[k]=fRegionI(fabs(x[k]),y);
+      else if (r==2)
+       for (k=i0+i;k<i0+j;k++)
+        voigt[k]=fRegionII(fabs(x[k]),y);
+      else if (r==3)
+       for (k=i0+i;k<i0+j;k++)
+        voigt[k]=fRegionIII(fabs(x[k]),y);
+      else if (r==4)
+       for (k=i0+i;k<i0+j;k++)
+        voigt[k]=fRegionIV(fabs(x[k]),y);
+      else
+       {
+        // Points outside the domain of the approximation
+
+        for (k=i0+i;k<i0+j;k++)
+         voigt[k]=(double)0.;
+
+        if (r<0)
+         nOverflow+=j-i;
+        else if (!nBad)
+         {
+          xBad=fabs(x[i0+i]);
+          nBad+=j-i;
+         }
+        else
+         nBad+=j-i;
+       }
+     }
+   }
+
+  if (nOverflow)
+   ERROR_SetLast("VoigtVector",ERROR_TYPE_WARNING,ERROR_ID_OVERFLOW);
+  if (nBad)
+   ERROR_SetLast("VoigtVector",ERROR_TYPE_WARNING,ERROR_ID_VOIGT,xBad,y);
+ }
+
 /************************************************************************************************
  *                                                                                              *
  * FUNCTION:  Voigt(xinf,xsup,y,Nbp,*lpVoigt)                                                   *
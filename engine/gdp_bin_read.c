@@ -1054,7 +1054,7 @@ static RC GdpBinNewRef(const ENGINE_CONTEXT *pEngineContext,void *responseHandle
 
         // align ref w.r.t irradiance reference:
         double sigma_shift, sigma_stretch, sigma_stretch2; // not used here...
-        rc = ANALYSE_fit_shift_stretch(1, 0, pTabFeno->SrefEtalon, ref->spectrum,
+        rc = ANALYSE_fit_shift_stretch(&ANALYSE_mainWorkspace,1, 0, pTabFeno->SrefEtalon, ref->spectrum,
                                        &ref->shift, &ref->stretch, &ref->stretch2, \
                                        &sigma_shift, &sigma_stretch, &sigma_stretch2);
       }
@@ -1245,7 +1245,7 @@ RC GDP_BIN_LoadAnalysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle) {
     if (useKurucz || (THRD_id==THREAD_TYPE_KURUCZ)) {
       KURUCZ_Init(0,0);
 
-      if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(NULL,0,saveFlag,0,responseHandle,0))!=ERROR_ID_NO))
+      if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(&ANALYSE_mainWorkspace,NULL,0,saveFlag,0,responseHandle,0))!=ERROR_ID_NO))
         goto EndGOME_LoadAnalysis;
     }
 
@@ -1263,7 +1263,7 @@ RC GDP_BIN_LoadAnalysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle) {
     // Reference
 
     if ((THRD_id==THREAD_TYPE_ANALYSIS) && gdpBinLoadReferenceFlag && !(rc=GdpBinNewRef(pEngineContext,responseHandle)))
-      rc=ANALYSE_AlignReference(pEngineContext,2,responseHandle,0); // automatic ref selection
+      rc=ANALYSE_AlignReference(&ANALYSE_mainWorkspace,pEngineContext,2,responseHandle,0); // automatic ref selection
 
     if (rc==ERROR_ID_NO_REF)
       for (i=GDP_BIN_currentFileIndex+1;i<gdpBinOrbitFilesN;i++)
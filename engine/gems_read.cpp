@@ -2,6 +2,7 @@
 #include <map>
 #include <cassert>
 #include <vector>
+#include <algorithm>
 #include <cstdint>
 
 #include <iostream>
@@ -10,6 +11,7 @@
 
 #include "gems_read.h"
 #include "netcdfwrapper.h"
+#include "l1_preload.h"
 
 extern "C" {
 #include <math.h>
@@ -36,6 +38,9 @@ static size_t n_wve;       // number of wavelengths
 static size_t n_rows;      // number of rows, cross-track
 static size_t n_images;    // number of images, along-track
 static bool   wve_reordering_flag;
+static bool   has_radiance; // radiance file (dimension dim_image_x) or irradiance file
+static bool   preload_pending=false; // start the preload of the images (see L1_SetPreloadBudget) with the first record
+static vector<double> radiance_wavelengths; // wavelengths of each row, read at the start of the preload
 static int    loadReferenceFlag=0; // if ((THRD_id==THREAD_TYPE_ANALYSIS) && pEngineContext->analysisRef.refAuto)
                                    // N/A here because files of the current orbit are not pre-loaded
 
@@ -75,6 +80,62 @@ void GEMS_get_orbit_date(int *orbit_year, int *orbit_month, int *orbit_day) {
   *orbit_day=gems_orbit_day;
 }
 
+// size in bytes of an image in the preload buffer : the spectra of all rows (double) followed
+// by the bad pixel masks (short), rounded up to keep the spectra of the next image aligned
+
+static size_t preload_image_size(void)
+ {
+  return (n_rows*n_wve*(sizeof(double)+sizeof(short))+sizeof(double)-1)/sizeof(double)*sizeof(double);
+ }
+
+// read the images first to first+count-1 (one hyperslab per variable) in the layout of the
+// preload buffer (see preload_image_size), whatever the order of the dimensions in the file
+
+static void read_images(size_t first,size_t count,char *buffer)
+ {
+  const size_t start[] = {(wve_reordering_flag)?first:0,0,(wve_reordering_flag)?0:first};
+  const size_t count_s[] = {(wve_reordering_flag)?count:n_wve,n_rows,(wve_reordering_flag)?n_wve:count};
+
+  vector<double> spectra(count*n_rows*n_wve);
+  vector<short> masks(count*n_rows*n_wve);
+
+  radiance_file.getVar("image_pixel_values", start, count_s, spectra.data());
+  radiance_file.getVar("bad_pixel_mask", start, count_s, masks.data());
+
+  for (size_t i=0;i<count;i++)
+   {
+    double *image_spectra=reinterpret_cast<double *>(buffer+i*preload_image_size());
+    short *image_masks=reinterpret_cast<short *>(image_spectra+n_rows*n_wve);
+
+    for (size_t row=0;row<n_rows;row++)
+     for (size_t j=0;j<n_wve;j++)
+      {
+       size_t index=(wve_reordering_flag)?(i*n_rows+row)*n_wve+j:(j*n_rows+row)*count+i;
+
+       image_spectra[row*n_wve+j]=spectra[index];
+       image_masks[row*n_wve+j]=masks[index];
+      }
+   }
+ }
+
+// read the wavelengths of all rows (main thread) and start the preload of the images
+
+static void start_preload(void)
+ {
+  const size_t start[] = {0,0};
+  const size_t count[] = {(wve_reordering_flag)?n_rows:n_wve,(wve_reordering_flag)?n_wve:n_rows};
+  vector<double> wavelengths(n_rows*n_wve);
+
+  radiance_file.getVar("wavelength", start, count, wavelengths.data());
+
+  radiance_wavelengths.resize(n_rows*n_wve);
+  for (size_t row=0;row<n_rows;row++)
+   for (size_t j=0;j<n_wve;j++)
+    radiance_wavelengths[row*n_wve+j]=wavelengths[(wve_reordering_flag)?row*n_wve+j:j*n_rows+row];
+
+  l1_preload_start(n_images,preload_image_size(),read_images);
+ }
+
 static void read_data_fields(NetCDFFile& orbit_file) //,bool *use_row,INDEX *use_row_index) 
  {
   // Float fields one dimension
@@ -276,6 +337,7 @@ int GEMS_Set(ENGINE_CONTEXT *pEngineContext) {
   int rc = 0;
 
   try {
+    L1_PreloadStop(); // the loader thread reads the previous file
     radiance_file = NetCDFFile(pEngineContext->fileInfo.fileName, nc_cache_size);
     radiance_file_data = data_fields();
     
@@ -287,6 +349,7 @@ int GEMS_Set(ENGINE_CONTEXT *pEngineContext) {
     
     has_radiance=radiance_file.hasDim("dim_image_x");
     has_irradiance=!has_radiance;
+    preload_pending=has_radiance;
 
     n_images = (has_radiance)?radiance_file.dimLen("dim_image_x"):1;
     n_wve=radiance_file.dimLen("dim_image_band");
@@ -352,7 +415,7 @@ int GEMS_Read(ENGINE_CONTEXT *pEngineContext, int record)
    {
     try
      {
-      if ((THRD_id==THREAD_TYPE_KURUCZ) || !radiance_file.hasDim("dim_image_x"))
+      if ((THRD_id==THREAD_TYPE_KURUCZ) || !has_radiance)
        {
         const size_t start[] = {(wve_reordering_flag)?i_crosstrack:0,(wve_reordering_flag)?0:i_crosstrack}; 
         const size_t count[] = {(wve_reordering_flag)?1:n_wve,(wve_reordering_flag)?n_wve:1};         
@@ -362,16 +425,38 @@ int GEMS_Read(ENGINE_CONTEXT *pEngineContext, int record)
         radiance_file.getVar("wavelength", start, count, pEngineContext->buffers.lambda);
         radiance_file.getVar("image_pixel_values", start, count, pEngineContext->buffers.spectrum);
        }
-      else if (radiance_file.hasDim("dim_image_x"))
+      else if (has_radiance)
        {
-        const size_t start_s[] = {(wve_reordering_flag)?i_alongtrack:0,i_crosstrack,(wve_reordering_flag)?0:i_alongtrack};
-        const size_t count_s[] = {(wve_reordering_flag)?1:n_wve,1,(wve_reordering_flag)?n_wve:1};
-        const size_t start_w[] = {(wve_reordering_flag)?i_crosstrack:0,(wve_reordering_flag)?0:i_crosstrack};
-        const size_t count_w[] = {(wve_reordering_flag)?1:n_wve,(wve_reordering_flag)?n_wve:1};
-        
-        radiance_file.getVar("wavelength", start_w, count_w, pEngineContext->buffers.lambda);
-        radiance_file.getVar("image_pixel_values", start_s, count_s, pEngineContext->buffers.spectrum);
-        radiance_file.getVar("bad_pixel_mask", start_s, count_s, pixelQF);
+        // the preload starts with the first record, once the reference files have been read
+        // (the loader thread must be the only one to read NetCDF files)
+
+        if (preload_pending)
+         {
+          preload_pending=false;
+          start_preload();
+         }
+
+        if (l1_preload_active())
+         {
+          const double *image_spectra=reinterpret_cast<const double *>(l1_preload_get(i_alongtrack));
+          const double *spectrum=image_spectra+i_crosstrack*n_wve;
+          const short *mask=reinterpret_cast<const short *>(image_spectra+n_rows*n_wve)+i_crosstrack*n_wve;
+
+          std::copy(radiance_wavelengths.begin()+i_crosstrack*n_wve,radiance_wavelengths.begin()+(i_crosstrack+1)*n_wve,pEngineContext->buffers.lambda);
+          std::copy(spectrum,spectrum+n_wve,pEngineContext->buffers.spectrum);
+          std::copy(mask,mask+n_wve,pixelQF);
+         }
+        else
+         {
+          const size_t start_s[] = {(wve_reordering_flag)?i_alongtrack:0,i_crosstrack,(wve_reordering_flag)?0:i_alongtrack};
+          const size_t count_s[] = {(wve_reordering_flag)?1:n_wve,1,(wve_reordering_flag)?n_wve:1};
+          const size_t start_w[] = {(wve_reordering_flag)?i_crosstrack:0,(wve_reordering_flag)?0:i_crosstrack};
+          const size_t count_w[] = {(wve_reordering_flag)?1:n_wve,(wve_reordering_flag)?n_wve:1};
+
+          radiance_file.getVar("wavelength", start_w, count_w, pEngineContext->buffers.lambda);
+          radiance_file.getVar("image_pixel_values", start_s, count_s, pEngineContext->buffers.spectrum);
+          radiance_file.getVar("bad_pixel_mask", start_s, count_s, pixelQF);
+         }
 
         nbad=0;
         for (int i=0;i<(int)n_wve;i++)
@@ -456,7 +541,10 @@ int GEMS_Read(ENGINE_CONTEXT *pEngineContext, int record)
  }
 
 void gems_clean(void) {
+  L1_PreloadStop();
   radiance_file.close();
+  radiance_wavelengths.clear();
+  preload_pending=has_radiance=false;
   
   gems_orbit_year=gems_orbit_month=gems_orbit_day=0;
 
@@ -623,7 +711,7 @@ RC GEMS_LoadAnalysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
   if (useKurucz || (THRD_id==THREAD_TYPE_KURUCZ)) {
     KURUCZ_Init(0,indexFenoColumn);
 
-    if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(NULL,0,saveFlag,0,responseHandle,indexFenoColumn)) !=ERROR_ID_NO))
+    if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(&ANALYSE_mainWorkspace,NULL,0,saveFlag,0,responseHandle,indexFenoColumn)) !=ERROR_ID_NO))
     {
        // Error on one irradiance spectrum shouldn't stop the analysis of other spectra
        ERROR_SetLast(__func__, ERROR_TYPE_WARNING, ERROR_ID_IMAGER_CALIB, 1+indexFenoColumn);
@@ -667,7 +755,7 @@ RC GEMS_LoadAnalysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
    if ((THRD_id!=THREAD_TYPE_KURUCZ) && useRef2)
 //      ( (gome1netCDF_loadReferenceFlag && !(rc=GOME1NETCDF_NewRef(pEngineContext,responseHandle))) || useRef2))
     for (int indexFenoColumn=0;(indexFenoColumn<ANALYSE_swathSize) && !rc;indexFenoColumn++)
-      rc=ANALYSE_AlignReference(pEngineContext,2,responseHandle,indexFenoColumn); // 2 is for automatic mode
+      rc=ANALYSE_AlignReference(&ANALYSE_mainWorkspace,pEngineContext,2,responseHandle,indexFenoColumn); // 2 is for automatic mode
 
   // if (!rc) gome1netCDF_loadReferenceFlag=0;
 
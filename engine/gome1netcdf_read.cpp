@@ -1550,7 +1550,7 @@ RC GOME1NETCDF_NewRef(ENGINE_CONTEXT *pEngineContext,void *responseHandle) {
 	// align ref w.r.t irradiance reference:
 	double sigma_shift, sigma_stretch, sigma_stretch2; // not used here...
 
-	rc = ANALYSE_fit_shift_stretch(1, 0, pTabFeno->SrefEtalon, ref->spectrum,
+	rc = ANALYSE_fit_shift_stretch(&ANALYSE_mainWorkspace,1, 0, pTabFeno->SrefEtalon, ref->spectrum,
 				       &ref->shift, &ref->stretch, &ref->stretch2,
 				       &sigma_shift, &sigma_stretch, &sigma_stretch2);
        }
@@ -1744,7 +1744,7 @@ RC GOME1NETCDF_LoadAnalysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
   if (useKurucz || (THRD_id==THREAD_TYPE_KURUCZ)) {
     KURUCZ_Init(0,indexFenoColumn);
 
-    if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(NULL,0,saveFlag,0,responseHandle,indexFenoColumn)) !=ERROR_ID_NO))
+    if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(&ANALYSE_mainWorkspace,NULL,0,saveFlag,0,responseHandle,indexFenoColumn)) !=ERROR_ID_NO))
       goto EndGOME1NETCDF_LoadAnalysis;
   }
  }
@@ -1768,7 +1768,7 @@ RC GOME1NETCDF_LoadAnalysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
    if ((THRD_id!=THREAD_TYPE_KURUCZ) &&
       ( (gome1netCDF_loadReferenceFlag && !(rc=GOME1NETCDF_NewRef(pEngineContext,responseHandle))) || useRef2))
     for (int indexFenoColumn=0;(indexFenoColumn<ANALYSE_swathSize) && !rc;indexFenoColumn++)
-      rc=ANALYSE_AlignReference(pEngineContext,2,responseHandle,indexFenoColumn); // 2 is for automatic mode
+      rc=ANALYSE_AlignReference(&ANALYSE_mainWorkspace,pEngineContext,2,responseHandle,indexFenoColumn); // 2 is for automatic mode
 
   if (!rc) gome1netCDF_loadReferenceFlag=0;
 
@@ -312,6 +312,20 @@ int GOME2_beatLoaded=0;
 static int gome2LoadReferenceFlag=0;
 static int gome2TotalRecordNumber=0;
 
+// radiances and errors of one band of the last MDR read, decoded in one pass
+
+static struct gome2_mdr_cache {
+  INDEX    indexFile,indexMDR,indexBand;                                        // the decoded band (ITEM_NONE if the cache is empty)
+  long     n_elements;                                                          // number of pixels of all the observations of the MDR
+  long     allocated;                                                           // number of pixels the buffers can hold
+  int64_t  raw_size;                                                            // size of the raw buffer in bytes
+  uint8_t *raw;                                                                 // raw bytes of the band array
+  double  *radiance,*error;                                                     // decoded radiances and errors
+} gome2MdrCache = { ITEM_NONE, ITEM_NONE, ITEM_NONE, 0, 0, 0, NULL, NULL, NULL };
+
+static double gome2Pow10[256];                                                  // 10^(-scale) for the scale factors -128..127 of the vsf integers
+static int gome2Pow10Set=0;
+
 // =========
 // FUNCTIONS
 // =========
@@ -430,37 +444,6 @@ int read_utc_string(coda_Cursor *cursor, char *utc_string, double *data) {
   return status;
 }
 
-// -----------------------------------------------------------------------------
-// FUNCTION      Gome2GotoOBS
-// -----------------------------------------------------------------------------
-// PURPOSE       Move cursor to the requested radiance record
-//
-// INPUT         indexBand      index of the selected band
-//               indexMDR       index of the requested MDR
-//               indexObs       index of the radiance record in the MDR
-// -----------------------------------------------------------------------------
-
-void Gome2GotoOBS(GOME2_ORBIT_FILE *pOrbitFile,INDEX indexBand,INDEX indexMDR,INDEX indexObs) {
-  // Declarations
-
-  int obsToBypass;
-
-  // Initializations
-
-  obsToBypass=indexObs*pOrbitFile->gome2Info.mdr[indexMDR].rec_length[indexBand];
-
-  // Goto the current MDR
-
-  coda_cursor_goto_root(&pOrbitFile->gome2Cursor);
-  coda_cursor_goto_record_field_by_name(&pOrbitFile->gome2Cursor,"MDR");
-  coda_cursor_goto_array_element_by_index(&pOrbitFile->gome2Cursor,pOrbitFile->gome2Info.mdr[indexMDR].indexMDR);
-
-  coda_cursor_goto_available_union_field(&pOrbitFile->gome2Cursor);                         // MDR.GOME2_MDR_L1B_EARTHSHINE_V1
-  coda_cursor_goto_record_field_by_name(&pOrbitFile->gome2Cursor,gome2BandName[indexBand]);    // MDR.GOME2_MDR_L1B_EARTHSHINE_V1.band(indexBand)
-
-  coda_cursor_goto_array_element_by_index(&pOrbitFile->gome2Cursor,obsToBypass);
-}
-
 // -----------------------------------------------------------------------------
 // FUNCTION      Gome2GetMDRIndex
 // -----------------------------------------------------------------------------
@@ -494,6 +477,182 @@ INDEX Gome2GetMDRIndex(const GOME2_ORBIT_FILE *pOrbitFile,INDEX indexBand,int re
   return indexMDR; // pOrbitFile->gome2Info.mdr[indexMDR].indexMDR;
 }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      Gome2ReleaseMDRCache
+// -----------------------------------------------------------------------------
+// PURPOSE       Release the buffers of the decoded MDR
+// -----------------------------------------------------------------------------
+
+static void Gome2ReleaseMDRCache(void) {
+  if (gome2MdrCache.raw!=NULL)
+    MEMORY_ReleaseBuffer(__func__,"raw",gome2MdrCache.raw);
+  if (gome2MdrCache.radiance!=NULL)
+    MEMORY_ReleaseDVector(__func__,"radiance",gome2MdrCache.radiance,0);
+  if (gome2MdrCache.error!=NULL)
+    MEMORY_ReleaseDVector(__func__,"error",gome2MdrCache.error,0);
+
+  memset(&gome2MdrCache,0,sizeof(gome2MdrCache));
+  gome2MdrCache.indexFile=gome2MdrCache.indexMDR=gome2MdrCache.indexBand=ITEM_NONE;
+}
+
+// -----------------------------------------------------------------------------
+// FUNCTION      Gome2ReadBandMDR
+// -----------------------------------------------------------------------------
+// PURPOSE       Read and decode the radiances and errors of all the
+//               observations of a band in a MDR
+//
+// INPUT         indexFile      index of the file in the list of orbit files
+//               indexBand      index of the selected band
+//               indexMDR       index of the requested MDR
+//
+// RETURN        ERROR_ID_ALLOC   if the allocation of the buffers failed;
+//               ERROR_ID_BEAT    if the band can't be read;
+//               ERROR_ID_NO      otherwise.
+//
+// REMARK        The band is an array of records whose RAD and ERR_RAD fields
+//               are 'vsf_integers' (a scale and a value, stored big-endian).
+//               Walking the cursor through each field of each pixel is slow,
+//               so the whole array is read at once with coda_cursor_read_bytes
+//               and decoded here; the byte offsets of the fields are taken
+//               from the cursor on the first element.  The result is kept
+//               until another band, MDR or file is requested.
+// -----------------------------------------------------------------------------
+
+static RC Gome2ReadBandMDR(GOME2_ORBIT_FILE *pOrbitFile,INDEX indexFile,INDEX indexBand,INDEX indexMDR) {
+  // Declarations
+
+  coda_Cursor *pCursor;                                                         // cursor on the band array
+  int64_t arraySize,elementSize,elementOffset;                                  // size of the array and of its elements, offset of the first element
+  int64_t radScale,radVal,errScale,errVal;                                      // offsets of the fields in an element
+  long n_elements;
+  int status;
+  RC rc;
+
+  // The band has already been decoded
+
+  if ((gome2MdrCache.indexFile==indexFile) && (gome2MdrCache.indexMDR==indexMDR) && (gome2MdrCache.indexBand==indexBand))
+    return ERROR_ID_NO;
+
+  // Initializations
+
+  pCursor=&pOrbitFile->gome2Cursor;
+  gome2MdrCache.indexFile=gome2MdrCache.indexMDR=gome2MdrCache.indexBand=ITEM_NONE;
+  rc=ERROR_ID_NO;
+
+  if (!gome2Pow10Set) {
+    for (int scale=-128; scale<128; scale++)
+      gome2Pow10[scale+128]=pow(10,-scale);
+    gome2Pow10Set=1;
+  }
+
+  // disable conversion of "special types" in order to access value and scale integers separately
+
+  coda_set_option_bypass_special_types(1);
+
+  // Goto the band array of the MDR
+
+  coda_cursor_goto_root(pCursor);
+  status=coda_cursor_goto_record_field_by_name(pCursor,"MDR");
+  if (!status) status=coda_cursor_goto_array_element_by_index(pCursor,pOrbitFile->gome2Info.mdr[indexMDR].indexMDR);
+  if (!status) status=coda_cursor_goto_available_union_field(pCursor);                     // MDR.GOME2_MDR_L1B_EARTHSHINE_V1
+  if (!status) status=coda_cursor_goto_record_field_by_name(pCursor,gome2BandName[indexBand]); // MDR.GOME2_MDR_L1B_EARTHSHINE_V1.band(indexBand)
+  if (!status) status=coda_cursor_get_num_elements(pCursor,&n_elements);
+  if (!status) status=coda_cursor_get_byte_size(pCursor,&arraySize);
+
+  // Layout of the elements
+
+  radScale=radVal=errScale=errVal=elementSize=elementOffset=0;
+
+  if (!status && (n_elements>0)) {
+    status=coda_cursor_goto_first_array_element(pCursor);                                    // BAND[0]
+    if (!status) status=coda_cursor_get_byte_size(pCursor,&elementSize);
+    if (!status) status=coda_cursor_get_file_byte_offset(pCursor,&elementOffset);
+    if (!status) status=coda_cursor_goto_first_record_field(pCursor);                        // BAND[0].RAD
+    if (!status) status=coda_cursor_goto_first_record_field(pCursor);                        // BAND[0].RAD.scale
+    if (!status) status=coda_cursor_get_file_byte_offset(pCursor,&radScale);
+    if (!status) status=coda_cursor_goto_next_record_field(pCursor);                         // BAND[0].RAD.val
+    if (!status) status=coda_cursor_get_file_byte_offset(pCursor,&radVal);
+    if (!status) status=coda_cursor_goto_parent(pCursor);                                    // BAND[0].RAD
+    if (!status) status=coda_cursor_goto_next_record_field(pCursor);                         // BAND[0].ERR_RAD
+    if (!status) status=coda_cursor_goto_first_record_field(pCursor);                        // BAND[0].ERR_RAD.scale
+    if (!status) status=coda_cursor_get_file_byte_offset(pCursor,&errScale);
+    if (!status) status=coda_cursor_goto_next_record_field(pCursor);                         // BAND[0].ERR_RAD.val
+    if (!status) status=coda_cursor_get_file_byte_offset(pCursor,&errVal);
+    if (!status) status=coda_cursor_goto_parent(pCursor);                                    // BAND[0].ERR_RAD
+    if (!status) status=coda_cursor_goto_parent(pCursor);                                    // BAND[0]
+    if (!status) status=coda_cursor_goto_parent(pCursor);                                    // BAND
+
+    radScale-=elementOffset;
+    radVal-=elementOffset;
+    errScale-=elementOffset;
+    errVal-=elementOffset;
+
+    // the elements must be contiguous records of the expected sizes
+
+    if (!status && ((arraySize!=n_elements*elementSize) ||
+                    (radScale<0) || (radVal<0) || (errScale<0) || (errVal<0) ||
+                    (radScale+1>elementSize) || (radVal+4>elementSize) || (errScale+1>elementSize) || (errVal+2>elementSize)))
+      status=-1;
+  }
+
+  // Allocate the buffers
+
+  if (!status && (n_elements>0) && ((n_elements>gome2MdrCache.allocated) || (arraySize>gome2MdrCache.raw_size))) {
+    Gome2ReleaseMDRCache();
+
+    if (((gome2MdrCache.raw=(uint8_t *)MEMORY_AllocBuffer(__func__,"raw",(int)arraySize,sizeof(uint8_t),0,MEMORY_TYPE_STRING))==NULL) ||
+        ((gome2MdrCache.radiance=MEMORY_AllocDVector(__func__,"radiance",0,(int)n_elements-1))==NULL) ||
+        ((gome2MdrCache.error=MEMORY_AllocDVector(__func__,"error",0,(int)n_elements-1))==NULL)) {
+      Gome2ReleaseMDRCache();
+      rc=ERROR_ID_ALLOC;
+    }
+    else {
+      gome2MdrCache.allocated=n_elements;
+      gome2MdrCache.raw_size=arraySize;
+    }
+  }
+
+  // Read the whole array
+
+  if (!status && !rc && (n_elements>0))
+    status=coda_cursor_read_bytes(pCursor,gome2MdrCache.raw,0,arraySize);
+
+  // re-enable CODA handling of "special types"
+
+  coda_set_option_bypass_special_types(0);
+
+  if (status)
+    rc=ERROR_SetLast(__func__,ERROR_TYPE_WARNING,ERROR_ID_BEAT,gome2BandName[indexBand],pOrbitFile->gome2FileName,"");
+  else if (!rc) {
+
+    // Decode the vsf integers : value * 10^(-scale)
+
+    const uint8_t *raw=gome2MdrCache.raw;
+    double *radiance=gome2MdrCache.radiance;
+    double *error=gome2MdrCache.error;
+
+    for (long i=0; i<n_elements; i++,raw+=elementSize) {
+      const uint8_t *pRadVal=raw+radVal;
+      const uint8_t *pErrVal=raw+errVal;
+
+      const int32_t radval=(int32_t)(((uint32_t)pRadVal[0]<<24)|((uint32_t)pRadVal[1]<<16)|((uint32_t)pRadVal[2]<<8)|(uint32_t)pRadVal[3]);
+      const int16_t errval=(int16_t)(((uint16_t)pErrVal[0]<<8)|(uint16_t)pErrVal[1]);
+
+      radiance[i]=(double)radval*gome2Pow10[(int8_t)raw[radScale]+128];
+      error[i]=(double)errval*gome2Pow10[(int8_t)raw[errScale]+128];
+    }
+
+    gome2MdrCache.n_elements=n_elements;
+    gome2MdrCache.indexFile=indexFile;
+    gome2MdrCache.indexMDR=indexMDR;
+    gome2MdrCache.indexBand=indexBand;
+  }
+
+  // Return
+
+  return rc;
+}
+
 // ===============
 // GOME2 FUNCTIONS
 // ===============
@@ -1185,6 +1344,7 @@ void GOME2_ReleaseBuffers(void) {
   gome2OrbitFilesN=0;
   gome2CurrentFileIndex=ITEM_NONE;
 
+  Gome2ReleaseMDRCache();
   free_vza_refs();
 
 #if defined(__DEBUG_) && __DEBUG_
@@ -1433,51 +1593,23 @@ RC GOME2_Read(ENGINE_CONTEXT *pEngineContext,int recordNo,INDEX fileIndex) {
         pEngineContext->buffers.lambda[i] = pGome2Info->mdr[indexMDR].earthshine_wavelength[i];
       }
 
-      // read radiance & error ('RAD' and 'ERR_RAD')
-      //
-      // RAD and ERR_RAD fields are 'vsf_integers', consisting of a
-      // 'value' and 'scale' integer pair.  CODA will automatically
-      // convert these to one number value * 10^(-scale), but it's
-      // slightly faster to disable this conversion and perform the
-      // conversion to double ourselves
-      int32_t radval;
-      int16_t errval;
-      int8_t radscale, errscale;
-      // disable conversion of "special types" in order to access
-      // value and scale integers separately:
-      coda_set_option_bypass_special_types(1);
-
-      Gome2GotoOBS(pOrbitFile, (INDEX) indexBand,indexMDR,recordNo-mdrObs-1);
-      for (int i=0; i < pGome2Info->no_of_pixels && !rc; ++i) {
-        coda_cursor_goto_first_record_field(&pOrbitFile->gome2Cursor);    // MDR.GOME2_MDR_L1B_EARTHSHINE_V1.BAND[i].RAD
-
-        coda_cursor_goto_first_record_field(&pOrbitFile->gome2Cursor);    // MDR.GOME2_MDR_L1B_EARTHSHINE_V1.BAND[i].RAD.scale
-        coda_cursor_read_int8(&pOrbitFile->gome2Cursor, &radscale);
-        coda_cursor_goto_next_record_field(&pOrbitFile->gome2Cursor);    // MDR.GOME2_MDR_L1B_EARTHSHINE_V1.BAND[i].RAD.val
-        coda_cursor_read_int32(&pOrbitFile->gome2Cursor, &radval);
-
-        coda_cursor_goto_parent(&pOrbitFile->gome2Cursor);    // MDR.GOME2_MDR_L1B_EARTHSHINE_V1.BAND[i].RAD
-        coda_cursor_goto_next_record_field(&pOrbitFile->gome2Cursor);    // MDR.GOME2_MDR_L1B_EARTHSHINE_V1.BAND[i].ERR_RAD
-        coda_cursor_goto_first_record_field(&pOrbitFile->gome2Cursor);    // MDR.GOME2_MDR_L1B_EARTHSHINE_V1.BAND[i].ERR_RAD.scale
-        coda_cursor_read_int8(&pOrbitFile->gome2Cursor, &errscale);
-        coda_cursor_goto_next_record_field(&pOrbitFile->gome2Cursor);    // MDR.GOME2_MDR_L1B_EARTHSHINE_V1.BAND[i].ERR_RAD.val
-        coda_cursor_read_int16(&pOrbitFile->gome2Cursor, &errval);
-
-        coda_cursor_goto_parent(&pOrbitFile->gome2Cursor);    // MDR.GOME2_MDR_L1B_EARTHSHINE_V1.BAND[i].ERR_RAD
-        coda_cursor_goto_parent(&pOrbitFile->gome2Cursor);    // MDR.GOME2_MDR_L1B_EARTHSHINE_V1.BAND[i]
-
-        spectrum[i] = ((double) radval) * pow(10, -radscale);
-        sigma[i] = ((double) errval) * pow(10, -errscale);
-
-        if (fabs(spectrum[i]) > (double) 1.e20)
+      // read radiance & error ('RAD' and 'ERR_RAD') : the whole band of
+      // the MDR is decoded at once and kept for the next observations
+
+      if (!(rc=Gome2ReadBandMDR(pOrbitFile,(fileIndex==ITEM_NONE)?gome2CurrentFileIndex:fileIndex,indexBand,indexMDR))) {
+        const long first=(long)(recordNo-mdrObs-1)*pGome2Info->mdr[indexMDR].rec_length[indexBand];
+
+        if (first+n_wavel>gome2MdrCache.n_elements)
           rc=ERROR_ID_FILE_RECORD;
 
-        if (i < (pGome2Info->no_of_pixels - 1)) {     // without CODA bounds checking, this check is necessary to avoid memory corruption when jumping past the last element, according to S Niemeijer at S&T
-          coda_cursor_goto_next_array_element(&pOrbitFile->gome2Cursor);    // MDR.GOME2_MDR_L1B_EARTHSHINE_V1.BAND[i+1]
+        for (int i=0; i < n_wavel && !rc; ++i) {
+          spectrum[i] = gome2MdrCache.radiance[first+i];
+          sigma[i] = gome2MdrCache.error[first+i];
+
+          if (fabs(spectrum[i]) > (double) 1.e20)
+            rc=ERROR_ID_FILE_RECORD;
         }
       }
-      // re-enable CODA handling of "special types"
-      coda_set_option_bypass_special_types(0);
 
       utcTime=pGome2Info->mdr[indexMDR].startTime+tint* (recordNo-mdrObs-2);    // NOV 2011 : problem with integration time (FRESCO comparison)
       coda_double_to_datetime(utcTime,&year,&month,&day,&hour,&min,&sec,&musec);
@@ -1799,7 +1931,7 @@ RC Gome2NewRef(ENGINE_CONTEXT *pEngineContext,void *responseHandle) {
 
         // align ref w.r.t irradiance reference:
         double sigma_shift, sigma_stretch, sigma_stretch2; // not used here...
-        rc = ANALYSE_fit_shift_stretch(1, 0, pTabFeno->SrefEtalon, ref->spectrum,
+        rc = ANALYSE_fit_shift_stretch(&ANALYSE_mainWorkspace,1, 0, pTabFeno->SrefEtalon, ref->spectrum,
                                        &ref->shift, &ref->stretch, &ref->stretch2, \
                                        &sigma_shift, &sigma_stretch, &sigma_stretch2);
       }
@@ -1936,7 +2068,7 @@ RC GOME2_LoadAnalysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle) {
   if (useKurucz || (THRD_id==THREAD_TYPE_KURUCZ)) {
     KURUCZ_Init(0,0);
 
-    if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(NULL,0,saveFlag,0,responseHandle,0)) !=ERROR_ID_NO))
+    if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(&ANALYSE_mainWorkspace,NULL,0,saveFlag,0,responseHandle,0)) !=ERROR_ID_NO))
       goto EndGOME2_LoadAnalysis;
   }
 
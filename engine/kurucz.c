@@ -30,6 +30,8 @@
 //  KURUCZ_Spectrum - apply Kurucz for building a new wavelength scale to a spectrum;
 //  KURUCZ_ApplyCalibration - apply the new calibration to cross sections to interpolate or to convolute and recalculate gaps;
 //  KURUCZ_Reference - browse analysis windows and apply Kurucz if needed on reference spectrum;
+//  KuruczFitWindows - fit the little windows of the calibration at the same time;
+//  KURUCZ_SetThreads - set the number of threads used to fit the little windows;
 //
 //  ====================
 //  RESOURCES MANAGEMENT
@@ -43,6 +45,10 @@
 #include <string.h>
 #include <math.h>
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
 #include "kurucz.h"
 #include "analyse.h"
 #include "mediate.h"
@@ -65,6 +71,8 @@ KURUCZ KURUCZ_buffers[MAX_SWATHSIZE];
 FFT *pKURUCZ_fft;
 int KURUCZ_indexLine=1;
 
+static int kuruczThreadsN=1;                                                    // number of threads used to fit the little windows
+
 // ===========================
 // CALCULATION OF THE PRESHIFT
 // ===========================
@@ -210,6 +218,7 @@ RC KuruczConvolveSolarSpectrum(MATRIX_OBJECT *pSolar,double *newlambda,int n_wav
  {
      // Declarations
 
+     FENO *pFeno;
      CROSS_REFERENCE *TabCross;
   MATRIX_OBJECT slitMatrix[NSFP],*pSlitMatrix;
   double slitParam[NSFP];
@@ -226,8 +235,8 @@ RC KuruczConvolveSolarSpectrum(MATRIX_OBJECT *pSolar,double *newlambda,int n_wav
   // Initializations
 
   pKurucz=&KURUCZ_buffers[indexFenoColumn];
-  Feno=&TabFeno[indexFenoColumn][pKurucz->indexKurucz];
-  TabCross=Feno->TabCross;
+  pFeno=&TabFeno[indexFenoColumn][pKurucz->indexKurucz];
+  TabCross=pFeno->TabCross;
   rc=ERROR_ID_NO;
 
   memset(slitMatrix,0,sizeof(MATRIX_OBJECT)*NSFP);
@@ -248,8 +257,8 @@ RC KuruczConvolveSolarSpectrum(MATRIX_OBJECT *pSolar,double *newlambda,int n_wav
 
     shiftIndex=(nc==2)?0:1;
 
-    fwhmStretch1=(Feno->indexFwhmParam[0]!=ITEM_NONE)?(double)TabCross[Feno->indexFwhmParam[0]].InitParam:(double)1.;
-    fwhmStretch2=(Feno->indexFwhmParam[1]!=ITEM_NONE)?(double)TabCross[Feno->indexFwhmParam[1]].InitParam:(double)1.;
+    fwhmStretch1=(pFeno->indexFwhmParam[0]!=ITEM_NONE)?(double)TabCross[pFeno->indexFwhmParam[0]].InitParam:(double)1.;
+    fwhmStretch2=(pFeno->indexFwhmParam[1]!=ITEM_NONE)?(double)TabCross[pFeno->indexFwhmParam[1]].InitParam:(double)1.;
 
     pSlitMatrix=&slitMatrix[0];
 
@@ -288,9 +297,9 @@ RC KuruczConvolveSolarSpectrum(MATRIX_OBJECT *pSolar,double *newlambda,int n_wav
 
     slitOptions.slitType=slitType;
     slitOptions.slitFile[0]=0;
-    slitOptions.slitParam=TabCross[Feno->indexFwhmParam[0]].InitParam;
-    slitOptions.slitParam2=(slitType==SLIT_TYPE_GAUSS)?(double)0.:TabCross[Feno->indexFwhmParam[1]].InitParam;
-    slitOptions.slitParam3=(slitType==SLIT_TYPE_SUPERGAUSS)?TabCross[Feno->indexFwhmParam[2]].InitParam:(double)0.;
+    slitOptions.slitParam=TabCross[pFeno->indexFwhmParam[0]].InitParam;
+    slitOptions.slitParam2=(slitType==SLIT_TYPE_GAUSS)?(double)0.:TabCross[pFeno->indexFwhmParam[1]].InitParam;
+    slitOptions.slitParam3=(slitType==SLIT_TYPE_SUPERGAUSS)?TabCross[pFeno->indexFwhmParam[2]].InitParam:(double)0.;
 
     rc=XSCONV_LoadSlitFunction(slitMatrix,&slitOptions,NULL,&slitType);
    }
@@ -314,6 +323,179 @@ RC KuruczConvolveSolarSpectrum(MATRIX_OBJECT *pSolar,double *newlambda,int n_wav
   return rc;
  }
 
+// ----------------------------------------------------------------------------
+// FUNCTION        KuruczCorrelPreshift
+// ----------------------------------------------------------------------------
+// PURPOSE         First estimate of the preshift from the cross-correlation of
+//                 two spectra, calculated by FFT on a uniform wavelength grid
+//
+// INPUT           lambda                wavelength calibration of both spectra
+//                 ref                   smoothed well calibrated spectrum
+//                 spec                  smoothed spectrum to calibrate
+//                 imin,imax             range of pixels on which the spectra are correlated
+//                 preshiftMin           minimum value for the preshift
+//                 preshiftMax           maximum value for the preshift
+//                 step                  maximum step of the uniform grid
+//
+// OUTPUT          pShift                the shift with the highest correlation,
+//                                       refined by a parabola through the best
+//                                       shift and its two neighbours
+//
+// RETURN          ERROR_ID_ALLOC if the allocation of a buffer failed;
+//                 the return code of the interpolation otherwise
+//
+// REMARK          As in ShiftCorrel, spec(lambda-shift) is compared to ref(lambda).
+//                 The spectra are padded with zeros so that the correlations of
+//                 the shifts in the preshift range don't wrap around.
+// ----------------------------------------------------------------------------
+
+RC KuruczCorrelPreshift(const double *lambda,const double *ref,const double *spec,int imin,int imax,
+                        double preshiftMin,double preshiftMax,double step,double *pShift)
+ {
+  // Declarations
+
+  double *grid,*deriv,*refGrid,*specGrid,*refFFT,*specFFT;
+  double h,refMean,specMean,correl,correlMax,correlPrev,correlNext,denom,delta;
+  int npix,npts,fftSize,lag,lagMin,lagMax,lagBest;
+  RC rc;
+
+  // Initializations
+
+  grid=deriv=refGrid=specGrid=refFFT=specFFT=NULL;
+  npix=imax-imin+1;
+  *pShift=(double)0.5*(preshiftMin+preshiftMax);
+  rc=ERROR_ID_NO;
+
+  if ((npix<3) || (lambda[imax]<=lambda[imin]))
+   return rc;
+
+  // Uniform grid with the mean step of the calibration
+
+  h=(lambda[imax]-lambda[imin])/(npix-1);
+
+  if ((step>(double)0.) && (h>step))
+   h=step;
+
+  npts=(int)floor((lambda[imax]-lambda[imin])/h)+1;
+
+  // Lags of the grid in the preshift range (a shift s corresponds to the lag -s/h)
+
+  lagMin=max((int)ceil(-preshiftMax/h),-(npts-2));
+  lagMax=min((int)floor(-preshiftMin/h),npts-2);
+
+  if (lagMin>lagMax)
+   return rc;
+
+  for (fftSize=4;fftSize<npts+max(-lagMin,lagMax);fftSize<<=1);
+
+  // Allocate temporary buffers
+
+  if (((grid=(double *)MEMORY_AllocDVector(__func__,"grid",0,npts-1))==NULL) ||
+      ((deriv=(double *)MEMORY_AllocDVector(__func__,"deriv",0,npix-1))==NULL) ||
+      ((refGrid=(double *)MEMORY_AllocDVector(__func__,"refGrid",1,fftSize))==NULL) ||
+      ((specGrid=(double *)MEMORY_AllocDVector(__func__,"specGrid",1,fftSize))==NULL) ||
+      ((refFFT=(double *)MEMORY_AllocDVector(__func__,"refFFT",1,fftSize))==NULL) ||
+      ((specFFT=(double *)MEMORY_AllocDVector(__func__,"specFFT",1,fftSize))==NULL))
+
+   rc=ERROR_ID_ALLOC;
+
+  else
+   {
+    for (int i=0;i<npts;i++)
+     grid[i]=lambda[imin]+(double)i*h;
+
+    for (int i=1;i<=fftSize;i++)
+     refGrid[i]=specGrid[i]=(double)0.;
+
+    // Interpolate both spectra on the uniform grid and remove their average
+
+    if (!(rc=SPLINE_Deriv2(&lambda[imin],&ref[imin],deriv,npix,__func__)) &&
+        !(rc=SPLINE_Vector(&lambda[imin],&ref[imin],deriv,npix,grid,&refGrid[1],npts,PRJCT_ANLYS_INTERPOL_SPLINE)) &&
+        !(rc=SPLINE_Deriv2(&lambda[imin],&spec[imin],deriv,npix,__func__)) &&
+        !(rc=SPLINE_Vector(&lambda[imin],&spec[imin],deriv,npix,grid,&specGrid[1],npts,PRJCT_ANLYS_INTERPOL_SPLINE)))
+     {
+      refMean=specMean=(double)0.;
+
+      for (int i=1;i<=npts;i++)
+       {
+        refMean+=refGrid[i];
+        specMean+=specGrid[i];
+       }
+
+      refMean/=npts;
+      specMean/=npts;
+
+      for (int i=1;i<=npts;i++)
+       {
+        refGrid[i]-=refMean;
+        specGrid[i]-=specMean;
+       }
+
+      // Correlation c(lag)=sum(ref[i]*spec[i+lag]) = inverse transform of conj(REF)*SPEC
+
+      realft(refGrid,refFFT,fftSize,1);
+      realft(specGrid,specFFT,fftSize,1);
+
+      refGrid[1]=refFFT[1]*specFFT[1];                                          // null frequency
+      refGrid[2]=refFFT[2]*specFFT[2];                                          // Nyquist frequency
+
+      for (int k=3;k<fftSize;k+=2)
+       {
+        refGrid[k]=refFFT[k]*specFFT[k]+refFFT[k+1]*specFFT[k+1];
+        refGrid[k+1]=refFFT[k]*specFFT[k+1]-refFFT[k+1]*specFFT[k];
+       }
+
+      realft(refGrid,specGrid,fftSize,-1);
+
+      // Best lag; correlations are averaged on the pixels common to both spectra
+
+      for (lag=lagBest=lagMin,correlMax=(double)0.;lag<=lagMax;lag++)
+       {
+        correl=specGrid[(lag>=0)?1+lag:1+fftSize+lag]/(npts-abs(lag));
+
+        if ((lag==lagMin) || (correl>correlMax))
+         {
+          correlMax=correl;
+          lagBest=lag;
+         }
+       }
+
+      delta=(double)0.;
+
+      if ((lagBest>lagMin) && (lagBest<lagMax))
+       {
+        correlPrev=specGrid[(lagBest-1>=0)?lagBest:1+fftSize+lagBest-1]/(npts-abs(lagBest-1));
+        correlNext=specGrid[(lagBest+1>=0)?2+lagBest:1+fftSize+lagBest+1]/(npts-abs(lagBest+1));
+        denom=correlPrev-2.*correlMax+correlNext;
+
+        if (denom<(double)0.)
+         delta=(double)0.5*(correlPrev-correlNext)/denom;
+       }
+
+      *pShift=min(max(-((double)lagBest+delta)*h,preshiftMin),preshiftMax);
+     }
+   }
+
+  // Release allocated buffers
+
+  if (grid!=NULL)
+   MEMORY_ReleaseDVector(__func__,"grid",grid,0);
+  if (deriv!=NULL)
+   MEMORY_ReleaseDVector(__func__,"deriv",deriv,0);
+  if (refGrid!=NULL)
+   MEMORY_ReleaseDVector(__func__,"refGrid",refGrid,1);
+  if (specGrid!=NULL)
+   MEMORY_ReleaseDVector(__func__,"specGrid",specGrid,1);
+  if (refFFT!=NULL)
+   MEMORY_ReleaseDVector(__func__,"refFFT",refFFT,1);
+  if (specFFT!=NULL)
+   MEMORY_ReleaseDVector(__func__,"specFFT",specFFT,1);
+
+  // Return
+
+  return rc;
+ }
+
 // ----------------------------------------------------------------------------
 // FUNCTION        KuruczCalculatePreshift
 // ----------------------------------------------------------------------------
@@ -325,7 +507,7 @@ RC KuruczConvolveSolarSpectrum(MATRIX_OBJECT *pSolar,double *newlambda,int n_wav
 //                 ndet                  size of the detector
 //                 preshiftMin           minimum value for the preshift
 //                 preshiftMax           maximum value for the preshift
-//                 step                  shift step in the wavelength shift window for correlation caluclation
+//                 step                  maximum step of the uniform wavelength grid on which the correlation is calculated
 //                 lambdaMin, lambdaMax  wavelengths range to calculate the correlation between the two spectra
 //
 // OUTPUT          newLambda             new grid
@@ -338,9 +520,9 @@ RC KuruczCalculatePreshift(double *calibratedLambda,double *calibratedRef,double
  {
      // Declarations
 
-  double *lambdas,*Sref1,*Sref2,*Sref2Deriv,*Sref2Interp,*shift,*coeff;
-  int ishift,ishiftMin,nshift,nfuncEval,nrestart,imin,imax,nsmooth;
-  double shiftIni,shiftMin,coefMin,varstep;
+  double *lambdas,*Sref1,*Sref2,*Sref2Deriv,*Sref2Interp;
+  int nfuncEval,nrestart,imin,imax,nsmooth;
+  double shiftIni,shiftCorrel,shiftMin,coefMin,varstep;
      RC rc,rc2;
 
 #if defined(__DEBUG_) && __DEBUG_
@@ -349,8 +531,7 @@ RC KuruczCalculatePreshift(double *calibratedLambda,double *calibratedRef,double
 
      // Initialization
 
-  Sref1=Sref2=Sref2Deriv=Sref2Interp=shift=NULL;
-  nshift=(double)((preshiftMax-preshiftMin)/step)+1.;
+  Sref1=Sref2=Sref2Deriv=Sref2Interp=NULL;
 
   varstep=1;
   *pShift=(double)0.;
@@ -362,9 +543,7 @@ RC KuruczCalculatePreshift(double *calibratedLambda,double *calibratedRef,double
          ((Sref1=(double *)MEMORY_AllocDVector("KuruczCalculatePreshift","Sref1",0,ndet-1))==NULL) ||
          ((Sref2=(double *)MEMORY_AllocDVector("KuruczCalculatePreshift","Sref2",0,ndet-1))==NULL) ||
          ((Sref2Deriv=(double *)MEMORY_AllocDVector("KuruczCalculatePreshift","Sref2Deriv",0,ndet-1))==NULL) ||
-         ((Sref2Interp=(double *)MEMORY_AllocDVector("KuruczCalculatePreshift","Sref2Interp",0,ndet-1))==NULL) ||
-         ((shift=(double *)MEMORY_AllocDVector("KuruczCalculatePreshift","shift",0,nshift-1))==NULL) ||
-         ((coeff=(double *)MEMORY_AllocDVector("KuruczCalculatePreshift","coeff",0,nshift-1))==NULL))
+         ((Sref2Interp=(double *)MEMORY_AllocDVector("KuruczCalculatePreshift","Sref2Interp",0,ndet-1))==NULL))
 
       rc=ERROR_ID_ALLOC;
 
@@ -387,19 +566,15 @@ RC KuruczCalculatePreshift(double *calibratedLambda,double *calibratedRef,double
           KuruczSmooth(calibratedLambda,calibratedRef,ndet,nsmooth,imin,imax,1,Sref1);
     KuruczSmooth(calibratedLambda,newRef,ndet,nsmooth,imin,imax,1,Sref2);
 
-          for (ishift=ishiftMin=0;(ishift<nshift) && !rc;ishift++)
-     {
-         shift[ishift]=preshiftMin+(double)ishift*step;
-         coeff[ishift]=ShiftCorrel(calibratedLambda,Sref1,Sref2,Sref2Deriv,lambdas,Sref2Interp,ndet,imin,imax,&shift[ishift],&rc);
+    // First estimate of the preshift by the cross-correlation of the spectra (instead of a scan of the preshift range)
 
-         if (!rc && (coeff[ishift]<coeff[ishiftMin]))
-          ishiftMin=ishift;
-     }
+    if ((rc=KuruczCorrelPreshift(calibratedLambda,Sref1,Sref2,imin,imax,preshiftMin,preshiftMax,step,&shiftIni))!=ERROR_ID_NO)
+     goto EndCalculatePreshift;
 
-    shiftIni=shift[ishiftMin];
+    shiftCorrel=shiftIni;
 
     nelmin  (ShiftCorrel,                                                                                                // I   double fn ( double x[] )    the name of the routine which evaluates the function to be minimized.
-             calibratedLambda,Sref1,Sref2,Sref2Deriv,lambdas,Sref2Interp,ndet,imin,imax,&shift[ishiftMin],&rc,           // I                               arguments of ShiftCorrel
+             calibratedLambda,Sref1,Sref2,Sref2Deriv,lambdas,Sref2Interp,ndet,imin,imax,&shiftCorrel,&rc,                // I                               arguments of ShiftCorrel
              1,                                                                                                          // I   int n                       the number of variables -> in this case, the shift
              &shiftIni,                                                                                                  // I/O double start[]              starting points for the iteration.  This data may be overwritten
              &shiftMin,                                                                                                  // O   double xmin[]               the coordinates of the point which is estimated to minimize the function.
@@ -418,6 +593,8 @@ RC KuruczCalculatePreshift(double *calibratedLambda,double *calibratedRef,double
     *pShift=shiftMin;
    }
 
+  EndCalculatePreshift :
+
   // Release allocated buffers
 
   if (lambdas!=NULL)
@@ -430,10 +607,6 @@ RC KuruczCalculatePreshift(double *calibratedLambda,double *calibratedRef,double
    MEMORY_ReleaseDVector("KuruczCalculatePreshift","Sref2Deriv",Sref2Deriv,0);
   if (Sref2Interp!=NULL)
    MEMORY_ReleaseDVector("KuruczCalculatePreshift","Sref2Interp",Sref2Interp,0);
-  if (shift!=NULL)
-   MEMORY_ReleaseDVector("KuruczCalculatePreshift","shift",shift,0);
-  if (coeff!=NULL)
-   MEMORY_ReleaseDVector("KuruczCalculatePreshift","coeff",coeff,0);
 
   // Return
 
@@ -484,12 +657,197 @@ INDEX KuruczSearchReference(INDEX indexRefFeno,INDEX indexRefColumn)
   return indexFeno;
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      KuruczFitWindows
+// -----------------------------------------------------------------------------
+// PURPOSE       Fit the little windows of the calibration at the same time
+//
+// INPUT         ws          workspace prepared by KURUCZ_Spectrum for the fits;
+//               pKurucz     Kurucz buffers of the row;
+//               pFeno       the calibration window;
+//               indexFeno   index of the analysis window to calibrate;
+//               spectrum    spectrum to shift;
+//               solar       solar spectrum;
+//               n_wavel     size of the spectra;
+//               nWorkers    number of threads
+//
+// OUTPUT        windowFits  return codes, chi square, linear fit results and
+//                           errors of the fits of the little windows
+//
+// RETURN        ERROR_ID_ALLOC if the allocation of a buffer failed;
+//               ERROR_ID_NO otherwise (the return codes of the fits are in windowFits)
+//
+// REMARK        Each thread fits its windows with its own copy of the workspace
+//               and of the calibration window.  Until KURUCZ_Spectrum processes
+//               them in the order of the windows, the results of the fit of a
+//               window are kept in KuruczFeno[indexFeno].results and its residual
+//               and transmission in the display buffers of the window.
+// -----------------------------------------------------------------------------
+
+typedef struct _kuruczWorker
+ {
+  struct analysis_workspace ws;                                                 // own buffers for the fits
+  FENO *pFeno;                                                                  // copy of the calibration window
+  double *vectors[MAX_FIT];                                                     // own vectors for predefined parameters and polynomials
+ }
+KURUCZ_WORKER;
+
+typedef struct _kuruczWindowFit
+ {
+  RC rc;                                                                        // return code of the fit
+  int stop;                                                                     // set if the calibration stops at this window
+  double square;                                                                // chi square returned by ANALYSE_CurFitMethod
+  double xmean;                                                                 // spectrum averaged on the window
+  double x[MAX_FIT+1];                                                          // results of the linear fit
+  ERROR_DESCRIPTION *errors;                                                    // errors registered by the fit (see ERROR_Save)
+  int nErrors;                                                                  // number of errors of the fit
+ }
+KURUCZ_WINDOW_FIT;
+
+static void KuruczWorkerFree(KURUCZ_WORKER *pWorker)
+ {
+  for (int i=0;i<MAX_FIT;i++)
+   if (pWorker->vectors[i]!=NULL)
+    MEMORY_ReleaseDVector(__func__,"vectors",pWorker->vectors[i],0);
+
+  if (pWorker->pFeno!=NULL)
+   MEMORY_ReleaseBuffer(__func__,"pFeno",pWorker->pFeno);
+
+  ANALYSE_WorkspaceFree(&pWorker->ws);
+ }
+
+static RC KuruczWorkerAlloc(KURUCZ_WORKER *pWorker,const struct analysis_workspace *ws,const FENO *pFeno,int n_wavel)
+ {
+  RC rc=ERROR_ID_NO;
+
+  memset(pWorker,0,sizeof(KURUCZ_WORKER));
+
+  if (((pWorker->pFeno=(FENO *)MEMORY_AllocBuffer(__func__,"pFeno",1,sizeof(FENO),0,MEMORY_TYPE_STRUCT))==NULL) ||
+      ((rc=ANALYSE_WorkspaceCopy(&pWorker->ws,ws))!=ERROR_ID_NO))
+
+   rc=ERROR_ID_ALLOC;
+
+  else
+   {
+    memcpy(pWorker->ws.absolu,ws->absolu,sizeof(double)*n_wavel);
+    memcpy(pWorker->ws.secX,ws->secX,sizeof(double)*n_wavel);
+    memcpy(pWorker->ws.t,ws->t,sizeof(double)*n_wavel);
+    memcpy(pWorker->ws.tc,ws->tc,sizeof(double)*n_wavel);
+
+    // ANALYSE_Function recalculates the vectors of the predefined parameters and of the polynomials
+
+    for (int i=0;(i<pFeno->NTabCross) && !rc;i++)
+     {
+      const CROSS_REFERENCE *pTabCross=&pFeno->TabCross[i];
+
+      if ((pTabCross->IndSvdA>0) && (pTabCross->vector!=NULL) && (WorkSpace[pTabCross->Comp].type!=WRK_SYMBOL_CROSS))
+       {
+        if ((pWorker->vectors[i]=MEMORY_AllocDVector(__func__,"vectors",0,n_wavel-1))==NULL)
+         rc=ERROR_ID_ALLOC;
+        else
+         memcpy(pWorker->vectors[i],pTabCross->vector,sizeof(double)*n_wavel);
+       }
+     }
+   }
+
+  return rc;
+ }
+
+static RC KuruczFitWindows(const struct analysis_workspace *ws,KURUCZ *pKurucz,const FENO *pFeno,INDEX indexFeno,const double *spectrum,const double *solar,
+                           int n_wavel,int nWorkers,KURUCZ_WINDOW_FIT *windowFits,INDEX indexFenoColumn)
+ {
+  // Declarations
+
+  struct fit_properties *subwindow_fit=pKurucz->KuruczFeno[indexFeno].subwindow_fits;
+  ERROR_DESCRIPTION *pendingErrors;
+  int nPendingErrors;
+  KURUCZ_WORKER *workers;
+  RC rc;
+
+  // Initializations
+
+  rc=ERROR_ID_NO;
+  memset(windowFits,0,sizeof(KURUCZ_WINDOW_FIT)*pKurucz->Nb_Win);
+
+  if ((workers=(KURUCZ_WORKER *)MEMORY_AllocBuffer(__func__,"workers",nWorkers,sizeof(KURUCZ_WORKER),0,MEMORY_TYPE_STRUCT))==NULL)
+   return ERROR_ID_ALLOC;
+
+  memset(workers,0,sizeof(KURUCZ_WORKER)*nWorkers);
+
+  for (int k=0;(k<nWorkers) && !rc;k++)
+   rc=KuruczWorkerAlloc(&workers[k],ws,pFeno,n_wavel);
+
+  if (!rc)
+   {
+    nPendingErrors=ERROR_Save(&pendingErrors);
+
+    #if defined(_OPENMP)
+    #pragma omp parallel for num_threads(nWorkers) schedule(dynamic,1)
+    #endif
+    for (int indexWindow=0;indexWindow<pKurucz->Nb_Win;indexWindow++)
+     {
+      #if defined(_OPENMP)
+      KURUCZ_WORKER *pWorker=&workers[omp_get_thread_num()];
+      #else
+      KURUCZ_WORKER *pWorker=&workers[0];
+      #endif
+      KURUCZ_WINDOW_FIT *pWindowFit=&windowFits[indexWindow];
+      struct analysis_workspace *pWs=&pWorker->ws;
+      FENO *pWindowFeno=pWorker->pFeno;
+
+      // Each window starts from the calibration window as it is before the fits
+
+      memcpy(pWindowFeno,pFeno,sizeof(FENO));
+
+      for (int i=0;i<pFeno->NTabCross;i++)
+       if (pWorker->vectors[i]!=NULL)
+        pWindowFeno->TabCross[i].vector=pWorker->vectors[i];
+
+      pWindowFeno->Decomp=1;
+      pKurucz->NIter[indexWindow]=0;
+
+      if (((pWindowFit->rc=ANALYSE_SvdInit(pWs,pWindowFeno,&subwindow_fit[indexWindow],n_wavel,pWs->lambda))!=ERROR_ID_NO) ||
+          ((pWindowFit->rc=ANALYSE_CurFitMethod(pWs,indexFenoColumn,spectrum,NULL,solar,n_wavel,NULL,&pWindowFit->square,
+                                                &pKurucz->NIter[indexWindow],1.,1.,&subwindow_fit[indexWindow]))>0))
+
+       pWindowFit->stop=1;
+
+      else
+       {
+        memcpy(pKurucz->KuruczFeno[indexFeno].results[indexWindow],pWindowFeno->TabCrossResults,sizeof(CROSS_RESULTS)*pWindowFeno->NTabCross);
+        memcpy(pWindowFit->x,pWs->x,sizeof(double)*(MAX_FIT+1));
+        pWindowFit->xmean=pWindowFeno->xmean;
+
+        for (int i=pWs->svdPDeb;i<=pWs->svdPFin;i++)
+         {
+          pKurucz->dispAbsolu[indexWindow][i]=pWs->absolu[i];
+          pKurucz->dispSecX[indexWindow][i]=pWs->tc[i];
+         }
+       }
+
+      pWindowFit->nErrors=ERROR_Save(&pWindowFit->errors);                      // the error stack is private to the thread
+     }
+
+    ERROR_Restore(pendingErrors,nPendingErrors);
+   }
+
+  // Release allocated buffers
+
+  for (int k=0;k<nWorkers;k++)
+   KuruczWorkerFree(&workers[k]);
+
+  MEMORY_ReleaseBuffer(__func__,"workers",workers);
+
+  return rc;
+ }
+
 // ----------------------------------------------------------------------------
 // FUNCTION        KURUCZ_Spectrum
 // ----------------------------------------------------------------------------
 // PURPOSE         apply Kurucz for building a new wavelength scale to a spectrum
 //
-// INPUT           oldLambda      old calibration associated to reference;
+// INPUT           ws             workspace used for the fits of the sub-windows;
+//                 oldLambda      old calibration associated to reference;
 //                 spectrum       spectrum to shift;
 //                 reference      reference spectrum;
 //                 instrFunction  instrumental function for correcting reference
@@ -503,12 +861,13 @@ INDEX KuruczSearchReference(INDEX indexRefFeno,INDEX indexRefColumn)
 // RETURN          return code
 // ----------------------------------------------------------------------------
 
-RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,const double *reference,double *instrFunction,
+RC KURUCZ_Spectrum(struct analysis_workspace *ws,const double *oldLambda,double *newLambda,double *spectrum,const double *reference,double *instrFunction,
                    char displayFlag, const char *windowTitle,double **coeff,double **fwhmVector,double **fwhmDeriv2,int saveFlag,INDEX indexFeno,void *responseHandle,INDEX indexFenoColumn)
 {
   // Declarations
 
   char            string[MAX_ITEM_TEXT_LEN];
+  FENO            *pFeno;                                                       // calibration window
   CROSS_REFERENCE *TabCross,*pTabCross;
   CROSS_RESULTS   *pResults,*Results;                                           // pointer to results associated to a symbol
   double slitParam[NSFP],
@@ -530,6 +889,8 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
   RC               rc;                                                          // return code
   plot_data_t      *spectrumData;
   KURUCZ *pKurucz;
+  KURUCZ_WINDOW_FIT *windowFits;                                                // results of the little windows fitted at the same time
+  int              nWorkers;                                                    // number of threads fitting the little windows
 
 #if defined(__DEBUG_) && __DEBUG_
   DEBUG_FunctionBegin(__func__,DEBUG_FCTTYPE_APPL|DEBUG_FCTTYPE_MEM);
@@ -544,6 +905,7 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
   solar=NULL;
   const int oldNDET = NDET[indexFenoColumn];
   spectrumData=NULL;
+  windowFits=NULL;
 
   slitParam[0]=pSlitOptions->slitFunction.slitParam;
   slitParam[1]=pSlitOptions->slitFunction.slitParam2;
@@ -565,15 +927,15 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
 
   // Use substitution variables
 
-  Feno=&TabFeno[indexFenoColumn][pKurucz->indexKurucz];
-  shiftSign=(Feno->indexSpectrum!=ITEM_NONE)?(double)-1.:(double)1.;            // very important !!!
-  TabCross=Feno->TabCross;
+  pFeno=&TabFeno[indexFenoColumn][pKurucz->indexKurucz];
+  shiftSign=(pFeno->indexSpectrum!=ITEM_NONE)?(double)-1.:(double)1.;            // very important !!!
+  TabCross=pFeno->TabCross;
 
-  memcpy(Feno->LambdaK,oldLambda,sizeof(double)*oldNDET);
-  rc=ANALYSE_XsInterpolation(Feno,oldLambda,indexFenoColumn);
+  memcpy(pFeno->LambdaK,oldLambda,sizeof(double)*oldNDET);
+  rc=ANALYSE_XsInterpolation(pFeno,oldLambda,indexFenoColumn);
 
-  Results=Feno->TabCrossResults;
-  pResults=&Feno->TabCrossResults[(Feno->indexSpectrum!=ITEM_NONE)?Feno->indexSpectrum:Feno->indexReference];
+  Results=pFeno->TabCrossResults;
+  pResults=&pFeno->TabCrossResults[(pFeno->indexSpectrum!=ITEM_NONE)?pFeno->indexSpectrum:pFeno->indexReference];
 
   double *VSig = pKurucz->VSig;
   double *Pcalib = pKurucz->Pcalib; // polynomial coefficients computation
@@ -593,14 +955,14 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
   const int n_wavel = TabFeno[indexFenoColumn][indexFeno].NDET;
 
   for (maxParam=0;maxParam<MAX_KURUCZ_FWHM_PARAM;maxParam++)
-    if ((fwhmVector[maxParam]!=NULL) && (Feno->indexFwhmParam[maxParam]!=ITEM_NONE))
-      VECTOR_Init(fwhmVector[maxParam],TabCross[Feno->indexFwhmParam[maxParam]].InitParam,n_wavel);
+    if ((fwhmVector[maxParam]!=NULL) && (pFeno->indexFwhmParam[maxParam]!=ITEM_NONE))
+      VECTOR_Init(fwhmVector[maxParam],TabCross[pFeno->indexFwhmParam[maxParam]].InitParam,n_wavel);
     else
       break;
 
   // Instrumental correction
 
-  memcpy(ANALYSE_absolu,ANALYSE_zeros,sizeof(double)*n_wavel);
+  memcpy(ws->absolu,ANALYSE_zeros,sizeof(double)*n_wavel);
   memcpy(offset,ANALYSE_zeros,sizeof(double)*n_wavel);
 
   if (instrFunction!=NULL)
@@ -609,10 +971,10 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
 
   // Always restart from the original calibration
 
-  Lambda=newLambda;
-  LambdaSpec=newLambda;
-  memcpy(Lambda,oldLambda,sizeof(double)*n_wavel);
-  memcpy(ANALYSE_secX,spectrum,sizeof(double)*n_wavel);
+  ws->lambda=newLambda;
+  ws->lambdaSpec=newLambda;
+  memcpy(ws->lambda,oldLambda,sizeof(double)*n_wavel);
+  memcpy(ws->secX,spectrum,sizeof(double)*n_wavel);
 
   // Set solar spectrum
 
@@ -658,8 +1020,8 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
     for (indexTabCross=0;indexTabCross<pKurucz->crossFits.nc;indexTabCross++)
       memcpy(pKurucz->crossFits.matrix[indexTabCross],ANALYSE_zeros,sizeof(double)*n_wavel);
 
-  memcpy(ANALYSE_t,ANALYSE_zeros,sizeof(double)*n_wavel);
-  memcpy(ANALYSE_tc,ANALYSE_zeros,sizeof(double)*n_wavel);
+  memcpy(ws->t,ANALYSE_zeros,sizeof(double)*n_wavel);
+  memcpy(ws->tc,ANALYSE_zeros,sizeof(double)*n_wavel);
 
   ANALYSE_plotKurucz=(pKurucz->displaySpectra || pKurucz->displayResidual || pKurucz->displayFit || pKurucz->displayShift)?1:0;
 
@@ -689,10 +1051,10 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
         mediateResponseCellDataString(plotPageCalib,indexLine,indexColumn++,string,responseHandle);
       }
 
-    if ((Feno->indexOffsetConst!=ITEM_NONE) && (Feno->TabCross[Feno->indexOffsetConst].FitParam!=ITEM_NONE))
+    if ((pFeno->indexOffsetConst!=ITEM_NONE) && (pFeno->TabCross[pFeno->indexOffsetConst].FitParam!=ITEM_NONE))
       mediateResponseCellDataString(plotPageCalib,indexLine,indexColumn++,"Offset",responseHandle);
 
-    for (indexTabCross=0;indexTabCross<Feno->NTabCross;indexTabCross++) {
+    for (indexTabCross=0;indexTabCross<pFeno->NTabCross;indexTabCross++) {
       pTabCross=&TabCross[indexTabCross];
 
       if (pTabCross->IndSvdA && (WorkSpace[pTabCross->Comp].type==WRK_SYMBOL_CROSS))
@@ -700,46 +1062,107 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
     }
   }
 
+  // The little windows are fitted at the same time when the fits only modify their workspace
+  // and the calibration window (the fit of the slit function uses pKURUCZ_fft and convolves
+  // the cross sections of the calibration window)
+
+  nWorkers=min(kuruczThreadsN,Nb_Win);
+
+  #if defined(_OPENMP)
+  if (omp_in_parallel())                                                        // rows of imagers already calibrated at the same time
+   nWorkers=1;
+  #endif
+
+  if (pKuruczOptions->fwhmFit ||
+      (pFeno->analysisType==ANALYSIS_TYPE_FWHM_KURUCZ) ||
+      (pFeno->useUsamp && (pUsamp->method==PRJCT_USAMP_AUTOMATIC)))
+   nWorkers=1;
+
+  if (nWorkers>1)
+   {
+    if ((windowFits=(KURUCZ_WINDOW_FIT *)MEMORY_AllocBuffer(__func__,"windowFits",Nb_Win,sizeof(KURUCZ_WINDOW_FIT),0,MEMORY_TYPE_STRUCT))==NULL)
+     rc=ERROR_ID_ALLOC;
+    else
+     {
+      ws->feno=pFeno;                                                           // as ANALYSE_SvdInit for the display of the fits
+      memcpy(ws->splineX,ws->lambda,sizeof(double)*n_wavel);
+      rc=KuruczFitWindows(ws,pKurucz,pFeno,indexFeno,spectrum,solar,n_wavel,nWorkers,windowFits,indexFenoColumn);
+     }
+
+    if (rc!=ERROR_ID_NO)
+     goto EndKuruczSpectrum;
+   }
+
   // Browse little windows
 
   for (indexWindow=0,Square=(double)0.;(indexWindow<Nb_Win) && (rc<THREAD_EVENT_STOP);indexWindow++) {
-    Feno->Decomp=1;
-    NIter[indexWindow]=0;
-
     dispAbsolu=pKurucz->dispAbsolu[indexWindow];
     dispSecX=pKurucz->dispSecX[indexWindow];
 
+    if (windowFits!=NULL) {
+      // Results of the fit of the window, as if the windows were fitted one after the other
+
+      KURUCZ_WINDOW_FIT *pWindowFit=&windowFits[indexWindow];
+
+      ERROR_Restore(pWindowFit->errors,pWindowFit->nErrors);
+      pWindowFit->errors=NULL;
+
+      rc=pWindowFit->rc;
+
+      if (pWindowFit->stop)
+        break;
+
+      Square=pWindowFit->square;
+      pFeno->xmean=pWindowFit->xmean;
+      memcpy(pFeno->TabCrossResults,pKurucz->KuruczFeno[indexFeno].results[indexWindow],sizeof(CROSS_RESULTS)*pFeno->NTabCross);
+      memcpy(ws->x,pWindowFit->x,sizeof(double)*(MAX_FIT+1));
+
+      ws->specrange=subwindow_fit[indexWindow].specrange;
+      ws->svdPDeb=spectrum_start(subwindow_fit[indexWindow].specrange);
+      ws->svdPFin=spectrum_end(subwindow_fit[indexWindow].specrange);
+
+      for (i=ws->svdPDeb;i<=ws->svdPFin;i++) {
+        ws->absolu[i]=dispAbsolu[i];
+        ws->tc[i]=dispSecX[i];
+      }
+    }
+
     for (int i=0;i<n_wavel;i++)
      dispAbsolu[i]=dispSecX[i]=(double)0.;
 
-    if (pKuruczOptions->fwhmFit)
-      pKURUCZ_fft=&pKurucz->KuruczFeno[indexFeno].fft[indexWindow];
+    if (windowFits==NULL) {
+      pFeno->Decomp=1;
+      NIter[indexWindow]=0;
 
-    // Global initializations
+      if (pKuruczOptions->fwhmFit)
+        pKURUCZ_fft=&pKurucz->KuruczFeno[indexFeno].fft[indexWindow];
+
+      // Global initializations
 
 #if defined(__DEBUG_) && __DEBUG_
-    // DEBUG_Start(ENGINE_dbgFile,"Kurucz",DEBUG_FCTTYPE_MATH|DEBUG_FCTTYPE_APPL,5,DEBUG_DVAR_YES,0); // !debugResetFlag++);
+      // DEBUG_Start(ENGINE_dbgFile,"Kurucz",DEBUG_FCTTYPE_MATH|DEBUG_FCTTYPE_APPL,5,DEBUG_DVAR_YES,0); // !debugResetFlag++);
 #endif
 
-    if (((rc=ANALYSE_SvdInit(&TabFeno[indexFenoColumn][pKurucz->indexKurucz], &subwindow_fit[indexWindow], n_wavel, Lambda))!=ERROR_ID_NO) ||
+      if (((rc=ANALYSE_SvdInit(ws,pFeno, &subwindow_fit[indexWindow], n_wavel, ws->lambda))!=ERROR_ID_NO) ||
 
-        // Analysis method
+          // Analysis method
 
-        ((rc=ANALYSE_CurFitMethod(indexFenoColumn,                            // to change a little bit later for OMI
-                                  spectrum,                                   // spectrum
-                                  NULL,                                       // no error on previous spectrum
-                                  solar,                                      // reference (Kurucz)
-                                  n_wavel,
-                                  NULL,
-                                  &Square,                                     // returned stretch order 2
-                                  &NIter[indexWindow],
-                                  1.,1.,
-                                  &subwindow_fit[indexWindow]))>0))
-      break;
+          ((rc=ANALYSE_CurFitMethod(ws,indexFenoColumn,                            // to change a little bit later for OMI
+                                    spectrum,                                   // spectrum
+                                    NULL,                                       // no error on previous spectrum
+                                    solar,                                      // reference (Kurucz)
+                                    n_wavel,
+                                    NULL,
+                                    &Square,                                     // returned stretch order 2
+                                    &NIter[indexWindow],
+                                    1.,1.,
+                                    &subwindow_fit[indexWindow]))>0))
+        break;
 
 #if defined(__DEBUG_) && __DEBUG_
-    // DEBUG_Stop("Kurucz");
+      // DEBUG_Stop("Kurucz");
 #endif
+    }
 
 
     // Fill A SVD system
@@ -767,11 +1190,11 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
     if (pKuruczOptions->fwhmFit)
       for (indexParam=0;indexParam<maxParam;indexParam++) {
         if ((indexParam==1) && (pKuruczOptions->fwhmType==SLIT_TYPE_AGAUSS))
-          fwhm[indexParam][indexWindow]=Feno->TabCrossResults[Feno->indexFwhmParam[indexParam]].Param;  // asymmetric factor can be negatif for asymmetric gaussian
+          fwhm[indexParam][indexWindow]=pFeno->TabCrossResults[pFeno->indexFwhmParam[indexParam]].Param;  // asymmetric factor can be negatif for asymmetric gaussian
         else
-          fwhm[indexParam][indexWindow]=fabs(Feno->TabCrossResults[Feno->indexFwhmParam[indexParam]].Param);
+          fwhm[indexParam][indexWindow]=fabs(pFeno->TabCrossResults[pFeno->indexFwhmParam[indexParam]].Param);
 
-        fwhmSigma[indexParam][indexWindow]=Feno->TabCrossResults[Feno->indexFwhmParam[indexParam]].SigmaParam;
+        fwhmSigma[indexParam][indexWindow]=pFeno->TabCrossResults[pFeno->indexFwhmParam[indexParam]].SigmaParam;
       }
 
     // Store fit for display
@@ -779,52 +1202,52 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
     if (displayFlag) {
       if (pKurucz->method==OPTICAL_DENSITY_FIT)
        {
-        for (i=SvdPDeb;i<=SvdPFin;i++)
+        for (i=ws->svdPDeb;i<=ws->svdPFin;i++)
          {
-          dispAbsolu[i]=ANALYSE_absolu[i];
-          dispSecX[i]=ANALYSE_secX[i]=exp(log(spectrum[i])+ANALYSE_absolu[i]);
+          dispAbsolu[i]=ws->absolu[i];
+          dispSecX[i]=ws->secX[i]=exp(log(spectrum[i])+ws->absolu[i]);
          }
        }
       else
        {
-           for (i=SvdPDeb;i<=SvdPFin;i++)
+           for (i=ws->svdPDeb;i<=ws->svdPFin;i++)
             {
-          dispAbsolu[i]=ANALYSE_absolu[i]=(ANALYSE_tc[i]!=(double)0.)?ANALYSE_absolu[i]/ANALYSE_tc[i]:(double)0.;
-          dispSecX[i]=ANALYSE_secX[i]=exp(log(spectrum[i])+ANALYSE_absolu[i]/ANALYSE_tc[i]); // spectrum[i]+solar[i]*ANALYSE_absolu[i]/ANALYSE_tc[i];
+          dispAbsolu[i]=ws->absolu[i]=(ws->tc[i]!=(double)0.)?ws->absolu[i]/ws->tc[i]:(double)0.;
+          dispSecX[i]=ws->secX[i]=exp(log(spectrum[i])+ws->absolu[i]/ws->tc[i]); // spectrum[i]+solar[i]*ANALYSE_absolu[i]/ANALYSE_tc[i];
          }
        }
 
-      j0=(double)(SvdPDeb+SvdPFin)*0.5;
+      j0=(double)(ws->svdPDeb+ws->svdPFin)*0.5;
       lambda0=(fabs(j0-floor(j0))<(double)0.1)?
-        (double)ANALYSE_splineX[(INDEX)j0]:
-        (double)0.5*(ANALYSE_splineX[(INDEX)floor(j0)]+ANALYSE_splineX[(INDEX)floor(j0+1.)]);
-
-      if ((Feno->indexOffsetConst!=ITEM_NONE) &&
-          (Feno->indexOffsetOrder1!=ITEM_NONE) &&
-          (Feno->indexOffsetOrder2!=ITEM_NONE) &&
-
-          ((TabCross[Feno->indexOffsetConst].FitParam!=ITEM_NONE) ||
-           (TabCross[Feno->indexOffsetOrder1].FitParam!=ITEM_NONE) ||
-           (TabCross[Feno->indexOffsetOrder2].FitParam!=ITEM_NONE) ||
-           (TabCross[Feno->indexOffsetConst].InitParam!=(double)0.) ||
-           (TabCross[Feno->indexOffsetOrder1].InitParam!=(double)0.) ||
-           (TabCross[Feno->indexOffsetOrder2].InitParam!=(double)0.)))
-
-        for (i=SvdPDeb;i<=SvdPFin;i++) {
-          offset[i]=(double)1.-Feno->xmean*(Results[Feno->indexOffsetConst].Param+
-                                            Results[Feno->indexOffsetOrder1].Param*(ANALYSE_splineX[i]-lambda0)+
-                                            Results[Feno->indexOffsetOrder2].Param*(ANALYSE_splineX[i]-lambda0)*(ANALYSE_splineX[i]-lambda0))/spectrum[i];
+        (double)ws->splineX[(INDEX)j0]:
+        (double)0.5*(ws->splineX[(INDEX)floor(j0)]+ws->splineX[(INDEX)floor(j0+1.)]);
+
+      if ((pFeno->indexOffsetConst!=ITEM_NONE) &&
+          (pFeno->indexOffsetOrder1!=ITEM_NONE) &&
+          (pFeno->indexOffsetOrder2!=ITEM_NONE) &&
+
+          ((TabCross[pFeno->indexOffsetConst].FitParam!=ITEM_NONE) ||
+           (TabCross[pFeno->indexOffsetOrder1].FitParam!=ITEM_NONE) ||
+           (TabCross[pFeno->indexOffsetOrder2].FitParam!=ITEM_NONE) ||
+           (TabCross[pFeno->indexOffsetConst].InitParam!=(double)0.) ||
+           (TabCross[pFeno->indexOffsetOrder1].InitParam!=(double)0.) ||
+           (TabCross[pFeno->indexOffsetOrder2].InitParam!=(double)0.)))
+
+        for (i=ws->svdPDeb;i<=ws->svdPFin;i++) {
+          offset[i]=(double)1.-pFeno->xmean*(Results[pFeno->indexOffsetConst].Param+
+                                            Results[pFeno->indexOffsetOrder1].Param*(ws->splineX[i]-lambda0)+
+                                            Results[pFeno->indexOffsetOrder2].Param*(ws->splineX[i]-lambda0)*(ws->splineX[i]-lambda0))/spectrum[i];
           offset[i]=(offset[i]>(double)0.)?log(offset[i]):(double)0.;
         }
 
       if (pKurucz->crossFits.matrix!=NULL)
 
-        for (indexTabCross=indexCrossFit=0;(indexTabCross<Feno->NTabCross) && (indexCrossFit<pKurucz->crossFits.nc);indexTabCross++) {
+        for (indexTabCross=indexCrossFit=0;(indexTabCross<pFeno->NTabCross) && (indexCrossFit<pKurucz->crossFits.nc);indexTabCross++) {
           pTabCross=&TabCross[indexTabCross];
 
           if (pTabCross->IndSvdA && (WorkSpace[pTabCross->Comp].type==WRK_SYMBOL_CROSS) && pTabCross->display) {
-            for (i=SvdPDeb,k=1;i<=SvdPFin;i++,k++)
-              pKurucz->crossFits.matrix[indexCrossFit][i]=x[pTabCross->IndSvdA]*subwindow_fit[indexWindow].A[pTabCross->IndSvdA][k];
+            for (i=ws->svdPDeb,k=1;i<=ws->svdPFin;i++,k++)
+              pKurucz->crossFits.matrix[indexCrossFit][i]=ws->x[pTabCross->IndSvdA]*subwindow_fit[indexWindow].A[pTabCross->IndSvdA][k];
 
             indexCrossFit++;
           }
@@ -833,7 +1256,7 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
 
     // Results safe keeping
 
-    memcpy(pKurucz->KuruczFeno[indexFeno].results[indexWindow],Feno->TabCrossResults,sizeof(CROSS_RESULTS)*Feno->NTabCross);
+    memcpy(pKurucz->KuruczFeno[indexFeno].results[indexWindow],pFeno->TabCrossResults,sizeof(CROSS_RESULTS)*pFeno->NTabCross);
 
     pKurucz->KuruczFeno[indexFeno].wve[indexWindow]=VLambda[indexWindow+1];
     pKurucz->KuruczFeno[indexFeno].chiSquare[indexWindow]=Square;
@@ -846,8 +1269,8 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
   if (rc)
     goto EndKuruczSpectrum;
 
-  SvdPDeb=spectrum_start(subwindow_fit[0].specrange);
-  SvdPFin=spectrum_end(subwindow_fit[Nb_Win-1].specrange);
+  ws->svdPDeb=spectrum_start(subwindow_fit[0].specrange);
+  ws->svdPFin=spectrum_end(subwindow_fit[Nb_Win-1].specrange);
 
   // New wavelength scale (corrected calibration)
   // NB : we fit a polynomial in Lambda+shift point but it's possible to fit a polynomial in shift points by replacing
@@ -858,7 +1281,7 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
 
   if (pKuruczOptions->fwhmFit) {
     for (indexParam=0;indexParam<maxParam;indexParam++)
-      if (TabCross[Feno->indexFwhmParam[indexParam]].FitParam!=ITEM_NONE) {
+      if (TabCross[pFeno->indexFwhmParam[indexParam]].FitParam!=ITEM_NONE) {
         memcpy(coeff[indexParam],ANALYSE_zeros,sizeof(double)*(pKurucz->fwhmDegree+1));
         memcpy(fwhmVector[indexParam],ANALYSE_zeros,sizeof(double)*n_wavel);
 
@@ -876,18 +1299,18 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
       for (j=pKurucz->shiftDegree;j>=1;j--) {
         shiftPoly[i]=shiftPoly[i]*(double)i+Pcalib[j];
       }
-      Lambda[i]=oldLambda[i]-shiftSign*shiftPoly[i];
+      ws->lambda[i]=oldLambda[i]-shiftSign*shiftPoly[i];
     }
   } else {
     // if Nb_Win == 1, use fitted shift/stretch from calibration procedure to create corrected lambda grid:
 
-    int i_center = floor(0.5*(SvdPDeb + SvdPFin));
+    int i_center = floor(0.5*(ws->svdPDeb + ws->svdPFin));
     double lambda0 = 0.5*(oldLambda[i_center] + oldLambda[1+i_center]);
 
     for (int i=0; i<n_wavel; ++i) {
       const double x0 = oldLambda[i] - lambda0;
       shiftPoly[i] = calib_shift[0] + calib_stretch[0]*x0 + calib_stretch2[0]*x0*x0;
-      Lambda[i] = oldLambda[i] - shiftSign*shiftPoly[i];
+      ws->lambda[i] = oldLambda[i] - shiftSign*shiftPoly[i];
     }
   }
 
@@ -902,8 +1325,8 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
 
      if (pKuruczOptions->divisionMode==PRJCT_CALIB_WINDOWS_CONTIGUOUS)
       {
-       mediateAllocateAndSetPlotData(&spectrumData[0],"Spectrum",&Lambda[0],&spectrum[0],n_wavel,Line);
-       mediateAllocateAndSetPlotData(&spectrumData[1],"Adjusted Kurucz",&Lambda[0],&ANALYSE_secX[0],n_wavel,Line);
+       mediateAllocateAndSetPlotData(&spectrumData[0],"Spectrum",&ws->lambda[0],&spectrum[0],n_wavel,Line);
+       mediateAllocateAndSetPlotData(&spectrumData[1],"Adjusted Kurucz",&ws->lambda[0],&ws->secX[0],n_wavel,Line);
 
        mediateResponsePlotData(plotPageCalib,spectrumData,2,Spectrum,forceAutoScale,string,"Wavelength (nm)","Intensity", responseHandle);
        mediateReleasePlotData(&spectrumData[0]);
@@ -916,8 +1339,8 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
          pixMin=spectrum_start(subwindow_fit[indexWindow].specrange);
          pixMax=spectrum_end(subwindow_fit[indexWindow].specrange);
 
-         mediateAllocateAndSetNumberedPlotData(&spectrumData[(indexWindow<<1)],"Spectrum",&Lambda[pixMin],&spectrum[pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,0);
-         mediateAllocateAndSetNumberedPlotData(&spectrumData[(indexWindow<<1)+1],"Adjusted Kurucz",&Lambda[pixMin],&pKurucz->dispSecX[indexWindow][pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,1);
+         mediateAllocateAndSetNumberedPlotData(&spectrumData[(indexWindow<<1)],"Spectrum",&ws->lambda[pixMin],&spectrum[pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,0);
+         mediateAllocateAndSetNumberedPlotData(&spectrumData[(indexWindow<<1)+1],"Adjusted Kurucz",&ws->lambda[pixMin],&pKurucz->dispSecX[indexWindow][pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,1);
         }
        mediateResponsePlotData(plotPageCalib,spectrumData,Nb_Win*2,Spectrum,forceAutoScale,string,"Wavelength (nm)","Intensity", responseHandle);
 
@@ -940,7 +1363,7 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
 
       if (pKuruczOptions->divisionMode==PRJCT_CALIB_WINDOWS_CONTIGUOUS)
        {
-        mediateAllocateAndSetPlotData(&spectrumData[0],"Residual",&Lambda[0],&ANALYSE_absolu[0],n_wavel,Line);
+        mediateAllocateAndSetPlotData(&spectrumData[0],"Residual",&ws->lambda[0],&ws->absolu[0],n_wavel,Line);
         mediateResponsePlotData(plotPageCalib,spectrumData,1,Spectrum,forceAutoScale,string,"Wavelength (nm)","", responseHandle);
         mediateReleasePlotData(&spectrumData[0]);
        }
@@ -951,7 +1374,7 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
              pixMin=spectrum_start(subwindow_fit[indexWindow].specrange);
           pixMax=spectrum_end(subwindow_fit[indexWindow].specrange);
 
-          mediateAllocateAndSetNumberedPlotData(&spectrumData[indexWindow],"Residual",&Lambda[pixMin],&pKurucz->dispAbsolu[indexWindow][pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,0);
+          mediateAllocateAndSetNumberedPlotData(&spectrumData[indexWindow],"Residual",&ws->lambda[pixMin],&pKurucz->dispAbsolu[indexWindow][pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,0);
          }
 
         mediateResponsePlotData(plotPageCalib,spectrumData,Nb_Win,Spectrum,forceAutoScale,string,"Wavelength (nm)","", responseHandle);
@@ -961,21 +1384,21 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
        }
     }
 
-    memcpy(ANALYSE_secX,ANALYSE_zeros,sizeof(double)*n_wavel);
+    memcpy(ws->secX,ANALYSE_zeros,sizeof(double)*n_wavel);
 
     // Display Offset
 
     if  (// Feno->displayOffset &&
-         (Feno->indexOffsetConst!=ITEM_NONE) &&
-         (Feno->indexOffsetOrder1!=ITEM_NONE) &&
-         (Feno->indexOffsetOrder2!=ITEM_NONE) &&
+         (pFeno->indexOffsetConst!=ITEM_NONE) &&
+         (pFeno->indexOffsetOrder1!=ITEM_NONE) &&
+         (pFeno->indexOffsetOrder2!=ITEM_NONE) &&
 
-         ((TabCross[Feno->indexOffsetConst].FitParam!=ITEM_NONE) ||
-          (TabCross[Feno->indexOffsetOrder1].FitParam!=ITEM_NONE) ||
-          (TabCross[Feno->indexOffsetOrder2].FitParam!=ITEM_NONE) ||
-          (TabCross[Feno->indexOffsetConst].InitParam!=(double)0.) ||
-          (TabCross[Feno->indexOffsetOrder1].InitParam!=(double)0.) ||
-          (TabCross[Feno->indexOffsetOrder2].InitParam!=(double)0.))) {
+         ((TabCross[pFeno->indexOffsetConst].FitParam!=ITEM_NONE) ||
+          (TabCross[pFeno->indexOffsetOrder1].FitParam!=ITEM_NONE) ||
+          (TabCross[pFeno->indexOffsetOrder2].FitParam!=ITEM_NONE) ||
+          (TabCross[pFeno->indexOffsetConst].InitParam!=(double)0.) ||
+          (TabCross[pFeno->indexOffsetOrder1].InitParam!=(double)0.) ||
+          (TabCross[pFeno->indexOffsetOrder2].InitParam!=(double)0.))) {
 
       if (pKurucz->displayFit) {
         if (ANALYSE_swathSize==1)
@@ -985,14 +1408,14 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
 
         if (pKuruczOptions->divisionMode==PRJCT_CALIB_WINDOWS_CONTIGUOUS)
          {
-          for (j=SvdPDeb;j<=SvdPFin;j++) // !!!!!!!!!!!!!!!!!!! to test
+          for (j=ws->svdPDeb;j<=ws->svdPFin;j++) // !!!!!!!!!!!!!!!!!!! to test
            {
-            ANALYSE_absolu[j]+=offset[j]-ANALYSE_secX[j];
-            ANALYSE_secX[j]=offset[j];
+            ws->absolu[j]+=offset[j]-ws->secX[j];
+            ws->secX[j]=offset[j];
            }
 
-          mediateAllocateAndSetPlotData(&spectrumData[0],"Measured",&Lambda[0],&ANALYSE_absolu[0],n_wavel,Line);
-          mediateAllocateAndSetPlotData(&spectrumData[1],"Calculated",&Lambda[0],&ANALYSE_secX[0],n_wavel,Line);
+          mediateAllocateAndSetPlotData(&spectrumData[0],"Measured",&ws->lambda[0],&ws->absolu[0],n_wavel,Line);
+          mediateAllocateAndSetPlotData(&spectrumData[1],"Calculated",&ws->lambda[0],&ws->secX[0],n_wavel,Line);
           mediateResponsePlotData(plotPageCalib,spectrumData,2,Spectrum,forceAutoScale,string,"Wavelength (nm)","",responseHandle);
           mediateReleasePlotData(&spectrumData[1]);
           mediateReleasePlotData(&spectrumData[0]);
@@ -1010,8 +1433,8 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
               pKurucz->dispSecX[indexWindow][j]=offset[j];
              }
 
-            mediateAllocateAndSetNumberedPlotData(&spectrumData[(indexWindow<<1)],"Measured",&Lambda[pixMin],&pKurucz->dispAbsolu[indexWindow][pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,0);
-            mediateAllocateAndSetNumberedPlotData(&spectrumData[(indexWindow<<1)+1],"Calculated",&Lambda[pixMin],&pKurucz->dispSecX[indexWindow][pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,0);
+            mediateAllocateAndSetNumberedPlotData(&spectrumData[(indexWindow<<1)],"Measured",&ws->lambda[pixMin],&pKurucz->dispAbsolu[indexWindow][pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,0);
+            mediateAllocateAndSetNumberedPlotData(&spectrumData[(indexWindow<<1)+1],"Calculated",&ws->lambda[pixMin],&pKurucz->dispSecX[indexWindow][pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,0);
            }
 
           mediateResponsePlotData(plotPageCalib,spectrumData,Nb_Win,Spectrum,forceAutoScale,string,"Wavelength (nm)","", responseHandle);
@@ -1028,7 +1451,7 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
     // Display subwindow_fits
 
     if (pKurucz->crossFits.matrix!=NULL) {
-      for (indexTabCross=indexCrossFit=0;(indexTabCross<Feno->NTabCross) && (indexCrossFit<pKurucz->crossFits.nc);indexTabCross++) {
+      for (indexTabCross=indexCrossFit=0;(indexTabCross<pFeno->NTabCross) && (indexCrossFit<pKurucz->crossFits.nc);indexTabCross++) {
         pTabCross=&TabCross[indexTabCross];
 
         if (pTabCross->IndSvdA && (WorkSpace[pTabCross->Comp].type==WRK_SYMBOL_CROSS) && pTabCross->display) {
@@ -1040,13 +1463,13 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
 
           if (pKuruczOptions->divisionMode==PRJCT_CALIB_WINDOWS_CONTIGUOUS)
            {
-            for (j=SvdPDeb;j<=SvdPFin;j++) {
-              ANALYSE_absolu[j]+=pKurucz->crossFits.matrix[indexCrossFit][j]-ANALYSE_secX[j];
-              ANALYSE_secX[j]=pKurucz->crossFits.matrix[indexCrossFit][j];
+            for (j=ws->svdPDeb;j<=ws->svdPFin;j++) {
+              ws->absolu[j]+=pKurucz->crossFits.matrix[indexCrossFit][j]-ws->secX[j];
+              ws->secX[j]=pKurucz->crossFits.matrix[indexCrossFit][j];
             }
 
-             mediateAllocateAndSetPlotData(&spectrumData[0],"Measured",&Lambda[0],&ANALYSE_absolu[0],n_wavel,Line);
-             mediateAllocateAndSetPlotData(&spectrumData[1],"Calculated",&Lambda[0],&ANALYSE_secX[0],n_wavel,Line);
+             mediateAllocateAndSetPlotData(&spectrumData[0],"Measured",&ws->lambda[0],&ws->absolu[0],n_wavel,Line);
+             mediateAllocateAndSetPlotData(&spectrumData[1],"Calculated",&ws->lambda[0],&ws->secX[0],n_wavel,Line);
              mediateResponsePlotData(plotPageCalib,spectrumData,2,Spectrum,forceAutoScale,string,"Wavelength (nm)","", responseHandle);
              mediateReleasePlotData(&spectrumData[1]);
              mediateReleasePlotData(&spectrumData[0]);
@@ -1065,8 +1488,8 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
                 pKurucz->dispSecX[indexWindow][j]=pKurucz->crossFits.matrix[indexCrossFit][j];
                }
 
-              mediateAllocateAndSetNumberedPlotData(&spectrumData[(indexWindow<<1)],"Measured",&Lambda[pixMin],&pKurucz->dispAbsolu[indexWindow][pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,0);
-              mediateAllocateAndSetNumberedPlotData(&spectrumData[(indexWindow<<1)+1],"Calculated",&Lambda[pixMin],&pKurucz->dispSecX[indexWindow][pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,1);
+              mediateAllocateAndSetNumberedPlotData(&spectrumData[(indexWindow<<1)],"Measured",&ws->lambda[pixMin],&pKurucz->dispAbsolu[indexWindow][pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,0);
+              mediateAllocateAndSetNumberedPlotData(&spectrumData[(indexWindow<<1)+1],"Calculated",&ws->lambda[pixMin],&pKurucz->dispSecX[indexWindow][pixMin],pixMax-pixMin+1,(indexWindow%2)?DashLine:Line,1);
              }
 
             mediateResponsePlotData(plotPageCalib,spectrumData,Nb_Win,Spectrum,forceAutoScale,string,"Wavelength (nm)","", responseHandle);
@@ -1091,7 +1514,7 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
       else
         sprintf(string,"Shift (%d/%d)",indexFenoColumn+1,ANALYSE_swathSize);
 
-      mediateAllocateAndSetPlotData(&spectrumData[0],"Polynomial fitting individual shift points",&Lambda[0],&shiftPoly[0],n_wavel,Line);
+      mediateAllocateAndSetPlotData(&spectrumData[0],"Polynomial fitting individual shift points",&ws->lambda[0],&shiftPoly[0],n_wavel,Line);
       mediateAllocateAndSetPlotData(&spectrumData[1],"Shift calculated in the individual small windows",VLambda+1,VShift+1,Nb_Win,Point);
       mediateResponsePlotData(plotPageCalib,spectrumData,2,Spectrum,forceAutoScale,string,"Wavelength (nm)","Shift (nm)", responseHandle);
       mediateReleasePlotData(&spectrumData[1]);
@@ -1107,19 +1530,19 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
         else
           sprintf(string,"SFP %d (%d/%d)",indexParam+1,indexFenoColumn+1,ANALYSE_swathSize);
 
-        if (TabCross[Feno->indexFwhmParam[indexParam]].FitParam!=ITEM_NONE) {
+        if (TabCross[pFeno->indexFwhmParam[indexParam]].FitParam!=ITEM_NONE) {
           for (i=0;i<n_wavel;i++) {
             fwhmVector[indexParam][i]=(double)coeff[indexParam][pKurucz->fwhmDegree];
             for (j=pKurucz->fwhmDegree-1;j>=0;j--)
-              fwhmVector[indexParam][i]=fwhmVector[indexParam][i]*(double)Lambda[i]+coeff[indexParam][j];
+              fwhmVector[indexParam][i]=fwhmVector[indexParam][i]*(double)ws->lambda[i]+coeff[indexParam][j];
           }
 
-          if ((rc=SPLINE_Deriv2(Lambda,fwhmVector[indexParam],fwhmDeriv2[indexParam],n_wavel,__func__))!=0)
+          if ((rc=SPLINE_Deriv2(ws->lambda,fwhmVector[indexParam],fwhmDeriv2[indexParam],n_wavel,__func__))!=0)
             goto EndKuruczSpectrum;
         }
 
         if (pKurucz->displayShift) {
-          mediateAllocateAndSetPlotData(&spectrumData[0],"Polynomial fitting individual FWHM points",&Lambda[0],&fwhmVector[indexParam][0],n_wavel,Line);
+          mediateAllocateAndSetPlotData(&spectrumData[0],"Polynomial fitting individual FWHM points",&ws->lambda[0],&fwhmVector[indexParam][0],n_wavel,Line);
           mediateAllocateAndSetPlotData(&spectrumData[1],"FWHM calculated in the individual small windows",VLambda+1,fwhm[indexParam],Nb_Win,Point);
           mediateResponsePlotData(plotPageCalib,spectrumData,2,Spectrum,forceAutoScale,string,"Wavelength (nm)",(pKuruczOptions->fwhmType==SLIT_TYPE_FILE)?"":"SFP (nm)", responseHandle);
           mediateReleasePlotData(&spectrumData[1]);
@@ -1142,10 +1565,10 @@ RC KURUCZ_Spectrum(const double *oldLambda,double *newLambda,double *spectrum,co
       for (indexParam=0;indexParam<maxParam;indexParam++)
         mediateResponseCellInfoNoLabel(plotPageCalib,indexLine,indexColumn++,responseHandle,"%10.3e+/-%10.3e",fwhm[indexParam][indexWindow],fwhmSigma[indexParam][indexWindow]);
 
-      if ((Feno->indexOffsetConst!=ITEM_NONE) && (Feno->TabCross[Feno->indexOffsetConst].FitParam!=ITEM_NONE))
-        mediateResponseCellInfoNoLabel(plotPageCalib,indexLine,indexColumn++,responseHandle,"%10.3e+/-%10.3e",Feno->TabCrossResults[Feno->indexOffsetConst].Param,Feno->TabCrossResults[Feno->indexOffsetConst].SigmaParam);
+      if ((pFeno->indexOffsetConst!=ITEM_NONE) && (pFeno->TabCross[pFeno->indexOffsetConst].FitParam!=ITEM_NONE))
+        mediateResponseCellInfoNoLabel(plotPageCalib,indexLine,indexColumn++,responseHandle,"%10.3e+/-%10.3e",pFeno->TabCrossResults[pFeno->indexOffsetConst].Param,pFeno->TabCrossResults[pFeno->indexOffsetConst].SigmaParam);
 
-      for (indexTabCross=0;indexTabCross<Feno->NTabCross;indexTabCross++) {
+      for (indexTabCross=0;indexTabCross<pFeno->NTabCross;indexTabCross++) {
         pTabCross=&TabCross[indexTabCross];
 
         if (pTabCross->IndSvdA && (WorkSpace[pTabCross->Comp].type==WRK_SYMBOL_CROSS))
@@ -1167,6 +1590,14 @@ EndKuruczSpectrum:
   if (spectrumData!=NULL)
    MEMORY_ReleaseBuffer(__func__,"spectrumData",spectrumData);
 
+  if (windowFits!=NULL)
+   {
+    for (indexWindow=0;indexWindow<Nb_Win;indexWindow++)                        // errors of the windows after a failed fit
+     free(windowFits[indexWindow].errors);
+
+    MEMORY_ReleaseBuffer(__func__,"windowFits",windowFits);
+   }
+
   if (solar!=NULL)
    MEMORY_ReleaseDVector(__func__,"solar",solar,0);
 
@@ -1201,7 +1632,8 @@ RC KURUCZ_ApplyCalibration(FENO *pTabFeno,double *newLambda,INDEX indexFenoColum
   // Declarations
 
   MATRIX_OBJECT slitMatrix[NSFP];
-  double slitParam[NSFP];
+  double slitParam[NSFP],
+         projectSlitParam[NSFP];                                                // wavelength dependent slit functions overwrite the parameters : don't share ANALYSIS_slitParam between rows
   INDEX indexWindow,i;
   int newDimL = 0;
   RC rc;
@@ -1209,6 +1641,7 @@ RC KURUCZ_ApplyCalibration(FENO *pTabFeno,double *newLambda,INDEX indexFenoColum
   // Initializations
   const int n_wavel = NDET[indexFenoColumn];
   memset(slitMatrix,0,sizeof(MATRIX_OBJECT)*NSFP);
+  memcpy(projectSlitParam,ANALYSIS_slitParam,sizeof(double)*NSFP);
   rc=0;
 
 #if defined(__DEBUG_) && __DEBUG_
@@ -1290,7 +1723,7 @@ RC KURUCZ_ApplyCalibration(FENO *pTabFeno,double *newLambda,INDEX indexFenoColum
      (((pTabFeno->useKurucz==ANLYS_KURUCZ_REF) || (pTabFeno->useKurucz==ANLYS_KURUCZ_SPEC)) &&
       ((pKuruczOptions->fwhmFit && (pKuruczOptions->fwhmType!=SLIT_TYPE_FILE) && ((pTabFeno->rcKurucz=ANALYSE_XsConvolution(pTabFeno,newLambda,slitMatrix,slitParam,pKuruczOptions->fwhmType,indexFenoColumn,1))!=ERROR_ID_NO)) ||
        (pKuruczOptions->fwhmFit && (pKuruczOptions->fwhmType==SLIT_TYPE_FILE) && ((pTabFeno->rcKurucz=ANALYSE_XsConvolution(pTabFeno,newLambda,slitMatrix,slitParam,pKuruczOptions->fwhmType,indexFenoColumn,1))!=ERROR_ID_NO)) ||
-      (!pKuruczOptions->fwhmFit && ((pTabFeno->rcKurucz=ANALYSE_XsConvolution(pTabFeno,newLambda,ANALYSIS_slitMatrix,ANALYSIS_slitParam,pSlitOptions->slitFunction.slitType,indexFenoColumn,pSlitOptions->slitFunction.slitWveDptFlag))!=ERROR_ID_NO))))))
+      (!pKuruczOptions->fwhmFit && ((pTabFeno->rcKurucz=ANALYSE_XsConvolution(pTabFeno,newLambda,ANALYSIS_slitMatrix,projectSlitParam,pSlitOptions->slitFunction.slitType,indexFenoColumn,pSlitOptions->slitFunction.slitWveDptFlag))!=ERROR_ID_NO))))))
 
    rc=pTabFeno->rcKurucz;
 
@@ -1313,7 +1746,8 @@ RC KURUCZ_ApplyCalibration(FENO *pTabFeno,double *newLambda,INDEX indexFenoColum
 // ----------------------------------------------------------------------------
 // PURPOSE         browse analysis windows and apply Kurucz if needed on reference spectrum
 //
-// INPUT           instrFunction  instrumental function to apply on reference spectrum
+// INPUT           ws             workspace of the fits (ANALYSE_mainWorkspace or the workspace of a worker thread)
+//                 instrFunction  instrumental function to apply on reference spectrum
 //                 refFlag        1 to apply Kurucz on the daily selected reference spectrum
 //                 saveFlag       1 to save the calibration results in the data Window
 //
@@ -1328,7 +1762,7 @@ RC KURUCZ_ApplyCalibration(FENO *pTabFeno,double *newLambda,INDEX indexFenoColum
 #if defined(__BC32_) && __BC32_
 #pragma argsused
 #endif
-RC KURUCZ_Reference(double *instrFunction,INDEX refFlag,int saveFlag,int gomeFlag,void *responseHandle,INDEX indexFenoColumn) {
+RC KURUCZ_Reference(struct analysis_workspace *ws,double *instrFunction,INDEX refFlag,int saveFlag,int gomeFlag,void *responseHandle,INDEX indexFenoColumn) {
   // Declarations
 
   FENO            *pTabFeno,*pTabRef,                                           // browse analysis windows
@@ -1454,11 +1888,11 @@ RC KURUCZ_Reference(double *instrFunction,INDEX refFlag,int saveFlag,int gomeFla
 
             if (!rc &&
                 !(rc=KuruczCalculatePreshift(calibratedMatrix.matrix[0],calibratedMatrix.matrix[1],reference,pTabFeno->NDET,pKuruczOptions->preshiftMin,pKuruczOptions->preshiftMax,0.2,(double)pKuruczOptions->lambdaLeft,(double)pKuruczOptions->lambdaRight,&pTabFeno->preshift))) {
-              if ((pKuruczFeno->indexSpectrum!=ITEM_NONE) && (TabCross[Feno->indexSpectrum].FitShift!=ITEM_NONE))
-                TabCross[Feno->indexSpectrum].InitShift=pTabFeno->preshift;
-              if ((pKuruczFeno->indexReference!=ITEM_NONE) && (TabCross[Feno->indexReference].FitShift!=ITEM_NONE)) {
+              if ((pKuruczFeno->indexSpectrum!=ITEM_NONE) && (TabCross[pKuruczFeno->indexSpectrum].FitShift!=ITEM_NONE))
+                TabCross[pKuruczFeno->indexSpectrum].InitShift=pTabFeno->preshift;
+              if ((pKuruczFeno->indexReference!=ITEM_NONE) && (TabCross[pKuruczFeno->indexReference].FitShift!=ITEM_NONE)) {
                 pTabFeno->preshift=-pTabFeno->preshift;
-                TabCross[Feno->indexReference].InitShift=pTabFeno->preshift;
+                TabCross[pKuruczFeno->indexReference].InitShift=pTabFeno->preshift;
               }
             }
 
@@ -1466,7 +1900,7 @@ RC KURUCZ_Reference(double *instrFunction,INDEX refFlag,int saveFlag,int gomeFla
           }
 
           // Apply Kurucz for building new calibration for reference
-          if ((rc=pTabFeno->rcKurucz=KURUCZ_Spectrum(pTabFeno->LambdaRef,pTabFeno->LambdaK,reference,pKurucz->solar,instrFunction,
+          if ((rc=pTabFeno->rcKurucz=KURUCZ_Spectrum(ws,pTabFeno->LambdaRef,pTabFeno->LambdaK,reference,pKurucz->solar,instrFunction,
                                                      1,pTabFeno->windowName,pTabFeno->fwhmPolyRef,pTabFeno->fwhmVector,pTabFeno->fwhmDeriv2,saveFlag,indexFeno,responseHandle,indexFenoColumn))!=ERROR_ID_NO)
             goto EndKuruczReference;
         }
@@ -2133,3 +2567,26 @@ void KURUCZ_Free(void)
   DEBUG_FunctionStop(__func__,0);
 #endif
  }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      KURUCZ_SetThreads
+// -----------------------------------------------------------------------------
+// PURPOSE       Set the number of threads used by KURUCZ_Spectrum to fit the
+//               little windows of the calibration.
+//
+// INPUT         nThreads - the number of threads (1 to fit the windows one
+//                          after the other)
+//
+// REMARK        The windows are always fitted one after the other when KURUCZ_Spectrum
+//               is called from a parallel region, when the slit function is fitted
+//               and without OpenMP support.
+// -----------------------------------------------------------------------------
+
+void KURUCZ_SetThreads(int nThreads)
+ {
+  #if defined(_OPENMP)
+  kuruczThreadsN=(nThreads>1)?nThreads:1;
+  #else
+  kuruczThreadsN=1;
+  #endif
+ }
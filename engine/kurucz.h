@@ -69,14 +69,17 @@ extern int KURUCZ_indexLine;
 // PROTOTYPES
 // ----------
 
-RC   KURUCZ_Spectrum(const double *oldLambda, double *newLambda, double *spectrum, const double *reference, double *instrFunction,
+struct analysis_workspace;
+
+RC   KURUCZ_Spectrum(struct analysis_workspace *ws,const double *oldLambda, double *newLambda, double *spectrum, const double *reference, double *instrFunction,
                    char displayFlag,const char *windowTitle,double **coeff,double **fwhmVector,double **fwhmDeriv2,int saveFlag,
                    INDEX indexFeno,void *responseHandle,INDEX indexFenoColumn);
 RC   KURUCZ_ApplyCalibration(FENO *pTabFeno,double *newLambda,INDEX indexFenoColumn);
-RC   KURUCZ_Reference(double *instrFunction,INDEX refFlag,int saveFlag,int gomeFlag,void *responseHandle,INDEX indexFenoColumn);
+RC   KURUCZ_Reference(struct analysis_workspace *ws,double *instrFunction,INDEX refFlag,int saveFlag,int gomeFlag,void *responseHandle,INDEX indexFenoColumn);
 RC   KURUCZ_Alloc(const PROJECT *pProject, const double *lambda, INDEX indexKurucz, double lambdaMin, double lambdaMax,
                   INDEX indexFenoColumn, const MATRIX_OBJECT *hr_solar, const MATRIX_OBJECT *slit_matrix);
 void KURUCZ_Init(int gomeFlag,INDEX indexFenoColumn);
 void KURUCZ_Free(void);
+void KURUCZ_SetThreads(int nThreads);
 
 #endif
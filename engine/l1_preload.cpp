@@ -0,0 +1,188 @@
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <algorithm>
+
+#include "l1_preload.h"
+
+using std::vector;
+using std::string;
+
+namespace {
+
+  // size of the chunks read by the loader thread
+  const size_t chunk_bytes = 32 * 1024 * 1024;
+
+  size_t preload_budget = 0; // memory budget in bytes (0 if the preload is disabled)
+
+  // a range of consecutive slices read by the loader thread
+  struct chunk {
+    size_t first;
+    size_t count;
+    vector<char> data;
+  };
+
+  // preload of the current file
+  struct preload {
+    size_t n_slices = 0;     // number of slices of the file (0 if the preload is not active)
+    size_t slice_size = 0;   // size of a slice in bytes
+    size_t chunk_slices = 0; // number of slices per chunk
+    size_t max_chunks = 0;   // number of chunks the budget can hold
+    l1_preload_loader loader;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv; // a chunk has been read or released, or the loader thread stopped
+
+    // shared with the loader thread (protected by mutex)
+    std::deque<chunk> chunks; // chunks read and not yet released, in the order of the slices
+    size_t next_slice = 0;    // first slice of the next chunk to read
+    bool single_first = false; // the first chunk is made of one slice only
+    bool stop = false;        // request to stop the loader thread
+    bool running = false;     // the loader thread is reading chunks
+    string error;             // error of the loader thread
+
+    ~preload() {
+      stop_thread();
+    }
+
+    // loader thread : read the chunks in sequence as long as the budget allows it
+    void load_chunks(void) {
+      std::unique_lock<std::mutex> lock(mutex);
+
+      while (!stop && (next_slice < n_slices)) {
+        cv.wait(lock, [this] { return stop || (chunks.size() < max_chunks); });
+        if (stop)
+          break;
+
+        chunk c;
+        c.first = next_slice;
+        c.count = single_first ? 1 : std::min(chunk_slices, n_slices - next_slice);
+        single_first = false;
+
+        lock.unlock();
+        try {
+          c.data.resize(c.count * slice_size);
+          loader(c.first, c.count, c.data.data());
+        } catch (std::exception& e) {
+          lock.lock();
+          error = e.what();
+          break;
+        }
+        lock.lock();
+
+        next_slice += c.count;
+        chunks.push_back(std::move(c)); // references to the other chunks remain valid
+        cv.notify_all();
+      }
+
+      running = false;
+      cv.notify_all();
+    }
+
+    void start_thread(size_t first, bool single = false) {
+      chunks.clear();
+      next_slice = first;
+      single_first = single;
+      stop = false;
+      running = true;
+      error.clear();
+      thread = std::thread(&preload::load_chunks, this);
+    }
+
+    void stop_thread(void) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+      }
+      cv.notify_all();
+      if (thread.joinable())
+        thread.join();
+    }
+  };
+
+  preload current;
+}
+
+void L1_SetPreloadBudget(int megabytes) {
+  preload_budget = (megabytes > 0) ? (size_t)megabytes * 1024 * 1024 : 0;
+}
+
+void L1_PreloadStop(void) {
+  current.stop_thread();
+  current.chunks.clear();
+  current.n_slices = 0;
+  current.loader = nullptr;
+}
+
+bool l1_preload_start(size_t n_slices, size_t slice_size, l1_preload_loader loader) {
+  L1_PreloadStop();
+
+  if (!preload_budget || !n_slices || !slice_size)
+    return false;
+
+  // chunks of about chunk_bytes, smaller if the budget can't hold two of them
+  size_t chunk_slices = std::min(std::max(chunk_bytes / slice_size, (size_t)1), preload_budget / (2 * slice_size));
+  if (!chunk_slices)
+    return false;
+
+  current.n_slices = n_slices;
+  current.slice_size = slice_size;
+  current.chunk_slices = chunk_slices;
+  current.max_chunks = preload_budget / (chunk_slices * slice_size);
+  current.loader = loader;
+
+  current.start_thread(0);
+  return true;
+}
+
+bool l1_preload_active(void) {
+  return current.n_slices > 0;
+}
+
+const char *l1_preload_get(size_t slice) {
+  if (slice >= current.n_slices)
+    throw std::runtime_error("L1 preload : slice " + std::to_string(slice) + " out of range");
+
+  std::unique_lock<std::mutex> lock(current.mutex);
+
+  // records are read in the order of the slices : release the chunks before the requested slice
+  while (!current.chunks.empty() && (current.chunks.front().first + current.chunks.front().count <= slice))
+    current.chunks.pop_front();
+  current.cv.notify_all();
+
+  // the slice has already been released, or can't be read without releasing the chunks in
+  // memory (the budget is full) : read again from this slice
+  const size_t window_first = current.chunks.empty() ? current.next_slice : current.chunks.front().first;
+  if ((slice < window_first) || (slice >= window_first + current.max_chunks * current.chunk_slices)) {
+    lock.unlock();
+    current.stop_thread();
+    current.start_thread(slice);
+    lock.lock();
+  }
+
+  for (bool retry = false; ; retry = true) {
+    current.cv.wait(lock, [slice] {
+        return !current.running || (!current.chunks.empty() && (current.chunks.back().first + current.chunks.back().count > slice)); });
+
+    for (const auto& c : current.chunks)
+      if ((slice >= c.first) && (slice < c.first + c.count))
+        return c.data.data() + (slice - c.first) * current.slice_size;
+
+    // the loader thread stopped on a chunk it couldn't read : read this slice alone and
+    // go on from there, so that the error only affects the records of the slice
+    if (retry || current.error.empty())
+      break;
+
+    lock.unlock();
+    current.stop_thread();
+    current.start_thread(slice, true);
+    lock.lock();
+  }
+
+  throw std::runtime_error(current.error.empty() ? "L1 preload : slice " + std::to_string(slice) + " not read" : current.error);
+}
@@ -0,0 +1,50 @@
+#ifndef L1_PRELOAD_H
+#define L1_PRELOAD_H
+
+// In-memory preload of the spectra of L1B orbit files (TROPOMI, GEMS, OMPS).
+//
+// The reader of the current file describes the along-track slices (scanlines,
+// images, measurements) of the arrays it needs and a function that reads a
+// range of slices.  A background thread then reads the file in large
+// sequential chunks of slices, ahead of the records requested by the analysis,
+// and keeps at most the memory budget in memory.
+//
+// The loader thread is the only one to access the NetCDF/HDF5 libraries while
+// the preload is active (they are not thread-safe) : the reader must not call
+// them for any file until L1_PreloadStop is called.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// set the memory budget of the preload in MB (0, the default, disables it)
+void L1_SetPreloadBudget(int megabytes);
+
+// stop the preload of the current file and release its buffers
+void L1_PreloadStop(void);
+
+#ifdef __cplusplus
+}
+
+#include <cstddef>
+#include <functional>
+
+// read the slices first to first+count-1 in buffer (count*slice_size bytes);
+// errors are reported by throwing std::runtime_error.
+typedef std::function<void(size_t first, size_t count, char *buffer)> l1_preload_loader;
+
+// start the preload of n_slices slices of slice_size bytes (the preload of the
+// previous file is stopped first).  Returns false if the preload is disabled
+// or if the budget doesn't hold at least two chunks.
+bool l1_preload_start(size_t n_slices, size_t slice_size, l1_preload_loader loader);
+
+// true if a preload is active
+bool l1_preload_active(void);
+
+// return the slice (waiting for the loader thread if necessary); the pointer is
+// valid until the next call.  Throws std::runtime_error if the slice can't be read.
+const char *l1_preload_get(size_t slice);
+
+#endif
+
+#endif
@@ -43,21 +43,54 @@ extern "C" {
 }
 
 #include <Eigen/Dense>
+#include <atomic>
+#include <vector>
 
 typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> Matrix2d;
-typedef Eigen::ColPivHouseholderQR<Matrix2d> MatrixQR;
+// the QR decomposition is computed in place in the matrix of struct eigen_qr
+typedef Eigen::ColPivHouseholderQR<Eigen::Ref<Matrix2d> > MatrixQR;
 
 #define EPS 2.2204e-016
 
+// source of the generations of the fixed columns (see LINEAR_fixed_columns_generation);
+// linear systems are allocated and reset by the threads fitting the rows of a scanline
+static std::atomic<unsigned> linear_generation(0);
+
 struct eigen_qr {
   Matrix2d *A;
   MatrixQR *QR;
 };
 
+// Update of the QR decomposition when only some columns of the matrix
+// change between two decompositions (see LINEAR_set_fixed_columns).
+//
+// The columns are permuted as A = [F V], F being the k fixed columns and V
+// the other ones.  With F = Q1 R1 P1' (kept between decompositions) and
+// C = Q1' V, the system becomes
+//
+//   | R1 P1'  C_top |  x_F   =  Q1' b
+//   |   0     C_bot |  x_V
+//
+// so that only C_bot (m-k rows, n-k columns) has to be decomposed again.
+struct qr_update {
+  std::vector<int> perm; // perm[0..k-1]: fixed columns, perm[k..n-1]: other columns
+  int k;
+  bool valid; // the decomposition of the fixed columns (QR1, gram) is up to date
+  bool active; // the last decomposition used the update
+  Eigen::ColPivHouseholderQR<Matrix2d> QR1, QR2;
+  Matrix2d gram; // F' * F
+  Matrix2d C;
+};
+
 // linear system of m equations and n unknowns
 struct linear_system {
   int m, n;
   double *norms; // colums of matrix are normalized to avoid numerical issues.
+  const double *columns; // matrix set by LINEAR_wrap_matrix (owned by the caller), read by LINEAR_decompose
+  int stride; // distance between two columns of the wrapped matrix
+  const double *sigma; // weights of the wrapped matrix (owned by the caller)
+  struct qr_update *update; // set by LINEAR_set_fixed_columns (QR decomposition of a wrapped matrix only)
+  unsigned generation; // changed by LINEAR_forget_fixed_columns, unique among all linear systems
   enum linear_fit_mode mode;
   union {
     struct svd svd;
@@ -65,19 +98,14 @@ struct linear_system {
   } decomposition;
 };
 
-struct linear_system*LINEAR_alloc(int m, int n, enum linear_fit_mode mode) {
- 
-#if defined(__DEBUG_) && __DEBUG_
-  DEBUG_FunctionBegin(__func__,DEBUG_FCTTYPE_APPL|DEBUG_FCTTYPE_MEM);
-#endif
-  
-  struct linear_system *s = new linear_system();
+// allocate the buffers of the decomposition for s->m equations and s->n unknowns
+static void linear_alloc_buffers(struct linear_system *s) {
+  const int m = s->m;
+  const int n = s->n;
+
   s->norms = new double[n];
-  s->m = m;
-  s->n = n;
-  s->mode = mode;
 
-  switch (mode) {
+  switch (s->mode) {
   case DECOMP_SVD:
     s->decomposition.svd.U=MEMORY_AllocDMatrix(__func__,"U",1,m,1,n);
     s->decomposition.svd.V=MEMORY_AllocDMatrix(__func__,"V",1,n,1,n);
@@ -94,9 +122,42 @@ struct linear_system*LINEAR_alloc(int m, int n, enum linear_fit_mode mode) {
     break;
   case DECOMP_EIGEN_QR:
     s->decomposition.qr_eigen.A = new Matrix2d(m, n);
-    s->decomposition.qr_eigen.QR = new MatrixQR(m, n);
+    s->decomposition.qr_eigen.QR = NULL; // bound to A by LINEAR_decompose
     break;
   }
+}
+
+static void linear_free_buffers(struct linear_system *s) {
+  switch(s->mode) {
+  case DECOMP_SVD:
+    MEMORY_ReleaseDMatrix(__func__,"U",s->decomposition.svd.U,1,1);
+    MEMORY_ReleaseDMatrix(__func__,"V",s->decomposition.svd.V,1,1);
+    MEMORY_ReleaseDVector(__func__,"W",s->decomposition.svd.W,1);
+    break;
+  case DECOMP_EIGEN_QR:
+    delete s->decomposition.qr_eigen.A;
+    delete s->decomposition.qr_eigen.QR;
+  }
+
+  delete[] s->norms;
+
+  if (s->update != NULL)
+    s->update->valid = s->update->active = false;
+}
+
+struct linear_system*LINEAR_alloc(int m, int n, enum linear_fit_mode mode) {
+ 
+#if defined(__DEBUG_) && __DEBUG_
+  DEBUG_FunctionBegin(__func__,DEBUG_FCTTYPE_APPL|DEBUG_FCTTYPE_MEM);
+#endif
+  
+  struct linear_system *s = new linear_system();
+  s->m = m;
+  s->n = n;
+  s->mode = mode;
+  s->generation = ++linear_generation;
+
+  linear_alloc_buffers(s);
 
 #if defined(__DEBUG_) && __DEBUG_
   DEBUG_FunctionStop(__func__,0);
@@ -105,6 +166,37 @@ struct linear_system*LINEAR_alloc(int m, int n, enum linear_fit_mode mode) {
   return s;
 }
 
+void LINEAR_reset(struct linear_system *s, int m, int n) {
+  s->columns = NULL;
+  s->sigma = NULL;
+
+  if (m == s->m && n == s->n)
+    return;
+
+  switch (s->mode) {
+  case DECOMP_SVD:
+    linear_free_buffers(s);
+    s->m = m;
+    s->n = n;
+    linear_alloc_buffers(s);
+    break;
+  case DECOMP_EIGEN_QR:
+    // the QR decomposition is resized by its next computation
+    if (n != s->n) {
+      delete[] s->norms;
+      s->norms = new double[n];
+    }
+    s->m = m;
+    s->n = n;
+    s->decomposition.qr_eigen.A->resize(m, n);
+    delete s->decomposition.qr_eigen.QR; // refers to the previous storage of A
+    s->decomposition.qr_eigen.QR = NULL;
+    if (s->update != NULL)
+      s->update->valid = s->update->active = false;
+    break;
+  }
+}
+
 // linear system of m equations in n variables
 struct linear_system *LINEAR_from_matrix(const double *const *a, int m, int n, enum linear_fit_mode mode) {
   struct linear_system *s = LINEAR_alloc(m, n, mode);
@@ -136,18 +228,8 @@ void LINEAR_free(struct linear_system *s) {
   DEBUG_FunctionBegin(__func__,DEBUG_FCTTYPE_APPL|DEBUG_FCTTYPE_MEM);
 #endif
 
-  switch(s->mode) {
-  case DECOMP_SVD:
-    MEMORY_ReleaseDMatrix(__func__,"U",s->decomposition.svd.U,1,1);
-    MEMORY_ReleaseDMatrix(__func__,"V",s->decomposition.svd.V,1,1);
-    MEMORY_ReleaseDVector(__func__,"W",s->decomposition.svd.W,1);
-    break;
-  case DECOMP_EIGEN_QR:
-    delete s->decomposition.qr_eigen.A;
-    delete s->decomposition.qr_eigen.QR;
-  }
-
-  delete[] s->norms;
+  linear_free_buffers(s);
+  delete s->update;
   delete s;
   
 #if defined(__DEBUG_) && __DEBUG_
@@ -170,10 +252,80 @@ void LINEAR_set_column(struct linear_system *s, int n, const double *values) {
   }
 }
 
+void LINEAR_wrap_matrix(struct linear_system *s, const double *const *a, int ld) {
+  switch (s->mode) {
+  case DECOMP_SVD:
+    // the SVD decomposition is calculated in place
+    for (int j=1; j<=s->n; ++j) {
+      LINEAR_set_column(s, j, a[j]);
+    }
+    break;
+  case DECOMP_EIGEN_QR:
+    s->columns = &a[1][1];
+    s->stride = ld;
+    for (int j=2; j<=s->n; ++j) {
+      assert(a[j] == a[1]+(j-1)*s->stride); // columns must be stored one after the other (MEMORY_AllocAlignedDMatrix)
+    }
+    break;
+  }
+}
+
+void LINEAR_set_fixed_columns(struct linear_system *s, const int *fixed) {
+  if (s->mode != DECOMP_EIGEN_QR)
+    return;
+
+  if (fixed == NULL) {
+    delete s->update;
+    s->update = NULL;
+    return;
+  }
+
+  std::vector<int> perm;
+  perm.reserve(s->n);
+  for (int j=0; j<s->n; ++j) {
+    if (fixed[1+j])
+      perm.push_back(j);
+  }
+  const int k = perm.size();
+  for (int j=0; j<s->n; ++j) {
+    if (!fixed[1+j])
+      perm.push_back(j);
+  }
+
+  if (s->update == NULL) {
+    s->update = new qr_update();
+    s->update->valid = s->update->active = false;
+  }
+  if (s->update->k != k || s->update->perm != perm) {
+    s->update->perm = perm;
+    s->update->k = k;
+    s->update->valid = false;
+  }
+}
+
+void LINEAR_forget_fixed_columns(struct linear_system *s) {
+  if (s == NULL)
+    return;
+
+  s->generation = ++linear_generation;
+  if (s->update != NULL)
+    s->update->valid = false;
+}
+
+unsigned LINEAR_fixed_columns_generation(const struct linear_system *s) {
+  return (s != NULL) ? s->generation : 0;
+}
+
 void LINEAR_set_weight(struct linear_system *s, const double *sigma) {
   if (sigma == NULL)
     return;
 
+  if (s->columns != NULL) {
+    // applied when the wrapped matrix is read
+    s->sigma = sigma;
+    return;
+  }
+
   switch (s->mode) {
   case DECOMP_SVD:
     for (int i=1; i<= s->n; ++i) {
@@ -190,6 +342,96 @@ void LINEAR_set_weight(struct linear_system *s, const double *sigma) {
   }
 }
 
+#define LINEAR_UPDATE_NOT_APPLICABLE -1
+
+// copy column perm[j] of the wrapped matrix, weighted by sigma, in column j of
+// the matrix of the decomposition, and normalize it.
+static int linear_load_column(struct linear_system *s, int j, int col) {
+  Eigen::Map<const Eigen::VectorXd> column(s->columns+(size_t)col*s->stride, s->m);
+  auto col_j = s->decomposition.qr_eigen.A->col(j);
+  if (s->sigma != NULL) {
+    col_j = column.cwiseQuotient(Eigen::Map<const Eigen::VectorXd>(s->sigma, s->m));
+  } else {
+    col_j = column;
+  }
+  s->norms[col] = col_j.squaredNorm();
+  if (s->norms[col] == 0.)
+    return ERROR_SetLast(__func__, ERROR_TYPE_WARNING, ERROR_ID_NORMALIZE);
+  s->norms[col] = sqrt(s->norms[col]);
+  col_j /= s->norms[col];
+  return ERROR_ID_NO;
+}
+
+// decomposition of the wrapped matrix reusing the decomposition of the fixed
+// columns; returns LINEAR_UPDATE_NOT_APPLICABLE if the fixed columns are
+// linearly dependent (the full decomposition handles them).
+static int linear_decompose_update(struct linear_system *s, double *sigmasquare, double **covar) {
+  struct qr_update *u = s->update;
+  Matrix2d& matrix_A = *s->decomposition.qr_eigen.A; // columns in the order of perm
+  const int m = s->m, n = s->n, k = u->k, p = n-k;
+  int rc = ERROR_ID_NO;
+
+  if (!u->valid) {
+    for (int j=0; j<k; ++j) {
+      if ((rc = linear_load_column(s, j, u->perm[j])) != ERROR_ID_NO)
+        return rc;
+    }
+    u->QR1.compute(matrix_A.leftCols(k));
+    if (u->QR1.rank() < k)
+      return LINEAR_UPDATE_NOT_APPLICABLE;
+    u->gram = matrix_A.leftCols(k).transpose() * matrix_A.leftCols(k);
+    u->valid = true;
+  }
+
+  for (int j=k; j<n; ++j) {
+    if ((rc = linear_load_column(s, j, u->perm[j])) != ERROR_ID_NO)
+      return rc;
+  }
+
+  const auto matrix_F = matrix_A.leftCols(k);
+  const auto matrix_V = matrix_A.rightCols(p);
+  u->C = matrix_V;
+  u->C.applyOnTheLeft(u->QR1.householderQ().adjoint());
+  u->QR2.compute(u->C.bottomRows(m-k));
+  u->active = true;
+
+  // covariance: inverse of A' * A, assembled from the (cached) F' * F
+  Matrix2d gram(n, n);
+  gram.topLeftCorner(k, k) = u->gram;
+  gram.topRightCorner(k, p) = matrix_F.transpose() * matrix_V;
+  gram.bottomLeftCorner(p, k) = gram.topRightCorner(k, p).transpose();
+  gram.bottomRightCorner(p, p) = matrix_V.transpose() * matrix_V;
+  Matrix2d matrix_covar = gram.llt().solve(Eigen::MatrixXd::Identity(n, n));
+
+  for (int i=0; i<n; ++i) {
+    const int ci = u->perm[i];
+    if (covar != NULL) {
+      for (int j=0; j<n; ++j) {
+        const int cj = u->perm[j];
+        covar[1+ci][1+cj] = matrix_covar(i, j) / (s->norms[ci]*s->norms[cj]);
+      }
+    }
+    if (sigmasquare != NULL)
+      sigmasquare[1+ci] = matrix_covar(i, i) / (s->norms[ci]*s->norms[ci]);
+  }
+
+  return rc;
+}
+
+static void linear_solve_update(const struct linear_system *s, const Eigen::Map<const Eigen::VectorXd>& vb, Eigen::Map<Eigen::VectorXd>& vx) {
+  const struct qr_update *u = s->update;
+  const int m = s->m, n = s->n, k = u->k;
+
+  Eigen::VectorXd c = vb;
+  c.applyOnTheLeft(u->QR1.householderQ().adjoint());
+  const Eigen::VectorXd x_V = u->QR2.solve(c.tail(m-k));
+  const Eigen::VectorXd z = u->QR1.matrixR().topLeftCorner(k, k).triangularView<Eigen::Upper>().solve(c.head(k) - u->C.topRows(k) * x_V);
+  const Eigen::VectorXd x_F = u->QR1.colsPermutation() * z;
+
+  for (int j=0; j<n; ++j)
+    vx(u->perm[j]) = (j < k) ? x_F(j) : x_V(j-k);
+}
+
 int LINEAR_decompose(struct linear_system *s, double *sigmasquare, double **covar) {
   int rc=ERROR_ID_NO;
 
@@ -216,23 +458,59 @@ int LINEAR_decompose(struct linear_system *s, double *sigmasquare, double **cova
     }
     break;
   case DECOMP_EIGEN_QR: {
-    // normalisation:
-    for (int j=0; j<s->n; ++j) {
-      auto col_j = s->decomposition.qr_eigen.A->col(j);
-      s->norms[j] = col_j.squaredNorm();
-      if (s->norms[j] == 0.)
-	return ERROR_SetLast(__func__, ERROR_TYPE_WARNING, ERROR_ID_NORMALIZE);
-      s->norms[j] = sqrt(s->norms[j]);
-      col_j /= s->norms[j];
+    if (s->update != NULL) {
+      s->update->active = false;
+      if (s->columns != NULL && s->update->k > 0 && s->update->k < s->n) {
+        rc = linear_decompose_update(s, sigmasquare, covar);
+        if (rc != LINEAR_UPDATE_NOT_APPLICABLE)
+          return rc;
+        rc = ERROR_ID_NO;
+      }
+      s->update->valid = false; // A is overwritten below
+    }
+
+    Matrix2d& matrix_A = *s->decomposition.qr_eigen.A;
+    // copy the columns of the wrapped matrix (weighted by sigma) and normalize them, one column at a time:
+    if (s->columns != NULL) {
+      Eigen::Map<const Matrix2d, 0, Eigen::OuterStride<> > columns(s->columns, s->m, s->n, Eigen::OuterStride<>(s->stride));
+      for (int j=0; j<s->n; ++j) {
+        auto col_j = matrix_A.col(j);
+        if (s->sigma != NULL) {
+          col_j = columns.col(j).cwiseQuotient(Eigen::Map<const Eigen::VectorXd>(s->sigma, s->m));
+        } else {
+          col_j = columns.col(j);
+        }
+        s->norms[j] = col_j.squaredNorm();
+        if (s->norms[j] == 0.)
+          return ERROR_SetLast(__func__, ERROR_TYPE_WARNING, ERROR_ID_NORMALIZE);
+        s->norms[j] = sqrt(s->norms[j]);
+        col_j /= s->norms[j];
+      }
+    } else {
+      // normalisation:
+      for (int j=0; j<s->n; ++j) {
+        auto col_j = matrix_A.col(j);
+        s->norms[j] = col_j.squaredNorm();
+        if (s->norms[j] == 0.)
+          return ERROR_SetLast(__func__, ERROR_TYPE_WARNING, ERROR_ID_NORMALIZE);
+        s->norms[j] = sqrt(s->norms[j]);
+        col_j /= s->norms[j];
+      }
     }
-    s->decomposition.qr_eigen.QR->compute(*s->decomposition.qr_eigen.A);
 
     // Compute covariance.
     // The covariance matrix is given by the inverse of A' * A.  Unfortunately, Eigen does not seem to provide a way to
     // reuse the matrix R from our QR decomposition, which is also the Cholesky factor of A' * A.  Therefore, we compute
-    // the inverse of A' * A again, using Cholesky decomposition.
-    const auto& matrix_A = *s->decomposition.qr_eigen.A;
+    // the inverse of A' * A again, using Cholesky decomposition.  This has to be done before the decomposition, which
+    // overwrites A.
     Matrix2d matrix_covar = (matrix_A.transpose() * matrix_A).llt().solve(Eigen::MatrixXd::Identity(s->n, s->n));
+
+    // in-place decomposition: avoids a copy of A in the QR object, which is bound to A
+    // until A is resized (LINEAR_reset) and keeps its buffers between decompositions
+    if (s->decomposition.qr_eigen.QR == NULL)
+      s->decomposition.qr_eigen.QR = new MatrixQR(matrix_A);
+    else
+      s->decomposition.qr_eigen.QR->compute(matrix_A);
     if (covar != NULL) {
       for (int i=0; i<s->n; ++i) {
 	for (int j=0; j<s->n; ++j) {
@@ -261,7 +539,10 @@ int LINEAR_solve(const struct linear_system *s, const double *b, double *x) {
     // Define Eigen vectors mapping the existing buffers b and x (b and x index starts at 1):
     Eigen::Map<const Eigen::VectorXd> vb(b+1, s->m);
     Eigen::Map<Eigen::VectorXd> vx(x+1, s->n);
-    vx = s->decomposition.qr_eigen.QR->solve(vb);
+    if (s->update != NULL && s->update->active)
+      linear_solve_update(s, vb, vx);
+    else
+      vx = s->decomposition.qr_eigen.QR->solve(vb);
   }
     break;
   }
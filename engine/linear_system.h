@@ -26,7 +26,12 @@
 //
 // a linear system can be created from an existing matrix using
 // LINEAR_from_matrix(), or it can be allocated using LINEAR_alloc()
-// and LINEAR_set_column() (making sure each column is set)
+// and LINEAR_set_column() (making sure each column is set) or
+// LINEAR_wrap_matrix()
+//
+// a linear system can be reused for a new matrix with LINEAR_reset(),
+// which keeps its buffers if the number of equations and unknowns
+// doesn't change
 //
 // weights can be applied using linear_set_weight()
 //
@@ -65,10 +70,45 @@ struct linear_system *LINEAR_from_matrix(const double *const *a, int m, int n, e
 // col[1..m]:
 void LINEAR_set_column(struct linear_system *s, int n, const double *col);
 
+// use the columns a[1..n][1..m] of a matrix allocated by
+// MEMORY_AllocAlignedDMatrix without copying them: the matrix is read by
+// LINEAR_decompose and must not be released before.  ld is the
+// distance between two columns returned by MEMORY_AllocAlignedDMatrix.
+// With SVD decomposition, the columns are copied.
+void LINEAR_wrap_matrix(struct linear_system *s, const double *const *a, int ld);
+
+// prepare the linear system for a new matrix of m equations and n
+// unknowns.  Buffers are reallocated only if the size changes.
+void LINEAR_reset(struct linear_system *s, int m, int n);
+
+// declare the columns of a wrapped matrix which do not change from one
+// decomposition to the next (same values, same weights).
+// fixed[1..n]: nonzero for a fixed column; NULL to always decompose
+// the full matrix.
+//
+// With QR decomposition, LINEAR_decompose keeps the decomposition of
+// the fixed columns and only updates it with the other columns, until
+// LINEAR_forget_fixed_columns is called or the size of the system
+// changes.  The solution is the same as with the full decomposition,
+// up to rounding errors.
+void LINEAR_set_fixed_columns(struct linear_system *s, const int *fixed);
+
+// the fixed columns (or the weights) have changed: the next call to
+// LINEAR_decompose recalculates their decomposition.  s may be NULL.
+void LINEAR_forget_fixed_columns(struct linear_system *s);
+
+// value changed by each call to LINEAR_forget_fixed_columns (and different
+// for each allocated system; 0 if s is NULL): the copies of a linear
+// system (see curfit.c) forget their fixed columns when it changes.
+unsigned LINEAR_fixed_columns_generation(const struct linear_system *s);
+
 // weigh the vectors of the linear system by sigma.
 // sigma[0..m-1]: vector of weights
 //
 // TODO: store weight vector in linear system and automatically apply to right hand side when solving A*x=b?
+//
+// for a wrapped matrix, the weights are applied by LINEAR_decompose:
+// sigma must not be released before.
 void LINEAR_set_weight(struct linear_system *s, const double *sigma);
 
 // release memory
@@ -10,6 +10,10 @@
 //    12 october 2004 - the debug mode and errors handling have been improved;
 //                    - the stack is not mandatory anymore (could be allocated
 //                      in debugging mode only);
+//    16 october 2026 - scratch arenas for the temporary vectors of the
+//                      fitting functions;
+//                    - matrices with aligned columns for the linear systems
+//                      of the fit;
 //
 //  QDOAS is a cross-platform application developed in QT for DOAS retrieval
 //  (Differential Optical Absorption Spectroscopy).
@@ -48,6 +52,13 @@
 //  MEMORY_ReleaseDVector - release a vector previously allocated by MEMORY_AllocDVector;
 //  MEMORY_AllocDMatrix - allocate a matrix in double precision with specified base indexes for rows and columns;
 //  MEMORY_ReleaseDMatrix - release a matrix previously allocated by MEMORY_AllocDMatrix;
+//  MEMORY_AllocAlignedDMatrix - allocate a matrix in double precision with aligned columns;
+//  MEMORY_ReleaseAlignedDMatrix - release a matrix previously allocated by MEMORY_AllocAlignedDMatrix;
+//  MEMORY_AllocArena - allocate a scratch arena for temporary vectors;
+//  MEMORY_ReleaseArena - release a scratch arena allocated by MEMORY_AllocArena;
+//  MEMORY_SelectArena - select the scratch arena of the calling thread;
+//  MEMORY_AllocScratchDVector - allocate a temporary vector from the scratch arena;
+//  MEMORY_ReleaseScratchDVector - release a vector allocated by MEMORY_AllocScratchDVector;
 //  MEMORY_Alloc - allocate memory for a stack in view of debugging the allocation/release application buffers;
 //  MEMORY_End - release the memory allocated for the stack by MEMORY_Alloc;
 //  MEMORY_GetInfo - retrieve from the stack the information about an allocated object;
@@ -94,6 +105,8 @@ static int32_t    memoryMaxBytes=0;
 static int     memoryMaxObjects=0;                                              // maximum number of objects allocated in one time
 static int32_t    memoryMaxObjectsSize=0;                                          // total size used when maximum number of objects is reached
 
+static THREAD_LOCAL MEMORY_ARENA *memoryArena=NULL;                             // scratch arena selected by the current thread
+
 // =========
 // FUNCTIONS
 // =========
@@ -441,6 +454,232 @@ void MEMORY_ReleaseDMatrix(const char *callingFunctionName,const char *bufferNam
   #endif
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      MEMORY_AllocAlignedDMatrix
+// -----------------------------------------------------------------------------
+// PURPOSE       allocate a matrix in double precision with columns aligned on
+//               MEMORY_ALIGNMENT bytes;
+//
+// INPUT         see MEMORY_AllocDMatrix;
+//
+// OUTPUT        pLd : the leading dimension, i.e. the distance between two
+//                     consecutive columns (may be NULL);
+//
+// RETURN        pointer to the allocated buffer;
+//
+// NB            columns are stored one after the other in a single buffer, as
+//               in MEMORY_AllocDMatrix, but the number of rows is padded so
+//               that each column starts on an aligned address.  Matrices
+//               allocated with this function should be released with
+//               MEMORY_ReleaseAlignedDMatrix.
+// -----------------------------------------------------------------------------
+
+double **MEMORY_AllocAlignedDMatrix(const char *callingFunctionName, const char *bufferName,int nrl,int nrh,int ncl,int nch,int *pLd) {
+  #if defined(__DEBUG_) && __DEBUG_
+  DEBUG_FunctionBegin("MEMORY_AllocAlignedDMatrix",DEBUG_FCTTYPE_MEM);
+  #endif
+
+  if ((nch-ncl+1<=0) || (nrh-nrl+1<=0)) {
+    ERROR_SetLast(callingFunctionName,ERROR_TYPE_FATAL,ERROR_ID_ALLOCMATRIX,bufferName,nrl,nrh,ncl,nch);
+    return NULL;
+  }
+
+  double **m=MEMORY_AllocBuffer(callingFunctionName,bufferName,nch-ncl+1,sizeof(double *),ncl,MEMORY_TYPE_PTR);
+  if (m==NULL)
+    return m;
+  m -= ncl;
+
+  const int align = MEMORY_ALIGNMENT/sizeof(double);
+  const int n_cols = nch-ncl+1;
+  const int ld = ((nrh-nrl+1+align-1)/align)*align;
+
+  // Over-allocate the buffer and keep the address returned by malloc just
+  // before the aligned block for MEMORY_ReleaseAlignedDMatrix
+
+  char *raw = malloc(sizeof(double)*n_cols*ld+MEMORY_ALIGNMENT+sizeof(void *));
+  if (raw == NULL) {
+    MEMORY_ReleaseBuffer(callingFunctionName,bufferName,m+ncl);
+    ERROR_SetLast(callingFunctionName,ERROR_TYPE_FATAL,ERROR_ID_ALLOCMATRIX,bufferName,nrl,nrh,ncl,nch);
+    return NULL;
+  }
+
+  double *buffer = (double *)(((uintptr_t)(raw+sizeof(void *))+MEMORY_ALIGNMENT-1)&~(uintptr_t)(MEMORY_ALIGNMENT-1));
+  ((void **)buffer)[-1] = raw;
+
+  for (int i=0; i<n_cols; ++i) {
+    m[ncl+i] = &buffer[i*ld]-nrl;
+  }
+
+  if (pLd != NULL)
+    *pLd = ld;
+
+  #if defined(__DEBUG_) && __DEBUG_
+  DEBUG_FunctionStop("MEMORY_AllocAlignedDMatrix",(RC)m);
+  #endif
+
+  return(m);
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      MEMORY_ReleaseAlignedDMatrix
+// -----------------------------------------------------------------------------
+// PURPOSE       release a matrix previously allocated by MEMORY_AllocAlignedDMatrix
+//
+// INPUT         see MEMORY_ReleaseDMatrix;
+// -----------------------------------------------------------------------------
+
+void MEMORY_ReleaseAlignedDMatrix(const char *callingFunctionName,const char *bufferName,double **m,int ncl,int nrl)
+ {
+  #if defined(__DEBUG_) && __DEBUG_
+  DEBUG_FunctionBegin("MEMORY_ReleaseAlignedDMatrix",DEBUG_FCTTYPE_MEM);
+  #endif
+
+  if (m!=NULL) {
+    free(((void **)&m[ncl][nrl])[-1]);
+    MEMORY_ReleaseBuffer(callingFunctionName,bufferName,m+ncl);
+  }
+
+  #if defined(__DEBUG_) && __DEBUG_
+  DEBUG_FunctionStop("MEMORY_ReleaseAlignedDMatrix",0);
+  #endif
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      MEMORY_AllocArena
+// -----------------------------------------------------------------------------
+// PURPOSE       allocate a scratch arena for temporary vectors in double precision
+//
+// INPUT         callingFunctionName  : the name of the calling function;
+//               pArena               : the arena to allocate;
+//               size                 : the number of doubles the arena can hold;
+//
+// RETURN        ERROR_ID_ALLOC if the allocation of the arena failed;
+//               ERROR_ID_NO otherwise
+//
+// NB            temporary vectors are taken from the arena by MEMORY_AllocScratchDVector
+//               once the arena has been selected by MEMORY_SelectArena;  this avoids
+//               one allocation/release of buffers for each evaluation of the fitting
+//               function.
+// -----------------------------------------------------------------------------
+
+RC MEMORY_AllocArena(const char *callingFunctionName,MEMORY_ARENA *pArena,int size)
+ {
+  memset(pArena,0,sizeof(MEMORY_ARENA));
+
+  if ((pArena->buffer=(double *)MEMORY_AllocBuffer(callingFunctionName,"arena",size,sizeof(double),0,MEMORY_TYPE_DOUBLE))==NULL)
+   return ERROR_ID_ALLOC;
+
+  pArena->size=size;
+
+  return ERROR_ID_NO;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      MEMORY_ReleaseArena
+// -----------------------------------------------------------------------------
+// PURPOSE       release a scratch arena allocated by MEMORY_AllocArena
+//
+// INPUT         callingFunctionName  : the name of the calling function;
+//               pArena               : the arena to release;
+// -----------------------------------------------------------------------------
+
+void MEMORY_ReleaseArena(const char *callingFunctionName,MEMORY_ARENA *pArena)
+ {
+  if (memoryArena==pArena)
+   memoryArena=NULL;
+
+  if (pArena->buffer!=NULL)
+   MEMORY_ReleaseBuffer(callingFunctionName,"arena",pArena->buffer);
+
+  memset(pArena,0,sizeof(MEMORY_ARENA));
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      MEMORY_SelectArena
+// -----------------------------------------------------------------------------
+// PURPOSE       select the scratch arena of the calling thread
+//
+// INPUT         pArena : the arena to use for scratch vectors (NULL to allocate
+//                        them on the heap);
+//
+// RETURN        the arena previously selected, to restore after use
+// -----------------------------------------------------------------------------
+
+MEMORY_ARENA *MEMORY_SelectArena(MEMORY_ARENA *pArena)
+ {
+  MEMORY_ARENA *pPrevious=memoryArena;
+
+  memoryArena=pArena;
+
+  return pPrevious;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      MEMORY_AllocScratchDVector
+// -----------------------------------------------------------------------------
+// PURPOSE       allocate a temporary vector in double precision with a specified
+//               base index from the scratch arena of the calling thread
+//
+// INPUT         callingFunctionName  : the name of the calling function;
+//               bufferName           : the name of the buffer in the calling function;
+//               nl                   : lower index in use;
+//               nh                   : higher index in use;
+//
+// RETURN        pointer to the allocated buffer;
+//
+// NB            when no arena is selected or the arena is full, the vector is
+//               allocated by MEMORY_AllocDVector.  Vectors allocated with this
+//               function should be released with MEMORY_ReleaseScratchDVector.
+// -----------------------------------------------------------------------------
+
+double *MEMORY_AllocScratchDVector(const char *callingFunctionName, const char *bufferName,int nl,int nh)
+ {
+  MEMORY_ARENA *pArena=memoryArena;
+  double *v;
+
+  if ((pArena==NULL) || (nh-nl+1<=0) || (pArena->used+nh-nl+1>pArena->size))
+   return MEMORY_AllocDVector(callingFunctionName,bufferName,nl,nh);
+
+  v=pArena->buffer+pArena->used;
+  pArena->used+=nh-nl+1;
+
+  return v-nl;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      MEMORY_ReleaseScratchDVector
+// -----------------------------------------------------------------------------
+// PURPOSE       release a vector previously allocated by MEMORY_AllocScratchDVector
+//
+// INPUT         callingFunctionName  : the name of the calling function;
+//               bufferName           : the name of the buffer in the calling function;
+//               v                    : the pointer to the vector;
+//               nl                   : lower index in use;
+//
+// NB            the space of the arena is recovered in the reverse order of the
+//               allocations : releasing a vector also releases the vectors
+//               allocated after it in the arena, so that scratch vectors should
+//               all be released at the end of the calling function.
+// -----------------------------------------------------------------------------
+
+void MEMORY_ReleaseScratchDVector(const char *callingFunctionName, const char *bufferName,double *v,int nl)
+ {
+  MEMORY_ARENA *pArena=memoryArena;
+
+  if (v==NULL)
+   return;
+
+  v+=nl;
+
+  if ((pArena!=NULL) && (v>=pArena->buffer) && (v<pArena->buffer+pArena->size))
+   {
+    if (v-pArena->buffer<pArena->used)
+     pArena->used=(int)(v-pArena->buffer);
+   }
+  else
+   MEMORY_ReleaseBuffer(callingFunctionName,bufferName,v);
+ }
+
 // -----------------------------------------------------------------------------
 // FUNCTION      MEMORY_Alloc
 // -----------------------------------------------------------------------------
@@ -44,8 +44,13 @@
 //  MFC_ReadRecord - record read out and processing in binary format;
 //
 //  ReliMFC - MFC binary format read out;
+//  ReliMFCHeader - MFC binary format read out of the header only;
 //
 //  ReliMFCStd - MFC ASCII format read out;
+//  ReliMFCStdHeader - MFC ASCII format read out of the header only;
+//
+//  MFCBIRA_Reli - MFC BIRA-IASB binary format read out;
+//  MFCBIRA_ReliHeader - MFC BIRA-IASB binary format read out of the header only;
 //  ----------------------------------------------------------------------------
 
 // =======
@@ -421,7 +426,8 @@ RC SetMFC(ENGINE_CONTEXT *pEngineContext,FILE *specFp)
 //               mask              mask used for spectra selection;
 //
 // OUTPUT        pHeaderSpe, spe   resp. data on the current record and the spectrum
-//                                 to process;
+//                                 to process (only the header is read if spe is NULL,
+//                                 the file is checked to contain the whole spectrum);
 //
 // RETURN        ERROR_ID_FILE_NOT_FOUND  the input file can't be found;
 //               ERROR_ID_FILE_EMPTY      the file is empty;
@@ -458,21 +464,23 @@ RC MFC_ReadRecord(char *fileName,
 
   // Allocate a buffer for the spectrum
 
-  else if ((specTmp=(float *)MEMORY_AllocBuffer(__func__,"specTmp",n_wavel,sizeof(float),0,MEMORY_TYPE_FLOAT))==NULL)
+  else if ((spe!=NULL) && ((specTmp=(float *)MEMORY_AllocBuffer(__func__,"specTmp",n_wavel,sizeof(float),0,MEMORY_TYPE_FLOAT))==NULL))
    rc=ERROR_ID_ALLOC;
   else
    {
-    for (i=0;i<n_wavel;i++)
-     specTmp[i]=0.0f;
+    if (specTmp!=NULL)
+     for (i=0;i<n_wavel;i++)
+      specTmp[i]=0.0f;
 
     if (!fread(pHeaderSpe,sizeof(*pHeaderSpe),1,fp) || // header
        ((mask!=maskSpec) && ((pHeaderSpe->ty&mask)==0) && ((unsigned int)pHeaderSpe->wavelength1!=mask)) ||                    // spectrum selection
         (pHeaderSpe->no_chan==0) || (pHeaderSpe->no_chan>n_wavel) || // verify the size of the spectrum
-        !fread(specTmp,sizeof(*specTmp)*pHeaderSpe->no_chan,1,fp)) { // read spectrum
+        ((specTmp!=NULL) && !fread(specTmp,sizeof(*specTmp)*pHeaderSpe->no_chan,1,fp)) || // read spectrum
+        ((specTmp==NULL) && (STD_FileLength(fp)-ftell(fp)<(long)sizeof(float)*pHeaderSpe->no_chan))) { // or only check that it is complete
       memset(pHeaderSpe,0,sizeof(TBinaryMFC));
       pHeaderSpe->int_time= 0.0f;
       rc=ERROR_ID_FILE_BAD_FORMAT;
-    } else {
+    } else if (spe!=NULL) {
 
       // Copy original spectrum to the output buffer
 
@@ -516,14 +524,14 @@ RC MFC_ReadRecord(char *fileName,
  }
 
 // -----------------------------------------------------------------------------
-// FUNCTION      ReliMFC
+// FUNCTION      MfcReli
 // -----------------------------------------------------------------------------
-// PURPOSE       MFC binary format read out
+// PURPOSE       MFC binary format read out (ReliMFC, ReliMFCHeader)
 //
 // INPUT         recordNo     index of record in file;
 //               dateFlag     0 no date constraint; 1 a date selection is applied;
-//               specFp       pointer to the spectra file;
 //               mfcMask      mask for spectra selection;
+//               headerOnly   1 to skip the read out of the spectrum;
 //
 // OUTPUT        pEngineContext  : pointer to a structure whose some fields are filled
 //                            with data on the current spectrum
@@ -532,7 +540,7 @@ RC MFC_ReadRecord(char *fileName,
 //               ERROR_ID_FILE_RECORD    : the record doesn't satisfy user constraints
 //               ERROR_ID_NO             : otherwise.
 // -----------------------------------------------------------------------------
-RC ReliMFC(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp,unsigned int mfcMask)
+static RC MfcReli(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,unsigned int mfcMask,int headerOnly)
  {
   // Declarations
 
@@ -583,7 +591,7 @@ RC ReliMFC(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay
 
     // Record read out
 
-    if (!(rc=MFC_ReadRecord(fileName,&MFC_header,pBuffers->spectrum,&MFC_headerDrk,pBuffers->varPix,&MFC_headerOff,pBuffers->offset,mfcMask,pMfc->mfcMaskSpec,pMfc->mfcRevert)))
+    if (!(rc=MFC_ReadRecord(fileName,&MFC_header,(!headerOnly)?pBuffers->spectrum:NULL,&MFC_headerDrk,pBuffers->varPix,&MFC_headerOff,pBuffers->offset,mfcMask,pMfc->mfcMaskSpec,pMfc->mfcRevert)))
      {
       if ((mfcMask==pMfc->mfcMaskSpec) &&
          (((pMfc->mfcMaskSpec!=(unsigned int)0) && ((unsigned int)MFC_header.ty==mfcMask)) ||
@@ -761,6 +769,34 @@ RC ReliMFC(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay
   return rc;
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      ReliMFC
+// -----------------------------------------------------------------------------
+// PURPOSE       MFC binary format read out
+// -----------------------------------------------------------------------------
+
+RC ReliMFC(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp,unsigned int mfcMask)
+ {
+  (void)specFp;                                                                 // each record is a file opened by MFC_ReadRecord
+
+  return MfcReli(pEngineContext,recordNo,dateFlag,localDay,mfcMask,0);
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      ReliMFCHeader
+// -----------------------------------------------------------------------------
+// PURPOSE       MFC binary format read out of the information on the record
+//               (date, time, geolocation and viewing angles) without the
+//               spectrum; same arguments and return codes as ReliMFC.
+// -----------------------------------------------------------------------------
+
+RC ReliMFCHeader(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp,unsigned int mfcMask)
+ {
+  (void)specFp;                                                                 // each record is a file opened by MFC_ReadRecord
+
+  return MfcReli(pEngineContext,recordNo,dateFlag,localDay,mfcMask,1);
+ }
+
 // ================
 // MFC ASCII FORMAT
 // ================
@@ -776,7 +812,7 @@ RC ReliMFC(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay
 //               mask              mask used for spectra selection;
 //
 // OUTPUT        pHeaderSpe, spe   resp. data on the current record and the spectrum
-//                                 to process;
+//                                 to process (the spectrum is skipped if spe is NULL);
 //
 // RETURN        ERROR_ID_FILE_NOT_FOUND  the input file can't be found;
 //               ERROR_ID_FILE_EMPTY      the file is empty;
@@ -828,8 +864,9 @@ RC MFC_ReadRecordStd(ENGINE_CONTEXT *pEngineContext,char *fileName,
    rc=ERROR_SetLast("ReadMFCRecordStd",ERROR_TYPE_WARNING,ERROR_ID_FILE_EMPTY,fileName);
   else
    {
-    for (i=0;i<n_wavel;i++)
-     spe[i]=(double)0.;
+    if (spe!=NULL)
+     for (i=0;i<n_wavel;i++)
+      spe[i]=(double)0.;
 
     if (fgets(line,MAX_STR_SHORT_LEN,fp) &&                                       // first line
         fgets(line,MAX_STR_SHORT_LEN,fp) && // (sscanf(line,"%d",&pixDeb)>=1) &&  // get the first pixel
@@ -838,7 +875,8 @@ RC MFC_ReadRecordStd(ENGINE_CONTEXT *pEngineContext,char *fileName,
      for (i=0;i<pixFin;i++)
       {
           fgets(line,MAX_STR_SHORT_LEN,fp);
-       sscanf(line,"%lf",&spe[i]);
+       if (spe!=NULL)
+        sscanf(line,"%lf",&spe[i]);
       }
 
 //    fgets(line,MAX_STR_SHORT_LEN,fp);
@@ -978,7 +1016,7 @@ RC MFC_ReadRecordStd(ENGINE_CONTEXT *pEngineContext,char *fileName,
 
     // Offset correction if any
 
-    if ((off!=NULL) && (pHeaderOff->noscans>0) && (THRD_browseType!=THREAD_BROWSE_MFC_OFFSET))
+    if ((spe!=NULL) && (off!=NULL) && (pHeaderOff->noscans>0) && (THRD_browseType!=THREAD_BROWSE_MFC_OFFSET))
      {
       for (i=0;i<n_wavel;i++)
        spe[i]-=(double)off[i]*pHeaderSpe->noscans/pHeaderOff->noscans;
@@ -986,7 +1024,7 @@ RC MFC_ReadRecordStd(ENGINE_CONTEXT *pEngineContext,char *fileName,
 
     // Dark current correction if any
 
-    if ((drk!=NULL) && (pHeaderDrk->int_time!=(float)0.) && (THRD_browseType!=THREAD_BROWSE_MFC_OFFSET) && (THRD_browseType!=THREAD_BROWSE_MFC_DARK))
+    if ((spe!=NULL) && (drk!=NULL) && (pHeaderDrk->int_time!=(float)0.) && (THRD_browseType!=THREAD_BROWSE_MFC_OFFSET) && (THRD_browseType!=THREAD_BROWSE_MFC_DARK))
      {
       for (i=0;i<n_wavel;i++)
        spe[i]-=(double)pHeaderSpe->noscans*drk[i]*pHeaderSpe->int_time/(pHeaderDrk->int_time*pHeaderDrk->noscans);
@@ -1005,13 +1043,13 @@ RC MFC_ReadRecordStd(ENGINE_CONTEXT *pEngineContext,char *fileName,
  }
 
 // -----------------------------------------------------------------------------
-// FUNCTION      ReliMFCStd
+// FUNCTION      MfcReliStd
 // -----------------------------------------------------------------------------
-// PURPOSE       MFC ASCII format read out
+// PURPOSE       MFC ASCII format read out (ReliMFCStd, ReliMFCStdHeader)
 //
 // INPUT         recordNo     index of record in file
 //               dateFlag     0 no date constraint; 1 a date selection is applied
-//               specFp       pointer to the spectra file
+//               headerOnly   1 to skip the read out of the spectrum
 //
 // OUTPUT        pEngineContext  : pointer to a structure whose some fields are filled
 //                            with data on the current spectrum
@@ -1021,7 +1059,7 @@ RC MFC_ReadRecordStd(ENGINE_CONTEXT *pEngineContext,char *fileName,
 //               ERROR_ID_FILE_RECORD    : the record doesn't satisfy user constraints
 //               ERROR_ID_NO             : otherwise.
 // -----------------------------------------------------------------------------
-RC ReliMFCStd(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp)
+static RC MfcReliStd(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,int headerOnly)
  {
   // Declarations
 
@@ -1055,7 +1093,7 @@ RC ReliMFCStd(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int local
    {
     // open the file
 
-    if (!(rc=MFC_ReadRecordStd(pEngineContext,fileName,&MFC_header,pBuffers->spectrum,&MFC_headerDrk,pBuffers->varPix,&MFC_headerOff,pBuffers->offset)))
+    if (!(rc=MFC_ReadRecordStd(pEngineContext,fileName,&MFC_header,(!headerOnly)?pBuffers->spectrum:NULL,&MFC_headerDrk,pBuffers->varPix,&MFC_headerOff,pBuffers->offset)))
      {
       pRecord->SkyObs   = 0;
       pRecord->rejected = 0;
@@ -1087,7 +1125,7 @@ RC ReliMFCStd(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int local
                               (pRecord->elevationViewAngle>pEngineContext->project.spectra.refAngle+pEngineContext->project.spectra.refTol))))            // reference spectra could be a not zenith sky spectrum
       // if (rc || (dateFlag && ((pRecord->localCalDay!=localDay) || (pRecord->elevationViewAngle<80.))) )                     // reference spectra are zenith only
        rc=ERROR_ID_FILE_RECORD;
-      else if (pEngineContext->project.instrumental.mfc.mfcRevert)
+      else if (!headerOnly && pEngineContext->project.instrumental.mfc.mfcRevert)
        VECTOR_Invert(pBuffers->spectrum,n_wavel);
      }
    }
@@ -1104,6 +1142,34 @@ RC ReliMFCStd(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int local
   return rc;
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION      ReliMFCStd
+// -----------------------------------------------------------------------------
+// PURPOSE       MFC ASCII format read out
+// -----------------------------------------------------------------------------
+
+RC ReliMFCStd(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp)
+ {
+  (void)specFp;                                                                 // each record is a file opened by MFC_ReadRecordStd
+
+  return MfcReliStd(pEngineContext,recordNo,dateFlag,localDay,0);
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      ReliMFCStdHeader
+// -----------------------------------------------------------------------------
+// PURPOSE       MFC ASCII format read out of the information on the record
+//               without the spectrum; same arguments and return codes as
+//               ReliMFCStd.
+// -----------------------------------------------------------------------------
+
+RC ReliMFCStdHeader(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp)
+ {
+  (void)specFp;                                                                 // each record is a file opened by MFC_ReadRecordStd
+
+  return MfcReliStd(pEngineContext,recordNo,dateFlag,localDay,1);
+ }
+
 // ===========================
 // MFC BIRA-IASB BINARY FORMAT
 // ===========================
@@ -1285,23 +1351,24 @@ RC MFCBIRA_Set(ENGINE_CONTEXT *pEngineContext,FILE *specFp)
  }
 
 // -----------------------------------------------------------------------------
-// FUNCTION MFCBIRA_Reli
+// FUNCTION MfcBiraReli
 // -----------------------------------------------------------------------------
 /*!
-   \fn      RC MFCBIRA_Reli(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp)
-   \details
+   \fn      RC MfcBiraReli(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp,int headerOnly)
+   \details Read a record in the MFC BIRA binary format (\ref MFCBIRA_Reli, \ref MFCBIRA_ReliHeader)
    \param   [in]  pEngineContext  pointer to the engine context; some fields are affected by this function.
    \param   [in]  recordNo        the index of the record to read
    \param   [in]  dateFlag        1 to search for a reference spectrum; 0 otherwise
    \param   [in]  localDay        if \a dateFlag is 1, the calendar day for the reference spectrum to search for
    \param   [in]  specFp          pointer to the spectra file to read
+   \param   [in]  headerOnly      1 to skip the read out of the spectrum
    \return  ERROR_ID_ALLOC if the allocation of the buffer for the spectrum failed \n
             ERROR_ID_FILE_RECORD if the record is the spectrum is not a spectrum to analyze (sky or dark spectrum)\n
             ERROR_ID_NO on success
 */
 // -----------------------------------------------------------------------------
 
-RC MFCBIRA_Reli(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp)
+static RC MfcBiraReli(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp,int headerOnly)
  {
   // Declarations
 
@@ -1322,9 +1389,11 @@ RC MFCBIRA_Reli(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int loc
   pBuffers=&pEngineContext->buffers;
   rc=ERROR_ID_NO;
 
+  spectrum=NULL;
+
   const int n_wavel = NDET[0];
 
-  if ((spectrum=MEMORY_AllocBuffer("MFCBIRA_Reli","spectrum",sizeof(float)*n_wavel,1,0,MEMORY_TYPE_FLOAT))==NULL)
+  if (!headerOnly && ((spectrum=MEMORY_AllocBuffer("MFCBIRA_Reli","spectrum",sizeof(float)*n_wavel,1,0,MEMORY_TYPE_FLOAT))==NULL))
    rc=ERROR_ID_ALLOC;
   else
    {
@@ -1332,7 +1401,8 @@ RC MFCBIRA_Reli(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int loc
 
     fseek(specFp,2L*sizeof(int)+(recordNo-1)*(sizeof(MFCBIRA_HEADER)+n_wavel*sizeof(float)),SEEK_SET);
     fread(&header,sizeof(MFCBIRA_HEADER),1,specFp);
-    fread(spectrum,sizeof(float),n_wavel,specFp);
+    if (spectrum!=NULL)
+     fread(spectrum,sizeof(float),n_wavel,specFp);
 
     // Retrieve the main information from the header
 
@@ -1406,20 +1476,21 @@ RC MFCBIRA_Reli(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int loc
     pRecord->localCalDay=ZEN_FNCaljda(&tmLocal);
     pRecord->localTimeDec=fmod(pRecord->TimeDec+24.+timeshift,(double)24.);
 
-    for (i=0;i<n_wavel;i++)
-     pBuffers->spectrum[i]=(double)spectrum[i];
+    if (spectrum!=NULL)
+     for (i=0;i<n_wavel;i++)
+      pBuffers->spectrum[i]=(double)spectrum[i];
 
     if ((header.measurementType!=PRJCT_INSTR_MAXDOAS_TYPE_DARK) && (header.measurementType!=PRJCT_INSTR_MAXDOAS_TYPE_OFFSET))
      {
       // Offset correction
 
-      if (pBuffers->offset!=NULL)
+      if ((spectrum!=NULL) && (pBuffers->offset!=NULL))
        for (i=0;i<n_wavel;i++)
         pBuffers->spectrum[i]-=pBuffers->offset[i]*header.scansNumber;          // offset is already divided by its number of scans
 
       // Dark current correction                                                // dark current is already divided by it integration time
 
-      if (pBuffers->varPix!=NULL)
+      if ((spectrum!=NULL) && (pBuffers->varPix!=NULL))
        for (i=0;i<n_wavel;i++)
         {
          pBuffers->spectrum[i]-=pBuffers->varPix[i]*header.scansNumber*header.exposureTime;
@@ -1454,6 +1525,35 @@ RC MFCBIRA_Reli(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int loc
   return rc;
  }
 
+// -----------------------------------------------------------------------------
+// FUNCTION MFCBIRA_Reli
+// -----------------------------------------------------------------------------
+/*!
+   \fn      RC MFCBIRA_Reli(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp)
+   \details Read a record (header and spectrum) in the MFC BIRA binary format
+*/
+// -----------------------------------------------------------------------------
+
+RC MFCBIRA_Reli(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp)
+ {
+  return MfcBiraReli(pEngineContext,recordNo,dateFlag,localDay,specFp,0);
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION MFCBIRA_ReliHeader
+// -----------------------------------------------------------------------------
+/*!
+   \fn      RC MFCBIRA_ReliHeader(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp)
+   \details Read the header of a record in the MFC BIRA binary format without
+            its spectrum; same arguments and return codes as \ref MFCBIRA_Reli
+*/
+// -----------------------------------------------------------------------------
+
+RC MFCBIRA_ReliHeader(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp)
+ {
+  return MfcBiraReli(pEngineContext,recordNo,dateFlag,localDay,specFp,1);
+ }
+
 // -----------------------------------------------------------------------------
 // FUNCTION      MFC_LoadAnalysis
 // -----------------------------------------------------------------------------
@@ -1577,7 +1677,7 @@ RC MFC_LoadAnalysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle)
      {
       KURUCZ_Init(0,0);
 
-      if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(NULL,0,saveFlag,0,responseHandle,0))!=ERROR_ID_NO))
+      if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(&ANALYSE_mainWorkspace,NULL,0,saveFlag,0,responseHandle,0))!=ERROR_ID_NO))
        goto EndMFC_LoadAnalysis;
      }
    }
@@ -79,9 +79,12 @@ INDEX MFC_SearchForCurrentFileIndex(ENGINE_CONTEXT *pEngineContext);
 int   MFC_AllocFiles(ENGINE_CONTEXT *pEngineContext);
 RC    SetMFC(ENGINE_CONTEXT *pEngineContext,FILE *specFp);
 RC    ReliMFC(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp,unsigned int mfcMask);
+RC    ReliMFCHeader(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp,unsigned int mfcMask);
 RC    ReliMFCStd(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp);
+RC    ReliMFCStdHeader(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp);
 RC    MFCBIRA_Set(ENGINE_CONTEXT *pEngineContext,FILE *specFp);
 RC    MFCBIRA_Reli(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp);
+RC    MFCBIRA_ReliHeader(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp);
 
 RC MFC_LoadAnalysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle);
 
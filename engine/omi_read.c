@@ -1468,7 +1468,7 @@ RC OMI_prepare_automatic_reference(ENGINE_CONTEXT *pEngineContext, void *respons
         // fit wavelength shift between calibrated solar irradiance
         // and automatic reference spectrum and apply this shift to
         // absorption crosssections
-        rc = ANALYSE_AlignReference(pEngineContext,2,responseHandle,i);
+        rc = ANALYSE_AlignReference(&ANALYSE_mainWorkspace,pEngineContext,2,responseHandle,i);
         if (rc) return rc;
       }
     }
@@ -531,7 +531,7 @@ namespace {
       // fit wavelength shift between calibrated solar irradiance
       // and automatic reference spectrum and apply this shift to
       // absorption crosssections
-      int rc = ANALYSE_AlignReference(pEngineContext,2,responseHandle,i);
+      int rc = ANALYSE_AlignReference(&ANALYSE_mainWorkspace,pEngineContext,2,responseHandle,i);
       if (rc) {
         throw std::runtime_error("Error aligning radiance reference with calibrated irradiance spectrum.");
       }
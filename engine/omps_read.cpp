@@ -6,11 +6,13 @@
 
 #include <cmath>
 #include <cstring>
+#include <algorithm>
 
 #include <H5Cpp.h>
 #include "boost/multi_array.hpp"
 
 #include "omps_read.h"
+#include "l1_preload.h"
 
 extern "C" {
 #include "dir_iter.h"
@@ -64,6 +66,8 @@ namespace {
   OMPSOrbit currentOrbit;
   OMPSGeo geoData;
 
+  bool preloadPending = false; // start the preload of the measurements (see L1_SetPreloadBudget) with the first record
+
   template<typename T>
   H5::DataType getDataType(void);
 
@@ -110,6 +114,38 @@ namespace {
     d.read(&buffer[0], outType, memspace, s);
   }
 
+  // read the radiances, wavelengths and radiance errors of the measurements first to
+  // first+count-1 (one hyperslab per dataset).  For each measurement, buffer holds the
+  // three arrays (nXTrack x nLambda) one after the other.
+  void readMeasurements(size_t first, size_t count, double *buffer) {
+    const char *dataSetNames[] = {"BinScheme1/ScienceData/Radiance",
+                                  "BinScheme1/CalibrationData/BandCenterWavelengths",
+                                  "BinScheme1/ScienceData/RadianceError"};
+    const size_t n = currentOrbit.nXTrack * currentOrbit.nLambda;
+
+    hsize_t offset[3] = {first, 0, 0};
+    hsize_t countSlab[3] = {count, currentOrbit.nXTrack, currentOrbit.nLambda};
+    hsize_t nPoints = count * n;
+
+    vector<double> data(nPoints);
+    DataSpace memspace(1, &nPoints);
+
+    try {
+      for (int k=0; k<3; ++k) {
+        DataSet d = currentOrbit.file.openDataSet(dataSetNames[k]);
+        DataSpace s = d.getSpace();
+        s.selectHyperslab(H5S_SELECT_SET, countSlab, offset);
+        d.read(data.data(), H5::PredType::NATIVE_DOUBLE, memspace, s);
+        d.close();
+
+        for (size_t i=0; i<count; ++i)
+          std::copy(data.begin() + i*n, data.begin() + (i+1)*n, buffer + (3*i+k)*n);
+      }
+    } catch (H5::Exception& e) {
+      throw std::runtime_error(e.getDetailMsg());
+    }
+  }
+
   struct Reference {
     vector<double> lambda;
     vector<double> radiance;
@@ -342,7 +378,9 @@ namespace {
 }
 
 RC OMPS_set(ENGINE_CONTEXT *pEngineContext) {
+  L1_PreloadStop(); // the loader thread reads the previous file
   currentOrbit.file = H5File(pEngineContext->fileInfo.fileName, H5F_ACC_RDONLY);
+  preloadPending = true;
 
   try {
     DataSet d = currentOrbit.file.openDataSet("BinScheme1/ScienceData/Radiance");
@@ -408,29 +446,47 @@ RC OMPS_read(ENGINE_CONTEXT *pEngineContext,int record) {
   count[1] = 1;
 
   try {
-    DataSet radiance = currentOrbit.file.openDataSet("BinScheme1/ScienceData/Radiance");
-    hsize_t dims[3];
-    DataSpace s = radiance.getSpace();
-    s.getSimpleExtentDims(dims, NULL); // dims[0] = nMeasurements, dims[1] = nXtrack, dims[2] = nLambda
-
-    // create DataSpace object for spectrum/lambda/... buffers: rank=1, length = nLambda
-    DataSpace memspace(1, &dims[2]);
-    count[2] = dims[2];
-    s.selectHyperslab(H5S_SELECT_SET, count, offset);
-    radiance.read(pEngineContext->buffers.spectrum, H5::PredType::NATIVE_DOUBLE, memspace, s);
-    radiance.close();
+    // the preload starts with the first record, once the orbits of the automatic
+    // reference have been read (the loader thread must be the only one to read HDF5 files)
+    if (preloadPending) {
+      preloadPending = false;
+      l1_preload_start(currentOrbit.nMeasurements, 3 * currentOrbit.nXTrack * currentOrbit.nLambda * sizeof(double),
+                       [](size_t first, size_t count, char *buffer) {
+                         readMeasurements(first, count, reinterpret_cast<double *>(buffer)); });
+    }
 
-    DataSet lambda = currentOrbit.file.openDataSet("BinScheme1/CalibrationData/BandCenterWavelengths");
-    s = lambda.getSpace();
-    s.selectHyperslab(H5S_SELECT_SET, count, offset);
-    lambda.read(pEngineContext->buffers.lambda, H5::PredType::NATIVE_DOUBLE, memspace, s);
-    lambda.close();
+    if (l1_preload_active()) {
+      const size_t n = currentOrbit.nXTrack * currentOrbit.nLambda;
+      const double *measurement = reinterpret_cast<const double *>(l1_preload_get(indexMeasurement)) + indexXTrack * currentOrbit.nLambda;
 
-    DataSet radianceError = currentOrbit.file.openDataSet("BinScheme1/ScienceData/RadianceError");
-    s = radianceError.getSpace();
-    s.selectHyperslab(H5S_SELECT_SET, count, offset);
-    radianceError.read(pEngineContext->buffers.sigmaSpec, H5::PredType::NATIVE_DOUBLE, memspace, s);
-    radianceError.close();
+      std::copy(measurement, measurement + currentOrbit.nLambda, pEngineContext->buffers.spectrum);
+      std::copy(measurement + n, measurement + n + currentOrbit.nLambda, pEngineContext->buffers.lambda);
+      std::copy(measurement + 2*n, measurement + 2*n + currentOrbit.nLambda, pEngineContext->buffers.sigmaSpec);
+    } else {
+      DataSet radiance = currentOrbit.file.openDataSet("BinScheme1/ScienceData/Radiance");
+      hsize_t dims[3];
+      DataSpace s = radiance.getSpace();
+      s.getSimpleExtentDims(dims, NULL); // dims[0] = nMeasurements, dims[1] = nXtrack, dims[2] = nLambda
+
+      // create DataSpace object for spectrum/lambda/... buffers: rank=1, length = nLambda
+      DataSpace memspace(1, &dims[2]);
+      count[2] = dims[2];
+      s.selectHyperslab(H5S_SELECT_SET, count, offset);
+      radiance.read(pEngineContext->buffers.spectrum, H5::PredType::NATIVE_DOUBLE, memspace, s);
+      radiance.close();
+
+      DataSet lambda = currentOrbit.file.openDataSet("BinScheme1/CalibrationData/BandCenterWavelengths");
+      s = lambda.getSpace();
+      s.selectHyperslab(H5S_SELECT_SET, count, offset);
+      lambda.read(pEngineContext->buffers.lambda, H5::PredType::NATIVE_DOUBLE, memspace, s);
+      lambda.close();
+
+      DataSet radianceError = currentOrbit.file.openDataSet("BinScheme1/ScienceData/RadianceError");
+      s = radianceError.getSpace();
+      s.selectHyperslab(H5S_SELECT_SET, count, offset);
+      radianceError.read(pEngineContext->buffers.sigmaSpec, H5::PredType::NATIVE_DOUBLE, memspace, s);
+      radianceError.close();
+    }
 
     auto extent = boost::extents[currentOrbit.nXTrack][currentOrbit.nLambda];
     array2d<double> irradiances(currentOrbit.irradiances.data(), extent);
@@ -534,7 +590,7 @@ RC OMPS_load_analysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle) {
     if (useKurucz || (THRD_id==THREAD_TYPE_KURUCZ)) {
       KURUCZ_Init(0, j);
 
-      if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(NULL,0,pEngineContext->project.spectra.displayDataFlag,0,responseHandle,j))!=ERROR_ID_NO))
+      if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(&ANALYSE_mainWorkspace,NULL,0,pEngineContext->project.spectra.displayDataFlag,0,responseHandle,j))!=ERROR_ID_NO))
         return rc;
     }
   }
@@ -547,7 +603,7 @@ RC OMPS_load_analysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle) {
       // fit wavelength shift between calibrated solar irradiance
       // and automatic reference spectrum and apply this shift to
       // absorption crosssections
-      rc = ANALYSE_AlignReference(pEngineContext,2,responseHandle,i);
+      rc = ANALYSE_AlignReference(&ANALYSE_mainWorkspace,pEngineContext,2,responseHandle,i);
     }
 
   }
@@ -556,6 +612,8 @@ RC OMPS_load_analysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle) {
 }
 
 void OMPS_ReleaseBuffers(void) {
+  L1_PreloadStop();
+  preloadPending = false;
   referenceFileNames.clear();
 }
 
@@ -3,6 +3,8 @@
 #include <map>
 #include <cassert>
 #include <sstream>
+#include <fstream>
+#include <cstring>
 #include <ctime>
 
 #include "netcdfwrapper.h"
@@ -720,6 +722,119 @@ RC netcdf_write_analysis_data(const bool selected_records[], int num_records, co
   return rc;
 }
 
+// Merge of the output files of the shards of one input file (doas_cl -shard).
+// Analysis variables have the n_alongtrack x n_crosstrack layout of the input
+// file in all shards, with fill values for the records of the other shards.
+// Shards are not allowed when only the successful records are saved (the
+// records of the output are not the ones of the input file, see
+// mediateRequestSetRecordRange).
+
+static void merge_check(int rc, const string& what) {
+  if (rc != NC_NOERR)
+    throw std::runtime_error("Cannot merge " + what + ": " + nc_strerror(rc));
+}
+
+static void merge_group(NetCDFGroup &target, const NetCDFGroup &shard) {
+  int nvars;
+  merge_check(nc_inq_varids(shard.groupID(), &nvars, NULL), "group " + shard.getName());
+  vector<int> varids(nvars);
+  merge_check(nc_inq_varids(shard.groupID(), &nvars, varids.data()), "group " + shard.getName());
+
+  for (int varid : varids) {
+    const string varname = shard.varName(varid);
+    const vector<int> dimids = shard.dimIDs(varid);
+
+    // only variables with one value per record are merged; others (calibration, ...) are the same in all shards
+    if (dimids.empty() || (shard.dimName(dimids[0]) != "n_alongtrack") || !target.hasVar(varname))
+      continue;
+
+    const int target_varid = target.varID(varname);
+    const vector<int> target_dimids = target.dimIDs(target_varid);
+
+    size_t num_values = 1;
+    for (size_t i=0; i<dimids.size(); ++i) {
+      if ((i >= target_dimids.size()) || (shard.dimLen(dimids[i]) != target.dimLen(target_dimids[i])))
+        throw std::runtime_error("Cannot merge variable '" + shard.getName() + "/" + varname + "': shards have different dimensions");
+      num_values *= shard.dimLen(dimids[i]);
+    }
+
+    nc_type xtype;
+    size_t type_size;
+    merge_check(nc_inq_vartype(shard.groupID(), varid, &xtype), varname);
+    merge_check(nc_inq_type(shard.groupID(), xtype, NULL, &type_size), varname);
+
+    vector<char> target_data(num_values * type_size), shard_data(num_values * type_size);
+    merge_check(nc_get_var(target.groupID(), target_varid, target_data.data()), varname);
+    merge_check(nc_get_var(shard.groupID(), varid, shard_data.data()), varname);
+
+    if (xtype == NC_STRING) {
+      const string fill = shard.getFillValue<string>(varid);
+      char **target_strings = reinterpret_cast<char **>(target_data.data());
+      char **shard_strings = reinterpret_cast<char **>(shard_data.data());
+
+      // exchange the pointers so that each string is released once below
+      for (size_t i=0; i<num_values; ++i)
+        if ((shard_strings[i] != NULL) && (fill != shard_strings[i]))
+          std::swap(target_strings[i], shard_strings[i]);
+
+      merge_check(nc_put_var_string(target.groupID(), target_varid, const_cast<const char **>(target_strings)), varname);
+      nc_free_string(num_values, target_strings);
+      nc_free_string(num_values, shard_strings);
+    } else {
+      vector<char> fill(type_size);
+      int no_fill;
+      merge_check(nc_inq_var_fill(shard.groupID(), varid, &no_fill, fill.data()), varname);
+
+      for (size_t i=0; i<num_values; ++i)
+        if (memcmp(&shard_data[i*type_size], fill.data(), type_size))
+          memcpy(&target_data[i*type_size], &shard_data[i*type_size], type_size);
+
+      merge_check(nc_put_var(target.groupID(), target_varid, target_data.data()), varname);
+    }
+  }
+
+  // subgroups (swath, analysis windows)
+
+  int ngroups;
+  merge_check(nc_inq_grps(shard.groupID(), &ngroups, NULL), "group " + shard.getName());
+  vector<int> groupids(ngroups);
+  merge_check(nc_inq_grps(shard.groupID(), &ngroups, groupids.data()), "group " + shard.getName());
+
+  for (int groupid : groupids) {
+    char groupname[NC_MAX_NAME+1];
+    merge_check(nc_inq_grpname(groupid, groupname), "group " + shard.getName());
+
+    if (target.groupID(groupname) >= 0) {
+      NetCDFGroup target_group = target.getGroup(groupname);
+      merge_group(target_group, NetCDFGroup(groupid, groupname));
+    }
+  }
+}
+
+RC netcdf_merge_files(const char *target_file, const char **shard_files, int num_shards) {
+  RC rc = ERROR_ID_NO;
+
+  try {
+    // the first shard is the starting point of the merged file
+    {
+      std::ifstream source(shard_files[0], std::ios::binary);
+      std::ofstream target(target_file, std::ios::binary | std::ios::trunc);
+      if (!source || !target || !(target << source.rdbuf()))
+        throw std::runtime_error(string("Cannot copy ") + shard_files[0] + " to " + target_file);
+    }
+
+    NetCDFFile target(target_file, NetCDFFile::Mode::append);
+    for (int i=1; i<num_shards; ++i) {
+      NetCDFFile shard(shard_files[i], NetCDFFile::Mode::read);
+      merge_group(target, shard);
+    }
+  } catch (std::runtime_error& e) {
+    rc = ERROR_SetLast(__func__, ERROR_TYPE_FATAL, ERROR_ID_NETCDF, e.what());
+  }
+
+  return rc;
+}
+
 RC netcdf_allow_file(const char *filename, const PRJCT_RESULTS *results) {
   int rc = ERROR_ID_NO;
   try {
@@ -15,6 +15,7 @@ extern "C" {
   RC netcdf_write_analysis_data(const bool selected_records[], int num_records, const OUTPUT_INFO *outputRecords);
 
   RC netcdf_allow_file(const char *filename, const PRJCT_RESULTS *results);
+  RC netcdf_merge_files(const char *target_file, const char **shard_files, int num_shards);
   RC netcdf_save_calib(double *lambda,double *reference,int indexFenoColumn,int n_wavel);
   RC netcdf_open_calib(const ENGINE_CONTEXT *pEngineContext, const char *filename,int col_dim,int spectral_dim);
   void netcdf_close_calib(void);
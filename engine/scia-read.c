@@ -1564,7 +1564,7 @@ RC SciaNewRef(ENGINE_CONTEXT *pEngineContext,void *responseHandle) {
 
         // align ref w.r.t irradiance reference:
         double sigma_shift, sigma_stretch, sigma_stretch2; // not used here...
-        rc = ANALYSE_fit_shift_stretch(1, 0, pTabFeno->SrefEtalon, ref->spectrum,
+        rc = ANALYSE_fit_shift_stretch(&ANALYSE_mainWorkspace,1, 0, pTabFeno->SrefEtalon, ref->spectrum,
                                        &ref->shift, &ref->stretch, &ref->stretch2, \
                                        &sigma_shift, &sigma_stretch, &sigma_stretch2);
       }
@@ -1716,7 +1716,7 @@ RC SCIA_LoadAnalysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle) {
      {
       KURUCZ_Init(0,0);
 
-      if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(NULL,0,saveFlag,0,responseHandle,0))!=ERROR_ID_NO))
+      if ((THRD_id!=THREAD_TYPE_KURUCZ) && ((rc=KURUCZ_Reference(&ANALYSE_mainWorkspace,NULL,0,saveFlag,0,responseHandle,0))!=ERROR_ID_NO))
        goto EndSCIA_LoadAnalysis;
      }
 
@@ -1736,7 +1736,7 @@ RC SCIA_LoadAnalysis(ENGINE_CONTEXT *pEngineContext,void *responseHandle) {
     // Automatic reference selection
 
     if ((THRD_id!=THREAD_TYPE_KURUCZ) && sciaLoadReferenceFlag && !(rc=SciaNewRef(pEngineContext,responseHandle)))
-      rc=ANALYSE_AlignReference(pEngineContext,2,responseHandle,0);
+      rc=ANALYSE_AlignReference(&ANALYSE_mainWorkspace,pEngineContext,2,responseHandle,0);
 
     if (!rc)
      sciaLoadReferenceFlag=0;
@@ -46,6 +46,7 @@ RC   ReliOceanOptics(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,in
 RC   ASCII_Set(ENGINE_CONTEXT *pEngineContext,FILE *specFp);
 RC   ASCII_QDOAS_Set(ENGINE_CONTEXT *pEngineContext,FILE *specFp);
 RC   ASCII_Read(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp);
+RC   ASCII_ReadHeader(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp);
 RC   ASCII_QDOAS_Read(ENGINE_CONTEXT *pEngineContext,int recordNo,int dateFlag,int localDay,FILE *specFp);
 void ASCII_Free(const char *functionStr);
 void ASCII_QDOAS_Reset(void);
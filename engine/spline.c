@@ -39,6 +39,8 @@
 //
 //  SPLINE_Deriv2  calculates the second derivatives needed for cubic spline interpolation
 //  SPLINE_Vector  function for linear and cubic interpolation;
+//  SPLINE_Weights weights of the cubic spline interpolation on the tabulated values;
+//  SPLINE_Deriv1Vector first derivative of the linear or cubic interpolant;
 //
 //  ----------------------------------------------------------------------------
 
@@ -189,6 +191,103 @@ unsigned log2_ceil (unsigned long x) {
   return (8*sizeof(x))-COUNT_LEADING_ZEROS(x-1);
 }
 
+/*! \brief binary search of the interval of xa containing x
+
+  \param[in] xa x values of the tabulated function, monotonously increasing
+
+  \param[in] na size of xa (expects na >=2)
+
+  \param[in] num_steps log2_ceil(na)
+
+  \param[in] x value such that xa[0] < x < xa[na-1]
+
+  \retval k such that xa[k] < x <= xa[k+1]
+*/
+static inline size_t spline_locate(const double *restrict xa,int na,unsigned num_steps,double x) {
+  // binary search for xlo such that *xlo < x <= xlo[1],
+  const double *xlo=xa;
+
+  // special case for the first step, in case na is not a power of 2:
+
+  // 1. find the largest power of 2 which is smaller than 'na'
+  size_t size = (1ul << (num_steps - 1) );
+
+  // 2. reduce the search to a search in a sequence of length 'size'
+  double start = xa[na - size];
+  if (start < x) // if mid < x, look in the sequence (start, start+size[
+    xlo += na-size;
+  // else: look in (xa, xa+size[
+
+  // 3. we now search in a sequence of 'size' elements, where 'size'
+  // is a power of 2.  'size' is halved in each iteration.
+  for (unsigned j=num_steps-1; j != 0; --j) {
+    size/=2;
+    double mid = xlo[size];
+    if (mid < x)
+      xlo += size;
+  }
+
+  return xlo-xa;
+}
+
+// number of abscissae located before being interpolated (see spline_locate_block)
+
+#define SPLINE_BLOCK 64
+
+/*! \brief intervals of xa containing a block of abscissae
+
+  Most callers interpolate on an increasing grid: the search then starts
+  from the interval of the previous abscissa, with a step that doubles
+  until the new abscissa is bracketed, followed by a binary search in the
+  last step (galloping search).  A block of n increasing abscissae costs
+  O(n log(na/n)) comparisons instead of O(n log(na)), and a single pass
+  over xa when both grids have a similar resolution.  Other abscissae use
+  spline_locate, so unsorted input is still supported.
+
+  \param[in] xb,nb block of abscissae
+
+  \param[in] k interval of the last abscissa of the previous block (0 for the first block)
+
+  \param[out] idx idx[i] such that xa[idx[i]] < xb[i] <= xa[idx[i]+1]; 0 or
+  na-2 for abscissae out of the tabulated range
+
+  \retval the interval of the last abscissa of the block
+*/
+static inline size_t spline_locate_block(const double *restrict xa,int na,unsigned num_steps,const double *restrict xb,int nb,size_t k,size_t *restrict idx) {
+  const size_t last=na-1;
+
+  for (int i=0; i<nb; ++i) {
+    const double x=xb[i];
+
+    if (x<=xa[0])
+      k=0;
+    else if (x>=xa[last])
+      k=last-1;
+    else if (xa[k]<x) {
+      size_t step=1,hi=k+1;
+      while ((hi<last) && (xa[hi]<x)) {
+        k=hi;
+        step*=2;
+        hi=(step<last-k)?k+step:last;
+      }
+      // xa[k] < x <= xa[hi]
+      while (hi-k>1) {
+        size_t mid=k+(hi-k)/2;
+        if (xa[mid]<x)
+          k=mid;
+        else
+          hi=mid;
+      }
+    }
+    else
+      k=spline_locate(xa,na,num_steps,x);
+
+    idx[i]=k;
+  }
+
+  return k;
+}
+
 /*! \brief linear or cubic spline interpolation
 
   \param[in] xa,ya x and y values of the tabulated function
@@ -205,6 +304,10 @@ unsigned log2_ceil (unsigned long x) {
   \param[in] type SPLINE_LINEAR or SPLINE_CUBIC
 
   \retval ERROR_ID_NO
+
+  The intervals of a block of abscissae are located first (spline_locate_block),
+  then the block is interpolated by a loop without branches that the compiler
+  can vectorize.
 */
 RC SPLINE_Vector(const double *restrict xa, const double *restrict ya, const double *restrict y2a,int na, const double *restrict xb, double *restrict yb,int nb,int type)
 {
@@ -216,55 +319,137 @@ RC SPLINE_Vector(const double *restrict xa, const double *restrict ya, const dou
   // of the next power of 2.
   const unsigned num_steps = log2_ceil(na);
 
-  // Browse new absissae
-  for (int i=0; i<nb; ++i) {
-    const double x=xb[i];
+  // new absissae out of boundaries get the first or last value
+  const double xmin=xa[0],xmax=xa[na-1];
+  const double ymin=ya[0],ymax=ya[na-1];
 
-    // new absissae is out of boundaries
-    if (x<=xa[0]) {
-      yb[i]=ya[0];
-      continue;
-    } else if (x>=xa[na-1]) {
-      yb[i]=ya[na-1];
-      continue;
+  size_t idx[SPLINE_BLOCK];
+  size_t k=0;
+
+  // Browse new absissae
+  for (int i0=0; i0<nb; i0+=SPLINE_BLOCK) {
+    const int n=min(SPLINE_BLOCK,nb-i0);
+    const double *restrict x=xb+i0;
+    double *restrict y=yb+i0;
+
+    k=spline_locate_block(xa,na,num_steps,x,n,k,idx);
+
+    if (type==SPLINE_CUBIC) {
+      for (int i=0; i<n; ++i) {
+        const size_t j=idx[i];
+        const double h=xa[j+1]-xa[j];
+        const double a=(xa[j+1]-x[i])/h;
+        const double b=1.-a;
+        const double v=a*ya[j]+b*ya[j+1]+((a*a*a-a)*y2a[j]+(b*b*b-b)*y2a[j+1])*(h*h)/6.;
+        y[i]=(x[i]<=xmin)?ymin:(x[i]>=xmax)?ymax:v;
+      }
+    } else { // assume type == SPLINE_LINEAR
+      for (int i=0; i<n; ++i) {
+        const size_t j=idx[i];
+        const double a=(xa[j+1]-x[i])/(xa[j+1]-xa[j]);
+        const double v=a*ya[j]+(1.-a)*ya[j+1];
+        y[i]=(x[i]<=xmin)?ymin:(x[i]>=xmax)?ymax:v;
+      }
     }
+  }
 
-    // binary search for xlo such that *xlo < x <= xlo[1],
-    const double *xlo=xa;
+  return ERROR_ID_NO;
+}
 
-    // special case for the first step, in case na is not a power of 2:
+/*! \brief first derivative of the linear or cubic spline interpolant
 
-    // 1. find the largest power of 2 which is smaller than 'na'
-    size_t size = (1ul << (num_steps - 1) );
+  Same arguments as SPLINE_Vector; dyb receives dy/dx at the points xb.  Outside
+  the tabulated range, SPLINE_Vector returns a constant, so the derivative is 0.
 
-    // 2. reduce the search to a search in a sequence of length 'size'
-    double start = xa[na - size];
-    if (start < x) // if mid < x, look in the sequence (start, start+size[
-      xlo += na-size;
-    // else: look in (xa, xa+size[
+  \retval ERROR_ID_NO
+*/
+RC SPLINE_Deriv1Vector(const double *restrict xa, const double *restrict ya, const double *restrict y2a,int na, const double *restrict xb, double *restrict dyb,int nb,int type)
+{
+  assert(na >= 2);
 
-    // 3. we now search in a sequence of 'size' elements, where 'size'
-    // is a power of 2.  'size' is halved in each iteration.
-    for (unsigned j=num_steps-1; j != 0; --j) {
-      size/=2;
-      double mid = xlo[size];
-      if (mid < x)
-        xlo += size;
+  const unsigned num_steps = log2_ceil(na);
+  const double xmin=xa[0],xmax=xa[na-1];
+
+  size_t idx[SPLINE_BLOCK];
+  size_t k=0;
+
+  for (int i0=0; i0<nb; i0+=SPLINE_BLOCK) {
+    const int n=min(SPLINE_BLOCK,nb-i0);
+    const double *restrict x=xb+i0;
+    double *restrict dy=dyb+i0;
+
+    k=spline_locate_block(xa,na,num_steps,x,n,k,idx);
+
+    for (int i=0; i<n; ++i) {
+      const size_t j=idx[i];
+      const double h=xa[j+1]-xa[j];
+      const double a=(xa[j+1]-x[i])/h;
+      const double b=1.-a;
+      double v=(ya[j+1]-ya[j])/h;
+      if (type==SPLINE_CUBIC)
+        v+=((1.-3.*a*a)*y2a[j]+(3.*b*b-1.)*y2a[j+1])*h/6.;
+      dy[i]=((x[i]<=xmin) || (x[i]>=xmax))?0.:v;
     }
+  }
+
+  return ERROR_ID_NO;
+}
+
+/*! \brief weights of the cubic spline interpolation
+
+  The value interpolated by SPLINE_Vector (SPLINE_CUBIC) at xb[i] is
+
+    wa[i]*ya[k]+wb[i]*ya[k+1]+w2a[i]*y2a[k]+w2b[i]*y2a[k+1]  with k=klo[i]
+
+  whatever the tabulated values ya and their second derivatives y2a.  The
+  interpolation is linear in (ya,y2a), so that these weights can be used to
+  build interpolation or convolution operators that are applied to several
+  functions tabulated on the same grid xa.
+
+  \param[in] xa x values of the tabulated function (monotonously increasing)
 
-    size_t k = xlo-xa;
-    double xhi=xlo[1];
-    double h=xhi-*xlo;
-    
-    // get ratios        
-    double a = (xhi-x)/h;
-    double b = 1.-a; // (x-(*xlo) )/h;
-      
-    // interpolation
-       
-    yb[i] = a*ya[k]+b*ya[k+1]; // assume type == SPLINE_LINEAR or SPLINE_CUBIC
-    if (type==SPLINE_CUBIC)
-      yb[i] += ((a*a*a-a)*y2a[k]+(b*b*b-b)*y2a[k+1])*(h*h)/6.;
+  \param[in] na size of xa (expects na >=2)
+
+  \param[in] xb,nb x values for which we want the weights
+
+  \param[out] klo interval of xa for each point of xb
+
+  \param[out] wa,wb,w2a,w2b weights of ya[klo],ya[klo+1],y2a[klo],y2a[klo+1]
+
+  \retval ERROR_ID_NO
+*/
+RC SPLINE_Weights(const double *restrict xa,int na,const double *restrict xb,int nb,int *restrict klo,
+                  double *restrict wa,double *restrict wb,double *restrict w2a,double *restrict w2b)
+{
+  assert(na >= 2);
+
+  const unsigned num_steps = log2_ceil(na);
+  const double xmin=xa[0],xmax=xa[na-1];
+
+  size_t idx[SPLINE_BLOCK];
+  size_t k=0;
+
+  for (int i0=0; i0<nb; i0+=SPLINE_BLOCK) {
+    const int n=min(SPLINE_BLOCK,nb-i0);
+
+    k=spline_locate_block(xa,na,num_steps,xb+i0,n,k,idx);
+
+    for (int i=0; i<n; ++i) {
+      const size_t j=idx[i];
+      const double x=xb[i0+i];
+      const double h=xa[j+1]-xa[j];
+      const double a=(xa[j+1]-x)/h;
+      const double b=1.-a;
+      const int inside=(x>xmin) && (x<xmax);
+
+      // out of the tabulated range, SPLINE_Vector returns the first or last value
+
+      klo[i0+i]=(int)j;
+      wa[i0+i]=(inside)?a:(x<=xmin)?1.:0.;
+      wb[i0+i]=(inside)?b:(x<=xmin)?0.:1.;
+      w2a[i0+i]=(inside)?(a*a*a-a)*(h*h)/6.:0.;
+      w2b[i0+i]=(inside)?(b*b*b-b)*(h*h)/6.:0.;
+    }
   }
 
   return ERROR_ID_NO;
@@ -16,6 +16,8 @@ extern "C" {
 
   RC SPLINE_Deriv2(const double *X, const double *Y, double *Y2,int n, const char *callingFunction);
   RC SPLINE_Vector(const double *xa, const double *ya, const double *y2a,int na, const double *xb,double *yb,int nb,int type);
+  RC SPLINE_Deriv1Vector(const double *xa, const double *ya, const double *y2a,int na, const double *xb,double *dyb,int nb,int type);
+  RC SPLINE_Weights(const double *xa,int na,const double *xb,int nb,int *klo,double *wa,double *wb,double *w2a,double *w2b);
 
 #if defined(_cplusplus) || defined(__cplusplus)
 }
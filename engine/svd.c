@@ -79,12 +79,6 @@
 
 #define SVD_MAX_ITERATIONS       30                                             // the maximum number of iterations
 
-// ================
-// STATIC VARIABLES
-// ================
-
-static double at, bt, ct, maxarg1, maxarg2;
-
 // -----------------------------------------------------------------------------
 // FUNCTION      SVD_Bksb
 // -----------------------------------------------------------------------------
@@ -218,6 +212,7 @@ RC SVD_Dcmp (struct svd *svd, int m, int n, double *SigmaSqr, double **covar) {
 
   int flag, i, its, j, jj, k, l, nm;
   double c, f, g, h, s, x, y, z, anorm, scale, *rv1, *wti;
+  double at, bt, ct, maxarg1, maxarg2;                                          // temporaries of PYTHAG and SMAX (not static : fits may run in parallel)
 
   // Debugging
 
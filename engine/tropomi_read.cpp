@@ -20,6 +20,7 @@
 #include <assert.h>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 
 #include "boost/multi_array.hpp"
 
@@ -28,6 +29,7 @@
 #include "netcdfwrapper.h"
 #include "dir_iter.h"
 #include "date_util.h"
+#include "l1_preload.h"
 
 extern "C" {
 #include "winthrd.h"
@@ -136,6 +138,20 @@ static time_t reference_time; // orbit start date
 static vector<int> delta_time; // number of milliseconds after reference_time
 static string current_filename="";
 
+// L1B radiance variables of the current file, looked up once in tropomi_set
+static NetCDFGroup obs_group; // OBSERVATIONS group
+static bool use_radiance_int16; // radiances stored as 16-bit integers with a scaling factor per spectrum
+static int radiance_varid, noise_varid, scaling_varid;
+static double fill_radiance; // fill value for radiances
+static double fill_noise; // fill value for radiance noise
+
+// radiances and noise of all ground pixels of the last scanline read
+static size_t cached_scanline = SIZE_MAX;
+static vector<double> scanline_data;
+
+// start the preload of the radiances (see L1_SetPreloadBudget) with the first record
+static bool preload_pending = false;
+
 
 static geodata read_geodata(const NetCDFGroup& geo_group, size_t n_scanline, size_t n_groundpixel) {
 
@@ -176,6 +192,7 @@ int tropomi_set(ENGINE_CONTEXT *pEngineContext) {
 
   int rc = 0;
   try {
+    L1_PreloadStop(); // the loader thread reads the previous file
     current_file = NetCDFFile(pEngineContext->fileInfo.fileName);
     current_filename=pEngineContext->fileInfo.fileName;
 
@@ -187,11 +204,11 @@ int tropomi_set(ENGINE_CONTEXT *pEngineContext) {
 
     reference_time = parse_utc_date(current_file.getAttText("time_reference"));
 
-    NetCDFGroup obsGroup = current_file.getGroup(current_band + "_RADIANCE/STANDARD_MODE/OBSERVATIONS");
+    obs_group = current_file.getGroup(current_band + "_RADIANCE/STANDARD_MODE/OBSERVATIONS");
 
-    size_scanline = obsGroup.dimLen("scanline");
-    size_spectral = obsGroup.dimLen("spectral_channel");
-    size_groundpixel = obsGroup.dimLen("ground_pixel");
+    size_scanline = obs_group.dimLen("scanline");
+    size_spectral = obs_group.dimLen("spectral_channel");
+    size_groundpixel = obs_group.dimLen("ground_pixel");
 
     pEngineContext->recordNumber = size_groundpixel * size_scanline;
     pEngineContext->n_alongtrack= size_scanline;
@@ -200,7 +217,23 @@ int tropomi_set(ENGINE_CONTEXT *pEngineContext) {
     size_t start[] = {0, 0};
     size_t count[] = {1, size_scanline};
     delta_time.resize(size_scanline);
-    obsGroup.getVar("delta_time", start, count, delta_time.data());
+    obs_group.getVar("delta_time", start, count, delta_time.data());
+
+    // radiance variables and their fill values, used for every record of the file
+    use_radiance_int16 = obs_group.hasVar("radiance_int16");
+    if (use_radiance_int16) {
+      assert(obs_group.hasVar("radiance_scaling"));
+      radiance_varid = obs_group.varID("radiance_int16");
+      scaling_varid = obs_group.varID("radiance_scaling");
+      fill_radiance = obs_group.getFillValue<double>(scaling_varid);
+    } else {
+      radiance_varid = obs_group.varID("radiance");
+      fill_radiance = obs_group.getFillValue<double>(radiance_varid);
+    }
+    noise_varid = obs_group.varID("radiance_noise");
+    fill_noise = obs_group.getFillValue<double>(noise_varid);
+    cached_scanline = SIZE_MAX;
+    preload_pending = true;
 
     NetCDFGroup instrGroup = current_file.getGroup(current_band + "_RADIANCE/STANDARD_MODE/INSTRUMENT");
     size_t start_wl[] = {0, 0, 0};
@@ -243,14 +276,64 @@ static void get_geodata(RECORD_INFO *pRecord, const geodata& geo, int record) {
   pRecord->satellite.altitude = geo.sat_alt[record-1];
 }
 
+// read the radiances and noise of all ground pixels of the scanlines first to
+// first+count-1 (one hyperslab per variable).  For each scanline, buffer holds
+// the radiances (ground pixels x spectral channels) followed by the noise.
+static void read_scanlines(size_t first, size_t count, double *buffer) {
+
+  // dimensions of radiance & error are
+  // ('time','scanline','ground_pixel','spectral_channel')
+  const size_t start[] = {0, first, 0, 0};
+  const size_t count_spectra[] = {1, count, size_groundpixel, size_spectral};
+  const size_t n = size_groundpixel * size_spectral;
+
+  vector<double> rad(count * n);
+  vector<double> rad_noise(count * n);
+
+  obs_group.getVar(noise_varid, start, count_spectra, rad_noise.data());
+
+  if (use_radiance_int16) {
+    vector<unsigned short> rad_int16(count * n);
+    vector<double> scale(count * size_groundpixel);
+
+    obs_group.getVar(radiance_varid, start, count_spectra, rad_int16.data());
+    obs_group.getVar(scaling_varid, start, count_spectra, scale.data()); // ('time','scanline','ground_pixel')
+
+    for (size_t i=0; i<count * n; ++i) {
+      rad[i] = (rad_int16[i] == 65535) ? fill_radiance : scale[i / size_spectral]*rad_int16[i];
+    }
+  } else {
+    obs_group.getVar(radiance_varid, start, count_spectra, rad.data());
+  }
+
+  for (size_t i=0; i<count; ++i) {
+    std::copy(rad.begin() + i*n, rad.begin() + (i+1)*n, buffer + 2*i*n);
+    std::copy(rad_noise.begin() + i*n, rad_noise.begin() + (i+1)*n, buffer + (2*i+1)*n);
+  }
+}
+
+// return the radiances and noise of a scanline (see read_scanlines), from the
+// preload buffer if any, otherwise from the last scanline read.
+static const double *read_scanline(size_t indexScanline) {
+
+  if (l1_preload_active())
+    return reinterpret_cast<const double *>(l1_preload_get(indexScanline));
+
+  if (indexScanline != cached_scanline) {
+    cached_scanline = SIZE_MAX; // the cache is valid only when all reads succeeded
+    scanline_data.resize(2 * size_groundpixel * size_spectral);
+    read_scanlines(indexScanline, 1, scanline_data.data());
+    cached_scanline = indexScanline;
+  }
+
+  return scanline_data.data();
+}
 
 int tropomi_read(ENGINE_CONTEXT *pEngineContext,int record) {
 
   assert(record > 0); // record is the requested record number, starting from 1
   int rc = 0;
 
-  NetCDFGroup obsGroup = current_file.getGroup(current_band + "_RADIANCE/STANDARD_MODE/OBSERVATIONS");
-
   const size_t indexScanline = (record - 1) / size_groundpixel;
   const size_t indexPixel = (record - 1) % size_groundpixel;
   size_t n_wavel = 0;
@@ -259,6 +342,15 @@ int tropomi_read(ENGINE_CONTEXT *pEngineContext,int record) {
     return ERROR_ID_FILE_RECORD;
   }
 
+  // the preload starts with the first record, so that the files of the automatic
+  // reference are read before (the loader thread must be the only one to read NetCDF files)
+  if (preload_pending) {
+    preload_pending = false;
+    l1_preload_start(size_scanline, 2 * size_groundpixel * size_spectral * sizeof(double),
+                     [](size_t first, size_t count, char *buffer) {
+                       read_scanlines(first, count, reinterpret_cast<double *>(buffer)); });
+  }
+
   if (THRD_id==THREAD_TYPE_ANALYSIS) {
     // in analysis mode, variables must have been initialized by tropomi_init()
     n_wavel = NDET[indexPixel];
@@ -275,54 +367,22 @@ int tropomi_read(ENGINE_CONTEXT *pEngineContext,int record) {
     n_wavel = size_spectral;
   }
 
-  // dimensions of radiance & error are
-  // ('time','scanline','ground_pixel','spectral_channel')
-  const size_t start[] = {0,indexScanline, indexPixel, 0};
-  const size_t start_scale[] = {0,indexScanline, indexPixel};
-
-  const size_t count[] = {1, 1, 1, size_spectral};
-  const size_t onecount[] = {1, 1, 1};
-
-
-  vector<unsigned short int> rad_int16(size_spectral);
-  vector<double> rad(size_spectral);
-  vector<double> scale(1);
-  vector<double> rad_noise(size_spectral);
-
   try {
-      double tempfill;
-      if(obsGroup.hasVar("radiance_int16")  ){
-          obsGroup.getVar("radiance_noise", start, count, rad_noise.data() );
-          assert(obsGroup.hasVar("radiance_scaling"));
-          obsGroup.getVar("radiance_int16", start, count, rad_int16.data() );
-          obsGroup.getVar("radiance_scaling",start_scale,onecount,scale.data() ) ;
-          const int fill_rad_int16 = obsGroup.getFillValue<int>("radiance_int16");
-          tempfill = obsGroup.getFillValue<double>("radiance_scaling");
-          for(int i = 0; i < size_spectral ;i++){
-              rad[i] = scale[0]*rad_int16[i];
-              if(rad_int16[i]==65535){
-                  rad[i]=tempfill;
-              }
-          }
-      }
-      else{
-          tempfill = obsGroup.getFillValue<double>("radiance");
-          obsGroup.getVar("radiance_noise", start, count, rad_noise.data() );
-          obsGroup.getVar("radiance", start, count, rad.data());
-      }
-      const double fill_rad=tempfill;
+    // radiances of the whole scanline are read with the first record of the scanline
+    const double *scanline = read_scanline(indexScanline);
 
-    const double fill_noise = obsGroup.getFillValue<double>("radiance_noise");
+    const double *rad = scanline + indexPixel*size_spectral;
+    const double *rad_noise = scanline + (size_groundpixel + indexPixel)*size_spectral;
     const vector<double>& lambda = nominal_wavelengths.at(indexPixel);
     // copy non-fill values to buffers:
     size_t j=0;
-    for (size_t i=0; i<rad.size() && j<n_wavel; ++i) {
+    for (size_t i=0; i<size_spectral && j<n_wavel; ++i) {
       double li = lambda[i];
       double ri = rad[i];
       double ni = rad_noise[i];
 
       pEngineContext->buffers.lambda[i]=li;
-      if (li != fill_nominal_wavelengths && ri != fill_rad && ni != fill_noise)
+      if (li != fill_nominal_wavelengths && ri != fill_radiance && ni != fill_noise)
        {
         pEngineContext->buffers.spectrum[i]=ri;
         pEngineContext->buffers.sigmaSpec[i]=ri/(std::pow(10.0, ni/10.0));
@@ -1023,7 +1083,7 @@ int tropomi_prepare_automatic_reference(ENGINE_CONTEXT *pEngineContext, void *re
   }
   for (size_t row = 0; row!= size_groundpixel; ++row) {
     if (!pEngineContext->project.instrumental.use_row[row]) continue;
-    int rc = ANALYSE_AlignReference(pEngineContext,2,responseHandle,row);
+    int rc = ANALYSE_AlignReference(&ANALYSE_mainWorkspace,pEngineContext,2,responseHandle,row);
     if (rc) return rc;
   }
 
@@ -1064,9 +1124,15 @@ int tropomi_get_orbit_date(int *orbit_year, int *orbit_month, int *orbit_day) {
 }
 
 void tropomi_cleanup(void) {
+  L1_PreloadStop();
   current_file.close();
   current_filename="";
 
+  obs_group = NetCDFGroup();
+  cached_scanline = SIZE_MAX;
+  scanline_data.clear();
+  preload_pending = false;
+
   current_geodata = geodata();
   current_band = "";
 
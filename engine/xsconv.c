@@ -54,6 +54,13 @@
 //
 //  XSCONV_TypeNone - apply no convolution, interpolation only;
 //  XSCONV_TypeGauss - gaussian convolution with variable half way up width;
+//  XSCONV_TypeGaussVector - gaussian convolution on a grid of wavelengths with a fwhm per pixel;
+//  XsconvSlitVector - calculate the slit function on a vector of distances;
+//  XsconvReserveSlitBuffers - allocate the buffers of the slit function of a row of the operator;
+//  XsconvBuildOperator - build the operator of the standard convolution for a slit function and wavelength grids;
+//  XsconvApplyOperator - convolve a high resolution vector with an operator;
+//  XSCONV_SelectCache - select the cache of convolution operators of the calling thread;
+//  XSCONV_ReleaseCache - release the operators of a cache;
 //  XSCONV_TypeStandard - standard convolution of cross section with a slit function;
 //  XSCONV_RealTimeXs - real time cross sections convolution;
 //
@@ -144,6 +151,7 @@
 #define NFWHM          18                 // number of pixels/FWHM
 
 double Voigtx(double x,double y);
+void   VoigtVector(const double *x,int n,double y,double *voigt);
 
 // Slit types
 
@@ -942,6 +950,95 @@ RC XSCONV_TypeNone(MATRIX_OBJECT *pXsnew,MATRIX_OBJECT *pXshr)
    return rc;
  }
 
+// -------------------------------------------------------------------------------------------
+// XSCONV_TypeGaussVector : Gaussian convolution on a grid of wavelengths with a fwhm per pixel
+// -------------------------------------------------------------------------------------------
+
+// Same as calling XSCONV_TypeGauss (SLIT_TYPE_GAUSS) for each pixel i=0..n-1
+// with lambdaj[i], dldj[i] and fwhm[i]; pixels with a zero fwhm are only
+// interpolated (SPLINE_Vector with the interpol type).
+//
+// The integration points of a pixel are generated by blocks, in the same way
+// as XSCONV_TypeGauss, and interpolated by a single call to SPLINE_Vector,
+// which walks the sorted source grid instead of searching it for each point.
+
+#define XSCONV_GAUSS_BLOCK 128
+
+RC XSCONV_TypeGaussVector(const double *lambda,const double *Spec,const double *SDeriv2,int ndet,
+                          const double *lambdaj,const double *dldj,const double *fwhm,double *SpecConv,int n,int interpol)
+ {
+  // Declarations
+
+  double x[XSCONV_GAUSS_BLOCK],y[XSCONV_GAUSS_BLOCK];
+  RC rc;
+
+  // Interpolation of all the pixels; the convolved ones are replaced below
+
+  rc=SPLINE_Vector(lambda,Spec,SDeriv2,ndet,lambdaj,SpecConv,n,interpol);
+
+  for (int i=0;(i<n) && !rc;i++)
+   if (fwhm[i]!=(double)0.)
+    {
+     const double fwhmi=fabs(fwhm[i]);
+     const double sigma2=fwhmi*0.5;                                             // use sigma2=fwhm/2 because in the S/W user manual sigma=fwhm
+     const double a=sigma2/sqrt(log(2.));
+     const double Lim=(double)2.*fwhmi;
+     const double ld_inc=((double)fwhmi/3.>dldj[i])?dldj[i]:(double)fwhmi/3.;
+     const double h=(double)ld_inc*0.5;
+     const double ia=(double)ld_inc/(a*sqrt(DOAS_PI));                          // see XSCONV_FctGauss
+     const double lambdaMax=lambdaj[i]+Lim;
+
+     double ldi=lambdaj[i]-Lim;
+     double oldF=(double)0.,SpecOld=(double)0.,crossFIntegral=(double)0.,FIntegral=(double)0.;
+     int first=1;
+
+     if (ld_inc<=(double)0.)
+      {
+       rc=ERROR_SetLast("XSCONV_FctGauss",ERROR_TYPE_FATAL,ERROR_ID_BAD_ARGUMENTS,"step<=0");
+       break;
+      }
+
+     do
+      {
+       int m=0;
+
+       if (first)
+        x[m++]=ldi;
+       while ((m<XSCONV_GAUSS_BLOCK) && (ldi<=lambdaMax))
+        {
+         ldi += (double) ld_inc;
+         x[m++]=ldi;
+        }
+
+       SPLINE_Vector(lambda,Spec,SDeriv2,ndet,x,y,m,SPLINE_CUBIC);
+
+       for (int k=0;k<m;k++)
+        {
+         const double dld=-(x[k]-lambdaj[i]);
+         const double newF=ia*exp(-(dld*dld)/(a*a));
+
+         if (!first || k)
+          {
+           crossFIntegral += (SpecOld*oldF+y[k]*newF)*h;
+           FIntegral      += (oldF+newF)*h;
+          }
+
+         oldF=newF;
+         SpecOld=y[k];
+        }
+
+       first=0;
+      }
+     while (ldi<=lambdaMax);
+
+     SpecConv[i]=(FIntegral!=(double)0.)?(double)crossFIntegral/FIntegral:(double)1.;
+    }
+
+  // Return
+
+  return rc;
+ }
+
 RC XSCONV_TypeStandardFFT(FFT *pFFT,int fwhmType,double slitParam,double slitParam2,double *lambda, double *target,int size)
  {
   // Declarations
@@ -1067,71 +1164,442 @@ RC GetNewF(double *pNewF,
   return rc;
  }
 
-// --------------------------------------------------------------------------------
-// XSCONV_TypeStandard : Standard convolution of cross section with a slit function
-// --------------------------------------------------------------------------------
-
+// -----------------------------------------------------------------------------
+// FUNCTION      XsconvSlitVector
+// -----------------------------------------------------------------------------
+// PURPOSE       calculate the slit function on a vector of distances (same as
+//               GetNewF for each element)
 //
-// RC XSCONV_TypeStandard(XS *pXsnew,XS *pXshr,XS *pSlit,XS *pI,double *Ic,
-//                        int slitType,double slitWidth,double slitParam)
+// INPUT         slitType            : the type of line shape;
+//               slitLambda,slitVector,slitDeriv2,slitNDET : the pre-calculated
+//                                     slit function (SLIT_TYPE_FILE);
+//               dist                : the distances to the central wavelength;
+//               n                   : the number of distances;
+//               slitParam,slitParam2,slitParam3 : the slit function parameters;
 //
-// with :
+// OUTPUT        newF                : the slit function calculated on dist
 //
-//  - pXsnew->lambda : final wavelength scale (input);
-//  - pXsnew->vector : pXshr->vector after convolution (output);
-//  - indexLambdaMin,indexLambdaMax : the calibration range to calculate
+// RETURN        ERROR_ID_DIVISION_BY_0 if the Voigt function can't be normalized;
+//               ERROR_ID_ALLOC on allocation error;
+//               the return code of the apodisation functions otherwise.
 //
-//  - pXshr : cross section high resolution (wavelength scale,slit vector and second derivatives);
+// REMARK        the constants of the line shape are calculated once for the
+//               vector.  Voigt and error functions are calculated by VoigtVector
+//               and ERF_GetVector (see their accuracy); the other line shapes use
+//               the formulas of GetNewF in loops without branches.
+// -----------------------------------------------------------------------------
+
+static RC XsconvSlitVector(int slitType,const double *slitLambda,const double *slitVector,const double *slitDeriv2,int slitNDET,
+                           const double *dist,int n,double slitParam,double slitParam2,double slitParam3,double *newF)
+ {
+  // Declarations
+
+  double sigma2,a,aLeft,aRight,a2,norm1,delta,powSigma2,*work;
+  INDEX i;
+  RC rc;
+
+  // Initializations
+
+  sigma2=(double)slitParam*0.5;                                                 // use sigma2=fwhm/2 because in the S/W user manual sigma=fwhm
+  a=((slitType!=SLIT_TYPE_SUPERGAUSS) || (fabs(slitParam2)<EPSILON))?sigma2/sqrt(log(2.)):sigma2/pow(log(2.),(double)1./slitParam2);
+  delta=(double)slitParam2*0.5;
+  work=NULL;
+
+  rc=ERROR_ID_NO;
+
+  if (slitType==SLIT_TYPE_INVPOLY)
+   {
+    powSigma2=pow(sigma2,slitParam2);
+
+    for (i=0;i<n;i++)
+     newF[i]=(double)powSigma2/(pow(dist[i],slitParam2)+powSigma2);
+   }
+  else if ((slitType==SLIT_TYPE_ERF) && (slitParam2!=(double)0.))
+   {
+    if ((work=MEMORY_AllocScratchDVector(__func__,"work",0,4*n-1))==NULL)
+     rc=ERROR_ID_ALLOC;
+    else
+     {
+      for (i=0;i<n;i++)
+       {
+        work[i]=(dist[i]+delta)/a;
+        work[n+i]=(dist[i]-delta)/a;
+       }
+
+      ERF_GetVector(work,work+2*n,2*n);
+
+      for (i=0;i<n;i++)
+       newF[i]=(double)(work[2*n+i]-work[3*n+i])/(4.*delta);
+     }
+   }
+  else if ((slitType==SLIT_TYPE_AGAUSS) || (slitType==SLIT_TYPE_SUPERGAUSS))
+   {
+    // for super gaussian, asymmetry factor is the third one
+
+    aLeft=(slitType==SLIT_TYPE_AGAUSS)?(double)a*(1.-slitParam2):(double)a*(1.-slitParam3);
+    aRight=(slitType==SLIT_TYPE_AGAUSS)?(double)a*(1.+slitParam2):(double)a*(1.+slitParam3);
+
+    if (slitType==SLIT_TYPE_AGAUSS)
+     for (i=0;i<n;i++)
+      {
+       a2=(dist[i]<(double)0.)?aLeft:aRight;
+       newF[i]=(double)exp(-(dist[i]*dist[i])/(a2*a2));
+      }
+    else
+     for (i=0;i<n;i++)
+      {
+       a2=(dist[i]<(double)0.)?aLeft:aRight;
+       newF[i]=(double)exp(-pow(fabs(dist[i]/a2),slitParam2));
+      }
+   }
+  else if (slitType==SLIT_TYPE_VOIGT)
+   {
+    norm1=(double)Voigtx((double)0.,slitParam2);
+
+    if (norm1==(double)0.)
+     rc=ERROR_SetLast("XsconvSlitVector",ERROR_TYPE_WARNING,ERROR_ID_DIVISION_BY_0,"calculation of the voigt function");
+    else if ((work=MEMORY_AllocScratchDVector(__func__,"work",0,n-1))==NULL)
+     rc=ERROR_ID_ALLOC;
+    else
+     {
+      for (i=0,norm1=(double)1./norm1;i<n;i++)
+       work[i]=dist[i]/a;
+
+      VoigtVector(work,n,slitParam2,newF);
+
+      for (i=0;i<n;i++)
+       newF[i]*=norm1;
+     }
+   }
+  else if (slitType==SLIT_TYPE_FILE)
+   SPLINE_Vector(slitLambda,slitVector,slitDeriv2,slitNDET,dist,newF,n,SPLINE_CUBIC);
+  else if (slitType==SLIT_TYPE_APOD)
+   for (i=0;(i<n) && !rc;i++)
+    rc=XsconvFctApod(&newF[i],slitParam,slitParam2,0.01,dist[i]);
+  else if (slitType==SLIT_TYPE_APODNBS)
+   for (i=0;(i<n) && !rc;i++)
+    rc=XsconvFctApodNBS(&newF[i],slitParam,slitParam2,0.01,dist[i]);
+  else // if (slitType==SLIT_TYPE_GAUSS)
+   for (i=0;i<n;i++)
+    newF[i]=(double)exp(-4.*log(2.)*(dist[i]*dist[i])/(slitParam*slitParam));
+
+  if (work!=NULL)
+   MEMORY_ReleaseScratchDVector(__func__,"work",work,0);
+
+  return rc;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      XsconvReserveSlitBuffers
+// -----------------------------------------------------------------------------
+// PURPOSE       make sure that the buffers used to calculate the slit function
+//               on a row of the convolution operator have at least n elements
+// -----------------------------------------------------------------------------
+
+static RC XsconvReserveSlitBuffers(double **pSlitDist,double **pSlitF,int *pSize,int n)
+ {
+  if (n<=*pSize)
+   return ERROR_ID_NO;
+
+  if (*pSlitDist!=NULL) MEMORY_ReleaseDVector(__func__,"slitDist",*pSlitDist,0);
+  if (*pSlitF!=NULL) MEMORY_ReleaseDVector(__func__,"slitF",*pSlitF,0);
+
+  *pSlitDist=*pSlitF=NULL;
+  *pSize=0;
+
+  if (((*pSlitDist=(double *)MEMORY_AllocDVector(__func__,"slitDist",0,n-1))==NULL) ||
+      ((*pSlitF=(double *)MEMORY_AllocDVector(__func__,"slitF",0,n-1))==NULL))
+   return ERROR_ID_ALLOC;
+
+  *pSize=n;
+
+  return ERROR_ID_NO;
+ }
+
+// ======================
+// CONVOLUTION OPERATORS
+// ======================
+
+#define XSCONV_CACHE_SIZE 8                                                     // maximum number of operators kept in a cache
+
+// Convolution operator : for each pixel of the final grid, the convolved cross section is
 //
-//  - pSlit : if wveDptFlag=1 : wavelength dependent slit function parameters (wavelength scale, slit vector and second derivatives);
-//  - slitParam : if wveDptFlag=0 : slit function parameters (constants)
+//   (sum(weights[m]*xshr[rowMin+m])+sum(weights[rowSize+m]*xshrDeriv2[rowMin+m]))/rowIntegral
 //
-//  - pI,Ic : these extra parameters are mainly used when I0 correction is applied in order to speed up total convolution
-//            work because integrals of I and I0 can be computed simultaneously;
+// with m from 0 to rowSize-1.  The weights of the second derivatives are only present when
+// the high resolution cross section is interpolated on the grid of the slit function.
+// The operator only depends on the grids and on the slit function, so that it is built
+// once and applied to all the cross sections convolved with the same slit function.
+
+struct _xsconvOperator
+ {
+  // grids and slit function the operator has been built for
+
+  int            slitType,wveDptFlag;
+  double         slitParam[NSFP];                                               // slit function parameters on input (see XsconvSlitParamKey)
+  MATRIX_OBJECT  slitMatrix[NSFP];                                              // copy of the slit function matrices if any
+  int            slitMatrixFlag;
+  double        *xshrLambda;                                                    // copy of the high resolution grid
+  int            xshrNDET;
+  double        *xsnewLambda;                                                   // copy of the final grid from indexMin to indexMax-1
+  INDEX          indexMin,indexMax;
+
+  // rows of the operator (indexed by xsnewIndex-indexMin)
+
+  int           *rowMin;                                                        // first pixel of the band in the high resolution grid
+  int           *rowSize;                                                       // number of pixels in the band
+  int           *rowDeriv2;                                                     // 1 if the weights of the second derivatives follow the ones of the cross section
+  int           *rowOffset;                                                     // offset of the weights in the pool
+  double        *rowIntegral;                                                   // integral of the slit function
+  double        *rowSlitParam;                                                  // slit function parameters after the pixel has been processed (wavelength dependent slit functions)
+  double        *pool;                                                          // weights of all rows
+  int            poolSize,poolUsed;
+ };
+
+static THREAD_LOCAL XSCONV_CACHE *xsconvCache=NULL;                             // cache of operators selected by the current thread
+
+// -----------------------------------------------------------------------------
+// FUNCTION      XsconvReleaseOperator
+// -----------------------------------------------------------------------------
+// PURPOSE       release the buffers allocated for a convolution operator
+// -----------------------------------------------------------------------------
+
+static void XsconvReleaseOperator(XSCONV_OPERATOR *pOperator)
+ {
+  INDEX i;
+
+  for (i=0;i<NSFP;i++)
+   MATRIX_Free(&pOperator->slitMatrix[i],__func__);
+
+  if (pOperator->xshrLambda!=NULL)
+   MEMORY_ReleaseDVector(__func__,"xshrLambda",pOperator->xshrLambda,0);
+  if (pOperator->xsnewLambda!=NULL)
+   MEMORY_ReleaseDVector(__func__,"xsnewLambda",pOperator->xsnewLambda,0);
+  if (pOperator->rowMin!=NULL)
+   MEMORY_ReleaseBuffer(__func__,"rowMin",pOperator->rowMin);
+  if (pOperator->rowSize!=NULL)
+   MEMORY_ReleaseBuffer(__func__,"rowSize",pOperator->rowSize);
+  if (pOperator->rowDeriv2!=NULL)
+   MEMORY_ReleaseBuffer(__func__,"rowDeriv2",pOperator->rowDeriv2);
+  if (pOperator->rowOffset!=NULL)
+   MEMORY_ReleaseBuffer(__func__,"rowOffset",pOperator->rowOffset);
+  if (pOperator->rowIntegral!=NULL)
+   MEMORY_ReleaseDVector(__func__,"rowIntegral",pOperator->rowIntegral,0);
+  if (pOperator->rowSlitParam!=NULL)
+   MEMORY_ReleaseDVector(__func__,"rowSlitParam",pOperator->rowSlitParam,0);
+  if (pOperator->pool!=NULL)
+   MEMORY_ReleaseDVector(__func__,"pool",pOperator->pool,0);
+
+  memset(pOperator,0,sizeof(XSCONV_OPERATOR));
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      XsconvReservePool
+// -----------------------------------------------------------------------------
+// PURPOSE       make room for n more weights in the pool of an operator
 //
-//    if I0 correction is applied, Ic is the I convoluted vector;
-//    if no I0 correction is applied, Ic is set to NULL but pI is set to pXshr in order to avoid extra tests in loops;
+// RETURN        ERROR_ID_ALLOC if the allocation of the pool failed
+// -----------------------------------------------------------------------------
+
+static RC XsconvReservePool(XSCONV_OPERATOR *pOperator,int n)
+ {
+  double *pool;
+  int poolSize;
+
+  if (pOperator->poolUsed+n<=pOperator->poolSize)
+   return ERROR_ID_NO;
+
+  poolSize=max(2*pOperator->poolSize,pOperator->poolUsed+n);
+
+  if ((pool=(double *)MEMORY_AllocDVector(__func__,"pool",0,poolSize-1))==NULL)
+   return ERROR_ID_ALLOC;
+
+  if (pOperator->pool!=NULL)
+   {
+    memcpy(pool,pOperator->pool,sizeof(double)*pOperator->poolUsed);
+    MEMORY_ReleaseDVector(__func__,"pool",pOperator->pool,0);
+   }
+
+  pOperator->pool=pool;
+  pOperator->poolSize=poolSize;
+
+  return ERROR_ID_NO;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      XsconvSameMatrix
+// -----------------------------------------------------------------------------
+// PURPOSE       compare the content of two matrices
 //
-//    the computed integral is then the same as pXshr's one and is not used;
+// RETURN        1 if both matrices have the same dimensions and values
+// -----------------------------------------------------------------------------
+
+static int XsconvSameMatrix(const MATRIX_OBJECT *pMatrix1,const MATRIX_OBJECT *pMatrix2)
+ {
+  INDEX indexC;
+
+  if ((pMatrix1->nl!=pMatrix2->nl) || (pMatrix1->nc!=pMatrix2->nc) || (pMatrix1->basel!=pMatrix2->basel) || (pMatrix1->basec!=pMatrix2->basec))
+   return 0;
+
+  if ((pMatrix1->nl==0) || (pMatrix1->nc==0) || (pMatrix1->matrix==NULL) || (pMatrix2->matrix==NULL))
+   return (pMatrix1->matrix==NULL) && (pMatrix2->matrix==NULL);
+
+  for (indexC=pMatrix1->basec;indexC<pMatrix1->basec+pMatrix1->nc;indexC++)
+   if (memcmp(pMatrix1->matrix[indexC]+pMatrix1->basel,pMatrix2->matrix[indexC]+pMatrix2->basel,sizeof(double)*pMatrix1->nl) ||
+      ((indexC>pMatrix1->basec) && ((pMatrix1->deriv2==NULL)!=(pMatrix2->deriv2==NULL))) ||
+      ((indexC>pMatrix1->basec) && (pMatrix1->deriv2!=NULL) &&
+        memcmp(pMatrix1->deriv2[indexC]+pMatrix1->basel,pMatrix2->deriv2[indexC]+pMatrix2->basel,sizeof(double)*pMatrix1->nl)))
+
+    return 0;
+
+  return 1;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      XsconvSlitParamKey
+// -----------------------------------------------------------------------------
+// PURPOSE       slit function parameters an operator depends on
 //
-//  - slitType : type of slit function;
+// OUTPUT        key : slitParam, with 0 for the parameters that are calculated
+//                     from the wavelength dependent slit function for each pixel
+//                     (XSCONV_TypeStandard overwrites them)
+// -----------------------------------------------------------------------------
+
+static void XsconvSlitParamKey(int slitType,const MATRIX_OBJECT *slitMatrix,const double *slitParam,int wveDptFlag,double *key)
+ {
+  memcpy(key,slitParam,sizeof(double)*NSFP);
+
+  if (wveDptFlag)
+   {
+    key[2]=(double)0.;
+
+    if ((slitType!=SLIT_TYPE_FILE) && (slitMatrix!=NULL) && (slitMatrix[1].nl>0))
+     key[1]=(double)0.;
+    if ((slitType==SLIT_TYPE_FILE) || ((slitMatrix!=NULL) && (slitMatrix[0].nl>0)))
+     key[0]=(double)0.;
+   }
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      XsconvMatchOperator
+// -----------------------------------------------------------------------------
+// PURPOSE       check if an operator can be used for a convolution
 //
-// NB : pI->lambda==pXshr->lambda.
+// RETURN        1 if the operator has been built for the same slit function and
+//               the same high resolution grid, on a range of the final grid that
+//               includes the requested one with the same wavelengths
+// -----------------------------------------------------------------------------
+
+static int XsconvMatchOperator(const XSCONV_OPERATOR *pOperator,const double *xsnewLambda,INDEX indexMin,INDEX indexMax,
+                               const double *xshrLambda,int xshrNDET,int slitType,const MATRIX_OBJECT *slitMatrix,const double *slitParam,int wveDptFlag)
+ {
+  double key[NSFP];
+  INDEX i;
+
+  XsconvSlitParamKey(slitType,slitMatrix,slitParam,wveDptFlag,key);
+
+  if ((pOperator->rowMin==NULL) ||
+      (pOperator->slitType!=slitType) || (pOperator->wveDptFlag!=wveDptFlag) ||
+      (pOperator->slitMatrixFlag!=(slitMatrix!=NULL)) ||
+      (pOperator->xshrNDET!=xshrNDET) ||
+      (indexMin<pOperator->indexMin) || (indexMax>pOperator->indexMax) ||
+      memcmp(pOperator->slitParam,key,sizeof(double)*NSFP) ||
+      memcmp(pOperator->xsnewLambda+(indexMin-pOperator->indexMin),xsnewLambda+indexMin,sizeof(double)*(indexMax-indexMin)) ||
+      memcmp(pOperator->xshrLambda,xshrLambda,sizeof(double)*xshrNDET))
+
+   return 0;
+
+  if (slitMatrix!=NULL)
+   for (i=0;i<NSFP;i++)
+    if (!XsconvSameMatrix(&pOperator->slitMatrix[i],&slitMatrix[i]))
+     return 0;
+
+  return 1;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      XsconvBuildOperator
+// -----------------------------------------------------------------------------
+// PURPOSE       build the convolution operator of XSCONV_TypeStandard
 //
+// INPUT         xsnewLambda               : final wavelength grid;
+//               indexMin,indexMax         : the range of the final grid to calculate;
+//               xshrLambda,xshrNDET       : the high resolution wavelength grid;
+//               slitType,slitMatrix,
+//               slitParam,wveDptFlag      : the slit function (see XSCONV_TypeStandard)
+//
+// OUTPUT        pOperator                 : the operator
+//
+// RETURN        ERROR_ID_ALLOC if the allocation of a buffer failed;
+//               return code of the slit function calculation otherwise
+//
+// NB            the slit function is calculated at the same points and the
+//               integrals are calculated with the same trapezium formula as the
+//               original XSCONV_TypeStandard;  only the weights of the cross
+//               section values are accumulated instead of the integrals.
+// -----------------------------------------------------------------------------
 
-RC XSCONV_TypeStandard(MATRIX_OBJECT *pXsnew,INDEX indexLambdaMin,INDEX indexLambdaMax,const MATRIX_OBJECT *pXshr,
-                          const MATRIX_OBJECT *pI, double *Ic,int slitType,const MATRIX_OBJECT *slitMatrix, double *slitParam,int wveDptFlag)
+static RC XsconvBuildOperator(XSCONV_OPERATOR *pOperator,const double *xsnewLambda,INDEX indexMin,INDEX indexMax,
+                              const double *xshrLambda,int xshrNDET,int slitType,const MATRIX_OBJECT *slitMatrix,double *slitParam,int wveDptFlag)
  {
   // Declarations
+
   MATRIX_OBJECT slitTmp;
-  double *xsnewLambda,*xsnewVector,
-         *xshrLambda,*xshrVector,*xshrDeriv2,
-         *slitLambda[NSFP],*slitVector[NSFP],*slitDeriv2[NSFP],
-          slitWidth,dist,
-         *IVector,*IDeriv2,
-          crossFIntegral,IFIntegral,FIntegral,
-          oldF,newF,oldIF,newIF,stepF,h,fwhm,
-          slitCenter,
-          stepXshr,slitStretch1,slitStretch2,
-          lambdaMin,lambdaMax,oldXshr,newXshr;
-  INDEX   xshrPixMin,
-          xsnewIndex,indexOld,indexNew,
-          klo,khi,i;
-  int     xshrNDET,xsnewNDET,slitNDET[NSFP];
+  double *slitLambda[NSFP],*slitVector[NSFP],*slitDeriv2[NSFP],
+         *sampleLambda,*sampleWeight,*wa,*wb,*w2a,*w2b,*weights,
+         *slitDist,*slitF,                                                      // the distances and the slit function on the points of a row
+          slitWidth,dist,FIntegral,oldF,newF,stepF,h,fwhm,slitCenter,
+          stepXshr,slitStretch1,slitStretch2,lambdaMin,lambdaMax;
+  INDEX   xshrPixMin,xsnewIndex,indexOld,indexNew,klo,khi,i,row,indexPoint;
+  int    *sampleKlo,slitNDET[NSFP],nSamples,sampleSize,nRows,kmin,kmax,n,slitSize,nPoints;
   RC      rc;
 
+  // Initializations
+
   memset(&slitTmp,0,sizeof(MATRIX_OBJECT));
+  memset(pOperator,0,sizeof(XSCONV_OPERATOR));
+
+  sampleLambda=sampleWeight=wa=wb=w2a=w2b=NULL;
+  slitDist=slitF=NULL;
+  sampleKlo=NULL;
+  sampleSize=slitSize=0;
+
   fwhm=slitWidth=(double)0.;
+  nRows=indexMax-indexMin;
   rc=ERROR_ID_NO;
 
-  // Use substitution variables
+  // Key of the operator
 
-  xsnewLambda=pXsnew->matrix[0];
-  xsnewVector=pXsnew->matrix[1];
+  pOperator->slitType=slitType;
+  pOperator->wveDptFlag=wveDptFlag;
+  pOperator->slitMatrixFlag=(slitMatrix!=NULL);
+  pOperator->xshrNDET=xshrNDET;
+  pOperator->indexMin=indexMin;
+  pOperator->indexMax=indexMax;
 
-  xshrLambda=pXshr->matrix[0];
-  xshrVector=pXshr->matrix[1];
-  xshrDeriv2=pXshr->deriv2[1];
+  XsconvSlitParamKey(slitType,slitMatrix,slitParam,wveDptFlag,pOperator->slitParam);
+
+  if (slitMatrix!=NULL)
+   for (i=0;(i<NSFP) && !rc;i++)
+    if (slitMatrix[i].nl>0)
+     rc=MATRIX_Copy(&pOperator->slitMatrix[i],&slitMatrix[i],__func__);
+
+  if (rc ||
+     ((pOperator->xshrLambda=(double *)MEMORY_AllocDVector(__func__,"xshrLambda",0,xshrNDET-1))==NULL) ||
+     ((pOperator->xsnewLambda=(double *)MEMORY_AllocDVector(__func__,"xsnewLambda",0,nRows-1))==NULL) ||
+     ((pOperator->rowMin=(int *)MEMORY_AllocBuffer(__func__,"rowMin",nRows,sizeof(int),0,MEMORY_TYPE_INT))==NULL) ||
+     ((pOperator->rowSize=(int *)MEMORY_AllocBuffer(__func__,"rowSize",nRows,sizeof(int),0,MEMORY_TYPE_INT))==NULL) ||
+     ((pOperator->rowDeriv2=(int *)MEMORY_AllocBuffer(__func__,"rowDeriv2",nRows,sizeof(int),0,MEMORY_TYPE_INT))==NULL) ||
+     ((pOperator->rowOffset=(int *)MEMORY_AllocBuffer(__func__,"rowOffset",nRows,sizeof(int),0,MEMORY_TYPE_INT))==NULL) ||
+     ((pOperator->rowIntegral=(double *)MEMORY_AllocDVector(__func__,"rowIntegral",0,nRows-1))==NULL) ||
+     ((pOperator->rowSlitParam=(double *)MEMORY_AllocDVector(__func__,"rowSlitParam",0,nRows*NSFP-1))==NULL))
+   {
+    rc=(rc)?rc:ERROR_ID_ALLOC;
+    goto EndBuildOperator;
+   }
+
+  memcpy(pOperator->xshrLambda,xshrLambda,sizeof(double)*xshrNDET);
+  memcpy(pOperator->xsnewLambda,xsnewLambda+indexMin,sizeof(double)*nRows);
 
   memset(slitNDET,0,sizeof(int)*NSFP);
 
@@ -1142,26 +1610,26 @@ RC XSCONV_TypeStandard(MATRIX_OBJECT *pXsnew,INDEX indexLambdaMin,INDEX indexLam
 
   if (slitMatrix!=NULL)
    {
-       fwhm=(double)0.;    // will be calculated later
+    fwhm=(double)0.;    // will be calculated later
 
-       for (i=0;i<NSFP;i++)
-        {
-            if ((slitNDET[i]=slitMatrix[i].nl)>0)
-             {
-           slitLambda[i]=slitMatrix[i].matrix[0];
-           slitVector[i]=slitMatrix[i].matrix[1];
-           slitDeriv2[i]=slitMatrix[i].deriv2[1];
-          }
-         else
-          slitLambda[i]=slitVector[i]=slitDeriv2[i]=NULL;
-        }
+    for (i=0;i<NSFP;i++)
+     {
+      if ((slitNDET[i]=slitMatrix[i].nl)>0)
+       {
+        slitLambda[i]=slitMatrix[i].matrix[0];
+        slitVector[i]=slitMatrix[i].matrix[1];
+        slitDeriv2[i]=slitMatrix[i].deriv2[1];
+       }
+      else
+       slitLambda[i]=slitVector[i]=slitDeriv2[i]=NULL;
+     }
 
-       if ((slitType!=SLIT_TYPE_FILE) || (slitMatrix[0].nc==2))
-        {
+    if ((slitType!=SLIT_TYPE_FILE) || (slitMatrix[0].nc==2))
+     {
       if (wveDptFlag)
        {
         if ((rc=MATRIX_Allocate(&slitTmp,slitMatrix[0].nl,2,0,0,1,"XSCONV_TypeStandard"))!=0)
-         goto EndTypeStandard;
+         goto EndBuildOperator;
         else
          {
           slitLambda[0]=slitTmp.matrix[0];
@@ -1182,7 +1650,7 @@ RC XSCONV_TypeStandard(MATRIX_OBJECT *pXsnew,INDEX indexLambdaMin,INDEX indexLam
     // Multicolumns files
 
     else if ((rc=MATRIX_Allocate(&slitTmp,slitMatrix[0].nl-1,2,0,0,1,"XSCONV_TypeStandard"))!=0)
-     goto EndTypeStandard;
+     goto EndBuildOperator;
     else
      {
       slitLambda[0]=slitTmp.matrix[0];
@@ -1196,12 +1664,6 @@ RC XSCONV_TypeStandard(MATRIX_OBJECT *pXsnew,INDEX indexLambdaMin,INDEX indexLam
   else
    fwhm=(slitType!=SLIT_TYPE_ERF)?slitParam[0]:sqrt(slitParam[0]*slitParam[0]+slitParam[1]*slitParam[1]);
 
-  xsnewNDET=pXsnew->nl;
-  xshrNDET=pXshr->nl;
-
-  IVector=pI->matrix[1];
-  IDeriv2=pI->deriv2[1];
-
   // Initializations
 
   if (slitType==SLIT_TYPE_FILE)
@@ -1216,36 +1678,23 @@ RC XSCONV_TypeStandard(MATRIX_OBJECT *pXsnew,INDEX indexLambdaMin,INDEX indexLam
   else
    stepF=fwhm/(double)NFWHM;
 
-// Add an option later  if ((slitType==SLIT_TYPE_FILE) || (slitType==SLIT_TYPE_VOIGT) || (slitType==SLIT_TYPE_AGAUSS))
-// Add an option later   {
-// Add an option later    // Calculation of the center of the slit function
-// Add an option later
-// Add an option later    for (i=0,c=si=(double)0.;i<slitNDET;i++)
-// Add an option later     {
-// Add an option later      c+=(double)slitLambda[i]*slitVector[i];
-// Add an option later      si+=(double)slitVector[i];
-// Add an option later     }
-// Add an option later
-// Add an option later    slitCenter=(si>(double)EPSILON)?(double)c/si:(double)0.;
-// Add an option later   }
-// Add an option later  else
-   slitCenter=(double)0.;
+  slitCenter=(double)0.;
 
   // average wavelength step in Xshr:
   stepXshr = (xshrLambda[xshrNDET-1] - xshrLambda[0])/(xshrNDET-1);
 
   // Browse wavelengths in the final calibration vector
 
-  for (xsnewIndex=max(0,indexLambdaMin);(xsnewIndex<xsnewNDET) && (xsnewIndex<indexLambdaMax) && !rc;xsnewIndex++) {
+  for (xsnewIndex=indexMin;(xsnewIndex<indexMax) && !rc;xsnewIndex++) {
     double lambda=xsnewLambda[xsnewIndex];
     slitStretch1=slitStretch2=(double)1.;
+    row=xsnewIndex-indexMin;
 
     if ((slitType==SLIT_TYPE_FILE) && (slitMatrix[0].nc>2))
      {
       for (i=0;i<slitTmp.nl;i++)
        slitVector[0][i]=(double)VECTOR_Table2((double **)slitMatrix[0].matrix,slitMatrix[0].nl,slitMatrix[0].nc,slitMatrix[0].matrix[0][i+1],lambda);
 
-      // memcpy(slitLambda[0],(double *)slitMatrix[0].matrix[0]+1,sizeof(double)*(slitMatrix[0].nl-1));
       if (!(rc=SPLINE_Deriv2(slitLambda[0],slitVector[0],slitDeriv2[0],slitNDET[0],"XSCONV_TypeStandard")))
        rc=XSCONV_GetFwhm(slitLambda[0],slitVector[0],slitDeriv2[0],slitNDET[0],SLIT_TYPE_FILE,&fwhm);
      }
@@ -1312,6 +1761,8 @@ RC XSCONV_TypeStandard(MATRIX_OBJECT *pXsnew,INDEX indexLambdaMin,INDEX indexLam
         SPLINE_Vector(slitLambda[0],slitVector[0],slitDeriv2[0],slitNDET[0],&lambda,&slitParam[0],1,SPLINE_CUBIC);
     }
 
+    memcpy(pOperator->rowSlitParam+row*NSFP,slitParam,sizeof(double)*NSFP);
+
     if (slitType!=SLIT_TYPE_FILE) {
       fwhm=(slitType!=SLIT_TYPE_ERF)?slitParam[0]:sqrt(slitParam[0]*slitParam[0]+slitParam[1]*slitParam[1]);
       stepF=fwhm/(double)NFWHM;            // number of points/FWHM
@@ -1336,91 +1787,138 @@ RC XSCONV_TypeStandard(MATRIX_OBJECT *pXsnew,INDEX indexLambdaMin,INDEX indexLam
     }
 
     xshrPixMin=(xshrLambda[klo]<lambdaMin)?khi:klo;
-    crossFIntegral=IFIntegral=FIntegral=(double)0.;
+    FIntegral=(double)0.;
+
+    pOperator->rowMin[row]=xshrPixMin;
+    pOperator->rowSize[row]=0;
+    pOperator->rowDeriv2[row]=0;
+    pOperator->rowOffset[row]=pOperator->poolUsed;
 
     if (xshrPixMin==xshrNDET-1)
-      newF=newXshr=(double)0.;
+      ;
 
     // Case 1 : the resolution of cross section is better than the resolution of slit function => slit function interpolation only
 
     else if (2*stepF-stepXshr>EPSILON)
      {
-      // set indexes to browse wavelengths in the grid of the high resolution cross section
+      // size of the band
 
-      indexOld=xshrPixMin;
-      indexNew=indexOld+1;
+      for (n=1;(xshrPixMin+n<xshrNDET) && (xshrLambda[xshrPixMin+n]<=lambdaMax);n++);
 
-      // distance to the central wavelength
+      if ((rc=XsconvReservePool(pOperator,n))!=ERROR_ID_NO)
+       break;
 
-      dist=(double)slitCenter-(xshrLambda[indexOld]-lambda); // !!! slit function is inversed for convolution
+      weights=pOperator->pool+pOperator->poolUsed-xshrPixMin;                   // weights[k] for the pixel k of the high resolution grid
 
-      rc=GetNewF(&newF,slitType,slitLambda[0],slitVector[0],slitDeriv2[0],slitNDET[0],
-                  dist,slitParam[0],slitParam[1],slitParam[2],xshrLambda[xshrPixMin+1]-xshrLambda[xshrPixMin]);
+      for (i=xshrPixMin;i<xshrPixMin+n;i++)
+       weights[i]=(double)0.;
+
+      // distances to the central wavelength and slit function on the points of the band
+
+      if ((rc=XsconvReserveSlitBuffers(&slitDist,&slitF,&slitSize,n))!=ERROR_ID_NO)
+       break;
+
+      for (i=0;i<n;i++)
+       slitDist[i]=(double)slitCenter-(xshrLambda[xshrPixMin+i]-lambda); // !!! slit function is inversed for convolution
+
+      if ((rc=XsconvSlitVector(slitType,slitLambda[0],slitVector[0],slitDeriv2[0],slitNDET[0],
+                               slitDist,n,slitParam[0],slitParam[1],slitParam[2],slitF))!=ERROR_ID_NO)
+       break;
 
       // browse the grid of the high resolution cross section
 
-      while ((indexNew<xshrNDET) && (xshrLambda[indexNew]<=lambdaMax) && !rc)
+      for (indexOld=xshrPixMin,indexNew=indexOld+1;indexNew<xshrPixMin+n;indexOld=indexNew++)
        {
-        oldF=newF;
-
-        dist=(double)slitCenter-(xshrLambda[indexNew]-lambda);
+        oldF=slitF[indexOld-xshrPixMin];
+        newF=slitF[indexNew-xshrPixMin];
 
         // Convolution
 
-        if (!(rc=GetNewF(&newF,slitType,slitLambda[0],slitVector[0],slitDeriv2[0],slitNDET[0],
-                          dist,slitParam[0],slitParam[1],slitParam[2],xshrLambda[indexNew]-xshrLambda[indexOld])))
-         {
-          h=(xshrLambda[indexNew]-xshrLambda[indexOld])*0.5;  // use trapezium formula for surface computation (B+b)*H/2
-          crossFIntegral+=(xshrVector[indexOld]*oldF+xshrVector[indexNew]*newF)*h;
-          IFIntegral+=(IVector[indexOld]*oldF+IVector[indexNew]*newF)*h;
-          FIntegral+=(oldF+newF)*h;
-         }
-
-        indexOld=indexNew++;
+        h=(xshrLambda[indexNew]-xshrLambda[indexOld])*0.5;  // use trapezium formula for surface computation (B+b)*H/2
+        weights[indexOld]+=oldF*h;
+        weights[indexNew]+=newF*h;
+        FIntegral+=(oldF+newF)*h;
        }
 
+      pOperator->rowSize[row]=n;
+      pOperator->poolUsed+=n;
      }
 
     // Case 2 : the resolution of slit function is better than the resolution of cross section => cross section interpolation
 
     else
      {
+      // number of points of the slit function
+
+      n=(slitType==SLIT_TYPE_FILE)?slitNDET[0]:(int)ceil(2.*slitWidth/stepF)+2;
+
+      if (n>sampleSize)
+       {
+        if (sampleLambda!=NULL) MEMORY_ReleaseDVector(__func__,"sampleLambda",sampleLambda,0);
+        if (sampleWeight!=NULL) MEMORY_ReleaseDVector(__func__,"sampleWeight",sampleWeight,0);
+        if (wa!=NULL) MEMORY_ReleaseDVector(__func__,"wa",wa,0);
+        if (wb!=NULL) MEMORY_ReleaseDVector(__func__,"wb",wb,0);
+        if (w2a!=NULL) MEMORY_ReleaseDVector(__func__,"w2a",w2a,0);
+        if (w2b!=NULL) MEMORY_ReleaseDVector(__func__,"w2b",w2b,0);
+        if (sampleKlo!=NULL) MEMORY_ReleaseBuffer(__func__,"sampleKlo",sampleKlo);
+
+        sampleLambda=sampleWeight=wa=wb=w2a=w2b=NULL;
+        sampleKlo=NULL;
+        sampleSize=0;
+
+        if (((sampleLambda=(double *)MEMORY_AllocDVector(__func__,"sampleLambda",0,n-1))==NULL) ||
+            ((sampleWeight=(double *)MEMORY_AllocDVector(__func__,"sampleWeight",0,n-1))==NULL) ||
+            ((wa=(double *)MEMORY_AllocDVector(__func__,"wa",0,n-1))==NULL) ||
+            ((wb=(double *)MEMORY_AllocDVector(__func__,"wb",0,n-1))==NULL) ||
+            ((w2a=(double *)MEMORY_AllocDVector(__func__,"w2a",0,n-1))==NULL) ||
+            ((w2b=(double *)MEMORY_AllocDVector(__func__,"w2b",0,n-1))==NULL) ||
+            ((sampleKlo=(int *)MEMORY_AllocBuffer(__func__,"sampleKlo",n,sizeof(int),0,MEMORY_TYPE_INT))==NULL) ||
+            (XsconvReserveSlitBuffers(&slitDist,&slitF,&slitSize,n)!=ERROR_ID_NO))
+         {
+          rc=ERROR_ID_ALLOC;
+          break;
+         }
+
+        sampleSize=n;
+       }
+
       // set indexes to browse wavelengths in the grid of the slit function if pre-calculated
 
       indexOld=0;
       indexNew=1;
-      rc=0;
+      nSamples=0;
+      indexPoint=nPoints=0;
 
       // Calculate first value for the slit function
 
       if (slitType==SLIT_TYPE_FILE)
-       {
-        dist=lambda-slitLambda[0][indexOld];           // !!! Hilke : - -> +
-        oldF=slitVector[0][indexOld];
-       }
+       dist=lambda-slitLambda[0][indexOld];           // !!! Hilke : - -> +
       else
        {
-        dist=lambda-slitWidth;
+        // the points of the slit function (same recurrence as in the loop below) and the slit function on these points
+
+        for (dist=lambda-slitWidth;(dist+stepF<=lambda+slitWidth) && (nPoints<sampleSize);nPoints++)
+         {
+          dist+=stepF;
+          slitDist[nPoints]=dist-lambda;
+         }
 
-        if ((rc=GetNewF(&oldF,slitType,slitLambda[0],slitVector[0],slitDeriv2[0],slitNDET[0],
-                        dist-lambda,slitParam[0],slitParam[1],slitParam[2],stepF))!=ERROR_ID_NO)
+        if ((rc=XsconvSlitVector(slitType,slitLambda[0],slitVector[0],slitDeriv2[0],slitNDET[0],
+                                 slitDist,nPoints,slitParam[0],slitParam[1],slitParam[2],slitF))!=ERROR_ID_NO)
 
-         goto EndTypeStandard;
-       }
+         break;
 
-      // Calculate first value for the high resolution cross section
+        dist=lambda-slitWidth;
+       }
 
-      oldF=oldIF=oldXshr=(double)0.;
+      // the first value of the slit function is not used in the integrals
 
-      if ((dist<xshrLambda[0]) || (dist>xshrLambda[xshrNDET-1]))
-       oldF=oldIF=oldXshr=(double)0.;
-      else if (!(rc=SPLINE_Vector(xshrLambda,xshrVector,xshrDeriv2,xshrNDET,&dist,&oldXshr,1,SPLINE_CUBIC)) && (Ic!=NULL))
-       rc=SPLINE_Vector(xshrLambda,IVector,IDeriv2,xshrNDET,&dist,&oldIF,1,SPLINE_CUBIC);
+      oldF=(double)0.;
 
       // browse the grid of the slit function
 
       while ((((slitType==SLIT_TYPE_FILE) && (indexNew<slitNDET[0])) ||
-              ((slitType!=SLIT_TYPE_FILE) && (dist+stepF<=lambda+slitWidth))) && !rc)
+              ((slitType!=SLIT_TYPE_FILE) && (indexPoint<nPoints))) && (nSamples<sampleSize) && !rc)
        {
         // the slit function is pre-calculated
 
@@ -1439,50 +1937,281 @@ RC XSCONV_TypeStandard(MATRIX_OBJECT *pXsnew,INDEX indexLambdaMin,INDEX indexLam
          {
           dist+=stepF;
           h=stepF*0.5;
+          newF=slitF[indexPoint++];
+         }
 
-          if ((rc=GetNewF(&newF,slitType,slitLambda[0],slitVector[0],slitDeriv2[0],slitNDET[0],
-                           dist-lambda,slitParam[0],slitParam[1],slitParam[2],stepF))!=ERROR_ID_NO)
+        // Convolution : the cross section is interpolated at dist (oldF is 0 if the previous point is out of the high resolution grid)
 
-           goto EndTypeStandard;
+        if ((dist>=xshrLambda[0]) && (dist<=xshrLambda[xshrNDET-1])) {
+          if (nSamples>0)
+            sampleWeight[nSamples-1]+=oldF*h;
 
-         }
+          sampleLambda[nSamples]=dist;
+          sampleWeight[nSamples++]=newF*h;
 
-        if ((dist>=xshrLambda[0]) && (dist<=xshrLambda[xshrNDET-1])) {
-          // interpolation of the high resolution cross section
+          FIntegral+=(oldF+newF)*h;
+        }
+        else
+         newF=(double)0.;
 
-          SPLINE_Vector(xshrLambda,xshrVector,xshrDeriv2,xshrNDET,&dist,&newXshr,1,SPLINE_CUBIC);
+        oldF=newF;
+       }
 
-          // Convolution
+      // Weights of the interpolation of the cross section
 
-          crossFIntegral+=(oldF*oldXshr+newF*newXshr)*h;
-          FIntegral+=(oldF+newF)*h;
+      if (!rc && (nSamples>0) &&
+          !(rc=SPLINE_Weights(xshrLambda,xshrNDET,sampleLambda,nSamples,sampleKlo,wa,wb,w2a,w2b)))
+       {
+        for (i=1,kmin=kmax=sampleKlo[0];i<nSamples;i++)
+         {
+          kmin=min(kmin,sampleKlo[i]);
+          kmax=max(kmax,sampleKlo[i]);
+         }
+
+        n=kmax-kmin+2;
+
+        if ((rc=XsconvReservePool(pOperator,2*n))!=ERROR_ID_NO)
+         break;
+
+        weights=pOperator->pool+pOperator->poolUsed-kmin;
 
-          // I0 correction
+        for (i=kmin;i<kmin+2*n;i++)
+         weights[i]=(double)0.;
 
-          if ((Ic!=NULL) && !(rc=SPLINE_Vector(xshrLambda,IVector,IDeriv2,xshrNDET,&dist,&newIF,1,SPLINE_CUBIC)))
-           {
-            IFIntegral+=(oldF*oldIF+newF*newIF)*h;
-            oldIF=newIF;
-           }
+        for (i=0;i<nSamples;i++)
+         {
+          weights[sampleKlo[i]]+=sampleWeight[i]*wa[i];
+          weights[sampleKlo[i]+1]+=sampleWeight[i]*wb[i];
+          weights[n+sampleKlo[i]]+=sampleWeight[i]*w2a[i];
+          weights[n+sampleKlo[i]+1]+=sampleWeight[i]*w2b[i];
          }
-        else
-         newF=newXshr=(double)0.;
 
-        oldXshr=newXshr;
-        oldF=newF;
+        pOperator->rowMin[row]=kmin;
+        pOperator->rowSize[row]=n;
+        pOperator->rowDeriv2[row]=1;
+        pOperator->poolUsed+=2*n;
        }
      }
 
-    xsnewVector[xsnewIndex]=(FIntegral!=(double)0.)?crossFIntegral/FIntegral:(double)0.;
-
-    if (Ic!=NULL)
-     Ic[xsnewIndex]=(FIntegral!=(double)0.)?IFIntegral/FIntegral:(double)0.;
+    pOperator->rowIntegral[row]=FIntegral;
    }
 
-  EndTypeStandard :
+  EndBuildOperator :
+
+  if (sampleLambda!=NULL) MEMORY_ReleaseDVector(__func__,"sampleLambda",sampleLambda,0);
+  if (sampleWeight!=NULL) MEMORY_ReleaseDVector(__func__,"sampleWeight",sampleWeight,0);
+  if (wa!=NULL) MEMORY_ReleaseDVector(__func__,"wa",wa,0);
+  if (wb!=NULL) MEMORY_ReleaseDVector(__func__,"wb",wb,0);
+  if (w2a!=NULL) MEMORY_ReleaseDVector(__func__,"w2a",w2a,0);
+  if (w2b!=NULL) MEMORY_ReleaseDVector(__func__,"w2b",w2b,0);
+  if (sampleKlo!=NULL) MEMORY_ReleaseBuffer(__func__,"sampleKlo",sampleKlo);
+  if (slitDist!=NULL) MEMORY_ReleaseDVector(__func__,"slitDist",slitDist,0);
+  if (slitF!=NULL) MEMORY_ReleaseDVector(__func__,"slitF",slitF,0);
 
   MATRIX_Free(&slitTmp,"XSCONV_TypeStandard");
 
+  if (rc)
+   XsconvReleaseOperator(pOperator);
+
+  // Return
+
+  return rc;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      XsconvApplyOperator
+// -----------------------------------------------------------------------------
+// PURPOSE       convolve a high resolution vector with an operator
+//
+// INPUT         pOperator          : the convolution operator;
+//               indexMin,indexMax  : the range of the final grid to calculate;
+//               vector,deriv2      : the high resolution vector and its second
+//                                    derivatives;
+//
+// OUTPUT        output             : the convolved vector (from indexMin to
+//                                    indexMax-1)
+// -----------------------------------------------------------------------------
+
+static void XsconvApplyOperator(const XSCONV_OPERATOR *pOperator,INDEX indexMin,INDEX indexMax,const double *vector,const double *deriv2,double *output)
+ {
+  const double *weights,*x,*x2;
+  double sum;
+  INDEX xsnewIndex,row,m;
+  int n;
+
+  for (xsnewIndex=indexMin;xsnewIndex<indexMax;xsnewIndex++)
+   {
+    row=xsnewIndex-pOperator->indexMin;
+    weights=pOperator->pool+pOperator->rowOffset[row];
+    n=pOperator->rowSize[row];
+    x=vector+pOperator->rowMin[row];
+
+    for (sum=(double)0.,m=0;m<n;m++)
+     sum+=weights[m]*x[m];
+
+    if (pOperator->rowDeriv2[row])
+     for (x2=deriv2+pOperator->rowMin[row],m=0;m<n;m++)
+      sum+=weights[n+m]*x2[m];
+
+    output[xsnewIndex]=(pOperator->rowIntegral[row]!=(double)0.)?sum/pOperator->rowIntegral[row]:(double)0.;
+   }
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      XSCONV_SelectCache
+// -----------------------------------------------------------------------------
+// PURPOSE       select the cache of convolution operators of the calling thread
+//
+// INPUT         pCache : the cache to use (NULL to disable the cache)
+//
+// RETURN        the cache previously selected, to restore after use
+//
+// NB            while a cache is selected, XSCONV_TypeStandard keeps the
+//               operators it builds and reuses them for the cross sections
+//               convolved with the same slit function on the same grids (for
+//               example, all the cross sections of a row of an imager).
+//               Without cache, the operator is released after each convolution.
+// -----------------------------------------------------------------------------
+
+XSCONV_CACHE *XSCONV_SelectCache(XSCONV_CACHE *pCache)
+ {
+  XSCONV_CACHE *pPrevious=xsconvCache;
+
+  xsconvCache=pCache;
+
+  return pPrevious;
+ }
+
+// -----------------------------------------------------------------------------
+// FUNCTION      XSCONV_ReleaseCache
+// -----------------------------------------------------------------------------
+// PURPOSE       release the operators of a cache
+//
+// INPUT         pCache : the cache to release
+// -----------------------------------------------------------------------------
+
+void XSCONV_ReleaseCache(XSCONV_CACHE *pCache)
+ {
+  INDEX i;
+
+  if (xsconvCache==pCache)
+   xsconvCache=NULL;
+
+  if (pCache->operators!=NULL)
+   {
+    for (i=0;i<pCache->nOperators;i++)
+     XsconvReleaseOperator(&pCache->operators[i]);
+
+    MEMORY_ReleaseBuffer(__func__,"operators",pCache->operators);
+   }
+
+  memset(pCache,0,sizeof(XSCONV_CACHE));
+ }
+
+// --------------------------------------------------------------------------------
+// XSCONV_TypeStandard : Standard convolution of cross section with a slit function
+// --------------------------------------------------------------------------------
+
+//
+// RC XSCONV_TypeStandard(XS *pXsnew,XS *pXshr,XS *pSlit,XS *pI,double *Ic,
+//                        int slitType,double slitWidth,double slitParam)
+//
+// with :
+//
+//  - pXsnew->lambda : final wavelength scale (input);
+//  - pXsnew->vector : pXshr->vector after convolution (output);
+//  - indexLambdaMin,indexLambdaMax : the calibration range to calculate
+//
+//  - pXshr : cross section high resolution (wavelength scale,slit vector and second derivatives);
+//
+//  - pSlit : if wveDptFlag=1 : wavelength dependent slit function parameters (wavelength scale, slit vector and second derivatives);
+//  - slitParam : if wveDptFlag=0 : slit function parameters (constants)
+//
+//  - pI,Ic : these extra parameters are mainly used when I0 correction is applied in order to speed up total convolution
+//            work because integrals of I and I0 can be computed simultaneously;
+//
+//    if I0 correction is applied, Ic is the I convoluted vector;
+//    if no I0 correction is applied, Ic is set to NULL but pI is set to pXshr in order to avoid extra tests in loops;
+//
+//    the computed integral is then the same as pXshr's one and is not used;
+//
+//  - slitType : type of slit function;
+//
+// NB : pI->lambda==pXshr->lambda.
+//
+// The convolution is linear in the high resolution cross section : its weights are
+// calculated once in an operator (XsconvBuildOperator) that is kept in the cache selected
+// by XSCONV_SelectCache if any, and reused for the other cross sections convolved on the
+// same grids with the same slit function.
+//
+
+RC XSCONV_TypeStandard(MATRIX_OBJECT *pXsnew,INDEX indexLambdaMin,INDEX indexLambdaMax,const MATRIX_OBJECT *pXshr,
+                          const MATRIX_OBJECT *pI, double *Ic,int slitType,const MATRIX_OBJECT *slitMatrix, double *slitParam,int wveDptFlag)
+ {
+  // Declarations
+
+  XSCONV_OPERATOR operatorTmp,*pOperator;
+  XSCONV_CACHE *pCache;
+  INDEX indexMin,indexMax,i;
+  RC rc;
+
+  // Initializations
+
+  pCache=xsconvCache;
+  pOperator=NULL;
+  rc=ERROR_ID_NO;
+
+  indexMin=max(0,indexLambdaMin);
+  indexMax=min(pXsnew->nl,indexLambdaMax);
+
+  if (indexMin>=indexMax)
+   return rc;
+
+  // Search for an operator built for the same grids and slit function
+
+  if (pCache!=NULL)
+   for (i=0;(i<pCache->nOperators) && (pOperator==NULL);i++)
+    if (XsconvMatchOperator(&pCache->operators[i],pXsnew->matrix[0],indexMin,indexMax,pXshr->matrix[0],pXshr->nl,slitType,slitMatrix,slitParam,wveDptFlag))
+     pOperator=&pCache->operators[i];
+
+  // Otherwise, build it (in the cache if any, replacing the oldest operator when the cache is full)
+
+  if (pOperator==NULL)
+   {
+    if (pCache==NULL)
+     pOperator=&operatorTmp;
+    else if ((pCache->operators==NULL) &&
+            ((pCache->operators=(XSCONV_OPERATOR *)MEMORY_AllocBuffer(__func__,"operators",XSCONV_CACHE_SIZE,sizeof(XSCONV_OPERATOR),0,MEMORY_TYPE_STRUCT))==NULL))
+     rc=ERROR_ID_ALLOC;
+    else if (pCache->nOperators<XSCONV_CACHE_SIZE)
+     pOperator=&pCache->operators[pCache->nOperators++];
+    else
+     {
+      pOperator=&pCache->operators[pCache->indexNext];
+      pCache->indexNext=(pCache->indexNext+1)%XSCONV_CACHE_SIZE;
+      XsconvReleaseOperator(pOperator);
+     }
+
+    if (!rc)
+     rc=XsconvBuildOperator(pOperator,pXsnew->matrix[0],indexMin,indexMax,pXshr->matrix[0],pXshr->nl,slitType,slitMatrix,slitParam,wveDptFlag);
+   }
+
+  // Convolution of the cross section (and of I for the I0 correction)
+
+  else if (wveDptFlag)
+   memcpy(slitParam,pOperator->rowSlitParam+(indexMax-1-pOperator->indexMin)*NSFP,sizeof(double)*NSFP);
+
+  if (!rc)
+   {
+    XsconvApplyOperator(pOperator,indexMin,indexMax,pXshr->matrix[1],(pXshr->deriv2!=NULL)?pXshr->deriv2[1]:NULL,pXsnew->matrix[1]);
+
+    if (Ic!=NULL)
+     XsconvApplyOperator(pOperator,indexMin,indexMax,pI->matrix[1],(pI->deriv2!=NULL)?pI->deriv2[1]:NULL,Ic);
+   }
+
+  if (pOperator==&operatorTmp)
+   XsconvReleaseOperator(&operatorTmp);
+
   // Return
 
   return rc;
@@ -34,9 +34,25 @@ extern "C" {
   RC   XSCONV_GetFwhm(const double *lambda, const double *slit, const double *deriv2,int nl,int slitType,double *slitParam);
   RC   XSCONV_TypeNone(MATRIX_OBJECT *pXsnew,MATRIX_OBJECT *pXshr);
   RC   XSCONV_TypeGauss(const double *lambda, const double *Spec, const double *SDeriv2,double lambdaj,double dldj,double *SpecConv,double fwhm,double n,int slitType, int ndet);
+  RC   XSCONV_TypeGaussVector(const double *lambda,const double *Spec,const double *SDeriv2,int ndet,const double *lambdaj,const double *dldj,const double *fwhm,double *SpecConv,int n,int interpol);
   RC   XSCONV_TypeStandard(MATRIX_OBJECT *pXsnew,INDEX indexLambdaMin,INDEX indexLambdaMax,const MATRIX_OBJECT *pXshr,const MATRIX_OBJECT *pI, double *Ic,int slitType,const MATRIX_OBJECT *slitMatrix, double *slitParam,int wveDptFlag);
   RC   XSCONV_TypeI0Correction(MATRIX_OBJECT *pXsnew,MATRIX_OBJECT *pXshr,MATRIX_OBJECT *pI0,double conc,int slitType,MATRIX_OBJECT *slitMatrix,double *slitParam,int wveDptFlag);
 
+  // Cache of the convolution operators of XSCONV_TypeStandard
+
+  typedef struct _xsconvOperator XSCONV_OPERATOR;
+
+  typedef struct _xsconvCache
+   {
+    XSCONV_OPERATOR *operators;                                                 // operators built while the cache is selected
+    int              nOperators;                                                // number of operators in use
+    int              indexNext;                                                 // next operator to replace when the cache is full
+   }
+  XSCONV_CACHE;
+
+  XSCONV_CACHE *XSCONV_SelectCache(XSCONV_CACHE *pCache);
+  void XSCONV_ReleaseCache(XSCONV_CACHE *pCache);
+
   // Cross section to convolute
   struct _FFT {
     double *fftIn;
@@ -3,6 +3,7 @@
   algorithm.  Copyright (C) 2007  S[&]T and BIRA
 */
 
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
@@ -19,8 +20,11 @@
 #include "analyse.h"
 #include "spectrum_files.h"
 #include "output.h"
+#include "output_netcdf.h"
 #include "kurucz.h"
+#include "xsconv.h"
 #include "svd.h"
+#include "curfit.h"
 #include "winthrd.h"
 
 #include "radiance_ref.h"
@@ -30,10 +34,17 @@
 #include "gome1netcdf_read.h"
 #include "apex_read.h"
 #include "gems_read.h"
+#include "l1_preload.h"
 #include "mfc-read.h"
 
 #include "matrix_netcdf_read.h"
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+static int mediateSetupThreadsN=1;                                              // number of threads preparing the rows of imagers (see mediateRequestSetSetupThreads)
+
 int mediateRequestDisplaySpecInfo(void *engineContext,int page,void *responseHandle)
  {
    // Declarations
@@ -1645,6 +1656,93 @@ RC mediateRequestSetAnalysisNonLinearDoas(ENGINE_CONTEXT *pEngineContext, const
    return rc;
  }
 
+// Result of the preparation of a row (see mediateSetAnalysisRow)
+
+typedef struct _mediateRowSetup
+ {
+  RC rc;                                                                        // return code of the row
+  int fatal;                                                                    // set if the error must stop the session
+  ERROR_DESCRIPTION *errors;                                                    // errors registered by the row (see ERROR_Save)
+  int nErrors;                                                                  // number of errors of the row
+ }
+MEDIATE_ROW_SETUP;
+
+// mediateSetAnalysisRow : convolve the cross sections of the analysis windows of a row,
+// allocate the Kurucz buffers and calibrate and align the reference spectra of the row.
+//
+// The function only modifies the analysis windows and the Kurucz buffers of the row
+// and the workspace ws, so that several rows can be prepared at the same time.
+
+static RC mediateSetAnalysisRow(ENGINE_CONTEXT *pEngineContext,struct analysis_workspace *ws,INDEX indexFenoColumn,
+                                int useKurucz,int xsToConvolute,INDEX indexKurucz,double lambdaMin,double lambdaMax,
+                                MATRIX_OBJECT *hr_solar_temp,MATRIX_OBJECT *slit_matrix_temp,int saveFlag,
+                                int *pFatal,void *responseHandle)
+ {
+   // Declarations
+
+   XSCONV_CACHE xsconvCache;                                                     // convolution operators shared by the cross sections of the row
+   double slitParam[NSFP];                                                       // overwritten by wavelength dependent slit functions
+   FENO *pTabFeno;
+   RC rc;
+
+   // Initializations
+
+   memset(&xsconvCache,0,sizeof(xsconvCache));
+   memcpy(slitParam,ANALYSIS_slitParam,sizeof(double)*NSFP);
+   *pFatal=0;
+   rc=ERROR_ID_NO;
+
+   // the cross sections of the row are convolved on the same grid : the convolution operators are built once for all of them
+
+   XSCONV_SelectCache(&xsconvCache);
+
+   for (int indexWindow=0;(indexWindow<NFeno) && !rc;indexWindow++)
+    {
+     pTabFeno=&TabFeno[indexFenoColumn][indexWindow];
+
+     if (pTabFeno->saveResidualsFlag && !pTabFeno->hidden &&
+       ((pTabFeno->residualSpectrum=(double *)MEMORY_AllocDVector(__func__,"residualSpectrum",0,pTabFeno->fit_properties.DimL))==NULL))
+        break;
+
+     if ((xsToConvolute && !useKurucz) || !pKuruczOptions->fwhmFit)
+      {
+       if ((pSlitOptions->slitFunction.slitType==SLIT_TYPE_NONE) && pTabFeno->xsToConvolute)
+         rc = ERROR_SetLast(__func__, ERROR_TYPE_FATAL, ERROR_ID_CONVOLUTION);
+       else if ((pTabFeno->gomeRefFlag || pEngineContext->refFlag) &&         // test on pTabFeno->xsToConvolute done in ANALYSE_XsConvolution (molecular ring done in this function for both convolution and interpolation)
+               ((rc=ANALYSE_XsConvolution(pTabFeno,pTabFeno->LambdaRef,ANALYSIS_slitMatrix,slitParam,pSlitOptions->slitFunction.slitType,indexFenoColumn,pSlitOptions->slitFunction.slitWveDptFlag))!=0))
+         break;
+      }
+    }
+
+   if (!rc) {
+     // Allocate Kurucz buffers on Run Calibration or
+     //                            Run Analysis and wavelength calibration is different from None at least for one spectral window
+     //
+     // Apply the calibration procedure on the reference spectrum if the wavelength calibration is different from None at least for one spectral window
+
+     if ((THRD_id==THREAD_TYPE_KURUCZ) || useKurucz) {
+
+       rc=KURUCZ_Alloc(&pEngineContext->project,pEngineContext->buffers.lambda,indexKurucz,lambdaMin,lambdaMax,indexFenoColumn,hr_solar_temp,slit_matrix_temp);
+       if (rc) {
+         *pFatal=1; // If KURUCZ_Alloc fails, there is a fatal configuration error.
+       }
+
+       // the reference spectrum is corrected by the instrument function if any
+       else if (useKurucz) {
+         rc=KURUCZ_Reference(ws,pEngineContext->buffers.instrFunction,0,saveFlag,1,responseHandle,indexFenoColumn);
+       }
+     }
+
+     if (!rc && (THRD_id!=THREAD_TYPE_KURUCZ)) {
+       rc=ANALYSE_AlignReference(ws,pEngineContext,0,responseHandle,indexFenoColumn);
+     }
+   }
+
+   XSCONV_ReleaseCache(&xsconvCache);
+
+   return rc;
+ }
+
 int mediateRequestSetAnalysisWindows(void *engineContext,
                      int numberOfWindows,
                      const mediate_analysis_window_t *analysisWindows,
@@ -1668,6 +1766,10 @@ int mediateRequestSetAnalysisWindows(void *engineContext,
    int indexFeno,indexFenoColumn;                                                // browse analysis windows
    int n_wavel_temp1, n_wavel_temp2;                                             // temporary spectral channel
    MATRIX_OBJECT hr_solar_temp,  slit_matrix_temp;                               // to preload high res solar spectrum and slit function matrix
+   MEDIATE_ROW_SETUP *rowSetup;                                                  // result of the preparation of each row
+   struct analysis_workspace *setupWorkspaces;                                   // workspaces of the threads preparing the rows
+   ERROR_DESCRIPTION *pendingErrors;                                             // errors registered before the preparation of the rows
+   int nSetupThreads,nPendingErrors;
    RC rc;                                                                        // return code
 
    // Initializations
@@ -1692,6 +1794,9 @@ int mediateRequestSetAnalysisWindows(void *engineContext,
    memset(&calibWindows,0,sizeof(mediate_analysis_window_t));
    memset(&hr_solar_temp, 0, sizeof(hr_solar_temp));
    memset(&slit_matrix_temp, 0, sizeof(slit_matrix_temp));
+   rowSetup=NULL;
+   setupWorkspaces=NULL;
+   nSetupThreads=1;
 
    memcpy(&calibWindows.crossSectionList,&pEngineContext->calibFeno.crossSectionList,sizeof(cross_section_list_t));
    memcpy(&calibWindows.linear,&pEngineContext->calibFeno.linear,sizeof(struct anlyswin_linear));
@@ -2014,62 +2119,97 @@ int mediateRequestSetAnalysisWindows(void *engineContext,
    if (rc)
      goto handle_errors;
 
-   for (indexFenoColumn=0;(indexFenoColumn<ANALYSE_swathSize) && !rc;indexFenoColumn++) {
+   // The rows are independent once the cross sections are loaded in the WorkSpace : prepare them on
+   // several threads if requested (see mediateRequestSetSetupThreads), each one with its own workspace
+   // for the fits.  The errors of the rows are collected and reported in the order of the rows.
+   // The calibration of the rows is not thread-safe when the slit function is fitted (pKURUCZ_fft
+   // points to the FFT of the current row) or when the undersampling cross sections are built at
+   // each iteration.
 
-     if (!pEngineContext->project.instrumental.use_row[indexFenoColumn])
-       continue;
+   if (ANALYSE_swathSize>1)
+    {
+     int autoUsamp=0;                                                            // the calibration window of one of the rows uses the automatic undersampling
+
+     if (useKurucz && (indexKurucz!=ITEM_NONE) && (pEngineContext->project.usamp.method==PRJCT_USAMP_AUTOMATIC))
+      for (indexFenoColumn=0;(indexFenoColumn<ANALYSE_swathSize) && !autoUsamp;indexFenoColumn++)
+       autoUsamp=pEngineContext->project.instrumental.use_row[indexFenoColumn] && TabFeno[indexFenoColumn][indexKurucz].useUsamp;
+
+     if (!useKurucz || (!pKuruczOptions->fwhmFit && !autoUsamp))
+      nSetupThreads=min(mediateSetupThreadsN,ANALYSE_swathSize);
+    }
+
+   if (((rowSetup=(MEDIATE_ROW_SETUP *)MEMORY_AllocBuffer(__func__,"rowSetup",ANALYSE_swathSize,sizeof(MEDIATE_ROW_SETUP),0,MEMORY_TYPE_STRUCT))==NULL) ||
+       ((nSetupThreads>1) &&
+        ((setupWorkspaces=(struct analysis_workspace *)MEMORY_AllocBuffer(__func__,"setupWorkspaces",nSetupThreads,sizeof(struct analysis_workspace),0,MEMORY_TYPE_STRUCT))==NULL)))
+    {
+     rc=ERROR_ID_ALLOC;
+     goto handle_errors;
+    }
+
+   memset(rowSetup,0,sizeof(MEDIATE_ROW_SETUP)*ANALYSE_swathSize);
+
+   if (setupWorkspaces!=NULL)
+    {
+     memset(setupWorkspaces,0,sizeof(struct analysis_workspace)*nSetupThreads);
 
-     for (indexWindow=0;(indexWindow<NFeno) && !rc;indexWindow++)
+     for (int i=0;(i<nSetupThreads) && !rc;i++)
+      rc=ANALYSE_WorkspaceAlloc(&setupWorkspaces[i],max_ndet);
+
+     if (rc)
+      goto handle_errors;
+    }
+
+   nPendingErrors=ERROR_Save(&pendingErrors);
+
+   #if defined(_OPENMP)
+   #pragma omp parallel for num_threads(nSetupThreads) schedule(dynamic,1) if(nSetupThreads>1)
+   #endif
+   for (int indexRow=0;indexRow<ANALYSE_swathSize;indexRow++)
+    {
+     MEDIATE_ROW_SETUP *pRowSetup=&rowSetup[indexRow];
+
+     if (pEngineContext->project.instrumental.use_row[indexRow])
       {
-       pTabFeno=&TabFeno[indexFenoColumn][indexWindow];
-
-       if (pTabFeno->saveResidualsFlag && !pTabFeno->hidden &&
-         ((pTabFeno->residualSpectrum=(double *)MEMORY_AllocDVector(__func__,"residualSpectrum",0,pTabFeno->fit_properties.DimL))==NULL))
-          break;
-
-       if ((xsToConvolute && !useKurucz) || !pKuruczOptions->fwhmFit)
-        {
-         if ((pSlitOptions->slitFunction.slitType==SLIT_TYPE_NONE) && pTabFeno->xsToConvolute)
-           rc = ERROR_SetLast(__func__, ERROR_TYPE_FATAL, ERROR_ID_CONVOLUTION);
-         else if ((pTabFeno->gomeRefFlag || pEngineContext->refFlag) &&         // test on pTabFeno->xsToConvolute done in ANALYSE_XsConvolution (molecular ring done in this function for both convolution and interpolation)
-                 ((rc=ANALYSE_XsConvolution(pTabFeno,pTabFeno->LambdaRef,ANALYSIS_slitMatrix,ANALYSIS_slitParam,pSlitOptions->slitFunction.slitType,indexFenoColumn,pSlitOptions->slitFunction.slitWveDptFlag))!=0))
-           break;
-        }
-      }
+       #if defined(_OPENMP)
+       struct analysis_workspace *ws=(setupWorkspaces!=NULL)?&setupWorkspaces[omp_get_thread_num()]:&ANALYSE_mainWorkspace;
+       #else
+       struct analysis_workspace *ws=&ANALYSE_mainWorkspace;
+       #endif
 
-     if (!rc) {
-       // Allocate Kurucz buffers on Run Calibration or
-       //                            Run Analysis and wavelength calibration is different from None at least for one spectral window
-       //
-       // Apply the calibration procedure on the reference spectrum if the wavelength calibration is different from None at least for one spectral window
+       pRowSetup->rc=mediateSetAnalysisRow(pEngineContext,ws,indexRow,useKurucz,xsToConvolute,indexKurucz,lambdaMin,lambdaMax,
+                                           &hr_solar_temp,&slit_matrix_temp,saveFlag,&pRowSetup->fatal,responseHandle);
 
-       if ((THRD_id==THREAD_TYPE_KURUCZ) || useKurucz) {
+       pRowSetup->nErrors=ERROR_Save(&pRowSetup->errors);                       // the error stack is private to the thread
+      }
+    }
 
-         rc=KURUCZ_Alloc(&pEngineContext->project,pEngineContext->buffers.lambda,indexKurucz,lambdaMin,lambdaMax,indexFenoColumn, &hr_solar_temp, &slit_matrix_temp);
-         if (rc) {
-           goto handle_errors; // If KURUCZ_Alloc fails, there is a fatal configuration error.
-         }
+   // Report the errors in the order of the rows, as if the rows had been prepared one after the other
 
-         // the reference spectrum is corrected by the instrument function if any
-         if (useKurucz) {
-           rc=KURUCZ_Reference(pEngineContext->buffers.instrFunction,0,saveFlag,1,responseHandle,indexFenoColumn);
-         }
-       }
+   ERROR_Restore(pendingErrors,nPendingErrors);
 
-       if (!rc && (THRD_id!=THREAD_TYPE_KURUCZ)) {
-         rc=ANALYSE_AlignReference(pEngineContext,0,responseHandle,indexFenoColumn);
-       }
+   for (indexFenoColumn=0;indexFenoColumn<ANALYSE_swathSize;indexFenoColumn++) {
+     MEDIATE_ROW_SETUP *pRowSetup=&rowSetup[indexFenoColumn];
+
+     if (rc) {                                                                   // the rows after a fatal error are ignored
+       free(pRowSetup->errors);
+       continue;
      }
 
-     if ( (ANALYSE_swathSize > 1) && rc) {
+     ERROR_Restore(pRowSetup->errors,pRowSetup->nErrors);
+
+     if (pRowSetup->fatal || ((ANALYSE_swathSize==1) && pRowSetup->rc))
+       rc=pRowSetup->rc;
+     else if (pRowSetup->rc) {
        // Error on one irradiance spectrum shouldn't stop the analysis of other spectra
        ERROR_SetLast(__func__, ERROR_TYPE_WARNING, ERROR_ID_IMAGER_CALIB, 1+indexFenoColumn);
        imager_err = true;
        for (indexWindow=0;indexWindow<NFeno;indexWindow++)
-         TabFeno[indexFenoColumn][indexWindow].rcKurucz=rc;
-       rc=ERROR_ID_NO;
+         TabFeno[indexFenoColumn][indexWindow].rcKurucz=pRowSetup->rc;
      }
-   }  // for (indexFenoColumn=0;(
+   }
+
+   if (rc)
+     goto handle_errors;
 
    // OMI SEE LATER
 
@@ -2086,6 +2226,14 @@ int mediateRequestSetAnalysisWindows(void *engineContext,
    MATRIX_Free(&hr_solar_temp, __func__);
    MATRIX_Free(&slit_matrix_temp, __func__);
 
+   if (setupWorkspaces!=NULL) {
+     for (int i=0;i<nSetupThreads;i++)
+       ANALYSE_WorkspaceFree(&setupWorkspaces[i]);
+     MEMORY_ReleaseBuffer(__func__,"setupWorkspaces",setupWorkspaces);
+   }
+   if (rowSetup!=NULL)
+     MEMORY_ReleaseBuffer(__func__,"rowSetup",rowSetup);
+
    if (rc!=ERROR_ID_NO) {
      ERROR_DisplayMessage(responseHandle);
    } else if (imager_err) {
@@ -2453,6 +2601,100 @@ int mediateRequestBeginAnalyseSpectra(void *engineContext,
    }
  }
 
+int mediateRequestSetRecordRange(void *engineContext,int firstRecord,int lastRecord,int indexShard,int numberOfShards,void *responseHandle)
+ {
+   ENGINE_CONTEXT *pEngineContext = (ENGINE_CONTEXT *)engineContext;
+   PRJCT_SPECTRA *pSpectra=&pEngineContext->project.spectra;
+   int n_crosstrack=(pEngineContext->n_crosstrack>1)?pEngineContext->n_crosstrack:1;
+
+   // When only the successful records are saved (MAX-DOAS netCDF output, see netcdf_open), the
+   // records of the output file are not the records of the spectra file : the outputs of the
+   // shards of the file can't be merged (a single record range never needs to be merged)
+
+   if ((numberOfShards>1) && (pEngineContext->project.asciiResults.file_format==NETCDF) &&
+        pEngineContext->project.asciiResults.successFlag && pEngineContext->maxdoasFlag && (pEngineContext->n_crosstrack==1))
+    {
+     ERROR_SetLast(__func__,ERROR_TYPE_FATAL,ERROR_ID_BAD_ARGUMENTS,"shards are not supported when only successful records are saved in the netCDF output");
+     ERROR_DisplayMessage(responseHandle);
+     return -1;
+    }
+
+   // Records are numbered from 1; 0 means no limit
+
+   int first=(firstRecord>0)?firstRecord:1;
+   int last=((lastRecord>0) && (lastRecord<pEngineContext->recordNumber))?lastRecord:pEngineContext->recordNumber;
+
+   // Shards are made of complete scanlines so that the rows of a scanline are
+   // always analysed by the same process
+
+   if ((numberOfShards>1) && (first<=last))
+    {
+     int firstScan=(first-1)/n_crosstrack;
+     int scansN=(last-1)/n_crosstrack-firstScan+1;
+     int shardFirstScan=firstScan+(int)(((long long)scansN*indexShard)/numberOfShards);
+     int shardLastScan=firstScan+(int)(((long long)scansN*(indexShard+1))/numberOfShards)-1;
+
+     first=max(first,shardFirstScan*n_crosstrack+1);
+     last=min(last,(shardLastScan+1)*n_crosstrack);
+    }
+
+   if (first>last)
+    {
+     // empty range : start after the last record
+
+     first=pEngineContext->recordNumber+1;
+     last=pEngineContext->recordNumber;
+    }
+
+   pSpectra->noMin=first;
+   pSpectra->noMax=last;
+
+   return last-first+1;
+ }
+
+void mediateRequestSetFitThreads(int nThreads)
+ {
+   CURFIT_SetThreads(nThreads);
+   KURUCZ_SetThreads(nThreads);
+ }
+
+void mediateRequestSetSetupThreads(int nThreads)
+ {
+   #if defined(_OPENMP)
+   mediateSetupThreadsN=(nThreads>1)?nThreads:1;
+   #else
+   mediateSetupThreadsN=1;
+   #endif
+
+   KURUCZ_SetThreads(nThreads);
+ }
+
+void mediateRequestSetQRUpdate(int enable)
+ {
+   ANALYSE_SetQRUpdate(enable);
+ }
+
+void mediateRequestSetWarmStart(int enable)
+ {
+   ANALYSE_SetWarmStart(enable);
+ }
+
+void mediateRequestSetPreloadL1(int megabytes)
+ {
+   L1_SetPreloadBudget(megabytes);
+ }
+
+int mediateRequestMergeShards(const char *outputFileName,const char **shardFileNames,int numberOfShards,void *responseHandle)
+ {
+   if (netcdf_merge_files(outputFileName,shardFileNames,numberOfShards)!=ERROR_ID_NO)
+    {
+     ERROR_DisplayMessage(responseHandle);
+     return -1;
+    }
+
+   return 0;
+ }
+
 int mediateRequestNextMatchingAnalyseSpectrum(void *engineContext,
                           void *responseHandle)
  {
@@ -2482,7 +2724,7 @@ int mediateRequestNextMatchingAnalyseSpectrum(void *engineContext,
      ANALYSE_InitResults();
 
      if (!pEngineContext->analysisRef.refAuto || pEngineContext->satelliteFlag || ((pEngineContext->recordInfo.rc=EngineNewRef(pEngineContext,responseHandle))==ERROR_ID_NO))
-      pEngineContext->recordInfo.rc=ANALYSE_Spectrum(pEngineContext,responseHandle);
+      pEngineContext->recordInfo.rc=ANALYSE_Spectrum(&ANALYSE_mainWorkspace,pEngineContext,responseHandle);
 
     if ((pEngineContext->mfcDoasisFlag || (pEngineContext->lastSavedRecord!=pEngineContext->indexRecord)) &&
         (   ((THRD_id==THREAD_TYPE_ANALYSIS) && pEngineContext->project.asciiResults.analysisFlag && (!pEngineContext->project.asciiResults.successFlag || !pEngineContext->recordInfo.rc )) // (!pEngineContext->project.asciiResults.successFlag /* || nrc */))
@@ -2503,6 +2745,195 @@ int mediateRequestNextMatchingAnalyseSpectrum(void *engineContext,
    return ((pEngineContext->recordInfo.rc != ERROR_ID_REF_ALIGNMENT) || pEngineContext->analysisRef.refScan) ? rec : -1;
  }
 
+// ============================================================================
+// Analysis of the rows of a scanline by concurrent workers (imagers only)
+// ============================================================================
+
+static ENGINE_CONTEXT *mediateScanlineRows=NULL;                                // copies of the engine context, one per row of the current scanline
+static struct analysis_workspace *mediateScanlineWorkspaces=NULL;               // fit workspaces, one per worker
+static int mediateScanlineRowsN=0;                                              // number of rows read for the current scanline
+static int mediateScanlineRowsMax=0;                                            // number of allocated row contexts
+static int mediateScanlineWorkersN=0;                                           // number of allocated workspaces
+
+// mediateScanlineAllowed : only analysis of imager formats without shared
+// per-spectrum state (undersampling, Kurucz applied on the spectra) can be
+// dispatched to concurrent workers; the residuals appended to a text file by
+// ANALYSE_Spectrum would be interleaved in an arbitrary order by the workers
+
+static int mediateScanlineAllowed(const ENGINE_CONTEXT *pEngineContext)
+ {
+   int format=pEngineContext->project.instrumental.readOutFormat;
+
+   if ((THRD_id!=THREAD_TYPE_ANALYSIS) || (ANALYSE_swathSize<=1) ||
+       ((format!=PRJCT_INSTR_FORMAT_TROPOMI) &&
+        (format!=PRJCT_INSTR_FORMAT_OMI) &&
+        (format!=PRJCT_INSTR_FORMAT_OMIV4) &&
+        (format!=PRJCT_INSTR_FORMAT_OMPS) &&
+        (format!=PRJCT_INSTR_FORMAT_GEMS)))
+    return 0;
+
+   for (int indexFenoColumn=0;indexFenoColumn<ANALYSE_swathSize;indexFenoColumn++)
+    for (int indexFeno=0;indexFeno<NFeno;indexFeno++)
+     {
+      const FENO *pTabFeno=&TabFeno[indexFenoColumn][indexFeno];
+
+      if (!pTabFeno->hidden &&
+          (pTabFeno->useUsamp ||
+           (pTabFeno->useKurucz==ANLYS_KURUCZ_SPEC) ||
+           (pTabFeno->useKurucz==ANLYS_KURUCZ_REF_AND_SPEC) ||
+           (strlen(pTabFeno->residualsFile) && (!pTabFeno->saveResidualsFlag || (pTabFeno->residualSpectrum==NULL)))))
+       return 0;
+     }
+
+   return 1;
+ }
+
+void mediateRequestEndAnalyseScanlines(void)
+ {
+   if (mediateScanlineRows!=NULL)
+    {
+     for (int i=0;i<mediateScanlineRowsMax;i++)
+      EngineResetContext(&mediateScanlineRows[i]);
+
+     MEMORY_ReleaseBuffer(__func__,"mediateScanlineRows",mediateScanlineRows);
+    }
+
+   if (mediateScanlineWorkspaces!=NULL)
+    {
+     for (int i=0;i<mediateScanlineWorkersN;i++)
+      ANALYSE_WorkspaceFree(&mediateScanlineWorkspaces[i]);
+
+     MEMORY_ReleaseBuffer(__func__,"mediateScanlineWorkspaces",mediateScanlineWorkspaces);
+    }
+
+   mediateScanlineRows=NULL;
+   mediateScanlineWorkspaces=NULL;
+   mediateScanlineRowsN=mediateScanlineRowsMax=mediateScanlineWorkersN=0;
+ }
+
+int mediateRequestBeginAnalyseScanlines(void *engineContext,int numberOfWorkers,void *responseHandle)
+ {
+   ENGINE_CONTEXT *pEngineContext = (ENGINE_CONTEXT *)engineContext;
+   RC rc=ERROR_ID_NO;
+
+   mediateRequestEndAnalyseScanlines();
+
+   if ((numberOfWorkers<=1) || !mediateScanlineAllowed(pEngineContext))
+    return 0;
+
+   int max_ndet = 0;
+   for (int i=0; i<ANALYSE_swathSize; ++i) {
+     if (NDET[i] > max_ndet)
+       max_ndet = NDET[i];
+   }
+
+   if (((mediateScanlineRows=(ENGINE_CONTEXT *)MEMORY_AllocBuffer(__func__,"mediateScanlineRows",ANALYSE_swathSize,sizeof(ENGINE_CONTEXT),0,MEMORY_TYPE_STRUCT))==NULL) ||
+       ((mediateScanlineWorkspaces=(struct analysis_workspace *)MEMORY_AllocBuffer(__func__,"mediateScanlineWorkspaces",numberOfWorkers,sizeof(struct analysis_workspace),0,MEMORY_TYPE_STRUCT))==NULL))
+    rc=ERROR_ID_ALLOC;
+   else
+    {
+     memset(mediateScanlineRows,0,sizeof(ENGINE_CONTEXT)*ANALYSE_swathSize);
+     memset(mediateScanlineWorkspaces,0,sizeof(struct analysis_workspace)*numberOfWorkers);
+
+     mediateScanlineRowsMax=ANALYSE_swathSize;
+
+     for (int i=0;(i<numberOfWorkers) && !rc;i++,mediateScanlineWorkersN++)
+      rc=ANALYSE_WorkspaceAlloc(&mediateScanlineWorkspaces[i],max_ndet);
+    }
+
+   if (rc!=ERROR_ID_NO)
+    {
+     mediateRequestEndAnalyseScanlines();
+     ERROR_DisplayMessage(responseHandle);
+     return -1;
+    }
+
+   return mediateScanlineWorkersN;
+ }
+
+int mediateRequestNextMatchingAnalyseScanline(void *engineContext,void *responseHandle)
+ {
+   ENGINE_CONTEXT *pEngineContext = (ENGINE_CONTEXT *)engineContext;
+   RECORD_INFO *pRecord=&pEngineContext->recordInfo;
+   int i_alongtrack=ITEM_NONE;
+   int rec=0;
+
+   mediateScanlineRowsN=0;
+
+   // Read the matching records of the scanline one after the other; the readers are not re-entrant
+
+   while (mediateScanlineRowsN<mediateScanlineRowsMax)
+    {
+     if (((rec=mediateRequestNextMatchingSpectrum(pEngineContext,responseHandle))<=0) ||
+         (pEngineContext->indexRecord>pEngineContext->recordNumber))
+      break;
+
+     if ((pEngineContext->project.instrumental.readOutFormat==PRJCT_INSTR_FORMAT_OMI) &&
+          pEngineContext->analysisRef.refAuto && !omi_has_automatic_reference(pRecord->i_crosstrack))
+      continue;
+
+     if (i_alongtrack==ITEM_NONE)
+      i_alongtrack=pRecord->i_alongtrack;
+     else if (pRecord->i_alongtrack!=i_alongtrack)
+      {
+       // first record of the next scanline : read it again with the next call
+
+       pEngineContext->currentRecord=pEngineContext->indexRecord;
+       break;
+      }
+
+     if (EngineCopyContext(&mediateScanlineRows[mediateScanlineRowsN],pEngineContext)!=ERROR_ID_NO)
+      {
+       ERROR_DisplayMessage(responseHandle);
+       return -1;
+      }
+
+     mediateRequestPlotSpectra(&mediateScanlineRows[mediateScanlineRowsN++],responseHandle);
+    }
+
+   if (rec<0)
+    return -1;
+
+   if (mediateScanlineRowsN)
+    ANALYSE_InitResults();
+
+   return mediateScanlineRowsN;
+ }
+
+int mediateRequestAnalyseScanlineRow(int indexRow,int indexWorker,void *responseHandle)
+ {
+   ENGINE_CONTEXT *pRowContext=&mediateScanlineRows[indexRow];
+
+   // Each row has its own analysis windows (TabFeno[i_crosstrack]), each worker its own workspace
+
+   pRowContext->recordInfo.rc=ANALYSE_Spectrum(&mediateScanlineWorkspaces[indexWorker],pRowContext,responseHandle);
+
+   // The error stack is private to the worker thread : flush it in the response of the row
+
+   if (pRowContext->recordInfo.rc!=ERROR_ID_NO)
+    ERROR_DisplayMessage(responseHandle);
+
+   return pRowContext->recordInfo.rc;
+ }
+
+int mediateRequestSaveScanlineRow(void *engineContext,int indexRow,void *responseHandle)
+ {
+   ENGINE_CONTEXT *pEngineContext = (ENGINE_CONTEXT *)engineContext;
+   ENGINE_CONTEXT *pRowContext=&mediateScanlineRows[indexRow];
+
+   if ((pRowContext->lastSavedRecord!=pRowContext->indexRecord) &&
+        pRowContext->project.asciiResults.analysisFlag &&
+       (!pRowContext->project.asciiResults.successFlag || !pRowContext->recordInfo.rc))
+    {
+     if ((pRowContext->recordInfo.rc=OUTPUT_SaveResults(pRowContext,pRowContext->recordInfo.i_crosstrack))!=ERROR_ID_NO)
+      ERROR_DisplayMessage(responseHandle);
+
+     pEngineContext->lastSavedRecord=pRowContext->lastSavedRecord;
+    }
+
+   return ((pRowContext->recordInfo.rc != ERROR_ID_REF_ALIGNMENT) || pRowContext->analysisRef.refScan) ? pRowContext->indexRecord : -1;
+ }
+
 int mediateRequestPrevMatchingAnalyseSpectrum(void *engineContext,
                           void *responseHandle)
  {
@@ -2535,7 +2966,7 @@ int mediateRequestNextMatchingCalibrateSpectrum(void *engineContext,
    if (rec > 0 && (pEngineContext->indexRecord<=pEngineContext->recordNumber))
     {
      mediateRequestPlotSpectra(pEngineContext,responseHandle);
-     if ((rc = ANALYSE_Spectrum(pEngineContext,responseHandle))!=ERROR_ID_NO)
+     if ((rc = ANALYSE_Spectrum(&ANALYSE_mainWorkspace,pEngineContext,responseHandle))!=ERROR_ID_NO)
       ERROR_DisplayMessage(responseHandle);
     }
 
@@ -228,6 +228,75 @@ int mediateRequestNextMatchingExportSpectrum(void *engineContext, void *response
   int mediateRequestBeginAnalyseSpectra(void *engineContext, const char *configFileName, const char *spectraFileName, void *responseHandle);
 
 
+// mediateRequestSetRecordRange
+//
+// restrict the records of the current spectra file to [firstRecord,lastRecord]
+// (1-based, 0 for no limit). If numberOfShards>1, the range is further split into
+// numberOfShards parts made of complete scanlines and only part indexShard
+// (0..numberOfShards-1) is kept. Must be called after mediateRequestBeginAnalyseSpectra
+// or mediateRequestBeginCalibrateSpectra. Returns the number of selected records, or
+// -1 if the outputs of the shards can't be merged (MAX-DOAS netCDF output of the
+// successful records only).
+
+int mediateRequestSetRecordRange(void *engineContext, int firstRecord, int lastRecord, int indexShard, int numberOfShards, void *responseHandle);
+
+
+// mediateRequestSetFitThreads
+//
+// set the number of threads used to evaluate the numeric derivatives of the fitting
+// function in the Marquardt-Levenberg fits and to fit the sub-windows of the Kurucz
+// calibration (1 by default).  Must be 1 when several fits are run at the same time
+// (see mediateRequestAnalyseScanlineRow).
+
+void mediateRequestSetFitThreads(int nThreads);
+
+
+// mediateRequestSetSetupThreads
+//
+// set the number of threads used by mediateRequestSetAnalysisWindows to prepare the
+// rows of imagers (convolution of the cross sections, Kurucz calibration and alignment
+// of the reference spectra) at the same time (1 by default).  The tables of results
+// sent to the response handle by the rows are then interleaved.  When the rows are
+// prepared one after the other, the threads fit the sub-windows of the Kurucz calibration.
+
+void mediateRequestSetSetupThreads(int nThreads);
+
+
+// mediateRequestSetQRUpdate
+//
+// in the Marquardt-Levenberg fits, keep the QR decomposition of the columns of the
+// linear system that don't depend on the non linear parameters and only decompose
+// the other columns at each iteration (disabled by default).
+
+void mediateRequestSetQRUpdate(int enable);
+
+
+// mediateRequestSetWarmStart
+//
+// start the non linear parameters of each fit from the last converged fit of the
+// same analysis window and row instead of their initial values (disabled by default).
+
+void mediateRequestSetWarmStart(int enable);
+
+
+// mediateRequestSetPreloadL1
+//
+// read the spectra of TROPOMI, GEMS and OMPS orbit files in large sequential chunks
+// in a background thread, ahead of the records analysed, keeping at most megabytes
+// MB in memory (0, the default, reads the spectra record by record).
+
+void mediateRequestSetPreloadL1(int megabytes);
+
+
+// mediateRequestMergeShards
+//
+// merge the netCDF output files of the shards of a spectra file into outputFileName.
+// Records not analysed in a shard are filled with the values of the other shards.
+// Zero is returned on success, -1 otherwise.
+
+int mediateRequestMergeShards(const char *outputFileName, const char **shardFileNames, int numberOfShards, void *responseHandle);
+
+
 // mediateRequestNextMatchingAnalyseSpectrum
 //
 // attempt to locate and analyse the next spectral record in the current spectra file that
@@ -252,6 +321,47 @@ int mediateRequestNextMatchingExportSpectrum(void *engineContext, void *response
 int mediateRequestNextMatchingAnalyseSpectrum(void *engineContext, void *responseHandle);
 
 
+// mediateRequestBeginAnalyseScanlines
+//
+// prepare the concurrent analysis of the rows of a scanline (imager formats) by
+// numberOfWorkers workers. Must be called after mediateRequestBeginAnalyseSpectra.
+// Returns the number of workers for which a fit workspace was allocated, 0 if the
+// current project does not allow it (the caller should use
+// mediateRequestNextMatchingAnalyseSpectrum instead) and -1 on error.
+
+int mediateRequestBeginAnalyseScanlines(void *engineContext, int numberOfWorkers, void *responseHandle);
+
+// mediateRequestNextMatchingAnalyseScanline
+//
+// read the matching records of the next scanline. Returns the number of rows
+// to analyse, 0 at the end of the file and -1 on error.
+
+int mediateRequestNextMatchingAnalyseScanline(void *engineContext, void *responseHandle);
+
+// mediateRequestAnalyseScanlineRow
+//
+// analyse row indexRow (0..n-1) of the scanline read by the last call to
+// mediateRequestNextMatchingAnalyseScanline using the fit workspace of worker
+// indexWorker. Different rows can be analysed concurrently by different workers;
+// each row needs its own responseHandle.
+
+int mediateRequestAnalyseScanlineRow(int indexRow, int indexWorker, void *responseHandle);
+
+// mediateRequestSaveScanlineRow
+//
+// store the results of row indexRow in the output buffers. Rows should be saved
+// one after the other, in order. Returns the record number of the row, -1 if the
+// processing of the next records is not possible.
+
+int mediateRequestSaveScanlineRow(void *engineContext, int indexRow, void *responseHandle);
+
+// mediateRequestEndAnalyseScanlines
+//
+// release the resources allocated by mediateRequestBeginAnalyseScanlines.
+
+void mediateRequestEndAnalyseScanlines(void);
+
+
 // mediateRequestPrevMatchingAnalyseSpectrum
 //
 // attempt to locate and analyse the previous spectral record in the current spectra file that
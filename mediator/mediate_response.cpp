@@ -6,6 +6,7 @@ algorithm.  Copyright (C) 2007  S[&]T and BIRA
 
 #include <cstdlib>
 #include <cmath>
+#include <mutex>
 #include <stdio.h>
 
 #include "mediate_response.h"
@@ -13,6 +14,11 @@ algorithm.  Copyright (C) 2007  S[&]T and BIRA
 #include "CEngineResponse.h"
 #include "CPlotDataSet.h"
 
+// the rows of imagers can be prepared by several threads sharing the same response
+// (see mediateRequestSetAnalysisWindows) : serialize the updates of the responses
+
+static std::mutex responseMutex;
+
 void mediateAllocateAndSetPlotData(plot_data_t *d, const char *curveName, const double *xData, const double *yData, int len, enum eCurveStyleType type)
 {
   d->curveNumber = -1;
@@ -85,6 +91,7 @@ void mediateResponsePlotData(int page,
                  void *responseHandle)
 {
   CEngineResponseVisual *resp = static_cast<CEngineResponseVisual*>(responseHandle);
+  std::lock_guard<std::mutex> lock(responseMutex);
 
   CPlotDataSet *dataSet = new CPlotDataSet(type, forceAutoScaling, title, xLabel, yLabel);
 
@@ -103,6 +110,7 @@ void mediateResponsePlotData(int page,
 void mediateResponsePlotImage(int page,const char *imageFile,const char *title,void *responseHandle)
  {
   CEngineResponseVisual *resp = static_cast<CEngineResponseVisual*>(responseHandle);
+  std::lock_guard<std::mutex> lock(responseMutex);
 
   CPlotImage *plotImage = new CPlotImage(imageFile,title);
 
@@ -116,6 +124,7 @@ void mediateResponseCellDataDouble(int page,
                    void *responseHandle)
 {
   CEngineResponseVisual *resp = static_cast<CEngineResponseVisual*>(responseHandle);
+  std::lock_guard<std::mutex> lock(responseMutex);
   resp->addCell(page, row, column, QVariant(doubleValue));
 }
 
@@ -126,6 +135,7 @@ void mediateResponseCellDataInteger(int page,
                     void *responseHandle)
 {
   CEngineResponseVisual *resp = static_cast<CEngineResponseVisual*>(responseHandle);
+  std::lock_guard<std::mutex> lock(responseMutex);
   resp->addCell(page, row, column, QVariant(integerValue));
 }
 
@@ -136,6 +146,7 @@ void mediateResponseCellDataString(int page,
                    void *responseHandle)
 {
   CEngineResponseVisual *resp = static_cast<CEngineResponseVisual*>(responseHandle);
+  std::lock_guard<std::mutex> lock(responseMutex);
   resp->addCell(page, row, column, QVariant(QString(stringValue)));
 }
 
@@ -154,6 +165,7 @@ void mediateResponseCellInfo(int page,
   va_end(argList);
 
   CEngineResponseVisual *resp = static_cast<CEngineResponseVisual*>(responseHandle);
+  std::lock_guard<std::mutex> lock(responseMutex);
 
   resp->addCell(page,row,column,QVariant(QString(label)));
   resp->addCell(page,row,column+1,QVariant(QString(stringValue)));
@@ -173,6 +185,7 @@ void mediateResponseCellInfoNoLabel(int page,
    va_end(argList);
 
    CEngineResponseVisual *resp = static_cast<CEngineResponseVisual*>(responseHandle);
+   std::lock_guard<std::mutex> lock(responseMutex);
    resp->addCell(page,row,column,QVariant(QString(stringValue)));
  }
 
@@ -182,12 +195,14 @@ void mediateResponseLabelPage(int page,
                   void *responseHandle)
 {
   CEngineResponseVisual *resp = static_cast<CEngineResponseVisual*>(responseHandle);
+  std::lock_guard<std::mutex> lock(responseMutex);
   resp->addPageTitleAndTag(page, title, tag);
 }
 
 void mediateResponseRetainPage(int page, void * responseHandle)
 {
   CEngineResponseVisual *resp = static_cast<CEngineResponseVisual*>(responseHandle);
+  std::lock_guard<std::mutex> lock(responseMutex);
   // an invalid cell position
   resp->addCell(page, -1, -1, QVariant());
   // a NULL data set
@@ -200,5 +215,6 @@ void mediateResponseErrorMessage(const char *function,
                  void *responseHandle)
 {
   CEngineResponse *resp = static_cast<CEngineResponse*>(responseHandle);
+  std::lock_guard<std::mutex> lock(responseMutex);
   resp->addErrorMessage(QString(function), QString(messageString), errorType);
 }
@@ -412,6 +412,7 @@ RC mediateConvolutionCalculate(void *engineContext,void *responseHandle)
   highFilterType=phFilter->type;           // high pass filtering
 
   plFilter->filterFunction=phFilter->filterFunction=NULL;
+  plFilter->composedFunction=phFilter->composedFunction=NULL;
 
   if ((((lowFilterType=plFilter->type)!=PRJCT_FILTER_TYPE_NONE) &&
         (lowFilterType!=PRJCT_FILTER_TYPE_ODDEVEN) &&
@@ -631,12 +632,24 @@ RC mediateConvolutionCalculate(void *engineContext,void *responseHandle)
     plFilter->filterFunction=NULL;
    }
 
+  if (plFilter->composedFunction!=NULL)
+   {
+    MEMORY_ReleaseDVector("mediateConvolutionCalculate","FILTER_composedFunction",plFilter->composedFunction,1);
+    plFilter->composedFunction=NULL;
+   }
+
   if (phFilter->filterFunction!=NULL)
    {
     MEMORY_ReleaseDVector("mediateConvolutionCalculate","FILTER_function",phFilter->filterFunction,1);
     phFilter->filterFunction=NULL;
    }
 
+  if (phFilter->composedFunction!=NULL)
+   {
+    MEMORY_ReleaseDVector("mediateConvolutionCalculate","FILTER_composedFunction",phFilter->composedFunction,1);
+    phFilter->composedFunction=NULL;
+   }
+
   if (tmpVector!=NULL)
    MEMORY_ReleaseDVector("mediateConvolutionCalculate","tmpVector",tmpVector,0);
   
@@ -29,6 +29,9 @@ CEngineThread::CEngineThread(CQdoasEngineController *parent) :
   int rc = mediateRequestCreateEngineContext(&m_engineContext, resp);
   assert(rc == 0);
   delete resp;
+
+  // records are analysed one at a time : use the available cores for the derivatives of the fits
+  mediateRequestSetFitThreads(QThread::idealThreadCount());
 }
 
 CEngineThread::~CEngineThread()